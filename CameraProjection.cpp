@@ -0,0 +1,298 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CameraProjection.h"
+#include "Constants.h"
+#include "math.h"
+
+//Singleton implementation
+CameraProjection* CameraProjection::mInstance = NULL;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes all matrices to identity.
+ */
+CameraProjection::CameraProjection()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < 16; i++)
+  {
+    mModelView[i] = (i % 5 == 0) ? 1.0 : 0.0;
+    mProjection[i] = mModelView[i];
+    mViewProjection[i] = mModelView[i];
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    mViewport[i] = 0;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+CameraProjection::~CameraProjection()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mInstance = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton pattern implementation. Returns the single instance of this class.
+ *
+ * @return The single instance of this object.
+ */
+CameraProjection* CameraProjection::getInstance()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mInstance == NULL)
+  {
+    mInstance = new CameraProjection();
+  }
+
+  return mInstance;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the viewport, same as glViewport.
+ *
+ * @param x Left edge in pixels
+ * @param y Bottom edge in pixels
+ * @param width Width in pixels
+ * @param height Height in pixels
+ */
+void CameraProjection::setViewport(int x, int y, int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mViewport[0] = x;
+  mViewport[1] = y;
+  mViewport[2] = width;
+  mViewport[3] = height;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Builds the projection matrix the same way gluPerspective does.
+ *
+ * @param fieldOfView Vertical field of view in degrees
+ * @param aspectRatio Width over height
+ * @param nearPlane Distance to the near clipping plane
+ * @param farPlane Distance to the far clipping plane
+ */
+void CameraProjection::setPerspective(double fieldOfView, double aspectRatio, double nearPlane,
+                                      double farPlane)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double f = 1.0 / tan(fieldOfView * 0.5 * Constants::DEGREES_TO_RADIANS);
+
+  for (int i = 0; i < 16; i++)
+  {
+    mProjection[i] = 0.0;
+  }
+  mProjection[0] = f / aspectRatio;
+  mProjection[5] = f;
+  mProjection[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+  mProjection[11] = -1.0;
+  mProjection[14] = 2.0 * farPlane * nearPlane / (nearPlane - farPlane);
+
+  updateViewProjection();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Builds the model-view matrix the same way gluLookAt does on top of an
+ * identity matrix.
+ *
+ * @param eye Camera position
+ * @param center Point the camera looks at
+ * @param up Up direction
+ */
+void CameraProjection::setLookAt(const SimpleVector& eye, const SimpleVector& center,
+                                 const SimpleVector& up)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //forward
+  double fx = center.x - eye.x;
+  double fy = center.y - eye.y;
+  double fz = center.z - eye.z;
+  double length = sqrt(fx*fx + fy*fy + fz*fz);
+  if (length > 0.0)
+  {
+    fx /= length;
+    fy /= length;
+    fz /= length;
+  }
+
+  //side = forward x up
+  double sx = fy*up.z - fz*up.y;
+  double sy = fz*up.x - fx*up.z;
+  double sz = fx*up.y - fy*up.x;
+  length = sqrt(sx*sx + sy*sy + sz*sz);
+  if (length > 0.0)
+  {
+    sx /= length;
+    sy /= length;
+    sz /= length;
+  }
+
+  //recomputed up = side x forward
+  double ux = sy*fz - sz*fy;
+  double uy = sz*fx - sx*fz;
+  double uz = sx*fy - sy*fx;
+
+  mModelView[0] = sx;
+  mModelView[4] = sy;
+  mModelView[8] = sz;
+  mModelView[1] = ux;
+  mModelView[5] = uy;
+  mModelView[9] = uz;
+  mModelView[2] = -fx;
+  mModelView[6] = -fy;
+  mModelView[10] = -fz;
+  mModelView[3] = 0.0;
+  mModelView[7] = 0.0;
+  mModelView[11] = 0.0;
+  mModelView[12] = -(sx*eye.x + sy*eye.y + sz*eye.z);
+  mModelView[13] = -(ux*eye.x + uy*eye.y + uz*eye.z);
+  mModelView[14] = fx*eye.x + fy*eye.y + fz*eye.z;
+  mModelView[15] = 1.0;
+
+  updateViewProjection();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Get method for the model-view matrix.
+ *
+ * @return Model-view matrix, 16 values in column-major order
+ */
+const double* CameraProjection::getModelView() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mModelView;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Get method for the projection matrix.
+ *
+ * @return Projection matrix, 16 values in column-major order
+ */
+const double* CameraProjection::getProjection() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mProjection;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Get method for the viewport.
+ *
+ * @return Viewport as x, y, width and height
+ */
+const int* CameraProjection::getViewport() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mViewport;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Converts the given world coordinates to screen coordinates, same as
+ * gluProject with the matrices of this frame.
+ *
+ * @param worldPosition World coordinates
+ * @return Screen coordinates (z value is used to determine if the position
+ *  lies behind the camera)
+ */
+SimpleVector CameraProjection::worldToScreen(const SimpleVector& worldPosition) const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  SimpleVector screenPosition;
+  worldToScreen(&worldPosition.x, &worldPosition.y, &worldPosition.z,
+                &screenPosition.x, &screenPosition.y, &screenPosition.z, 1);
+
+  return screenPosition;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Batch version of worldToScreen for arrays of positions. Coordinates go in
+ * and out as separate arrays and the loop has no branches, so the compiler
+ * can vectorize it.
+ *
+ * @param x X world coordinates
+ * @param y Y world coordinates
+ * @param z Z world coordinates
+ * @param screenX Returns the X screen coordinates
+ * @param screenY Returns the Y screen coordinates
+ * @param screenZ Returns the Z screen coordinates (used to determine if
+ *  positions lie behind the camera)
+ * @param count Number of positions
+ */
+void CameraProjection::worldToScreen(const double* x, const double* y, const double* z,
+                                     double* screenX, double* screenY, double* screenZ,
+                                     int count) const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const double* m = mViewProjection;
+  double halfWidth = mViewport[2] * 0.5;
+  double halfHeight = mViewport[3] * 0.5;
+  double centerX = mViewport[0] + halfWidth;
+  double centerY = mViewport[1] + halfHeight;
+
+  for (int i = 0; i < count; i++)
+  {
+    double clipX = m[0]*x[i] + m[4]*y[i] + m[8]*z[i] + m[12];
+    double clipY = m[1]*x[i] + m[5]*y[i] + m[9]*z[i] + m[13];
+    double clipZ = m[2]*x[i] + m[6]*y[i] + m[10]*z[i] + m[14];
+    double inverseW = 1.0 / (m[3]*x[i] + m[7]*y[i] + m[11]*z[i] + m[15]);
+
+    screenX[i] = centerX + halfWidth * clipX * inverseW;
+    screenY[i] = centerY + halfHeight * clipY * inverseW;
+    screenZ[i] = (clipZ * inverseW + 1.0) * 0.5;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Recomputes the combined projection * model-view matrix.
+ */
+void CameraProjection::updateViewProjection()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int column = 0; column < 4; column++)
+  {
+    for (int row = 0; row < 4; row++)
+    {
+      double sum = 0.0;
+      for (int k = 0; k < 4; k++)
+      {
+        sum += mProjection[k*4 + row] * mModelView[column*4 + k];
+      }
+      mViewProjection[column*4 + row] = sum;
+    }
+  }
+}
@@ -0,0 +1,70 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CAMERA_PROJECTION_H
+#define CAMERA_PROJECTION_H
+
+#include "globals.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton class that keeps the camera matrices of the current frame on the
+ * CPU. GLWidget builds the viewport, projection and model-view matrices here
+ * from the Camera state once per frame, the same way glViewport,
+ * gluPerspective and gluLookAt would, and loads them into OpenGL. Everything
+ * else projects positions against these copies instead of querying OpenGL
+ * state, whole arrays of positions at once where possible. Matrices are in
+ * OpenGL (column-major) order. Only the render thread may use this class.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class CameraProjection
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static CameraProjection* getInstance();
+    ~CameraProjection();
+
+    void setViewport(int x, int y, int width, int height);
+    void setPerspective(double fieldOfView, double aspectRatio, double nearPlane, double farPlane);
+    void setLookAt(const SimpleVector& eye, const SimpleVector& center, const SimpleVector& up);
+    const double* getModelView() const;
+    const double* getProjection() const;
+    const int* getViewport() const;
+    SimpleVector worldToScreen(const SimpleVector& worldPosition) const;
+    void worldToScreen(const double* x, const double* y, const double* z,
+                       double* screenX, double* screenY, double* screenZ, int count) const;
+
+  private:
+    CameraProjection();//private due to Singleton implementation
+    void updateViewProjection();
+
+    static CameraProjection* mInstance;
+    double mModelView[16];
+    double mProjection[16];
+    double mViewProjection[16];//projection * model-view
+    int mViewport[4];
+};
+
+#endif//CAMERA_PROJECTION_H
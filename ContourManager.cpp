@@ -0,0 +1,889 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <QtOpenGL>
+#include "ContourManager.h"
+#include "ContourThread.h"
+#include "ElevationManager.h"
+#include "Camera.h"
+#include "Utilities.h"
+#include "Constants.h"
+#include "math.h"
+
+//tile size in degrees and contour interval in Km of every level, coarsest first
+static const double TILE_SIZES[ContourManager::NUMBER_OF_LEVELS] = {1.0, 0.25, 0.0625, 0.015625};
+static const double CONTOUR_INTERVALS[ContourManager::NUMBER_OF_LEVELS] = {0.2, 0.1, 0.04, 0.01};
+
+//polylines are simplified to within this distance, in cells of their level
+static const double SIMPLIFY_TOLERANCE = 0.4;
+
+ContourManager* ContourManager::mInstance = NULL;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+ContourManager::ContourManager()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mIsEnabled = false;
+  mIsStopping.fetchAndStoreOrdered(0);
+  mElevationMode = false;
+  mFrame = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. Stops the contour threads and releases all tiles.
+ */
+ContourManager::~ContourManager()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  setEnabled(false);
+
+  QHash<qint64, Tile*>::iterator i;
+  for (i = mTiles.begin(); i != mTiles.end(); ++i)
+  {
+    delete i.value();
+  }
+  mTiles.clear();
+
+  mInstance = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the singleton instance of this class.
+ *
+ * @return Singleton instance of this class
+ */
+ContourManager* ContourManager::getInstance()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mInstance == 0)
+  {
+    mInstance = new ContourManager();
+  }
+
+  return mInstance;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Enables or disables contour lines. Enabling starts the pool of contour
+ * threads, disabling stops them (waiting for the tiles being generated) but
+ * keeps the generated tiles around.
+ *
+ * @param value True to enable contour lines
+ */
+void ContourManager::setEnabled(bool value)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (value == mIsEnabled)
+  {
+    return;
+  }
+
+  if (value)
+  {
+    mIsStopping.fetchAndStoreOrdered(0);
+
+    //leave a core for the GUI thread
+    int numberOfThreads = qMax(1, QThread::idealThreadCount() - 1);
+    for (int i = 0; i < numberOfThreads; i++)
+    {
+      ContourThread* thread = new ContourThread();
+      mThreads.append(thread);
+      thread->start();
+    }
+  }
+  else
+  {
+    mMutex.lock();
+    mRequests.clear();
+    mIsStopping.fetchAndStoreOrdered(1);
+    mMutex.unlock();
+
+    for (int i = 0; i < mThreads.size(); i++)
+    {
+      mThreads[i]->wait();
+      delete mThreads[i];
+    }
+    mThreads.clear();
+  }
+
+  mIsEnabled = value;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if contour lines are enabled.
+ *
+ * @return True if contour lines are enabled
+ */
+bool ContourManager::getIsEnabled()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mIsEnabled;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Renders the contour lines around the camera and requests the tiles that are
+ * still missing. Tiles show up as the contour threads finish them. Contour
+ * lines are drawn at their elevation in elevation mode, on the surface
+ * otherwise.
+ * WARNING: This method is supposed to get called from the OpenGL (GUI) thread.
+ *
+ * @param elevationMode True if maps are being rendered with elevation
+ */
+void ContourManager::render(bool elevationMode)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (!mIsEnabled)
+  {
+    return;
+  }
+
+  GeodeticPosition cameraPosition = Camera::getInstance()->getGeodeticPosition();
+  double heightAboveTerrain = cameraPosition.altitude -
+    ElevationManager::getInstance()->getElevation(cameraPosition.latitude, cameraPosition.longitude);
+
+  int level = findLevelFromHAT(heightAboveTerrain);
+  if (level < 0)
+  {
+    return;
+  }
+
+  QList<Tile*> visibleTiles;
+  QList<Tile*> tilesToCompile;
+
+  mMutex.lock();
+  mFrame++;
+
+  //contour lines have to be moved when switching elevation mode
+  if (elevationMode != mElevationMode)
+  {
+    mElevationMode = elevationMode;
+    QHash<qint64, Tile*>::iterator i;
+    for (i = mTiles.begin(); i != mTiles.end(); ++i)
+    {
+      i.value()->needsCompile = true;
+    }
+  }
+
+  requestTiles(level, cameraPosition, visibleTiles);
+  evictTiles();
+
+  //tiles that are ready are left alone by the contour threads
+  for (int i = 0; i < visibleTiles.size(); i++)
+  {
+    if (visibleTiles[i]->state == READY && visibleTiles[i]->needsCompile)
+    {
+      tilesToCompile.append(visibleTiles[i]);
+    }
+  }
+  mMutex.unlock();
+
+  for (int i = 0; i < tilesToCompile.size(); i++)
+  {
+    compileTile(tilesToCompile[i], elevationMode);
+  }
+
+  //tiles being contoured again keep showing their previous lines
+  glDisable(GL_DEPTH_TEST);
+  for (int i = 0; i < visibleTiles.size(); i++)
+  {
+    if (visibleTiles[i]->displayList != 0)
+    {
+      glCallList(visibleTiles[i]->displayList);
+    }
+  }
+  glLineWidth(1.0f);
+  glEnable(GL_DEPTH_TEST);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of tiles in the cache.
+ *
+ * @return Number of cached tiles
+ */
+int ContourManager::getNumberOfTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mTiles.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of tiles around the camera waiting for a contour thread.
+ *
+ * @return Number of requested tiles
+ */
+int ContourManager::getNumberOfPendingTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mRequests.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of the tiles of the given level.
+ *
+ * @param level Level of detail, 0 is the coarsest
+ * @return Tile size in decimal degrees
+ */
+double ContourManager::getTileSizeDegrees(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return TILE_SIZES[qBound(0, level, NUMBER_OF_LEVELS - 1)];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the elevation difference between contour lines of the given level.
+ * Every MAJOR_CONTOUR_EVERY lines one is drawn as a major (index) line.
+ *
+ * @param level Level of detail, 0 is the coarsest
+ * @return Contour interval in Km
+ */
+double ContourManager::getContourInterval(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return CONTOUR_INTERVALS[qBound(0, level, NUMBER_OF_LEVELS - 1)];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Finds the finest level whose tile window still covers the ground seen from
+ * the given height.
+ *
+ * @param heightAboveTerrain Camera height above terrain in Km
+ * @return Level of detail, -1 if the camera is too high for contour lines
+ */
+int ContourManager::findLevelFromHAT(double heightAboveTerrain)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double kmPerDegree = Constants::EARTH_MEAN_RADIUS * Constants::DEGREES_TO_RADIANS;
+
+  //ground seen around the camera is roughly 1.5 times its height
+  for (int level = NUMBER_OF_LEVELS - 1; level >= 0; level--)
+  {
+    if (heightAboveTerrain * 1.5 <= TILE_WINDOW_RADIUS * TILE_SIZES[level] * kmPerDegree)
+    {
+      return level;
+    }
+  }
+
+  return -1;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by contour threads. Returns true once the threads have been asked to
+ * stop.
+ *
+ * @return True if contour threads should stop
+ */
+bool ContourManager::getIsStopping()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mIsStopping.fetchAndAddOrdered(0) != 0);//atomic read
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by contour threads. Takes the requested tile closest to the camera
+ * and marks it as busy. This method is thread-safe.
+ *
+ * @return Tile to generate, NULL if no tiles are requested
+ */
+ContourManager::Tile* ContourManager::takeRequest()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  if (mRequests.isEmpty())
+  {
+    return NULL;
+  }
+
+  Tile* tile = mRequests.takeFirst();
+  tile->state = BUSY;
+
+  return tile;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by contour threads. Samples the elevations of the given (busy) tile
+ * in a single batch and traces every contour value crossing it. Samples are
+ * placed on a global grid per level, so neighboring tiles sample their shared
+ * edge at the very same positions.
+ *
+ * @param tile Tile to generate, taken with takeRequest
+ * @param latitudes Scratch buffer for sample latitudes
+ * @param longitudes Scratch buffer for sample longitudes
+ * @param elevations Scratch buffer for sample elevations
+ */
+void ContourManager::generateTile(Tile* tile, QVector<double>& latitudes, QVector<double>& longitudes,
+                                  QVector<float>& elevations)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int size = CELLS_PER_TILE + 1;
+  double step = getTileSizeDegrees(tile->level) / (double)CELLS_PER_TILE;
+  int firstRow = tile->row * CELLS_PER_TILE;
+  int firstColumn = tile->column * CELLS_PER_TILE;
+
+  //rows go south from the north pole, columns go east from the anti-meridian
+  latitudes.resize(size * size);
+  longitudes.resize(size * size);
+  elevations.resize(size * size);
+  for (int row = 0; row < size; row++)
+  {
+    double latitude = 90.0 - (double)(firstRow + row) * step;
+    for (int column = 0; column < size; column++)
+    {
+      latitudes[row*size + column] = latitude;
+      longitudes[row*size + column] = -180.0 + (double)(firstColumn + column) * step;
+    }
+  }
+
+  ElevationManager* elevationManager = ElevationManager::getInstance();
+  elevationManager->getElevations(latitudes.data(), longitudes.data(), elevations.data(), size * size);
+  tile->isIncomplete = tile->level < FIRST_LOADING_LEVEL && elevationManager->getIsLoading();
+
+  tile->vertices.clear();
+  tile->contourStarts.clear();
+  tile->contourValues.clear();
+
+  float minimum = elevations[0];
+  float maximum = elevations[0];
+  for (int i = 1; i < size * size; i++)
+  {
+    minimum = qMin(minimum, elevations[i]);
+    maximum = qMax(maximum, elevations[i]);
+  }
+
+  //every contour value between the lowest and highest sample
+  double interval = getContourInterval(tile->level);
+  int firstContour = (int)ceil(minimum / interval);
+  int lastContour = (int)floor(maximum / interval);
+  QVector<int> segments;
+  QVector<int> edgeSegments(size * size * 4, -1);
+  QVector<bool> isVisited;
+  for (int contour = firstContour; contour <= lastContour; contour++)
+  {
+    traceContour(tile, elevations.constData(), (float)(contour * interval), segments, edgeSegments, isVisited);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by contour threads. Hands the given tile over to render.
+ *
+ * @param tile Tile generated with generateTile
+ */
+void ContourManager::reportTileGenerated(Tile* tile)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  tile->state = READY;
+  tile->needsCompile = true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Collects the tiles of the given level around the camera, creating the ones
+ * not in the cache yet, and rebuilds the request list with those still to be
+ * generated. Tiles are visited in rings around the camera so that closer tiles
+ * get requested first. The manager must be locked.
+ *
+ * @param level Level of detail
+ * @param cameraPosition Camera geodetic position
+ * @param visibleTiles Output list of tiles around the camera
+ */
+void ContourManager::requestTiles(int level, const GeodeticPosition& cameraPosition, QList<Tile*>& visibleTiles)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double tileSize = TILE_SIZES[level];
+  int numberOfRows = (int)(180.0 / tileSize + 0.5);
+  int numberOfColumns = 2 * numberOfRows;
+  int centerRow = qBound(0, (int)((90.0 - cameraPosition.latitude) / tileSize), numberOfRows - 1);
+  int centerColumn = qBound(0, (int)((cameraPosition.longitude + 180.0) / tileSize), numberOfColumns - 1);
+
+  //tiles get narrower towards the poles, widen the window to cover as much ground
+  double cosine = cos(cameraPosition.latitude * Constants::DEGREES_TO_RADIANS);
+  double columnScale = qMin(2.0, 1.0 / qMax(cosine, 0.01));
+
+  ElevationManager* elevationManager = ElevationManager::getInstance();
+  bool isLoading = elevationManager->getIsLoading();
+
+  mRequests.clear();
+  for (int ring = 0; ring <= TILE_WINDOW_RADIUS; ring++)
+  {
+    int columnRing = (int)ceil(ring * columnScale);
+    for (int rowOffset = -ring; rowOffset <= ring; rowOffset++)
+    {
+      int row = centerRow + rowOffset;
+      if (row < 0 || row >= numberOfRows)
+      {
+        continue;
+      }
+
+      for (int columnOffset = -columnRing; columnOffset <= columnRing; columnOffset++)
+      {
+        int column = (centerColumn + columnOffset + numberOfColumns) % numberOfColumns;
+        qint64 key = getTileKey(level, row, column);
+        Tile* tile = mTiles.value(key, NULL);
+        if (tile == NULL)
+        {
+          tile = new Tile();
+          tile->level = level;
+          tile->row = row;
+          tile->column = column;
+          tile->state = PENDING;
+          tile->isIncomplete = false;
+          tile->needsCompile = false;
+          tile->lastUsed = 0;
+          tile->displayList = 0;
+          mTiles.insert(key, tile);
+        }
+
+        //already visited in an inner ring
+        if (tile->lastUsed == mFrame)
+        {
+          continue;
+        }
+        tile->lastUsed = mFrame;
+
+        //contour again once the elevations it was missing are loaded
+        if (tile->state == READY && tile->isIncomplete && !isLoading)
+        {
+          tile->state = PENDING;
+        }
+
+        //finer tiles are only handed out once their datasets are loaded,
+        //so contour threads never wait on ElevationManager
+        if (tile->state == PENDING &&
+            (level < FIRST_LOADING_LEVEL ||
+             elevationManager->startLoadingRegion(90.0 - (row + 1) * tileSize, -180.0 + column * tileSize,
+                                                  90.0 - row * tileSize, -180.0 + (column + 1) * tileSize)))
+        {
+          mRequests.append(tile);
+        }
+        visibleTiles.append(tile);
+      }
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Evicts least recently used tiles until the cache is back to its maximum
+ * size. Tiles in use this frame and tiles being generated are never evicted.
+ * The manager must be locked.
+ */
+void ContourManager::evictTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  while (mTiles.size() > MAXIMUM_NUMBER_OF_TILES)
+  {
+    QHash<qint64, Tile*>::iterator leastRecentlyUsed = mTiles.end();
+    QHash<qint64, Tile*>::iterator i;
+    for (i = mTiles.begin(); i != mTiles.end(); ++i)
+    {
+      Tile* tile = i.value();
+      if (tile->state != BUSY && tile->lastUsed != mFrame &&
+          (leastRecentlyUsed == mTiles.end() || tile->lastUsed < leastRecentlyUsed.value()->lastUsed))
+      {
+        leastRecentlyUsed = i;
+      }
+    }
+
+    if (leastRecentlyUsed == mTiles.end())
+    {
+      break;
+    }
+
+    Tile* tile = leastRecentlyUsed.value();
+    if (tile->displayList != 0)
+    {
+      glDeleteLists(tile->displayList, 1);
+    }
+    delete tile;
+    mTiles.erase(leastRecentlyUsed);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Compiles the contour lines of the given tile into its display list. Major
+ * lines are drawn brighter and thicker.
+ *
+ * @param tile Ready tile
+ * @param elevationMode True to raise lines to their elevation
+ */
+void ContourManager::compileTile(Tile* tile, bool elevationMode)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (tile->displayList == 0)
+  {
+    tile->displayList = glGenLists(1);
+  }
+
+  double interval = getContourInterval(tile->level);
+  int numberOfContours = tile->contourValues.size();
+  const float* vertices = tile->vertices.constData();
+
+  glNewList(tile->displayList, GL_COMPILE);
+  for (int contour = 0; contour < numberOfContours; contour++)
+  {
+    int first = tile->contourStarts[contour];
+    int last = contour + 1 < numberOfContours ? tile->contourStarts[contour + 1] : tile->vertices.size() / 3;
+    float value = tile->contourValues[contour];
+    float scale = 1.0f;
+    if (elevationMode)
+    {
+      scale = (float)((Constants::EARTH_MEAN_RADIUS + value) / Constants::EARTH_MEAN_RADIUS);
+    }
+
+    if (qRound(value / interval) % MAJOR_CONTOUR_EVERY == 0)
+    {
+      glColor4f(1.0f, 0.8f, 0.45f, 1.0f);
+      glLineWidth(2.0f);
+    }
+    else
+    {
+      glColor4f(0.85f, 0.6f, 0.3f, 1.0f);
+      glLineWidth(1.0f);
+    }
+
+    glBegin(GL_LINES);
+    for (int vertex = first; vertex < last; vertex++)
+    {
+      glVertex3f(vertices[vertex*3] * scale, vertices[vertex*3 + 1] * scale, vertices[vertex*3 + 2] * scale);
+    }
+    glEnd();
+  }
+  glEndList();
+
+  tile->needsCompile = false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Traces the contour lines of the given value over a tile with marching
+ * squares and adds them to the tile. Crossings are identified by the grid
+ * edge they are on: horizontal edges get even ids and vertical edges odd ids.
+ * Segments sharing a crossing are chained into polylines, starting with the
+ * open ones (which end on the tile border) and then the closed ones.
+ *
+ * @param tile Tile being generated
+ * @param elevations Tile samples, row by row from the north west corner
+ * @param value Contour value in Km
+ * @param segments Scratch buffer for segments (pairs of edge ids)
+ * @param edgeSegments Scratch buffer for the up to two segments on every edge,
+ *        all -1 on entry and left that way on exit
+ * @param isVisited Scratch buffer for chaining
+ */
+void ContourManager::traceContour(Tile* tile, const float* elevations, float value, QVector<int>& segments,
+                                  QVector<int>& edgeSegments, QVector<bool>& isVisited)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int size = CELLS_PER_TILE + 1;
+
+  //marching squares, corners are numbered top left, top right, bottom right
+  //and bottom left from the highest bit down
+  segments.clear();
+  for (int row = 0; row < CELLS_PER_TILE; row++)
+  {
+    for (int column = 0; column < CELLS_PER_TILE; column++)
+    {
+      int index = row*size + column;
+      float topLeft = elevations[index];
+      float topRight = elevations[index + 1];
+      float bottomLeft = elevations[index + size];
+      float bottomRight = elevations[index + size + 1];
+      int caseIndex = (topLeft >= value ? 8 : 0) | (topRight >= value ? 4 : 0) |
+                      (bottomRight >= value ? 2 : 0) | (bottomLeft >= value ? 1 : 0);
+      if (caseIndex == 0 || caseIndex == 15)
+      {
+        continue;
+      }
+
+      int top = index*2;
+      int bottom = (index + size)*2;
+      int left = index*2 + 1;
+      int right = (index + 1)*2 + 1;
+      bool isCenterAbove = (topLeft + topRight + bottomLeft + bottomRight) * 0.25f >= value;
+
+      switch (caseIndex)
+      {
+        case 1: case 14: segments << left << bottom; break;
+        case 2: case 13: segments << bottom << right; break;
+        case 3: case 12: segments << left << right; break;
+        case 4: case 11: segments << top << right; break;
+        case 6: case 9: segments << top << bottom; break;
+        case 7: case 8: segments << top << left; break;
+        case 5:
+          //saddle, top right and bottom left corners above
+          if (isCenterAbove)
+          {
+            segments << top << left << right << bottom;
+          }
+          else
+          {
+            segments << top << right << left << bottom;
+          }
+          break;
+        case 10:
+          //saddle, top left and bottom right corners above
+          if (isCenterAbove)
+          {
+            segments << top << right << left << bottom;
+          }
+          else
+          {
+            segments << top << left << right << bottom;
+          }
+          break;
+      }
+    }
+  }
+
+  int numberOfSegments = segments.size() / 2;
+  if (numberOfSegments == 0)
+  {
+    return;
+  }
+
+  for (int segment = 0; segment < numberOfSegments; segment++)
+  {
+    for (int end = 0; end < 2; end++)
+    {
+      int slot = segments[segment*2 + end] * 2;
+      edgeSegments[edgeSegments[slot] < 0 ? slot : slot + 1] = segment;
+    }
+  }
+
+  int firstVertex = tile->vertices.size() / 3;
+
+  //crossings in global grid coordinates, always interpolated from the top or
+  //left sample so tiles sharing an edge find exactly the same crossing
+  int firstRow = tile->row * CELLS_PER_TILE;
+  int firstColumn = tile->column * CELLS_PER_TILE;
+  QVector<double> rows;
+  QVector<double> columns;
+  isVisited.fill(false, numberOfSegments);
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int startSegment = 0; startSegment < numberOfSegments; startSegment++)
+    {
+      if (isVisited[startSegment])
+      {
+        continue;
+      }
+
+      //open polylines start at an edge with a single segment
+      int edge = segments[startSegment*2];
+      if (pass == 0)
+      {
+        if (edgeSegments[edge*2 + 1] >= 0)
+        {
+          edge = segments[startSegment*2 + 1];
+          if (edgeSegments[edge*2 + 1] >= 0)
+          {
+            continue;
+          }
+        }
+      }
+
+      rows.clear();
+      columns.clear();
+      int segment = startSegment;
+      while (true)
+      {
+        int index = edge / 2;
+        int row = index / size;
+        int column = index % size;
+        float start = elevations[index];
+        float end = (edge % 2 == 0) ? elevations[index + 1] : elevations[index + size];
+        double fraction = (value - start) / (end - start);
+        rows.append((double)(firstRow + row) + (edge % 2 == 0 ? 0.0 : fraction));
+        columns.append((double)(firstColumn + column) + (edge % 2 == 0 ? fraction : 0.0));
+
+        if (segment < 0 || isVisited[segment])
+        {
+          break;
+        }
+
+        isVisited[segment] = true;
+        edge = segments[segment*2] == edge ? segments[segment*2 + 1] : segments[segment*2];
+        segment = edgeSegments[edge*2] == segment ? edgeSegments[edge*2 + 1] : edgeSegments[edge*2];
+      }
+
+      addPolyline(tile, rows, columns);
+    }
+  }
+
+  //leave edge slots clean for the next contour value
+  for (int i = 0; i < segments.size(); i++)
+  {
+    edgeSegments[segments[i]*2] = -1;
+    edgeSegments[segments[i]*2 + 1] = -1;
+  }
+
+  if (tile->vertices.size() / 3 > firstVertex)
+  {
+    tile->contourStarts.append(firstVertex);
+    tile->contourValues.append(value);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Simplifies the given polyline and adds it to the tile as line segments on
+ * the surface.
+ *
+ * @param tile Tile being generated
+ * @param rows Polyline rows in global grid coordinates
+ * @param columns Polyline columns in global grid coordinates
+ */
+void ContourManager::addPolyline(Tile* tile, const QVector<double>& rows, const QVector<double>& columns)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QVector<bool> keep;
+  simplify(rows, columns, SIMPLIFY_TOLERANCE, keep);
+
+  double step = getTileSizeDegrees(tile->level) / (double)CELLS_PER_TILE;
+  GeodeticPosition position;
+  position.altitude = 0.0;
+  bool hasPrevious = false;
+  SimpleVector previous;
+
+  for (int i = 0; i < rows.size(); i++)
+  {
+    if (!keep[i])
+    {
+      continue;
+    }
+
+    position.latitude = 90.0 - rows[i] * step;
+    position.longitude = -180.0 + columns[i] * step;
+    SimpleVector current = Utilities::geodeticToXYZ(position);
+    if (hasPrevious)
+    {
+      tile->vertices << previous.x << previous.y << previous.z;
+      tile->vertices << current.x << current.y << current.z;
+    }
+
+    previous = current;
+    hasPrevious = true;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Douglas-Peucker simplification. Flags the points to keep so that the
+ * simplified polyline stays within the given distance of the original one.
+ * First and last points are always kept, so polylines still meet at tile
+ * edges after simplification.
+ *
+ * @param rows Polyline rows
+ * @param columns Polyline columns
+ * @param tolerance Maximum distance, in the same units as rows and columns
+ * @param keep Output flags, one per point
+ */
+void ContourManager::simplify(const QVector<double>& rows, const QVector<double>& columns,
+                              double tolerance, QVector<bool>& keep)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int numberOfPoints = rows.size();
+  keep.fill(false, numberOfPoints);
+  keep[0] = true;
+  keep[numberOfPoints - 1] = true;
+
+  double toleranceSquared = tolerance * tolerance;
+  QList<int> stack;
+  stack << 0 << numberOfPoints - 1;
+  while (!stack.isEmpty())
+  {
+    int last = stack.takeLast();
+    int first = stack.takeLast();
+    double rowDelta = rows[last] - rows[first];
+    double columnDelta = columns[last] - columns[first];
+    double lengthSquared = rowDelta*rowDelta + columnDelta*columnDelta;
+
+    //farthest point from the chord (or from the first point on closed lines)
+    int farthest = -1;
+    double farthestDistanceSquared = toleranceSquared;
+    for (int i = first + 1; i < last; i++)
+    {
+      double rowOffset = rows[i] - rows[first];
+      double columnOffset = columns[i] - columns[first];
+      double distanceSquared;
+      if (lengthSquared > 0.0)
+      {
+        double cross = rowOffset*columnDelta - columnOffset*rowDelta;
+        distanceSquared = cross*cross / lengthSquared;
+      }
+      else
+      {
+        distanceSquared = rowOffset*rowOffset + columnOffset*columnOffset;
+      }
+
+      if (distanceSquared > farthestDistanceSquared)
+      {
+        farthest = i;
+        farthestDistanceSquared = distanceSquared;
+      }
+    }
+
+    if (farthest >= 0)
+    {
+      keep[farthest] = true;
+      stack << first << farthest << farthest << last;
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the cache key of the given tile.
+ *
+ * @param level Level of detail
+ * @param row Tile row, from the north pole
+ * @param column Tile column, from the anti-meridian
+ * @return Tile key
+ */
+qint64 ContourManager::getTileKey(int level, int row, int column)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return ((qint64)level << 48) | ((qint64)row << 24) | (qint64)column;
+}
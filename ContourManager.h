@@ -0,0 +1,139 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef CONTOUR_MANAGER_H
+#define CONTOUR_MANAGER_H
+
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInt>
+#include "globals.h"
+
+class ContourThread;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton class that generates and renders contour lines from the elevation
+ * data in ElevationManager. The world is split into square tiles at a few
+ * levels of detail, the level follows the camera height above terrain and
+ * comes with its own contour interval. Only tiles around the camera get
+ * contoured: render requests the missing ones, closest first, and a pool of
+ * ContourThread objects generates them in the background. Generated tiles are
+ * cached (least recently used ones get evicted) so panning around does not
+ * contour the same tiles again.
+ *
+ * Tiles are contoured with marching squares over a grid of elevation samples,
+ * segments are chained into polylines and simplified with a tolerance that
+ * scales with the level. Samples on a tile edge are shared with the neighbor
+ * tile and edge crossings are always interpolated in the same direction, so
+ * lines leave one tile and enter the next at exactly the same point and join
+ * up without seams.
+ *
+ * Tiles from FIRST_LOADING_LEVEL on are only requested once ElevationManager
+ * has loaded the datasets under them (see startLoadingRegion), so contour
+ * threads never block on loads. Coarser tiles cover too much ground for that,
+ * they use whatever is loaded and get contoured again once loading is done.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ContourManager
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int NUMBER_OF_LEVELS = 4;
+    static const int CELLS_PER_TILE = 64;
+    static const int TILE_WINDOW_RADIUS = 4;
+    static const int MAXIMUM_NUMBER_OF_TILES = 768;
+    static const int MAJOR_CONTOUR_EVERY = 5;
+    static const int FIRST_LOADING_LEVEL = 2;
+
+    enum TileState
+    {
+      PENDING,
+      BUSY,
+      READY
+    };
+
+    struct Tile
+    {
+      int level;
+      int row;
+      int column;
+      TileState state;
+      bool isIncomplete;
+      bool needsCompile;
+      int lastUsed;
+      QVector<float> vertices;//XYZ on the surface, pairs of line end points
+      QVector<int> contourStarts;//first vertex of every contour value
+      QVector<float> contourValues;//contour values in Km
+      unsigned int displayList;
+    };
+
+    ~ContourManager();
+    static ContourManager* getInstance();
+
+    void setEnabled(bool value);
+    bool getIsEnabled();
+    void render(bool elevationMode);
+    int getNumberOfTiles();
+    int getNumberOfPendingTiles();
+
+    static double getTileSizeDegrees(int level);
+    static double getContourInterval(int level);
+    static int findLevelFromHAT(double heightAboveTerrain);
+
+    //called by contour threads
+    bool getIsStopping();
+    Tile* takeRequest();
+    void generateTile(Tile* tile, QVector<double>& latitudes, QVector<double>& longitudes,
+                      QVector<float>& elevations);
+    void reportTileGenerated(Tile* tile);
+
+  private:
+    ContourManager();//private due to Singleton implementation
+    void requestTiles(int level, const GeodeticPosition& cameraPosition, QList<Tile*>& visibleTiles);
+    void evictTiles();
+    void compileTile(Tile* tile, bool elevationMode);
+    void traceContour(Tile* tile, const float* elevations, float value, QVector<int>& segments,
+                      QVector<int>& edgeSegments, QVector<bool>& isVisited);
+    void addPolyline(Tile* tile, const QVector<double>& rows, const QVector<double>& columns);
+    static void simplify(const QVector<double>& rows, const QVector<double>& columns,
+                         double tolerance, QVector<bool>& keep);
+    static qint64 getTileKey(int level, int row, int column);
+
+    static ContourManager* mInstance;
+    QHash<qint64, Tile*> mTiles;
+    QList<Tile*> mRequests;
+    QList<ContourThread*> mThreads;
+    QMutex mMutex;
+    bool mIsEnabled;
+    QAtomicInt mIsStopping;//polled by contour threads
+    bool mElevationMode;
+    int mFrame;
+};
+
+#endif//CONTOUR_MANAGER_H
@@ -0,0 +1,57 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef CONTOUR_THREAD_H
+#define CONTOUR_THREAD_H
+
+#include <QThread>
+#include <QVector>
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Worker thread used by ContourManager to generate contour tiles in the
+ * background. Threads keep taking the next requested tile (closest to the
+ * camera first) until the manager stops them, and sleep for a bit whenever
+ * there is nothing to do.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ContourThread : public QThread
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    ContourThread();
+    ~ContourThread();
+
+    void run();//OVERRIDE
+
+  private:
+    //scratch buffers for the samples of a tile
+    QVector<double> mLatitudes;
+    QVector<double> mLongitudes;
+    QVector<float> mElevations;
+};
+
+#endif//CONTOUR_THREAD_H
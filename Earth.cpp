@@ -30,6 +30,10 @@
 #include "Camera.h"
 #include "Utilities.h"
 #include "ElevationManager.h"
+#include "ContourManager.h"
+#include "HillshadeManager.h"
+#include "QuantizedMeshManager.h"
+#include "GeoTiffReader.h"
 
 Earth* Earth::mInstance = NULL;//Singleton implementation
 static Camera* camera = NULL;
@@ -47,6 +51,9 @@ Earth::Earth()
   mNumberOfTileSubdivisions = 1;
   camera = Camera::getInstance();
   mRenderLatLonGrid = false;
+  mRenderContours = false;
+  mRenderHillshade = false;
+  mIsMeshGeometry = false;
 
   for (int i = 0; i < NUMBER_OF_DISPLAY_LISTS; i++)
   {
@@ -83,17 +90,24 @@ Earth* Earth::getInstance()
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Adds a map tile to the Earth's geometry.
+ * Adds a map tile to the Earth's geometry. Overlays are drawn on top of the
+ * maps underneath, blended according to the image alpha channel, they should
+ * be given the highest draw priority (10) so they get drawn last.
+ * WARNING: This method creates a texture, so it is supposed to get called from
+ * the OpenGL (GUI) thread.
  *
  * @param southWest Map's sothwest geodetic position
  * @param northEast Map's northeast geodetic position
  * @param visibleAltitude Altitude at which the map becomes visible
  * @param drawPriority The drawing priority, lower number means it gets drawn
  *        first
- * @param textureFile File name for the texture
+ * @param image Image for the texture
+ * @param isOverlay True if the image is blended on top of other maps
+ * @return OpenGL handle to the map texture, identifies the map in removeMap
  */
-void Earth::addMap(const GeodeticPosition& southWest, const GeodeticPosition& northEast,
-                   float visibleAltitude, int drawPriority, const QImage& image)
+unsigned int Earth::addMap(const GeodeticPosition& southWest, const GeodeticPosition& northEast,
+                           float visibleAltitude, int drawPriority, const QImage& image,
+                           bool isOverlay)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   Map map;
@@ -102,7 +116,31 @@ void Earth::addMap(const GeodeticPosition& southWest, const GeodeticPosition& no
   map.visibleAltitude = visibleAltitude;
   map.drawPriority = drawPriority;
   map.texture = Utilities::imageToTexture(image);
+  map.isOverlay = isOverlay;
   mMapList.append(map);
+
+  return map.texture;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Removes the map with the given texture and releases the texture.
+ * WARNING: This method is supposed to get called from the OpenGL (GUI) thread.
+ *
+ * @param texture OpenGL handle returned by addMap
+ */
+void Earth::removeMap(unsigned int texture)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int mapIndex = 0; mapIndex < mMapList.size(); mapIndex++)
+  {
+    if (mMapList[mapIndex].texture == texture)
+    {
+      glDeleteTextures(1, &texture);
+      mMapList.removeAt(mapIndex);
+      break;
+    }
+  }
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -124,6 +162,7 @@ void Earth::readMapsFile(const QString& filename)
   else
   {
     Map map;
+    map.isOverlay = false;
     QStringList split;
     QString line;
     QTextStream in(&file);
@@ -178,9 +217,25 @@ void Earth::readMapsFile(const QString& filename)
       else if (line.contains("Image="))
       {
         split = line.split("=");
-        //load image
+        //load image, GeoTIFF imagery is read from the finest overview that fits in a texture
         QImage image;
-        if (!image.load(split[1]))
+        GeoTiffReader reader;
+        if (GeoTiffReader::isTiffFile(split[1]) && reader.open(split[1]) && reader.getIsImage())
+        {
+          GLint maximumTextureSize = 0;
+          glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maximumTextureSize);
+          maximumTextureSize = qBound(1024, (int)maximumTextureSize, MAXIMUM_MAP_TEXTURE_SIZE);
+
+          int level = reader.findLevel(maximumTextureSize, maximumTextureSize);
+          image = reader.readImage(level, 0, 0, reader.getWidth(level), reader.getHeight(level));
+          reader.close();
+        }
+        else
+        {
+          image.load(split[1]);
+        }
+
+        if (image.isNull())
         {
           printf("Earth.cpp: Error loading image in maps file.\n");
           break;
@@ -207,6 +262,11 @@ void Earth::render()
   renderEarth();
   renderMaps();
 
+  if (mRenderContours)
+  {
+    ContourManager::getInstance()->render(mElevationMode);
+  }
+
   if (mRenderLatLonGrid)
   {
     renderLatLonGrid();
@@ -261,6 +321,18 @@ void Earth::setElevationMode(bool value)
   mElevationMode = value;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the value of the elevation mode flag (see setElevationMode).
+ *
+ * @return True if maps are being rendered in elevation mode
+ */
+bool Earth::getElevationMode()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mElevationMode;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Sets the value of flag that determines if the Lat/Lon grid will be rendered.
@@ -273,6 +345,34 @@ void Earth::setRenderLatLonGrid(bool value)
   mRenderLatLonGrid = value;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the value of flag that determines if contour lines will be rendered.
+ * Contour threads only run while contour lines are shown.
+ *
+ * @param value New value for render contours flag
+ */
+void Earth::setRenderContours(bool value)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ContourManager::getInstance()->setEnabled(value);
+  mRenderContours = value;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the value of flag that determines if the relief of the maps will be
+ * shaded. Shading only applies in elevation mode, see HillshadeManager.
+ *
+ * @param value New value for render hillshade flag
+ */
+void Earth::setRenderHillshade(bool value)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  HillshadeManager::getInstance()->setEnabled(value);
+  mRenderHillshade = value;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Renders the stars dome around the camera.
@@ -342,14 +442,15 @@ void Earth::renderEarth()
 /**
  * Renders the maps in our map list that are within visible camera altitude and
  * within the viewable boundaries. We use the mNumberOfTileSubdivisions variable
- * to have a higher resolution on terrain for elevation database purposes.
+ * to have a higher resolution on terrain for elevation database purposes. In
+ * elevation mode, maps covered by the quantized-mesh terrain are drawn with the
+ * triangles of its tiles instead.
  */
 void Earth::renderMaps()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   int mapIndex, drawPriority;
-  GeodeticPosition geoPosition[4];
-  SimpleVector xyzPosition[4];
+  GeodeticPosition geoPosition;
 
   //get rid of Z fighting by always drawing later maps on top
   //when not in elevation mode
@@ -358,16 +459,26 @@ void Earth::renderMaps()
     glDepthFunc(GL_ALWAYS);
   }
 
-  int subdivisionX = 0;
-  int subdivisionY = 0;
+  int vertexX = 0;
+  int vertexY = 0;
+  int vertexIndex = 0;
   double subdivisionWidth = 0.0;
   double subdivisionHeight = 0.0;
-  float textureWidth = 1.0f/(float)mNumberOfTileSubdivisions;
-  float textureHeight = 1.0f/(float)mNumberOfTileSubdivisions;
-  float texturePositionX = 0.0f;
-  float texturePositionY = 0.0f;
   ElevationManager* elevationManager = ElevationManager::getInstance();
+  HillshadeManager* hillshadeManager = HillshadeManager::getInstance();
+  QuantizedMeshManager* meshManager = QuantizedMeshManager::getInstance();
   GeodeticPosition cameraPosition = camera->getGeodeticPosition();
+  bool useTerrainMeshes = mElevationMode && meshManager->getIsOpen();
+
+  if (mRenderHillshade)
+  {
+    hillshadeManager->startFrame();
+  }
+
+  if (useTerrainMeshes)
+  {
+    meshManager->startFrame();
+  }
 
   //draw tiles by priority
   for (drawPriority = 0; drawPriority < 11; drawPriority++)
@@ -382,87 +493,100 @@ void Earth::renderMaps()
           mMapList[mapIndex].northEast.longitude < (cameraPosition.longitude + 3.0f) &&
           mMapList[mapIndex].southWest.longitude > (cameraPosition.longitude - 3.0f))
       {
-        subdivisionWidth = (mMapList[mapIndex].northEast.longitude -
-          mMapList[mapIndex].southWest.longitude) / (double)mNumberOfTileSubdivisions;
+        //terrain meshes are drawn as triangulated, maps they do not cover yet use the grid
+        mIsMeshGeometry = useTerrainMeshes &&
+          meshManager->getMapTiles(mMapList[mapIndex].southWest, mMapList[mapIndex].northEast, mMeshTiles);
 
-        subdivisionHeight = (mMapList[mapIndex].northEast.latitude -
-          mMapList[mapIndex].southWest.latitude) / (double)mNumberOfTileSubdivisions;
+        if (mIsMeshGeometry)
+        {
+          mMeshPositions.resize(0);
+          mMeshTextureCoordinates.resize(0);
+          for (int i = 0; i < mMeshTiles.size(); i++)
+          {
+            mMeshTiles[i]->appendTriangles(mMapList[mapIndex].southWest.latitude, mMapList[mapIndex].southWest.longitude,
+                                           mMapList[mapIndex].northEast.latitude, mMapList[mapIndex].northEast.longitude,
+                                           mMeshPositions, mMeshTextureCoordinates);
+          }
+        }
+        else
+        {
+          subdivisionWidth = (mMapList[mapIndex].northEast.longitude -
+            mMapList[mapIndex].southWest.longitude) / (double)mNumberOfTileSubdivisions;
 
-        geoPosition[0] = mMapList[mapIndex].southWest;
-        geoPosition[0].altitude = elevationManager->getElevation(geoPosition[0].latitude, geoPosition[0].longitude);
+          subdivisionHeight = (mMapList[mapIndex].northEast.latitude -
+            mMapList[mapIndex].southWest.latitude) / (double)mNumberOfTileSubdivisions;
+
+          //sample elevation for all tile vertices in one batch
+          int verticesPerSide = mNumberOfTileSubdivisions + 1;
+          int numberOfVertices = verticesPerSide * verticesPerSide;
+          mVertexLatitudes.resize(numberOfVertices);
+          mVertexLongitudes.resize(numberOfVertices);
+          mVertexElevations.resize(numberOfVertices);
+          mVertexPositions.resize(numberOfVertices);
+
+          for (vertexY = 0; vertexY < verticesPerSide; vertexY++)
+          {
+            for (vertexX = 0; vertexX < verticesPerSide; vertexX++)
+            {
+              vertexIndex = (vertexY * verticesPerSide) + vertexX;
+              mVertexLatitudes[vertexIndex] = mMapList[mapIndex].southWest.latitude + vertexY * subdivisionHeight;
+              mVertexLongitudes[vertexIndex] = mMapList[mapIndex].southWest.longitude + vertexX * subdivisionWidth;
+            }
+          }
 
-        texturePositionX = 0.0f;
-        texturePositionY = 0.0f;
+          elevationManager->getElevations(mVertexLatitudes.data(), mVertexLongitudes.data(),
+                                          mVertexElevations.data(), numberOfVertices);
+
+          for (vertexIndex = 0; vertexIndex < numberOfVertices; vertexIndex++)
+          {
+            geoPosition.latitude = mVertexLatitudes[vertexIndex];
+            geoPosition.longitude = mVertexLongitudes[vertexIndex];
+            geoPosition.altitude = mVertexElevations[vertexIndex];
+            mVertexPositions[vertexIndex] = Utilities::geodeticToXYZ(geoPosition);
+          }
+        }
+
+        //overlays get blended on top of whatever has been drawn underneath
+        if (mMapList[mapIndex].isOverlay)
+        {
+          glDepthFunc(GL_ALWAYS);
+          glDepthMask(GL_FALSE);
+          glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+          glEnable(GL_BLEND);
+          glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
 
         glEnable(GL_TEXTURE_2D);
         glBindTexture(GL_TEXTURE_2D, mMapList[mapIndex].texture);
 
-        glBegin(GL_TRIANGLES);
+        renderMapGeometry();
 
-        //draw tiles with subdivisions for higher terrain fidelity
-        for (subdivisionY = 0; subdivisionY < mNumberOfTileSubdivisions; subdivisionY++)
+        //shade the relief once the normal map of the tile is ready
+        if (mRenderHillshade && mElevationMode && !mMapList[mapIndex].isOverlay)
         {
-          for (subdivisionX = 0; subdivisionX < mNumberOfTileSubdivisions; subdivisionX++)
+          unsigned int normalMap = hillshadeManager->getTexture(mMapList[mapIndex].southWest,
+                                                                mMapList[mapIndex].northEast);
+          if (normalMap != 0)
           {
-            texturePositionX = (float)subdivisionX*textureWidth;
-            texturePositionY = (float)subdivisionY*textureHeight;
-
-            geoPosition[1].latitude = geoPosition[0].latitude;
-            geoPosition[1].longitude = geoPosition[0].longitude + subdivisionWidth;
-            geoPosition[1].altitude = elevationManager->getElevation(geoPosition[1].latitude, geoPosition[1].longitude);
-
-            geoPosition[2].latitude = geoPosition[0].latitude + subdivisionHeight;
-            geoPosition[2].longitude = geoPosition[0].longitude + subdivisionWidth;
-            geoPosition[2].altitude = elevationManager->getElevation(geoPosition[2].latitude, geoPosition[2].longitude);
-
-            geoPosition[3].latitude = geoPosition[0].latitude + subdivisionHeight;
-            geoPosition[3].longitude = geoPosition[0].longitude;
-            geoPosition[3].altitude = elevationManager->getElevation(geoPosition[3].latitude, geoPosition[3].longitude);
-
-            xyzPosition[0] = Utilities::geodeticToXYZ(geoPosition[0]);
-            xyzPosition[1] = Utilities::geodeticToXYZ(geoPosition[1]);
-            xyzPosition[2] = Utilities::geodeticToXYZ(geoPosition[2]);
-            xyzPosition[3] = Utilities::geodeticToXYZ(geoPosition[3]);
-
-            //first triangle
-            //equivalent to 0,0 of texture
-            glTexCoord2f(texturePositionX, texturePositionY);
-            glVertex3f(xyzPosition[0].x, xyzPosition[0].y, xyzPosition[0].z);
-
-            //equivalent to 1,1 of texture
-            glTexCoord2f(texturePositionX+textureWidth, texturePositionY+textureHeight);
-            glVertex3f(xyzPosition[2].x, xyzPosition[2].y, xyzPosition[2].z);
-
-            //equivalent to 0,1 of texture
-            glTexCoord2f(texturePositionX, texturePositionY+textureHeight);
-            glVertex3f(xyzPosition[3].x, xyzPosition[3].y, xyzPosition[3].z);
-
-            //second triangle
-            //equivalent to 0,0 of texture
-            glTexCoord2f(texturePositionX, texturePositionY);
-            glVertex3f(xyzPosition[0].x, xyzPosition[0].y, xyzPosition[0].z);
-
-            //equivalent to 1,0 of texture
-            glTexCoord2f(texturePositionX+textureWidth, texturePositionY);
-            glVertex3f(xyzPosition[1].x, xyzPosition[1].y, xyzPosition[1].z);
-
-            //equivalent to 1,1 of texture
-            glTexCoord2f(texturePositionX+textureWidth, texturePositionY+textureHeight);
-            glVertex3f(xyzPosition[2].x, xyzPosition[2].y, xyzPosition[2].z);
-
-            //advance SW origin in X
-            geoPosition[0].longitude += subdivisionWidth;
-            geoPosition[0].altitude = elevationManager->getElevation(geoPosition[0].latitude, geoPosition[0].longitude);
+            glBindTexture(GL_TEXTURE_2D, normalMap);
+            hillshadeManager->beginShading();
+            renderMapGeometry();
+            hillshadeManager->endShading();
           }
-
-          //advance SW origin in Y and reset X
-          geoPosition[0].latitude += subdivisionHeight;
-          geoPosition[0].longitude = mMapList[mapIndex].southWest.longitude;
-          geoPosition[0].altitude = elevationManager->getElevation(geoPosition[0].latitude, geoPosition[0].longitude);
         }
 
-        glEnd();
         glDisable(GL_TEXTURE_2D);
+
+        if (mMapList[mapIndex].isOverlay)
+        {
+          glDisable(GL_BLEND);
+          glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+          glDepthMask(GL_TRUE);
+          if (mElevationMode)
+          {
+            glDepthFunc(GL_LESS);
+          }
+        }
       }
     }
   }
@@ -473,6 +597,100 @@ void Earth::renderMaps()
   }
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Draws the triangles of the map tile whose vertices were last computed in
+ * renderMaps, with texture coordinates for a texture covering the whole tile.
+ * Hillshading draws the same triangles again, so depths match exactly.
+ */
+void Earth::renderMapGeometry()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mIsMeshGeometry)
+  {
+    renderMapMeshGeometry();
+    return;
+  }
+
+  int subdivisionX = 0;
+  int subdivisionY = 0;
+  int vertexIndex = 0;
+  int verticesPerSide = mNumberOfTileSubdivisions + 1;
+  float textureWidth = 1.0f/(float)mNumberOfTileSubdivisions;
+  float textureHeight = 1.0f/(float)mNumberOfTileSubdivisions;
+  float texturePositionX = 0.0f;
+  float texturePositionY = 0.0f;
+  SimpleVector xyzPosition[4];
+
+  glBegin(GL_TRIANGLES);
+
+  //draw tiles with subdivisions for higher terrain fidelity
+  for (subdivisionY = 0; subdivisionY < mNumberOfTileSubdivisions; subdivisionY++)
+  {
+    for (subdivisionX = 0; subdivisionX < mNumberOfTileSubdivisions; subdivisionX++)
+    {
+      texturePositionX = (float)subdivisionX*textureWidth;
+      texturePositionY = (float)subdivisionY*textureHeight;
+
+      //SW, SE, NE and NW corners of this subdivision
+      vertexIndex = (subdivisionY * verticesPerSide) + subdivisionX;
+      xyzPosition[0] = mVertexPositions[vertexIndex];
+      xyzPosition[1] = mVertexPositions[vertexIndex + 1];
+      xyzPosition[2] = mVertexPositions[vertexIndex + verticesPerSide + 1];
+      xyzPosition[3] = mVertexPositions[vertexIndex + verticesPerSide];
+
+      //first triangle
+      //equivalent to 0,0 of texture
+      glTexCoord2f(texturePositionX, texturePositionY);
+      glVertex3f(xyzPosition[0].x, xyzPosition[0].y, xyzPosition[0].z);
+
+      //equivalent to 1,1 of texture
+      glTexCoord2f(texturePositionX+textureWidth, texturePositionY+textureHeight);
+      glVertex3f(xyzPosition[2].x, xyzPosition[2].y, xyzPosition[2].z);
+
+      //equivalent to 0,1 of texture
+      glTexCoord2f(texturePositionX, texturePositionY+textureHeight);
+      glVertex3f(xyzPosition[3].x, xyzPosition[3].y, xyzPosition[3].z);
+
+      //second triangle
+      //equivalent to 0,0 of texture
+      glTexCoord2f(texturePositionX, texturePositionY);
+      glVertex3f(xyzPosition[0].x, xyzPosition[0].y, xyzPosition[0].z);
+
+      //equivalent to 1,0 of texture
+      glTexCoord2f(texturePositionX+textureWidth, texturePositionY);
+      glVertex3f(xyzPosition[1].x, xyzPosition[1].y, xyzPosition[1].z);
+
+      //equivalent to 1,1 of texture
+      glTexCoord2f(texturePositionX+textureWidth, texturePositionY+textureHeight);
+      glVertex3f(xyzPosition[2].x, xyzPosition[2].y, xyzPosition[2].z);
+    }
+  }
+
+  glEnd();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Draws the terrain mesh triangles of the map tile, clipped to it in
+ * renderMaps.
+ */
+void Earth::renderMapMeshGeometry()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const float* textureCoordinates = mMeshTextureCoordinates.constData();
+
+  glBegin(GL_TRIANGLES);
+
+  for (int i = 0; i < mMeshPositions.size(); i++)
+  {
+    glTexCoord2f(textureCoordinates[2*i], textureCoordinates[2*i + 1]);
+    glVertex3f(mMeshPositions[i].x, mMeshPositions[i].y, mMeshPositions[i].z);
+  }
+
+  glEnd();
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Renders the latitude longitude grid.
@@ -23,15 +23,22 @@
 #ifndef EARTH_H
 #define EARTH_H
 
+#include <QVector>
 #include "globals.h"
 
+class QuantizedMeshTile;
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Singleton class that encapsulates the functionality to render our precious
  * planet along with custom maps or tiles. These tiles can be loaded using a
  * configuration file read in readMapsFile, or by adding them at runtime using
  * the addMap function. The SatelliteImageDownloader class uses the latter to
- * add tiles downloaded from the web.
+ * add tiles downloaded from the web. Maps added as overlays (e.g. a Viewshed)
+ * are blended on top of the maps underneath using the image transparency.
+ * In elevation mode, maps are draped over the quantized-mesh terrain opened in
+ * QuantizedMeshManager where it has tiles, over a regular grid of
+ * ElevationManager samples otherwise.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -40,6 +47,8 @@ class Earth
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   public:
+    static const int MAXIMUM_MAP_TEXTURE_SIZE = 4096;
+
     struct Map
     {
       GeodeticPosition southWest;
@@ -47,19 +56,25 @@ class Earth
       float visibleAltitude;
       int drawPriority;
       unsigned int texture;
+      bool isOverlay;
     };
 
     ~Earth();
     static Earth* getInstance();
 
-    void addMap(const GeodeticPosition& southWest, const GeodeticPosition& northEast,
-                float visibleAltitude, int drawPriority, const QImage& image);
+    unsigned int addMap(const GeodeticPosition& southWest, const GeodeticPosition& northEast,
+                        float visibleAltitude, int drawPriority, const QImage& image,
+                        bool isOverlay = false);
+    bool getElevationMode();
+    void removeMap(unsigned int texture);
     void readMapsFile(const QString& filename);
     void render();
     void setEarthTexture(unsigned int handle);
     void setStarTexture(unsigned int handle);
     void setElevationMode(bool value);
     void setRenderLatLonGrid(bool value);
+    void setRenderContours(bool value);
+    void setRenderHillshade(bool value);
 
   private:
     enum
@@ -73,6 +88,8 @@ class Earth
     void renderStars();
     void renderEarth();
     void renderMaps();
+    void renderMapGeometry();
+    void renderMapMeshGeometry();
     void renderLatLonGrid();
     void createSphereGeometry(double radius);
     void renderLatitudeLine(double latitude);
@@ -85,7 +102,21 @@ class Earth
     unsigned int mStarTextureHandle;
     bool mElevationMode;
     bool mRenderLatLonGrid;
+    bool mRenderContours;
+    bool mRenderHillshade;
     int mNumberOfTileSubdivisions;
+
+    //scratch buffers for tile vertices, kept around to avoid allocating every frame
+    QVector<double> mVertexLatitudes;
+    QVector<double> mVertexLongitudes;
+    QVector<float> mVertexElevations;
+    QVector<SimpleVector> mVertexPositions;
+
+    //clipped terrain mesh triangles of the map tile being rendered
+    bool mIsMeshGeometry;
+    QList<QuantizedMeshTile*> mMeshTiles;
+    QVector<SimpleVector> mMeshPositions;
+    QVector<float> mMeshTextureCoordinates;
 };
 
 #endif//EARTH_H
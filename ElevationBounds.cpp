@@ -0,0 +1,408 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ElevationBounds.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+ElevationBounds::ElevationBounds()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mWidth = 0;
+  mHeight = 0;
+  mOwnedData = NULL;
+  mData = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+ElevationBounds::~ElevationBounds()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  clear();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Allocates a pyramid for a grid of the given size, to be filled with
+ * computeCells and buildLevels.
+ *
+ * @param width Grid width in samples
+ * @param height Grid height in samples
+ */
+void ElevationBounds::allocate(int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  clear();
+  setUpLevels(width, height);
+
+  mOwnedData = new float[getDataSize(width, height)];
+  mData = mOwnedData;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Uses an already built pyramid stored in memory owned by somebody else, the
+ * memory must stay valid until clear is called.
+ *
+ * @param data Pyramid data, getDataSize(width, height) floats
+ * @param width Grid width in samples
+ * @param height Grid height in samples
+ */
+void ElevationBounds::attach(const float* data, int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  clear();
+  setUpLevels(width, height);
+
+  mData = data;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Releases the pyramid.
+ */
+void ElevationBounds::clear()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  delete [] mOwnedData;
+  mOwnedData = NULL;
+  mData = NULL;
+  mWidth = 0;
+  mHeight = 0;
+  mLevelWidths.clear();
+  mLevelHeights.clear();
+  mLevelOffsets.clear();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the level 0 cells for the given band of rows. The band must start
+ * at a multiple of CELL_SIZE and span a multiple of CELL_SIZE rows (or end at
+ * the last row), so different threads can fill different bands at the same
+ * time.
+ *
+ * @param samples Samples of the band (not the whole grid) in meters, row by row
+ * @param firstRow First row of the band
+ * @param numberOfRows Number of rows in the band
+ */
+void ElevationBounds::computeCells(const float* samples, int firstRow, int numberOfRows)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mOwnedData == NULL)
+  {
+    return;
+  }
+
+  int lastRow = firstRow + numberOfRows;
+  for (int cellRow = firstRow / CELL_SIZE; cellRow * CELL_SIZE < lastRow; cellRow++)
+  {
+    int rowEnd = qMin((cellRow + 1) * CELL_SIZE, mHeight);
+    float* cell = mOwnedData + ((size_t)cellRow * mLevelWidths[0]) * 2;
+
+    for (int cellColumn = 0; cellColumn < mLevelWidths[0]; cellColumn++)
+    {
+      int columnStart = cellColumn * CELL_SIZE;
+      int columnEnd = qMin(columnStart + CELL_SIZE, mWidth);
+      float minimum = samples[((size_t)(cellRow * CELL_SIZE - firstRow) * mWidth) + columnStart];
+      float maximum = minimum;
+
+      for (int row = cellRow * CELL_SIZE; row < rowEnd; row++)
+      {
+        const float* sample = samples + ((size_t)(row - firstRow) * mWidth);
+        for (int column = columnStart; column < columnEnd; column++)
+        {
+          minimum = qMin(minimum, sample[column]);
+          maximum = qMax(maximum, sample[column]);
+        }
+      }
+
+      cell[cellColumn * 2] = minimum;
+      cell[(cellColumn * 2) + 1] = maximum;
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Builds every level above level 0, call once all level 0 cells are in.
+ */
+void ElevationBounds::buildLevels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mOwnedData == NULL)
+  {
+    return;
+  }
+
+  for (int level = 1; level < mLevelWidths.size(); level++)
+  {
+    const float* below = mOwnedData + mLevelOffsets[level - 1];
+    float* cells = mOwnedData + mLevelOffsets[level];
+    int belowWidth = mLevelWidths[level - 1];
+    int belowHeight = mLevelHeights[level - 1];
+
+    for (int row = 0; row < mLevelHeights[level]; row++)
+    {
+      for (int column = 0; column < mLevelWidths[level]; column++)
+      {
+        int row0 = row * 2;
+        int row1 = qMin(row0 + 1, belowHeight - 1);
+        int column0 = column * 2;
+        int column1 = qMin(column0 + 1, belowWidth - 1);
+
+        const float* cell00 = below + ((row0 * belowWidth) + column0) * 2;
+        const float* cell01 = below + ((row0 * belowWidth) + column1) * 2;
+        const float* cell10 = below + ((row1 * belowWidth) + column0) * 2;
+        const float* cell11 = below + ((row1 * belowWidth) + column1) * 2;
+
+        float* cell = cells + ((row * mLevelWidths[level]) + column) * 2;
+        cell[0] = qMin(qMin(cell00[0], cell01[0]), qMin(cell10[0], cell11[0]));
+        cell[1] = qMax(qMax(cell00[1], cell01[1]), qMax(cell10[1], cell11[1]));
+      }
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if there is a pyramid to query.
+ *
+ * @return True if allocated or attached
+ */
+bool ElevationBounds::getIsValid()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mData != NULL);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns conservative bounds for the given rectangle of samples (inclusive).
+ * We go up the pyramid until the rectangle spans at most 2x2 cells and take
+ * the bounds of those, so the result might be a little looser than the true
+ * bounds but never tighter.
+ *
+ * @param firstRow First sample row
+ * @param firstColumn First sample column
+ * @param lastRow Last sample row
+ * @param lastColumn Last sample column
+ * @param minimum Set to the minimum elevation in meters
+ * @param maximum Set to the maximum elevation in meters
+ * @return False if the rectangle is outside the grid
+ */
+bool ElevationBounds::getBounds(int firstRow, int firstColumn, int lastRow, int lastColumn,
+                                float& minimum, float& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mData == NULL)
+  {
+    return false;
+  }
+
+  firstRow = qMax(firstRow, 0);
+  firstColumn = qMax(firstColumn, 0);
+  lastRow = qMin(lastRow, mHeight - 1);
+  lastColumn = qMin(lastColumn, mWidth - 1);
+
+  if (firstRow > lastRow || firstColumn > lastColumn)
+  {
+    return false;
+  }
+
+  //convert to level 0 cells and climb until we span 2x2 cells at most
+  int cellRow0 = firstRow / CELL_SIZE;
+  int cellColumn0 = firstColumn / CELL_SIZE;
+  int cellRow1 = lastRow / CELL_SIZE;
+  int cellColumn1 = lastColumn / CELL_SIZE;
+  int level = 0;
+
+  while ((cellRow1 - cellRow0) > 1 || (cellColumn1 - cellColumn0) > 1)
+  {
+    cellRow0 /= 2;
+    cellColumn0 /= 2;
+    cellRow1 /= 2;
+    cellColumn1 /= 2;
+    level++;
+  }
+
+  const float* cells = mData + mLevelOffsets[level];
+  int levelWidth = mLevelWidths[level];
+  minimum = cells[((cellRow0 * levelWidth) + cellColumn0) * 2];
+  maximum = cells[((cellRow0 * levelWidth) + cellColumn0) * 2 + 1];
+
+  for (int row = cellRow0; row <= cellRow1; row++)
+  {
+    for (int column = cellColumn0; column <= cellColumn1; column++)
+    {
+      minimum = qMin(minimum, cells[((row * levelWidth) + column) * 2]);
+      maximum = qMax(maximum, cells[((row * levelWidth) + column) * 2 + 1]);
+    }
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of levels in the pyramid.
+ *
+ * @return Number of levels
+ */
+int ElevationBounds::getNumberOfLevels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevelWidths.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the width of the given level in cells.
+ *
+ * @param level Pyramid level
+ * @return Width in cells
+ */
+int ElevationBounds::getLevelWidth(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevelWidths[level];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the height of the given level in cells.
+ *
+ * @param level Pyramid level
+ * @return Height in cells
+ */
+int ElevationBounds::getLevelHeight(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevelHeights[level];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the bounds of a single cell. A level 0 cell covers CELL_SIZE samples
+ * on a side, and cells double in size on every level.
+ *
+ * @param level Pyramid level
+ * @param row Cell row
+ * @param column Cell column
+ * @param minimum Set to the minimum elevation in meters
+ * @param maximum Set to the maximum elevation in meters
+ */
+void ElevationBounds::getCell(int level, int row, int column, float& minimum, float& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const float* cell = mData + mLevelOffsets[level] + ((row * mLevelWidths[level]) + column) * 2;
+  minimum = cell[0];
+  maximum = cell[1];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the raw pyramid data, e.g. to write it to a file.
+ *
+ * @return Pyramid data
+ */
+const float* ElevationBounds::getData()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mData;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of the raw pyramid data.
+ *
+ * @return Number of floats
+ */
+int ElevationBounds::getDataSize()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return getDataSize(mWidth, mHeight);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of the raw pyramid data for a grid of the given size.
+ *
+ * @param width Grid width in samples
+ * @param height Grid height in samples
+ * @return Number of floats
+ */
+int ElevationBounds::getDataSize(int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int levelWidth = (width + CELL_SIZE - 1) / CELL_SIZE;
+  int levelHeight = (height + CELL_SIZE - 1) / CELL_SIZE;
+  int size = levelWidth * levelHeight * 2;
+
+  while (levelWidth > 1 || levelHeight > 1)
+  {
+    levelWidth = (levelWidth + 1) / 2;
+    levelHeight = (levelHeight + 1) / 2;
+    size += levelWidth * levelHeight * 2;
+  }
+
+  return size;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Figures out the size and location of every level.
+ *
+ * @param width Grid width in samples
+ * @param height Grid height in samples
+ */
+void ElevationBounds::setUpLevels(int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mWidth = width;
+  mHeight = height;
+
+  int levelWidth = (width + CELL_SIZE - 1) / CELL_SIZE;
+  int levelHeight = (height + CELL_SIZE - 1) / CELL_SIZE;
+  int offset = 0;
+
+  while (true)
+  {
+    mLevelWidths.append(levelWidth);
+    mLevelHeights.append(levelHeight);
+    mLevelOffsets.append(offset);
+    offset += levelWidth * levelHeight * 2;
+
+    if (levelWidth == 1 && levelHeight == 1)
+    {
+      break;
+    }
+
+    levelWidth = (levelWidth + 1) / 2;
+    levelHeight = (levelHeight + 1) / 2;
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELEVATION_BOUNDS_H
+#define ELEVATION_BOUNDS_H
+
+#include <QVector>
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Min/max pyramid over a grid of elevation samples. Level 0 holds the minimum
+ * and maximum of every CELL_SIZE x CELL_SIZE block of samples, every level
+ * after that halves the previous one, down to a single cell. Any rectangle of
+ * samples is bounded by at most 4 cells of the right level, so getBounds runs
+ * in O(log n) and never touches the samples themselves.
+ *
+ * Level 0 is filled a band of rows at a time with computeCells (loader threads
+ * do this as rows come in), then buildLevels computes the rest. Alternatively
+ * the whole pyramid can be attached from memory that somebody else owns, e.g.
+ * a memory mapped ElevationCache file.
+ *
+ * Cells are stored as (minimum, maximum) float pairs in meters, level after
+ * level, row by row.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ElevationBounds
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int CELL_SIZE = 16;
+
+    ElevationBounds();
+    ~ElevationBounds();
+
+    void allocate(int width, int height);
+    void attach(const float* data, int width, int height);
+    void clear();
+    void computeCells(const float* samples, int firstRow, int numberOfRows);
+    void buildLevels();
+
+    bool getIsValid();
+    bool getBounds(int firstRow, int firstColumn, int lastRow, int lastColumn,
+                   float& minimum, float& maximum);
+    int getNumberOfLevels();
+    int getLevelWidth(int level);
+    int getLevelHeight(int level);
+    void getCell(int level, int row, int column, float& minimum, float& maximum);
+    const float* getData();
+    int getDataSize();
+
+    static int getDataSize(int width, int height);
+
+  private:
+    void setUpLevels(int width, int height);
+
+    int mWidth;
+    int mHeight;
+    QVector<int> mLevelWidths;
+    QVector<int> mLevelHeights;
+    QVector<int> mLevelOffsets;
+    float* mOwnedData;
+    const float* mData;
+};
+
+#endif//ELEVATION_BOUNDS_H
@@ -0,0 +1,492 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <QList>
+#include <QFileInfo>
+#include "ElevationCache.h"
+#include "ElevationBounds.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+ElevationCache::ElevationCache()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mMappedFile = NULL;
+  mHeader = NULL;
+  mLevels = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. Unmaps the cache file if one is open.
+ */
+ElevationCache::~ElevationCache()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  close();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Memory maps the given cache file and validates its header. Nothing but the
+ * header and level table is actually read here, tiles are paged in by the OS
+ * the first time getSample touches them. The level table has to match the
+ * pyramid write would build for the header size exactly, so that every tile
+ * offset falls inside the mapped file.
+ *
+ * @param filePath The file path for the cache file
+ * @return True if the file was mapped and is a valid cache file
+ */
+bool ElevationCache::open(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  close();
+
+  mFile.setFileName(filePath);
+  if (!mFile.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  qint64 fileSize = mFile.size();
+  if (fileSize < (qint64)sizeof(Header))
+  {
+    printf("ElevationCache.cpp: %s is not an elevation cache file.\n", filePath.toStdString().c_str());
+    mFile.close();
+    return false;
+  }
+
+  mMappedFile = mFile.map(0, fileSize);
+  if (mMappedFile == NULL)
+  {
+    printf("ElevationCache.cpp: Error mapping %s.\n", filePath.toStdString().c_str());
+    mFile.close();
+    return false;
+  }
+
+  mHeader = (const Header*)mMappedFile;
+  mLevels = (const Level*)(mMappedFile + sizeof(Header));
+
+  //make sure this is a cache file we know how to read
+  bool isValid = (memcmp(mHeader->magic, "SEEC", 4) == 0 &&
+                  mHeader->version == VERSION &&
+                  mHeader->tileSize == TILE_SIZE &&
+                  mHeader->width > 0 && mHeader->height > 0 &&
+                  mHeader->sampleSizeXDegrees != 0.0 && mHeader->sampleSizeYDegrees != 0.0);
+
+  //the pyramid is fully determined by the level 0 size, see write
+  if (isValid)
+  {
+    int numberOfLevels = 1;
+    int levelWidth = mHeader->width;
+    int levelHeight = mHeader->height;
+    while (levelWidth > TILE_SIZE || levelHeight > TILE_SIZE)
+    {
+      levelWidth = (levelWidth + 1) / 2;
+      levelHeight = (levelHeight + 1) / 2;
+      numberOfLevels++;
+    }
+
+    isValid = (mHeader->numberOfLevels == numberOfLevels &&
+               sizeof(Header) + numberOfLevels * sizeof(Level) <= (size_t)fileSize);
+  }
+
+  //every level must be half the size of the previous one, with its tiles
+  //right after them, so nothing below reads past the end of the mapping
+  if (isValid)
+  {
+    qint64 tileBytes = (qint64)TILE_SIZE * TILE_SIZE * sizeof(float);
+    qint64 offset = sizeof(Header) + mHeader->numberOfLevels * sizeof(Level);
+    int levelWidth = mHeader->width;
+    int levelHeight = mHeader->height;
+    for (int i = 0; i < mHeader->numberOfLevels && isValid; i++)
+    {
+      const Level& level = mLevels[i];
+      isValid = (level.width == levelWidth &&
+                 level.height == levelHeight &&
+                 level.tilesX == (levelWidth + TILE_SIZE - 1) / TILE_SIZE &&
+                 level.tilesY == (levelHeight + TILE_SIZE - 1) / TILE_SIZE &&
+                 level.offset == offset &&
+                 (qint64)level.tilesX * level.tilesY <= (fileSize - offset) / tileBytes);
+
+      offset += (qint64)level.tilesX * level.tilesY * tileBytes;
+      levelWidth = (levelWidth + 1) / 2;
+      levelHeight = (levelHeight + 1) / 2;
+    }
+
+    //make sure the file was not truncated
+    qint64 boundsBytes = (qint64)ElevationBounds::getDataSize(mHeader->width, mHeader->height) * sizeof(float);
+    isValid = (isValid &&
+               mHeader->boundsOffset == offset &&
+               boundsBytes <= fileSize - offset);
+  }
+
+  if (!isValid)
+  {
+    printf("ElevationCache.cpp: %s is not a valid elevation cache file.\n", filePath.toStdString().c_str());
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unmaps and closes the cache file.
+ */
+void ElevationCache::close()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mMappedFile != NULL)
+  {
+    mFile.unmap(mMappedFile);
+  }
+
+  if (mFile.isOpen())
+  {
+    mFile.close();
+  }
+
+  mMappedFile = NULL;
+  mHeader = NULL;
+  mLevels = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if a cache file is currently mapped.
+ *
+ * @return True if a cache file is open
+ */
+bool ElevationCache::getIsOpen()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mMappedFile != NULL);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of levels in the pyramid, level 0 being full resolution.
+ *
+ * @return Number of pyramid levels
+ */
+int ElevationCache::getNumberOfLevels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mHeader != NULL) ? mHeader->numberOfLevels : 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the width of the given pyramid level in samples.
+ *
+ * @param level Pyramid level
+ * @return Width in samples
+ */
+int ElevationCache::getWidth(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mHeader != NULL) ? mLevels[level].width : 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the height of the given pyramid level in samples.
+ *
+ * @param level Pyramid level
+ * @return Height in samples
+ */
+int ElevationCache::getHeight(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mHeader != NULL) ? mLevels[level].height : 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the geodetic position of the top left sample.
+ *
+ * @return Origin of the database, altitude is always 0
+ */
+GeodeticPosition ElevationCache::getOrigin()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  GeodeticPosition origin;
+  origin.latitude = (mHeader != NULL) ? mHeader->originLatitude : 0.0;
+  origin.longitude = (mHeader != NULL) ? mHeader->originLongitude : 0.0;
+  origin.altitude = 0.0;
+
+  return origin;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of a level 0 sample in longitude.
+ *
+ * @return Sample size in decimal degrees
+ */
+double ElevationCache::getSampleSizeXDegrees()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mHeader != NULL) ? mHeader->sampleSizeXDegrees : 0.0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of a level 0 sample in latitude. Negative for north-up
+ * databases, just like the GDAL geotransform.
+ *
+ * @return Sample size in decimal degrees
+ */
+double ElevationCache::getSampleSizeYDegrees()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mHeader != NULL) ? mHeader->sampleSizeYDegrees : 0.0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the sample at the given row and column of the given pyramid level.
+ * Rows and columns outside the level are clamped to its edges.
+ *
+ * @param level Pyramid level
+ * @param row Sample row
+ * @param column Sample column
+ * @return Elevation in meters
+ */
+float ElevationCache::getSample(int level, int row, int column)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const Level& cacheLevel = mLevels[level];
+
+  if (row < 0) row = 0;
+  if (column < 0) column = 0;
+  if (row >= cacheLevel.height) row = cacheLevel.height - 1;
+  if (column >= cacheLevel.width) column = cacheLevel.width - 1;
+
+  //find tile, then sample within tile
+  size_t tileIndex = (size_t)(row / TILE_SIZE) * cacheLevel.tilesX + (column / TILE_SIZE);
+  size_t sampleIndex = (size_t)(row % TILE_SIZE) * TILE_SIZE + (column % TILE_SIZE);
+  const float* tile = (const float*)(mMappedFile + cacheLevel.offset) + tileIndex * TILE_SIZE * TILE_SIZE;
+
+  return tile[sampleIndex];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the min/max pyramid of level 0, to be attached to an ElevationBounds.
+ *
+ * @return Pyramid data, NULL if no file is open
+ */
+const float* ElevationCache::getBoundsData()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mHeader == NULL)
+  {
+    return NULL;
+  }
+
+  return (const float*)(mMappedFile + mHeader->boundsOffset);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the default cache file path for the given source database, i.e. the
+ * same path with a .sec extension.
+ *
+ * @param sourcePath The file path for the source database
+ * @return The file path for the cache file
+ */
+QString ElevationCache::getCachePath(const QString& sourcePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QFileInfo fileInfo(sourcePath);
+  return fileInfo.path() + "/" + fileInfo.completeBaseName() + ".sec";
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Writes the given samples into a new cache file, building all the pyramid
+ * levels on the way. Every level is the 2x2 average of the previous one, down
+ * to the first level that fits in a single tile. The min/max pyramid of level
+ * 0 goes at the end of the file.
+ *
+ * @param filePath The file path for the cache file
+ * @param samples Level 0 samples in meters, row by row
+ * @param width Width in samples
+ * @param height Height in samples
+ * @param origin Geodetic position of the top left sample
+ * @param sampleSizeXDegrees Size of a sample in longitude
+ * @param sampleSizeYDegrees Size of a sample in latitude
+ * @return True if the file was written successfully
+ */
+bool ElevationCache::write(const QString& filePath, const float* samples, int width, int height,
+                           const GeodeticPosition& origin, double sampleSizeXDegrees, double sampleSizeYDegrees)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (samples == NULL || width <= 0 || height <= 0)
+  {
+    return false;
+  }
+
+  //figure out pyramid levels and where their tiles go in the file
+  QList<Level> levels;
+  int levelWidth = width;
+  int levelHeight = height;
+  int numberOfLevels = 1;
+  while (levelWidth > TILE_SIZE || levelHeight > TILE_SIZE)
+  {
+    levelWidth = (levelWidth + 1) / 2;
+    levelHeight = (levelHeight + 1) / 2;
+    numberOfLevels++;
+  }
+
+  qint64 tileBytes = (qint64)TILE_SIZE * TILE_SIZE * sizeof(float);
+  qint64 offset = sizeof(Header) + numberOfLevels * sizeof(Level);
+  levelWidth = width;
+  levelHeight = height;
+  for (int i = 0; i < numberOfLevels; i++)
+  {
+    Level level;
+    level.width = levelWidth;
+    level.height = levelHeight;
+    level.tilesX = (levelWidth + TILE_SIZE - 1) / TILE_SIZE;
+    level.tilesY = (levelHeight + TILE_SIZE - 1) / TILE_SIZE;
+    level.offset = offset;
+    levels.append(level);
+
+    offset += (qint64)level.tilesX * level.tilesY * tileBytes;
+    levelWidth = (levelWidth + 1) / 2;
+    levelHeight = (levelHeight + 1) / 2;
+  }
+
+  QFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    printf("ElevationCache.cpp: Error opening %s for writing.\n", filePath.toStdString().c_str());
+    return false;
+  }
+
+  Header header;
+  memcpy(header.magic, "SEEC", 4);
+  header.version = VERSION;
+  header.width = width;
+  header.height = height;
+  header.tileSize = TILE_SIZE;
+  header.numberOfLevels = numberOfLevels;
+  header.originLatitude = origin.latitude;
+  header.originLongitude = origin.longitude;
+  header.sampleSizeXDegrees = sampleSizeXDegrees;
+  header.sampleSizeYDegrees = sampleSizeYDegrees;
+  header.boundsOffset = offset;
+
+  bool succeeded = (file.write((const char*)&header, sizeof(Header)) == (qint64)sizeof(Header));
+  for (int i = 0; i < numberOfLevels && succeeded; i++)
+  {
+    succeeded = (file.write((const char*)&levels[i], sizeof(Level)) == (qint64)sizeof(Level));
+  }
+
+  float* tile = new float[TILE_SIZE * TILE_SIZE];
+  const float* levelSamples = samples;
+  float* reducedSamples = NULL;
+
+  for (int i = 0; i < numberOfLevels && succeeded; i++)
+  {
+    const Level& level = levels[i];
+
+    //cut level into tiles, padding the edge tiles with the last row and column
+    for (int tileY = 0; tileY < level.tilesY && succeeded; tileY++)
+    {
+      for (int tileX = 0; tileX < level.tilesX && succeeded; tileX++)
+      {
+        for (int row = 0; row < TILE_SIZE; row++)
+        {
+          int sourceRow = qMin(tileY * TILE_SIZE + row, level.height - 1);
+          for (int column = 0; column < TILE_SIZE; column++)
+          {
+            int sourceColumn = qMin(tileX * TILE_SIZE + column, level.width - 1);
+            tile[row * TILE_SIZE + column] = levelSamples[(size_t)sourceRow * level.width + sourceColumn];
+          }
+        }
+
+        succeeded = (file.write((const char*)tile, tileBytes) == tileBytes);
+      }
+    }
+
+    //build next level by averaging 2x2 blocks of this one
+    if (i + 1 < numberOfLevels && succeeded)
+    {
+      const Level& nextLevel = levels[i + 1];
+      float* nextSamples = new float[(size_t)nextLevel.width * nextLevel.height];
+
+      for (int row = 0; row < nextLevel.height; row++)
+      {
+        int row0 = row * 2;
+        int row1 = qMin(row0 + 1, level.height - 1);
+        for (int column = 0; column < nextLevel.width; column++)
+        {
+          int column0 = column * 2;
+          int column1 = qMin(column0 + 1, level.width - 1);
+          nextSamples[(size_t)row * nextLevel.width + column] =
+            (levelSamples[(size_t)row0 * level.width + column0] +
+             levelSamples[(size_t)row0 * level.width + column1] +
+             levelSamples[(size_t)row1 * level.width + column0] +
+             levelSamples[(size_t)row1 * level.width + column1]) * 0.25f;
+        }
+      }
+
+      delete [] reducedSamples;
+      reducedSamples = nextSamples;
+      levelSamples = reducedSamples;
+    }
+  }
+
+  delete [] reducedSamples;
+  delete [] tile;
+
+  if (succeeded)
+  {
+    ElevationBounds bounds;
+    bounds.allocate(width, height);
+    bounds.computeCells(samples, 0, height);
+    bounds.buildLevels();
+
+    qint64 boundsBytes = (qint64)bounds.getDataSize() * sizeof(float);
+    succeeded = (file.write((const char*)bounds.getData(), boundsBytes) == boundsBytes);
+  }
+
+  file.close();
+
+  if (!succeeded)
+  {
+    printf("ElevationCache.cpp: Error writing %s.\n", filePath.toStdString().c_str());
+    QFile::remove(filePath);
+  }
+
+  return succeeded;
+}
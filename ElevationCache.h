@@ -0,0 +1,116 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELEVATION_CACHE_H
+#define ELEVATION_CACHE_H
+
+#include <QString>
+#include <QFile>
+#include "globals.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This class reads and writes SimpleEarth elevation cache files (.sec). A cache
+ * file stores an elevation database as a pyramid of levels, every level half
+ * the size of the previous one, cut into square tiles of float samples (in
+ * meters). Cache files are written once from a GDAL source (see the
+ * ElevationConverter tool) and then memory mapped, so opening one takes no
+ * time at all and the OS only pages in the tiles that are actually looked at.
+ *
+ * File layout (native byte order):
+ *   Header
+ *   Level[numberOfLevels]
+ *   tiles of level 0, row by row, then tiles of level 1, and so on
+ *   min/max pyramid of level 0 (see ElevationBounds)
+ *
+ * Samples in a tile are stored row by row, tiles on the right and bottom edges
+ * are padded by repeating the last column and row.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ElevationCache
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    /**
+     * Cache file header.
+     */
+    struct Header
+    {
+      char magic[4];
+      qint32 version;
+      qint32 width;
+      qint32 height;
+      qint32 tileSize;
+      qint32 numberOfLevels;
+      double originLatitude;
+      double originLongitude;
+      double sampleSizeXDegrees;
+      double sampleSizeYDegrees;
+      qint64 boundsOffset;
+    };
+
+    /**
+     * Describes one level of the pyramid, offset is in bytes from the start
+     * of the file.
+     */
+    struct Level
+    {
+      qint32 width;
+      qint32 height;
+      qint32 tilesX;
+      qint32 tilesY;
+      qint64 offset;
+    };
+
+    static const int TILE_SIZE = 256;
+    static const int VERSION = 2;
+
+    ElevationCache();
+    ~ElevationCache();
+
+    bool open(const QString& filePath);
+    void close();
+    bool getIsOpen();
+    int getNumberOfLevels();
+    int getWidth(int level = 0);
+    int getHeight(int level = 0);
+    GeodeticPosition getOrigin();
+    double getSampleSizeXDegrees();
+    double getSampleSizeYDegrees();
+    float getSample(int level, int row, int column);
+    const float* getBoundsData();
+
+    static QString getCachePath(const QString& sourcePath);
+    static bool write(const QString& filePath, const float* samples, int width, int height,
+                      const GeodeticPosition& origin, double sampleSizeXDegrees, double sampleSizeYDegrees);
+
+  private:
+    QFile mFile;
+    uchar* mMappedFile;
+    const Header* mHeader;
+    const Level* mLevels;
+};
+
+#endif//ELEVATION_CACHE_H
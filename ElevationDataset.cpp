@@ -0,0 +1,1022 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <QFileInfo>
+#include "ElevationDataset.h"
+#include "ElevationLoaderThread.h"
+#include "ElevationManager.h"
+#include "ElevationSampler.h"
+#include "GeoTiffReader.h"
+#include "math.h"
+
+#ifdef USING_GDAL
+#include "gdal.h"
+#include "cpl_conv.h"
+#endif
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes, call open to read the header.
+ *
+ * @param filePath The file path for the database or cache file
+ */
+ElevationDataset::ElevationDataset(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mFilePath = filePath;
+  mIsCache = filePath.endsWith(".sec", Qt::CaseInsensitive);
+  mIsGeoTiff = false;
+  mDatabase = NULL;
+  mIsCompressed = false;
+  mUseCompressedStorage = false;
+  mIsLoaded.fetchAndStoreOrdered(0);
+  mOrigin.latitude = 0.0;
+  mOrigin.longitude = 0.0;
+  mOrigin.altitude = 0.0;
+  mSampleSizeXDegrees = 0.0;
+  mSampleSizeYDegrees = 0.0;
+  mInverseSampleSizeXDegrees = 0.0;
+  mInverseSampleSizeYDegrees = 0.0;
+  mNorth = 0.0;
+  mSouth = 0.0;
+  mEast = 0.0;
+  mWest = 0.0;
+  mWidth = 0;
+  mHeight = 0;
+  mLastUsed.fetchAndStoreOrdered(0);
+  mPinCount.fetchAndStoreOrdered(0);
+  mNumberOfFinishedThreads = 0;
+  mRowsLoaded = 0;
+  mIsLoading = false;
+  mLoadFailed = false;
+  mLastLoadTime = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. Waits for loader threads and releases the samples.
+ */
+ElevationDataset::~ElevationDataset()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  unload();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads the header of the dataset: size, origin and sample size. No samples
+ * are read. GeoTIFF files are tried with GeoTiffReader first, GDAL gets the
+ * rest. Most of the GDAL code is taken from the GDAL API Tutorial, refer to
+ * (gdal.org/gdal_tutorial.html).
+ *
+ * @return True if the file could be opened and holds elevation data
+ */
+bool ElevationDataset::open()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mIsGeoTiff = false;
+
+  if (mIsCache)
+  {
+    //mapping a cache file is cheap, but there is no need to keep it around
+    if (!mCache.open(mFilePath))
+    {
+      return false;
+    }
+
+    mOrigin = mCache.getOrigin();
+    mSampleSizeXDegrees = mCache.getSampleSizeXDegrees();
+    mSampleSizeYDegrees = mCache.getSampleSizeYDegrees();
+    mWidth = mCache.getWidth();
+    mHeight = mCache.getHeight();
+    mCache.close();
+  }
+  else
+  {
+    //only the header is parsed here, loader threads open their own readers
+    if (GeoTiffReader::isTiffFile(mFilePath))
+    {
+      GeoTiffReader reader;
+      if (reader.open(mFilePath) && reader.getIsElevation() && reader.getHasGeoreference())
+      {
+        mIsGeoTiff = true;
+        mOrigin = reader.getOrigin();
+        mSampleSizeXDegrees = reader.getSampleSizeXDegrees();
+        mSampleSizeYDegrees = reader.getSampleSizeYDegrees();
+        mWidth = reader.getWidth();
+        mHeight = reader.getHeight();
+      }
+    }
+
+    if (!mIsGeoTiff)
+    {
+#ifndef USING_GDAL
+      return false;
+#else
+      GDALDatasetH hDataset;
+      GDALAllRegister();//register all drivers
+      hDataset = GDALOpen(mFilePath.toStdString().c_str(), GA_ReadOnly);
+
+      if (hDataset == NULL)
+      {
+        return false;
+      }
+
+      //elevation databases have a single band with no color table
+      GDALRasterBandH hBand = GDALGetRasterBand(hDataset, 1);
+      double adfGeoTransform[6];
+      bool isElevation = (GDALGetRasterCount(hDataset) == 1 &&
+                          GDALGetRasterColorTable(hBand) == NULL &&
+                          GDALGetGeoTransform(hDataset, adfGeoTransform) == CE_None);
+
+      if (isElevation)
+      {
+        mOrigin.longitude = adfGeoTransform[0];
+        mOrigin.latitude = adfGeoTransform[3];
+        mSampleSizeXDegrees = adfGeoTransform[1];
+        mSampleSizeYDegrees = adfGeoTransform[5];
+        mWidth = GDALGetRasterXSize(hDataset);
+        mHeight = GDALGetRasterYSize(hDataset);
+      }
+
+      //close file
+      GDALClose(hDataset);
+
+      if (!isElevation)
+      {
+        return false;
+      }
+#endif
+    }
+  }
+
+  if (mSampleSizeXDegrees == 0.0 || mSampleSizeYDegrees == 0.0)
+  {
+    return false;
+  }
+
+  //samplers multiply instead of divide
+  mInverseSampleSizeXDegrees = 1.0 / mSampleSizeXDegrees;
+  mInverseSampleSizeYDegrees = 1.0 / mSampleSizeYDegrees;
+
+  //footprint is checked for every sample, so we figure it out once
+  mNorth = qMax(mOrigin.latitude, mOrigin.latitude + mHeight * mSampleSizeYDegrees);
+  mSouth = qMin(mOrigin.latitude, mOrigin.latitude + mHeight * mSampleSizeYDegrees);
+  mEast = qMax(mOrigin.longitude, mOrigin.longitude + mWidth * mSampleSizeXDegrees);
+  mWest = qMin(mOrigin.longitude, mOrigin.longitude + mWidth * mSampleSizeXDegrees);
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts reading the samples. Cache files are mapped right away, source
+ * databases are read in native block rows by the given number of loader
+ * threads and become available once the last thread is done. Does nothing if
+ * the dataset is already loaded or loading.
+ *
+ * @param numberOfThreads Number of loader threads
+ * @return True if the samples are being (or have been) loaded
+ */
+bool ElevationDataset::startLoading(int numberOfThreads)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (getIsLoaded() || getIsLoading())
+  {
+    return true;
+  }
+
+  //make sure no previous load is still writing to the database
+  releaseLoaderThreads();
+
+  mLoadTimer.start();
+  mLastLoadTime = 0;
+
+  if (mIsCache)
+  {
+    //the file may have been replaced since open read its header
+    mLoadFailed = (!mCache.open(mFilePath) || mCache.getWidth() != mWidth || mCache.getHeight() != mHeight);
+    mRowsLoaded = mHeight;
+    finishLoading();
+    return getIsLoaded();
+  }
+
+  //native block height, reads are grouped in whole rows of blocks
+  int nBlockYSize = 1;
+
+  if (mIsGeoTiff)
+  {
+    GeoTiffReader reader;
+    if (!reader.open(mFilePath))
+    {
+      mLoadFailed = true;
+      return false;
+    }
+
+    nBlockYSize = reader.getTileHeight();
+    qDebug("GeoTIFF size is %dx%d, %d levels, block height %d", reader.getWidth(), reader.getHeight(),
+           reader.getNumberOfLevels(), nBlockYSize);
+  }
+  else
+  {
+#ifndef USING_GDAL
+    mLoadFailed = true;
+    return false;
+#else
+    GDALDatasetH hDataset;
+    GDALAllRegister();//register all drivers
+    hDataset = GDALOpen(mFilePath.toStdString().c_str(), GA_ReadOnly);
+
+    if (hDataset == NULL)
+    {
+      mLoadFailed = true;
+      return false;
+    }
+
+    GDALDriverH hDriver = GDALGetDatasetDriver(hDataset);
+    qDebug("Driver: %s/%s", GDALGetDriverShortName(hDriver), GDALGetDriverLongName(hDriver));
+    qDebug("Size is %dx%dx%d", GDALGetRasterXSize(hDataset), GDALGetRasterYSize(hDataset), GDALGetRasterCount(hDataset));
+
+    GDALRasterBandH hBand;
+    int nBlockXSize;
+
+    hBand = GDALGetRasterBand(hDataset, 1);
+    GDALGetBlockSize(hBand, &nBlockXSize, &nBlockYSize);
+    qDebug("Block=%dx%d Type=%s, ColorInterp=%s", nBlockXSize, nBlockYSize,
+           GDALGetDataTypeName(GDALGetRasterDataType(hBand)),
+           GDALGetColorInterpretationName(GDALGetRasterColorInterpretation(hBand)));
+
+    //we only needed the header, loader threads open their own handles
+    GDALClose(hDataset);
+#endif
+  }
+
+  //allocate space for database (or its tiles) and its min/max pyramid
+  mIsCompressed = mUseCompressedStorage;
+  if (mIsCompressed)
+  {
+    mStore.allocate(mWidth, mHeight);
+  }
+  else
+  {
+    mDatabase = new float[(size_t)mWidth*(size_t)mHeight];
+  }
+  mBounds.allocate(mWidth, mHeight);
+
+  //read whole rows of native blocks at a time, scanline formats report a block
+  //height of 1, so we group enough rows to keep the number of calls down
+  if (nBlockYSize < 1)
+  {
+    nBlockYSize = 1;//broken headers, the loop below would never end
+  }
+  int rowsPerRead = nBlockYSize;
+  while (rowsPerRead < 64 && rowsPerRead < mHeight)
+  {
+    rowsPerRead += nBlockYSize;
+  }
+
+  //min/max cells (and tiles, a multiple of cells) must not straddle two reads,
+  //they are computed by different threads
+  int rowAlignment = mIsCompressed ? ElevationTileStore::TILE_SIZE : ElevationBounds::CELL_SIZE;
+  rowsPerRead = ((rowsPerRead + rowAlignment - 1) / rowAlignment) * rowAlignment;
+
+  int numberOfBlockRows = (mHeight + rowsPerRead - 1) / rowsPerRead;
+  if (numberOfThreads > numberOfBlockRows)
+  {
+    numberOfThreads = numberOfBlockRows;
+  }
+  if (numberOfThreads < 1)
+  {
+    numberOfThreads = 1;
+  }
+
+  mLoadMutex.lock();
+  mRowsLoaded = 0;
+  mNumberOfFinishedThreads = 0;
+  mLoadFailed = false;
+  mIsLoading = true;
+
+  //block rows are interleaved between threads so that every thread reads
+  //from all over the file and they all finish at about the same time
+  for (int i = 0; i < numberOfThreads; i++)
+  {
+    mLoaderThreads.append(new ElevationLoaderThread(this, mFilePath, mIsGeoTiff, mDatabase,
+                                                     mIsCompressed ? &mStore : NULL, &mBounds,
+                                                     mWidth, mHeight, rowsPerRead, i, numberOfThreads));
+  }
+  mLoadMutex.unlock();
+
+  for (int i = 0; i < mLoaderThreads.size(); i++)
+  {
+    mLoaderThreads[i]->start();
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Blocks until the current load is done, i.e. until finishLoading or unload
+ * runs. Waits on a condition instead of the loader threads, which the dataset
+ * releases whenever it loads again. Pin the dataset first, so it stays around
+ * while waiting.
+ */
+void ElevationDataset::waitForLoading()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLoadMutex.lock();
+  while (mIsLoading)
+  {
+    mLoadFinished.wait(&mLoadMutex);
+  }
+  mLoadMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Makes the samples available to getElevation, or releases them if the load
+ * failed. ElevationManager calls this with its lock held for writing, so that
+ * readers never see a half loaded dataset.
+ */
+void ElevationDataset::finishLoading()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLoadMutex.lock();
+
+  if (mLoadFailed)
+  {
+    printf("ElevationDataset.cpp: Error loading %s.\n", mFilePath.toStdString().c_str());
+    delete [] mDatabase;
+    mDatabase = NULL;
+    mStore.clear();
+    mIsCompressed = false;
+    mBounds.clear();
+    mCache.close();
+    mIsLoaded.fetchAndStoreOrdered(0);
+  }
+  else
+  {
+    //cache files come with their pyramid, otherwise loader threads did level 0
+    if (mIsCache)
+    {
+      mBounds.attach(mCache.getBoundsData(), mWidth, mHeight);
+    }
+    else
+    {
+      mBounds.buildLevels();
+    }
+
+    //if we get this far, database loaded fine
+    mIsLoaded.fetchAndStoreOrdered(1);
+    mLastLoadTime = mLoadTimer.elapsed();
+
+    qDebug("Loaded %dx%d samples in %lld ms using %d threads (%.1f Msamples/s)",
+           mWidth, mHeight, (long long)mLastLoadTime, mLoaderThreads.size(),
+           ((double)mWidth * (double)mHeight) / ((double)(mLastLoadTime + 1) * 1000.0));
+  }
+
+  mIsLoading = false;
+  mLoadFinished.wakeAll();
+  mLoadMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Releases the samples, the header stays valid so the dataset can be loaded
+ * again later on.
+ */
+void ElevationDataset::unload()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mIsLoaded.fetchAndStoreOrdered(0);
+  releaseLoaderThreads();
+  mBounds.clear();
+  mCache.close();
+  delete [] mDatabase;
+  mDatabase = NULL;
+  mStore.clear();
+  mIsCompressed = false;
+
+  mLoadMutex.lock();
+  mIsLoading = false;
+  mLoadFinished.wakeAll();
+  mLoadMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Writes the samples of a loaded source database into an elevation cache file,
+ * so that it can be mapped from then on. Compressed datasets are unpacked into
+ * a temporary buffer first.
+ *
+ * @param filePath The file path for the cache file
+ * @return True if the cache file was written successfully
+ */
+bool ElevationDataset::saveCache(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (!getIsLoaded() || (mDatabase == NULL && !mIsCompressed))
+  {
+    return false;
+  }
+
+  if (mIsCompressed)
+  {
+    float* samples = new float[(size_t)mWidth*(size_t)mHeight];
+    mStore.decompressRows(samples, 0, mHeight);
+    bool succeeded = ElevationCache::write(filePath, samples, mWidth, mHeight,
+                                           mOrigin, mSampleSizeXDegrees, mSampleSizeYDegrees);
+    delete [] samples;
+    return succeeded;
+  }
+
+  return ElevationCache::write(filePath, mDatabase, mWidth, mHeight,
+                               mOrigin, mSampleSizeXDegrees, mSampleSizeYDegrees);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the file path for the dataset.
+ *
+ * @return The file path for the database or cache file
+ */
+const QString& ElevationDataset::getFilePath()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mFilePath;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the dataset is an ElevationCache file.
+ *
+ * @return True if the dataset is a cache file
+ */
+bool ElevationDataset::getIsCache()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mIsCache;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the samples are available to getElevation.
+ *
+ * @return True if the dataset is loaded
+ */
+bool ElevationDataset::getIsLoaded()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mIsLoaded.fetchAndAddOrdered(0) != 0);//atomic read
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true while loader threads are still reading the dataset.
+ *
+ * @return True if the dataset is currently being loaded
+ */
+bool ElevationDataset::getIsLoading()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLoadMutex.lock();
+  bool isLoading = mIsLoading;
+  mLoadMutex.unlock();
+
+  return isLoading;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the last attempt to load the dataset failed, in which case
+ * ElevationManager does not retry it.
+ *
+ * @return True if the last load failed
+ */
+bool ElevationDataset::getLoadFailed()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLoadMutex.lock();
+  bool loadFailed = mLoadFailed;
+  mLoadMutex.unlock();
+
+  return loadFailed;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of rows read so far by the current (or last) load.
+ *
+ * @return Number of rows read
+ */
+int ElevationDataset::getLoadProgress()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLoadMutex.lock();
+  int rowsLoaded = mRowsLoaded;
+  mLoadMutex.unlock();
+
+  return rowsLoaded;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns how long the last successful load took, from opening the file until
+ * the last loader thread finished.
+ *
+ * @return Load time in milliseconds
+ */
+qint64 ElevationDataset::getLastLoadTime()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLastLoadTime;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the amount of heap memory the dataset takes once loaded. Cache files
+ * are memory mapped and paged by the OS, so they do not count. Compressed
+ * datasets are budgeted for the worst case until they are loaded, their
+ * actual size depends on the terrain.
+ *
+ * @return Memory size in bytes
+ */
+qint64 ElevationDataset::getMemorySize()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mIsCache)
+  {
+    return 0;
+  }
+
+  if (getIsLoaded() && mIsCompressed)
+  {
+    return mStore.getMemorySize();
+  }
+
+  if ((getIsLoaded() || getIsLoading()) ? mIsCompressed : mUseCompressedStorage)
+  {
+    return ElevationTileStore::estimateMemorySize(mWidth, mHeight);
+  }
+
+  return (qint64)mWidth * (qint64)mHeight * (qint64)sizeof(float);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the width of the dataset.
+ *
+ * @return Width in samples
+ */
+int ElevationDataset::getWidth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mWidth;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the height of the dataset.
+ *
+ * @return Height in samples
+ */
+int ElevationDataset::getHeight()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mHeight;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the geodetic position of the top left sample.
+ *
+ * @return Origin of the dataset, altitude is always 0
+ */
+GeodeticPosition ElevationDataset::getOrigin()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mOrigin;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of a sample in longitude.
+ *
+ * @return Sample size in decimal degrees
+ */
+double ElevationDataset::getSampleSizeXDegrees()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSampleSizeXDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of a sample in latitude. Negative for north-up datasets.
+ *
+ * @return Sample size in decimal degrees
+ */
+double ElevationDataset::getSampleSizeYDegrees()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSampleSizeYDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the northern edge of the dataset footprint.
+ *
+ * @return Latitude in decimal degrees
+ */
+double ElevationDataset::getNorth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mNorth;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the southern edge of the dataset footprint.
+ *
+ * @return Latitude in decimal degrees
+ */
+double ElevationDataset::getSouth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSouth;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the eastern edge of the dataset footprint.
+ *
+ * @return Longitude in decimal degrees
+ */
+double ElevationDataset::getEast()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mEast;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the western edge of the dataset footprint.
+ *
+ * @return Longitude in decimal degrees
+ */
+double ElevationDataset::getWest()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mWest;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the given geodetic position falls inside the footprint.
+ *
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @return True if the dataset covers the given position
+ */
+bool ElevationDataset::contains(double latitude, double longitude)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (latitude >= mSouth && latitude <= mNorth &&
+          longitude >= mWest && longitude <= mEast);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the elevation of the given geodetic position in Km, interpolated
+ * bilinearly between the 4 surrounding samples. The dataset must be loaded,
+ * positions outside the footprint are clamped to its edges.
+ *
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @return Elevation of the given geodetic point in Km
+ */
+float ElevationDataset::getElevation(double latitude, double longitude)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  float elevation = 0.0f;
+  getElevations(&latitude, &longitude, &elevation, 1);
+
+  return elevation;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Batch version of getElevation. Datasets loaded into memory are sampled with
+ * ElevationSampler (AVX2 when available), compressed datasets by their
+ * ElevationTileStore and cache files tile by tile.
+ *
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ */
+void ElevationDataset::getElevations(const double* latitudes, const double* longitudes,
+                                     float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //can't interpolate on a single row or column
+  if (mWidth < 2 || mHeight < 2)
+  {
+    for (int i = 0; i < numberOfPoints; i++)
+    {
+      elevations[i] = 0.0f;
+    }
+    return;
+  }
+
+  if (mDatabase == NULL && !mIsCompressed)
+  {
+    sampleCacheBilinear(latitudes, longitudes, elevations, numberOfPoints);
+    return;
+  }
+
+  ElevationSampler::Grid grid;
+  grid.samples = mDatabase;
+  grid.width = mWidth;
+  grid.height = mHeight;
+  grid.originLatitude = mOrigin.latitude;
+  grid.originLongitude = mOrigin.longitude;
+  grid.inverseSampleSizeXDegrees = mInverseSampleSizeXDegrees;
+  grid.inverseSampleSizeYDegrees = mInverseSampleSizeYDegrees;
+
+  if (mIsCompressed)
+  {
+    mStore.sampleBilinear(grid, latitudes, longitudes, elevations, numberOfPoints);
+    return;
+  }
+
+  ElevationSampler::sampleBilinear(grid, latitudes, longitudes, elevations, numberOfPoints);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns conservative elevation bounds for the given region, looked up in the
+ * min/max pyramid. The dataset must be loaded.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param minimum Set to the minimum elevation in Km
+ * @param maximum Set to the maximum elevation in Km
+ * @return False if the region does not overlap the dataset
+ */
+bool ElevationDataset::getElevationBounds(double south, double west, double north, double east,
+                                          float& minimum, float& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (south > mNorth || north < mSouth || west > mEast || east < mWest)
+  {
+    return false;
+  }
+
+  //rows and columns of the samples around the region corners, bilinear
+  //interpolation never goes outside of those
+  double row0 = (north - mOrigin.latitude) * mInverseSampleSizeYDegrees;
+  double row1 = (south - mOrigin.latitude) * mInverseSampleSizeYDegrees;
+  double column0 = (west - mOrigin.longitude) * mInverseSampleSizeXDegrees;
+  double column1 = (east - mOrigin.longitude) * mInverseSampleSizeXDegrees;
+
+  if (!mBounds.getBounds((int)floor(qMin(row0, row1)), (int)floor(qMin(column0, column1)),
+                         (int)ceil(qMax(row0, row1)), (int)ceil(qMax(column0, column1)),
+                         minimum, maximum))
+  {
+    return false;
+  }
+
+  //return bounds in Km
+  minimum /= 1000.0f;
+  maximum /= 1000.0f;
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the min/max pyramid of the dataset, only valid while loaded.
+ *
+ * @return The min/max pyramid
+ */
+ElevationBounds* ElevationDataset::getBounds()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return &mBounds;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the last time (in ElevationManager ticks) the dataset was used, this
+ * is what the least recently used datasets are unloaded by. Readers call this
+ * concurrently, so the tick is kept in an atomic.
+ *
+ * @param lastUsed Tick of last use
+ */
+void ElevationDataset::setLastUsed(int lastUsed)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLastUsed.fetchAndStoreOrdered(lastUsed);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the last time (in ElevationManager ticks) the dataset was used.
+ *
+ * @return Tick of last use
+ */
+int ElevationDataset::getLastUsed()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLastUsed.fetchAndAddOrdered(0);//atomic read
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Pins the dataset: ElevationManager neither unloads nor reloads pinned
+ * datasets, and does not delete them until they are unpinned. Pins are
+ * counted, every pin must be balanced by unpin. Pin while holding the manager
+ * lock, so the dataset can not be unregistered in between.
+ */
+void ElevationDataset::pin()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mPinCount.fetchAndAddOrdered(1);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Releases a pin taken with pin.
+ */
+void ElevationDataset::unpin()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mPinCount.fetchAndAddOrdered(-1);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if somebody holds a pin on the dataset.
+ *
+ * @return True if the dataset is pinned
+ */
+bool ElevationDataset::getIsPinned()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mPinCount.fetchAndAddOrdered(0) > 0);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets whether samples are kept as floats or packed into an
+ * ElevationTileStore (about a quarter of the memory, slower to sample). Takes
+ * effect the next time the dataset is loaded, cache files are not affected.
+ *
+ * @param value True to store samples compressed
+ */
+void ElevationDataset::setCompressedStorage(bool value)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mUseCompressedStorage = value;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by loader threads every time they are done reading a block row. This
+ * method is thread-safe.
+ *
+ * @param numberOfRows Number of database rows that were just read
+ */
+void ElevationDataset::reportRowsLoaded(int numberOfRows)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLoadMutex.lock();
+  mRowsLoaded += numberOfRows;
+  mLoadMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by loader threads right before they exit. The last thread to finish
+ * hands the dataset over to ElevationManager, which publishes it. This method
+ * is thread-safe.
+ *
+ * @param succeeded False if the calling thread failed to read its rows
+ */
+void ElevationDataset::reportLoaderThreadFinished(bool succeeded)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLoadMutex.lock();
+
+  mNumberOfFinishedThreads++;
+  if (!succeeded)
+  {
+    mLoadFailed = true;
+  }
+  bool isLastThread = (mNumberOfFinishedThreads == mLoaderThreads.size());
+
+  mLoadMutex.unlock();
+
+  if (isLastThread)
+  {
+    ElevationManager::getInstance()->reportDatasetLoaded(this);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the given file looks like something ElevationDataset can
+ * open, judging by its extension.
+ *
+ * @param filePath The file path to check
+ * @return True if the file extension is a known elevation format
+ */
+bool ElevationDataset::isElevationFile(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QString suffix = QFileInfo(filePath).suffix().toLower();
+  return (suffix == "sec" || suffix == "tif" || suffix == "tiff" || suffix == "img" ||
+          suffix == "dem" || suffix == "dt0" || suffix == "dt1" || suffix == "dt2" ||
+          suffix == "hgt" || suffix == "bil");
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Bilinear sampling for cache files, same math as the scalar kernel in
+ * ElevationSampler but going through the tiled layout.
+ *
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ */
+void ElevationDataset::sampleCacheBilinear(const double* latitudes, const double* longitudes,
+                                           float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double maxRow = mHeight - 1;
+  double maxColumn = mWidth - 1;
+
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    double row = (latitudes[i] - mOrigin.latitude) * mInverseSampleSizeYDegrees;
+    double column = (longitudes[i] - mOrigin.longitude) * mInverseSampleSizeXDegrees;
+    row = (row < 0.0) ? 0.0 : ((row > maxRow) ? maxRow : row);
+    column = (column < 0.0) ? 0.0 : ((column > maxColumn) ? maxColumn : column);
+
+    int row0 = qMin((int)row, mHeight - 2);
+    int column0 = qMin((int)column, mWidth - 2);
+    float fractionY = (float)(row - row0);
+    float fractionX = (float)(column - column0);
+
+    float topLeft = mCache.getSample(0, row0, column0);
+    float topRight = mCache.getSample(0, row0, column0 + 1);
+    float bottomLeft = mCache.getSample(0, row0 + 1, column0);
+    float bottomRight = mCache.getSample(0, row0 + 1, column0 + 1);
+
+    float top = topLeft + (topRight - topLeft) * fractionX;
+    float bottom = bottomLeft + (bottomRight - bottomLeft) * fractionX;
+
+    //return elevation in Km
+    elevations[i] = (top + (bottom - top) * fractionY) * 0.001f;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Waits for any running loader threads and releases them.
+ */
+void ElevationDataset::releaseLoaderThreads()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < mLoaderThreads.size(); i++)
+  {
+    mLoaderThreads[i]->wait();
+    delete mLoaderThreads[i];
+  }
+  mLoaderThreads.clear();
+}
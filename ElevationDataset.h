@@ -0,0 +1,154 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELEVATION_DATASET_H
+#define ELEVATION_DATASET_H
+
+#include <QString>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include "globals.h"
+#include "ElevationCache.h"
+#include "ElevationBounds.h"
+#include "ElevationTileStore.h"
+
+class ElevationLoaderThread;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * A single elevation database registered with ElevationManager. A dataset is
+ * either a source database or an ElevationCache file. GeoTIFF databases are
+ * read with the built-in GeoTiffReader, every other format goes through GDAL.
+ * Opening a dataset only reads its header (footprint, size and resolution),
+ * samples are read later on by startLoading: source databases are read into
+ * memory by a pool of ElevationLoaderThread objects (either as floats or
+ * packed into an ElevationTileStore, see setCompressedStorage), cache files
+ * are just memory mapped. GeoTIFF databases are loaded whole as well: their
+ * loader threads use windowed GeoTiffReader reads, one block row at a time,
+ * but nothing is streamed by view. Overviews are only used for imagery.
+ * A min/max pyramid (ElevationBounds) comes along with the samples, so that
+ * region bounds can be queried without scanning them.
+ *
+ * ElevationManager is in charge of deciding which datasets are loaded at any
+ * given time, and of publishing the loaded state (see finishLoading) so that
+ * getElevation can be called without locking the dataset. Callers that wait for
+ * a dataset to load pin it (see pin), so that the manager does not unload or
+ * reload it under them.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ElevationDataset
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    ElevationDataset(const QString& filePath);
+    ~ElevationDataset();
+
+    bool open();
+    bool startLoading(int numberOfThreads);
+    void waitForLoading();
+    void finishLoading();
+    void unload();
+    bool saveCache(const QString& filePath);
+
+    const QString& getFilePath();
+    bool getIsCache();
+    bool getIsLoaded();
+    bool getIsLoading();
+    bool getLoadFailed();
+    int getLoadProgress();
+    qint64 getLastLoadTime();
+    qint64 getMemorySize();
+    int getWidth();
+    int getHeight();
+    GeodeticPosition getOrigin();
+    double getSampleSizeXDegrees();
+    double getSampleSizeYDegrees();
+    double getNorth();
+    double getSouth();
+    double getEast();
+    double getWest();
+    bool contains(double latitude, double longitude);
+    float getElevation(double latitude, double longitude);
+    void getElevations(const double* latitudes, const double* longitudes, float* elevations, int numberOfPoints);
+    bool getElevationBounds(double south, double west, double north, double east,
+                            float& minimum, float& maximum);
+    ElevationBounds* getBounds();
+
+    void setLastUsed(int lastUsed);
+    int getLastUsed();
+    void pin();
+    void unpin();
+    bool getIsPinned();
+    void setCompressedStorage(bool value);
+
+    //called by loader threads
+    void reportRowsLoaded(int numberOfRows);
+    void reportLoaderThreadFinished(bool succeeded);
+
+    static bool isElevationFile(const QString& filePath);
+
+  private:
+    void releaseLoaderThreads();
+    void sampleCacheBilinear(const double* latitudes, const double* longitudes, float* elevations, int numberOfPoints);
+
+    QString mFilePath;
+    bool mIsCache;
+    bool mIsGeoTiff;
+    ElevationCache mCache;
+    float* mDatabase;
+    ElevationTileStore mStore;
+    bool mIsCompressed;
+    bool mUseCompressedStorage;
+    ElevationBounds mBounds;
+    QAtomicInt mIsLoaded;//read without the load mutex by getIsLoaded
+    GeodeticPosition mOrigin;
+    double mSampleSizeXDegrees;
+    double mSampleSizeYDegrees;
+    double mInverseSampleSizeXDegrees;
+    double mInverseSampleSizeYDegrees;
+    double mNorth;
+    double mSouth;
+    double mEast;
+    double mWest;
+    int mWidth;
+    int mHeight;
+    QAtomicInt mLastUsed;//set by readers holding the manager lock for reading
+    QAtomicInt mPinCount;
+
+    QList<ElevationLoaderThread*> mLoaderThreads;
+    QMutex mLoadMutex;
+    QWaitCondition mLoadFinished;//signaled when mIsLoading goes back to false
+    int mNumberOfFinishedThreads;
+    int mRowsLoaded;
+    bool mIsLoading;
+    bool mLoadFailed;
+    QElapsedTimer mLoadTimer;
+    qint64 mLastLoadTime;
+};
+
+#endif//ELEVATION_DATASET_H
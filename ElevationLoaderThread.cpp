@@ -0,0 +1,209 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include "ElevationLoaderThread.h"
+#include "ElevationDataset.h"
+#include "ElevationBounds.h"
+#include "ElevationTileStore.h"
+#include "GeoTiffReader.h"
+
+#ifdef USING_GDAL
+#include "gdal.h"
+#endif
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ *
+ * @param dataset Dataset the rows are read for
+ * @param filePath The file path for the database
+ * @param isGeoTiff True to read the database with GeoTiffReader instead of GDAL
+ * @param destination Buffer of width*height samples the rows are read into,
+ *        NULL when reading into the store
+ * @param store Tile store the rows are packed into, NULL when reading into
+ *        the destination buffer
+ * @param bounds Min/max pyramid to compute level 0 cells for
+ * @param width Database width in samples
+ * @param height Database height in samples
+ * @param blockHeight Number of rows read on every call
+ * @param firstBlockRow Index of the first block row read by this thread
+ * @param blockRowStride Number of block rows to skip after every read
+ */
+ElevationLoaderThread::ElevationLoaderThread(ElevationDataset* dataset, const QString& filePath,
+                                             bool isGeoTiff, float* destination, ElevationTileStore* store,
+                                             ElevationBounds* bounds, int width, int height, int blockHeight,
+                                             int firstBlockRow, int blockRowStride)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mDataset = dataset;
+  mFilePath = filePath;
+  mIsGeoTiff = isGeoTiff;
+  mDestination = destination;
+  mStore = store;
+  mBounds = bounds;
+  mWidth = width;
+  mHeight = height;
+  mBlockHeight = blockHeight;
+  mFirstBlockRow = firstBlockRow;
+  mBlockRowStride = blockRowStride;
+  mSucceeded = false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+ElevationLoaderThread::~ElevationLoaderThread()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * OVERRIDE FOR QThread. This method runs on a separate thread. Reads every
+ * block row assigned to this thread with a single windowed read (GeoTIFF) or
+ * GDALRasterIO call per block row, computes its min/max cells and lets the
+ * dataset know about the progress.
+ */
+void ElevationLoaderThread::run()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mSucceeded = false;
+
+  //every thread needs its own handle since GDAL handles are not thread-safe,
+  //readers only map the file so opening one per thread is cheap as well
+  GeoTiffReader reader;
+#ifdef USING_GDAL
+  GDALDatasetH hDataset = NULL;
+  GDALRasterBandH hBand = NULL;
+#endif
+
+  if (mIsGeoTiff)
+  {
+    if (!reader.open(mFilePath))
+    {
+      printf("ElevationLoaderThread.cpp: Error opening elevation database.\n");
+      mDataset->reportLoaderThreadFinished(false);
+      return;
+    }
+  }
+  else
+  {
+#ifndef USING_GDAL
+    mDataset->reportLoaderThreadFinished(false);
+    return;
+#else
+    hDataset = GDALOpen(mFilePath.toStdString().c_str(), GA_ReadOnly);
+    if (hDataset == NULL)
+    {
+      printf("ElevationLoaderThread.cpp: Error opening elevation database.\n");
+      mDataset->reportLoaderThreadFinished(false);
+      return;
+    }
+
+    hBand = GDALGetRasterBand(hDataset, 1);
+#endif
+  }
+
+  int numberOfBlockRows = (mHeight + mBlockHeight - 1) / mBlockHeight;
+  int firstRow = 0;
+  int numberOfRows = 0;
+  mSucceeded = true;
+
+  for (int blockRow = mFirstBlockRow; blockRow < numberOfBlockRows && mSucceeded; blockRow += mBlockRowStride)
+  {
+    firstRow = blockRow * mBlockHeight;
+    numberOfRows = mBlockHeight;
+
+    //last block row might be incomplete
+    if (firstRow + numberOfRows > mHeight)
+    {
+      numberOfRows = mHeight - firstRow;
+    }
+
+    float* destination = NULL;
+    if (mStore != NULL)
+    {
+      mBlockRow.resize(numberOfRows * mWidth);
+      destination = mBlockRow.data();
+    }
+    else
+    {
+      destination = &mDestination[(size_t)firstRow * (size_t)mWidth];
+    }
+    bool isRead = false;
+
+    if (mIsGeoTiff)
+    {
+      isRead = reader.readSamples(0, 0, firstRow, mWidth, numberOfRows, destination);
+    }
+#ifdef USING_GDAL
+    else
+    {
+      isRead = (GDALRasterIO(hBand, GF_Read, 0, firstRow, mWidth, numberOfRows, destination,
+                             mWidth, numberOfRows, GDT_Float32, 0, 0) == CE_None);
+    }
+#endif
+
+    if (!isRead)
+    {
+      printf("ElevationLoaderThread.cpp: Error reading elevation database.\n");
+      mSucceeded = false;
+    }
+    else
+    {
+      //pack first, bounds have to match the quantized samples
+      if (mStore != NULL)
+      {
+        mStore->compressRows(destination, firstRow, numberOfRows);
+      }
+      mBounds->computeCells(destination, firstRow, numberOfRows);
+    }
+
+    mDataset->reportRowsLoaded(numberOfRows);
+  }
+
+  //close file
+  reader.close();
+#ifdef USING_GDAL
+  if (hDataset != NULL)
+  {
+    GDALClose(hDataset);
+  }
+#endif
+
+  mDataset->reportLoaderThreadFinished(mSucceeded);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if all block rows assigned to this thread were read without
+ * errors.
+ *
+ * @return True if this thread read its block rows successfully
+ */
+bool ElevationLoaderThread::getSucceeded()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSucceeded;
+}
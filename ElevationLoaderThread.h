@@ -0,0 +1,79 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELEVATION_LOADER_THREAD_H
+#define ELEVATION_LOADER_THREAD_H
+
+#include <QThread>
+#include <QString>
+#include <QVector>
+
+class ElevationDataset;
+class ElevationBounds;
+class ElevationTileStore;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Worker thread used by ElevationDataset to read an elevation database in
+ * parallel. Each thread opens its own GeoTiffReader or GDAL handle to the file
+ * (GDAL handles are not thread-safe) and reads whole rows of native blocks,
+ * starting at the given block row and skipping ahead by the given stride,
+ * straight into the shared destination buffer. Since every thread writes to a
+ * disjoint set of rows no locking is needed on the buffer itself. When the
+ * dataset is stored compressed, block rows are read into a scratch buffer and
+ * packed into the ElevationTileStore instead. The level 0 cells of the min/max
+ * pyramid are computed for every block row as soon as it is read. Progress is
+ * reported back to the ElevationDataset after every block row.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ElevationLoaderThread : public QThread
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    ElevationLoaderThread(ElevationDataset* dataset, const QString& filePath, bool isGeoTiff,
+                          float* destination, ElevationTileStore* store, ElevationBounds* bounds,
+                          int width, int height, int blockHeight,
+                          int firstBlockRow, int blockRowStride);
+    ~ElevationLoaderThread();
+
+    void run();//OVERRIDE
+    bool getSucceeded();
+
+  private:
+    ElevationDataset* mDataset;
+    QString mFilePath;
+    bool mIsGeoTiff;
+    float* mDestination;
+    ElevationTileStore* mStore;
+    ElevationBounds* mBounds;
+    int mWidth;
+    int mHeight;
+    int mBlockHeight;
+    int mFirstBlockRow;
+    int mBlockRowStride;
+    bool mSucceeded;
+    QVector<float> mBlockRow;//scratch buffer when reading into the store
+};
+
+#endif//ELEVATION_LOADER_THREAD_H
@@ -20,13 +20,20 @@
  *  <http://www.gnu.org/licenses/>.
  */
 
-#include "ElevationManager.h"
-#include "math.h"
 
-#ifdef USING_GDAL
-#include "gdal.h"
-#include "cpl_conv.h"
+#include <QThread>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <qnumeric.h>
+#include "ElevationManager.h"
+#include "ElevationDataset.h"
+#include "ElevationCache.h"
+#ifndef NO_QUANTIZED_MESH
+#include "QuantizedMeshManager.h"
 #endif
+#include "CrossPlatformSleep.h"
+#include "math.h"
 
 //Singleton implementation
 ElevationManager* ElevationManager::mInstance = NULL;
@@ -38,14 +45,16 @@ ElevationManager* ElevationManager::mInstance = NULL;
 ElevationManager::ElevationManager()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  mDatabase = NULL;
-  mDatabaseIsLoaded = false;
-  mDatabaseOrigin.latitude = 0.0f;
-  mDatabaseOrigin.longitude = 0.0f;
-  mAreaSizeXDegrees = 0.0f;
-  mAreaSizeYDegrees = 0.0f;
-  mDatabaseWidth = 0;
-  mDatabaseHeight = 0;
+  mUseTick = 0;
+  mNumberOfLoaderThreads = QThread::idealThreadCount();
+  mMemoryBudget = 1024LL * 1024LL * 1024LL;//1 GB
+  mUseCompressedStorage = false;
+  mLastLoadTime = 0;
+#ifndef NO_QUANTIZED_MESH
+  mMeshManager = QuantizedMeshManager::getInstance();
+#else
+  mMeshManager = NULL;
+#endif
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -55,8 +64,7 @@ ElevationManager::ElevationManager()
 ElevationManager::~ElevationManager()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  delete [] mDatabase;
-  mDatabaseIsLoaded = false;
+  clearElevationDatasets();
   mInstance = NULL;
 }
 
@@ -79,114 +87,487 @@ ElevationManager* ElevationManager::getInstance()
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Loads the given elevation database file into memory for quick access to the
- * the data. Most of this method is taken from the GDAL API Tutorial, refer to
- * (gdal.org/gdal_tutorial.html).
+ * Registers the given elevation database (or ElevationCache file) with the
+ * mosaic. Only the header is read, samples are loaded on demand.
+ *
+ * @param filePath The file path for the database
+ * @return True if the database was registered (or already was)
+ */
+bool ElevationManager::addElevationDataset(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (registerDataset(filePath) != NULL);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Registers every elevation database found in the given directory. When both
+ * a source database and its converted ElevationCache file are found, only the
+ * cache file is registered, unless the source was modified after the cache
+ * was written. The stale cache is left out then.
+ *
+ * @param directoryPath Directory that holds the elevation databases
+ * @return Number of databases registered
+ */
+int ElevationManager::addElevationDirectory(const QString& directoryPath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QDir directory(directoryPath);
+  QStringList fileNames = directory.entryList(QDir::Files, QDir::Name);
+  QStringList skippedFileNames;
+  int numberOfDatasets = 0;
+
+  //pick either the source database or its cache file, whichever is newer
+  for (int i = 0; i < fileNames.size(); i++)
+  {
+    QString filePath = directoryPath + "/" + fileNames[i];
+    if (filePath.endsWith(".sec", Qt::CaseInsensitive) || !ElevationDataset::isElevationFile(filePath))
+    {
+      continue;
+    }
+
+    QFileInfo cacheInfo(ElevationCache::getCachePath(filePath));
+    if (cacheInfo.exists())
+    {
+      if (QFileInfo(filePath).lastModified() > cacheInfo.lastModified())
+      {
+        skippedFileNames.append(cacheInfo.fileName());
+      }
+      else
+      {
+        skippedFileNames.append(fileNames[i]);
+      }
+    }
+  }
+
+  for (int i = 0; i < fileNames.size(); i++)
+  {
+    QString filePath = directoryPath + "/" + fileNames[i];
+    if (skippedFileNames.contains(fileNames[i]) || !ElevationDataset::isElevationFile(filePath))
+    {
+      continue;
+    }
+
+    if (registerDataset(filePath) != NULL)
+    {
+      numberOfDatasets++;
+    }
+  }
+
+  return numberOfDatasets;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unregisters and releases all datasets.
+ */
+void ElevationManager::clearElevationDatasets()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLock.lockForWrite();
+  QList<ElevationDataset*> datasets = mDatasets;
+  mDatasets.clear();
+  mCells.clear();
+  mLock.unlock();
+
+  //loader threads report back to us, so we can't wait for them while locked,
+  //and loadRegion callers or pinRegion users may still hold pins on them
+  for (int i = 0; i < datasets.size(); i++)
+  {
+    datasets[i]->waitForLoading();
+    while (datasets[i]->getIsPinned())
+    {
+      CrossPlatformSleep::msleep(1);
+    }
+    delete datasets[i];
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of registered datasets.
+ *
+ * @return Number of datasets
+ */
+int ElevationManager::getNumberOfDatasets()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  return mDatasets.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Registers the given elevation database if needed and loads it into memory
+ * right away. This method blocks until the whole database has been read, use
+ * startLoadingElevationDatabase if you want to keep processing events (e.g. to
+ * show progress) while the database loads.
  *
  * @param filePath The file path for the database.
+ * @return True if the database was loaded successfully
  */
-void ElevationManager::loadElevationDatabase(const QString& filePath)
+bool ElevationManager::loadElevationDatabase(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-#ifndef USING_GDAL
-  Q_UNUSED(filePath);
-#else
+  if (!startLoadingElevationDatabase(filePath))
+  {
+    return false;
+  }
 
-  //clear previous database in case one was already loaded
-  if (mDatabase != NULL)
+  //keep the dataset from being unloaded or deleted while we wait
+  ElevationDataset* dataset = findDataset(filePath, true);
+  if (dataset == NULL)
   {
-    delete [] mDatabase;
+    return false;//cleared in the meantime
   }
 
-  GDALDatasetH hDataset;
-  GDALAllRegister();//register all drivers
-  hDataset = GDALOpen(filePath.toStdString().c_str(), GA_ReadOnly);
+  dataset->waitForLoading();
+
+  mLock.lockForRead();
+  bool isLoaded = dataset->getIsLoaded();
+  mLock.unlock();
 
-  if (hDataset == NULL)
+  dataset->unpin();
+  return isLoaded;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Registers the given elevation database if needed and starts loading it
+ * right away instead of waiting for getElevation to ask for it. A database
+ * that is already loaded is read again, unless somebody is waiting on it (see
+ * ElevationDataset::pin). Returns right away, poll getIsLoading and
+ * getLoadProgress to find out when it is done.
+ *
+ * @param filePath The file path for the database.
+ * @return True if the database was opened and loading was started
+ */
+bool ElevationManager::startLoadingElevationDatabase(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ElevationDataset* dataset = registerDataset(filePath);
+  if (dataset == NULL)
   {
-    return;
+    return false;
+  }
+
+  QWriteLocker locker(&mLock);
+
+  if (dataset->getIsLoading() || dataset->getIsPinned())
+  {
+    return true;
+  }
+
+  if (dataset->getIsLoaded())
+  {
+    dataset->unload();
+  }
+
+  makeRoomFor(dataset);
+  dataset->setLastUsed(mUseTick);
+  return dataset->startLoading(mNumberOfLoaderThreads);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Loads the finest datasets covering the given region right away instead of
+ * waiting for getElevation to ask for them, so that analyses that sample a
+ * whole region at once (e.g. Viewshed) never get coarser elevations. This
+ * method blocks until those datasets have been read, they are pinned in the
+ * meantime so that loads of other regions can not unload them.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @return True if every dataset covering the region got loaded
+ */
+bool ElevationManager::loadRegion(double south, double west, double north, double east)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QList<ElevationDataset*> datasets;
+  bool succeeded = pinRegion(south, west, north, east, datasets);
+  unpinDatasets(datasets);
+
+  return succeeded;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Same as loadRegion, but the datasets covering the region stay pinned when
+ * this method returns, so that analyses running on several threads can load
+ * their region once and sample it until they are done. Pass the datasets to
+ * unpinDatasets then, clearElevationDatasets waits until they are unpinned.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param datasets Set to the pinned datasets
+ * @return True if every dataset covering the region got loaded
+ */
+bool ElevationManager::pinRegion(double south, double west, double north, double east,
+                                 QList<ElevationDataset*>& datasets)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLock.lockForRead();
+  findRegionDatasets(south, west, north, east, true, datasets);
+  for (int i = 0; i < datasets.size(); i++)
+  {
+    datasets[i]->pin();
+  }
+  mLock.unlock();
+
+  for (int i = 0; i < datasets.size(); i++)
+  {
+    requestLoad(datasets[i]);
   }
 
-  //if we get this far, database will load fine
-  mDatabaseIsLoaded = true;
+  bool succeeded = true;
+  for (int i = 0; i < datasets.size(); i++)
+  {
+    datasets[i]->waitForLoading();
 
-  GDALDriverH hDriver;
-  double adfGeoTransform[6];
-  hDriver = GDALGetDatasetDriver(hDataset);
+    mLock.lockForRead();
+    if (!datasets[i]->getIsLoaded())
+    {
+      succeeded = false;
+    }
+    mLock.unlock();
+  }
 
-  qDebug("Driver: %s/%s", GDALGetDriverShortName(hDriver), GDALGetDriverLongName(hDriver));
-  qDebug("Size is %dx%dx%d", GDALGetRasterXSize(hDataset), GDALGetRasterYSize(hDataset), GDALGetRasterCount(hDataset));
+  return succeeded;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts loading the finest datasets covering the given region, like
+ * loadRegion, but returns right away. Threads that must not block (e.g. the
+ * GUI thread handing out tiles to workers) call it until it returns true.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @return True once every dataset covering the region is done loading
+ */
+bool ElevationManager::startLoadingRegion(double south, double west, double north, double east)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QList<ElevationDataset*> datasets;
+  QList<ElevationDataset*> datasetsToLoad;
 
-  if (GDALGetProjectionRef(hDataset) != NULL)
+  mLock.lockForRead();
+  findRegionDatasets(south, west, north, east, true, datasets);
+  for (int i = 0; i < datasets.size(); i++)
   {
-    qDebug("Projection is %s", GDALGetProjectionRef(hDataset));
+    //datasets that failed to load are done too, they will never get loaded
+    if (!datasets[i]->getIsLoaded() && !datasets[i]->getLoadFailed())
+    {
+      datasetsToLoad.append(datasets[i]);
+    }
   }
+  mLock.unlock();
 
-  if (GDALGetGeoTransform(hDataset, adfGeoTransform) == CE_None)
+  for (int i = 0; i < datasetsToLoad.size(); i++)
   {
-    qDebug("Origin = (%.6f,%.6f)", adfGeoTransform[0], adfGeoTransform[3]);
-    qDebug("Pixel Size = (%.6f,%.6f)", adfGeoTransform[1], adfGeoTransform[5]);
-    mDatabaseOrigin.longitude = adfGeoTransform[0];
-    mDatabaseOrigin.latitude = adfGeoTransform[3];
-    mAreaSizeXDegrees = adfGeoTransform[1];
-    mAreaSizeYDegrees = adfGeoTransform[5];
+    requestLoad(datasetsToLoad[i]);
   }
 
-  GDALRasterBandH hBand;
-  int nBlockXSize, nBlockYSize;
-  int bGotMin, bGotMax;
-  double adfMinMax[2];
+  return datasetsToLoad.isEmpty();
+}
 
-  hBand = GDALGetRasterBand(hDataset, 1);
-  GDALGetBlockSize(hBand, &nBlockXSize, &nBlockYSize);
-  qDebug("Block=%dx%d Type=%s, ColorInterp=%s",
-         nBlockXSize, nBlockYSize,
-         GDALGetDataTypeName(GDALGetRasterDataType(hBand)),
-         GDALGetColorInterpretationName(GDALGetRasterColorInterpretation(hBand)));
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Releases the pins taken by pinRegion.
+ *
+ * @param datasets Datasets pinRegion returned
+ */
+void ElevationManager::unpinDatasets(const QList<ElevationDataset*>& datasets)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < datasets.size(); i++)
+  {
+    datasets[i]->unpin();
+  }
+}
 
-  adfMinMax[0] = GDALGetRasterMinimum(hBand, &bGotMin);
-  adfMinMax[1] = GDALGetRasterMaximum(hBand, &bGotMax);
-  if (!(bGotMin && bGotMax))
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true while any dataset is being loaded.
+ *
+ * @return True if a dataset is currently being loaded
+ */
+bool ElevationManager::getIsLoading()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+
+  for (int i = 0; i < mDatasets.size(); i++)
   {
-    GDALComputeRasterMinMax(hBand, TRUE, adfMinMax);
-    qDebug("Min=%.3fd, Max=%.3f", adfMinMax[0], adfMinMax[1]);
+    if (mDatasets[i]->getIsLoading())
+    {
+      return true;
+    }
   }
 
-  if (GDALGetOverviewCount(hBand) > 0)
+  return false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the combined progress of all datasets currently being loaded.
+ *
+ * @return Load progress in percent, 100 if nothing is loading
+ */
+int ElevationManager::getLoadProgress()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  qint64 rowsLoaded = 0;
+  qint64 rowsToLoad = 0;
+
+  for (int i = 0; i < mDatasets.size(); i++)
   {
-    qDebug("Band has %d overviews.", GDALGetOverviewCount(hBand));
+    if (mDatasets[i]->getIsLoading())
+    {
+      rowsLoaded += mDatasets[i]->getLoadProgress();
+      rowsToLoad += mDatasets[i]->getHeight();
+    }
   }
 
-  if (GDALGetRasterColorTable(hBand) != NULL)
+  if (rowsToLoad == 0)
   {
-    qDebug("Band has a color table with %d entries.", GDALGetColorEntryCount(GDALGetRasterColorTable(hBand)));
+    return 100;
   }
 
-  mDatabaseWidth = GDALGetRasterXSize(hDataset);
-  mDatabaseHeight = GDALGetRasterYSize(hDataset);
+  return (int)((rowsLoaded * 100) / rowsToLoad);
+}
 
-  //allocate space for database
-  mDatabase = new float[mDatabaseWidth*mDatabaseHeight];
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns how long the last dataset load took, from opening the file until
+ * the last loader thread finished.
+ *
+ * @return Load time in milliseconds
+ */
+qint64 ElevationManager::getLastLoadTime()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  return mLastLoadTime;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the number of threads used to read every dataset. Defaults to the
+ * number of processor cores.
+ *
+ * @param numberOfThreads Number of loader threads
+ */
+void ElevationManager::setNumberOfLoaderThreads(int numberOfThreads)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (numberOfThreads < 1)
+  {
+    numberOfThreads = 1;
+  }
+
+  mNumberOfLoaderThreads = numberOfThreads;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the amount of memory loaded datasets may take. Least recently used
+ * datasets are unloaded to make room for new ones. A single dataset bigger
+ * than the budget is still loaded. Defaults to 1 GB.
+ *
+ * @param bytes Memory budget in bytes
+ */
+void ElevationManager::setMemoryBudget(qint64 bytes)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+  mMemoryBudget = bytes;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the amount of memory loaded datasets may take.
+ *
+ * @return Memory budget in bytes
+ */
+qint64 ElevationManager::getMemoryBudget()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  return mMemoryBudget;
+}
 
-  int width = 0;
-  int height = 0;
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the amount of memory taken by loaded (and loading) datasets.
+ *
+ * @return Memory usage in bytes
+ */
+qint64 ElevationManager::getMemoryUsage()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  qint64 memoryUsage = 0;
 
-  for (height = 0; height < mDatabaseHeight; height++)
+  for (int i = 0; i < mDatasets.size(); i++)
   {
-    for (width = 0; width < mDatabaseWidth; width++)
+    if (mDatasets[i]->getIsLoaded() || mDatasets[i]->getIsLoading())
     {
-      GDALRasterIO(hBand, GF_Read, width, height, 1, 1, &mDatabase[(height * mDatabaseWidth) + width], 1, 1, GDT_Float32, 0, 0);
+      memoryUsage += mDatasets[i]->getMemorySize();
     }
   }
 
-  //close file
-  GDALClose(hDataset);
-#endif
+  return memoryUsage;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets whether datasets keep their samples as floats or quantized to 16 bits
+ * and packed in tiles (see ElevationTileStore). Compressed datasets take about
+ * a quarter of the memory but sampling them is slower, most of all for
+ * scattered positions. Applies to datasets loaded from now on, datasets that
+ * are loaded already stay as they are until reloaded. Defaults to false.
+ *
+ * @param value True to store samples compressed
+ */
+void ElevationManager::setCompressedStorage(bool value)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+  mUseCompressedStorage = value;
+
+  for (int i = 0; i < mDatasets.size(); i++)
+  {
+    mDatasets[i]->setCompressedStorage(value);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if datasets are stored compressed.
+ *
+ * @return True if samples are stored compressed
+ */
+bool ElevationManager::getCompressedStorage()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  return mUseCompressedStorage;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Returns the elevation of the given geodetic position in Km.
+ * Returns the elevation of the given geodetic position in Km, interpolated
+ * bilinearly. The finest loaded dataset that covers the position answers. If
+ * a finer dataset covers it but is not loaded yet, it is scheduled for
+ * loading.
  *
  * @param latitude Latitude in decimal degrees
  * @param longitude Longitude in decimal degrees
@@ -195,23 +576,503 @@ void ElevationManager::loadElevationDatabase(const QString& filePath)
 float ElevationManager::getElevation(double latitude, double longitude)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  //return 0 if no database loaded
-  if (!mDatabaseIsLoaded)
+  float elevation = 0.0f;
+  getElevations(&latitude, &longitude, &elevation, 1);
+
+  return elevation;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Batch version of getElevation. Consecutive positions answered by the same
+ * dataset are handed to it in a single call, so nearby positions (e.g. the
+ * vertices of a terrain tile) are sampled with the SIMD kernels in
+ * ElevationSampler. Positions no dataset covers are answered by the
+ * quantized-mesh terrain if one is open, they return 0 otherwise.
+ *
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ */
+void ElevationManager::getElevations(const double* latitudes, const double* longitudes,
+                                     float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ElevationDataset* datasetToLoad = NULL;
+  ElevationDataset* runDataset = NULL;
+  const QList<ElevationDataset*>* datasets = NULL;
+  int runStart = 0;
+  int cellKey = -1;
+  int lastCellKey = -1;
+
+  mLock.lockForRead();
+
+  for (int i = 0; i <= numberOfPoints; i++)
+  {
+    ElevationDataset* dataset = NULL;
+
+    if (i < numberOfPoints)
+    {
+      //look cell up only when we move to a different one
+      //positions without a key (not a number) are in no cell
+      cellKey = getCellKey(latitudes[i], longitudes[i]);
+      if (cellKey != lastCellKey)
+      {
+        QHash<int, QList<ElevationDataset*> >::const_iterator cell = mCells.constFind(cellKey);
+        datasets = (cell != mCells.constEnd()) ? &cell.value() : NULL;
+        lastCellKey = cellKey;
+      }
+
+      if (datasets != NULL)
+      {
+        dataset = resolveDataset(*datasets, latitudes[i], longitudes[i], &datasetToLoad);
+      }
+
+      if (dataset == runDataset)
+      {
+        continue;
+      }
+    }
+
+    //dataset changed, sample the run we have so far
+    if (runDataset != NULL)
+    {
+      runDataset->setLastUsed(mUseTick);
+      runDataset->getElevations(latitudes + runStart, longitudes + runStart, elevations + runStart, i - runStart);
+    }
+#ifndef NO_QUANTIZED_MESH
+    else if (mMeshManager->getIsOpen())
+    {
+      mMeshManager->getElevations(latitudes + runStart, longitudes + runStart, elevations + runStart, i - runStart);
+    }
+#endif
+    else
+    {
+      for (int j = runStart; j < i; j++)
+      {
+        elevations[j] = 0.0f;
+      }
+    }
+
+    runDataset = dataset;
+    runStart = i;
+  }
+
+  mLock.unlock();
+
+  if (datasetToLoad != NULL)
+  {
+    requestLoad(datasetToLoad);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns conservative elevation bounds for the given region, in O(log n)
+ * per dataset thanks to their min/max pyramids. Every loaded dataset that
+ * overlaps the region contributes, candidates come from the cells the region
+ * overlaps. Unless a single dataset covers the whole
+ * region, sea level (which is what getElevation returns outside of datasets)
+ * is included as well, unless decoded quantized-mesh tiles cover all of it. Tile
+ * culling, LOD selection and ray picking use this to get a height range
+ * without looking at samples.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param minimum Set to the minimum elevation in Km
+ * @param maximum Set to the maximum elevation in Km
+ * @return False if no loaded dataset overlaps the region (bounds are 0 then)
+ */
+bool ElevationManager::getElevationBounds(double south, double west, double north, double east,
+                                          float& minimum, float& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  bool isCovered = false;
+  bool foundDataset = false;
+  float datasetMinimum = 0.0f;
+  float datasetMaximum = 0.0f;
+
+  minimum = 0.0f;
+  maximum = 0.0f;
+
+  //coarser datasets count too, getElevation falls back to them while finer
+  //ones load. Regions spanning more cells than there are datasets (e.g. the
+  //whole globe) are cheaper to check against the list
+  QList<ElevationDataset*> datasets;
+  double numberOfCells = (floor(north) - floor(south) + 1.0) * (floor(east) - floor(west) + 1.0);
+  if (numberOfCells > mDatasets.size() || !qIsFinite(numberOfCells))
+  {
+    datasets = mDatasets;
+  }
+  else
+  {
+    findRegionDatasets(south, west, north, east, false, datasets);
+  }
+
+  for (int i = 0; i < datasets.size(); i++)
+  {
+    ElevationDataset* dataset = datasets[i];
+    if (!dataset->getIsLoaded() ||
+        !dataset->getElevationBounds(south, west, north, east, datasetMinimum, datasetMaximum))
+    {
+      continue;
+    }
+
+    if (!foundDataset)
+    {
+      minimum = datasetMinimum;
+      maximum = datasetMaximum;
+      foundDataset = true;
+    }
+    else
+    {
+      minimum = qMin(minimum, datasetMinimum);
+      maximum = qMax(maximum, datasetMaximum);
+    }
+
+    if (dataset->getSouth() <= south && dataset->getNorth() >= north &&
+        dataset->getWest() <= west && dataset->getEast() >= east)
+    {
+      isCovered = true;
+    }
+  }
+
+#ifndef NO_QUANTIZED_MESH
+  //terrain tiles answer where datasets do not
+  if (!isCovered && mMeshManager->getIsOpen() &&
+      mMeshManager->getElevationBounds(south, west, north, east, datasetMinimum, datasetMaximum))
+  {
+    minimum = foundDataset ? qMin(minimum, datasetMinimum) : datasetMinimum;
+    maximum = foundDataset ? qMax(maximum, datasetMaximum) : datasetMaximum;
+    foundDataset = true;
+    isCovered = mMeshManager->getIsCovered(south, west, north, east);
+  }
+#endif
+
+  //parts of the region might be at sea level, which positions neither
+  //datasets nor decoded tiles answer for get
+  if (!isCovered)
+  {
+    minimum = qMin(minimum, 0.0f);
+    maximum = qMax(maximum, 0.0f);
+  }
+
+  return foundDataset;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by a dataset when its last loader thread is done. Publishes the
+ * dataset while holding the lock for writing, so getElevation never sees a
+ * half loaded dataset. This method is thread-safe.
+ *
+ * @param dataset Dataset that finished loading
+ */
+void ElevationManager::reportDatasetLoaded(ElevationDataset* dataset)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+  dataset->finishLoading();
+  mLastLoadTime = dataset->getLastLoadTime();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Opens the given dataset and adds its footprint to the cell index, unless it
+ * is registered already.
+ *
+ * @param filePath The file path for the database
+ * @return The registered dataset, NULL if it could not be opened
+ */
+ElevationDataset* ElevationManager::registerDataset(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ElevationDataset* dataset = findDataset(filePath, false);
+  if (dataset != NULL)
+  {
+    return dataset;
+  }
+
+  //read header without holding the lock, it might take a while
+  dataset = new ElevationDataset(filePath);
+  if (!dataset->open())
+  {
+    delete dataset;
+    return NULL;
+  }
+
+  QWriteLocker locker(&mLock);
+
+  //somebody else might have registered it in the meantime
+  for (int i = 0; i < mDatasets.size(); i++)
+  {
+    if (mDatasets[i]->getFilePath() == filePath)
+    {
+      delete dataset;
+      return mDatasets[i];
+    }
+  }
+
+  dataset->setCompressedStorage(mUseCompressedStorage);
+  mDatasets.append(dataset);
+
+  //add dataset to every cell its footprint touches, keeping the finest
+  //resolution datasets at the front of every cell. Footprints are clipped to
+  //the globe, and the cells at 180 degrees east are the ones at 180 west
+  double resolution = fabs(dataset->getSampleSizeXDegrees() * dataset->getSampleSizeYDegrees());
+  double north = qMin(dataset->getNorth(), 90.0);
+  double east = qMin(dataset->getEast(), 180.0);
+  for (double latitude = qMax(floor(dataset->getSouth()), -90.0); latitude <= north; latitude += 1.0)
+  {
+    for (double longitude = qMax(floor(dataset->getWest()), -180.0); longitude <= east; longitude += 1.0)
+    {
+      QList<ElevationDataset*>& datasets = mCells[getCellKey(latitude, longitude)];
+      if (datasets.contains(dataset))
+      {
+        continue;
+      }
+
+      int index = 0;
+      while (index < datasets.size() &&
+             fabs(datasets[index]->getSampleSizeXDegrees() * datasets[index]->getSampleSizeYDegrees()) <= resolution)
+      {
+        index++;
+      }
+      datasets.insert(index, dataset);
+    }
+  }
+
+  return dataset;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the registered dataset for the given file path.
+ *
+ * @param filePath The file path for the database
+ * @param pin True to pin the dataset before the lock is released, the caller
+ *        must unpin it
+ * @return The registered dataset, NULL if not registered
+ */
+ElevationDataset* ElevationManager::findDataset(const QString& filePath, bool pin)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+
+  for (int i = 0; i < mDatasets.size(); i++)
   {
-    return 0.0f;
+    if (mDatasets[i]->getFilePath() == filePath)
+    {
+      if (pin)
+      {
+        mDatasets[i]->pin();
+      }
+      return mDatasets[i];
+    }
   }
 
-  //convert latitude and longitude into database indeces
-  int latitudeIndex = rint((latitude - mDatabaseOrigin.latitude) / mAreaSizeYDegrees);
-  int longitudeIndex = rint((longitude - mDatabaseOrigin.longitude) / mAreaSizeXDegrees);
+  return NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the finest loaded dataset of the given cell that covers the given
+ * position. Must be called with the lock held.
+ *
+ * @param datasets Datasets of the cell, sorted from finest to coarsest
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @param datasetToLoad Set to the finer dataset that should be loaded, if any
+ * @return The dataset to sample, NULL if none covers the position
+ */
+ElevationDataset* ElevationManager::resolveDataset(const QList<ElevationDataset*>& datasets,
+                                                   double latitude, double longitude,
+                                                   ElevationDataset** datasetToLoad)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < datasets.size(); i++)
+  {
+    ElevationDataset* dataset = datasets[i];
+    if (!dataset->contains(latitude, longitude))
+    {
+      continue;
+    }
+
+    if (dataset->getIsLoaded())
+    {
+      return dataset;
+    }
+
+    if (*datasetToLoad == NULL && !dataset->getIsLoading() && !dataset->getLoadFailed())
+    {
+      *datasetToLoad = dataset;
+    }
+  }
+
+  return NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Lists the datasets touching the given region by looking at the cells it
+ * overlaps. If only sampled datasets are asked for, these are the datasets
+ * getElevation would sample: in every cell, the datasets touching the region
+ * from finest to coarsest, down to the first one that covers the whole part
+ * of the region in the cell. Must be called with the lock held.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param isSampledOnly Whether to leave out datasets hidden by finer ones
+ * @param datasets Set to the datasets touching the region
+ */
+void ElevationManager::findRegionDatasets(double south, double west, double north, double east,
+                                          bool isSampledOnly, QList<ElevationDataset*>& datasets)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  datasets.clear();
+
+  //datasets are registered with footprints clipped to the globe
+  double lastLatitude = qMin(north, 90.0);
+  double lastLongitude = qMin(east, 180.0);
+  for (double latitude = qMax(floor(south), -90.0); latitude <= lastLatitude; latitude += 1.0)
+  {
+    for (double longitude = qMax(floor(west), -180.0); longitude <= lastLongitude; longitude += 1.0)
+    {
+      //part of the region that falls in this cell
+      double cellSouth = qMax(south, latitude);
+      double cellNorth = qMin(north, latitude + 1.0);
+      double cellWest = qMax(west, longitude);
+      double cellEast = qMin(east, longitude + 1.0);
+
+      //cell lists go from finest to coarsest, stop at the first dataset
+      //that covers the whole part, coarser ones would never be sampled
+      QList<ElevationDataset*> cellDatasets = mCells.value(getCellKey(latitude, longitude));
+      for (int i = 0; i < cellDatasets.size(); i++)
+      {
+        ElevationDataset* dataset = cellDatasets[i];
+        if (dataset->getSouth() > cellNorth || dataset->getNorth() < cellSouth ||
+            dataset->getWest() > cellEast || dataset->getEast() < cellWest)
+        {
+          continue;
+        }
+
+        if (!datasets.contains(dataset))
+        {
+          datasets.append(dataset);
+        }
+
+        if (isSampledOnly &&
+            dataset->getSouth() <= cellSouth && dataset->getNorth() >= cellNorth &&
+            dataset->getWest() <= cellWest && dataset->getEast() >= cellEast)
+        {
+          break;
+        }
+      }
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts loading the given dataset on behalf of getElevation, unloading least
+ * recently used datasets first if needed.
+ *
+ * @param dataset Dataset to load
+ */
+void ElevationManager::requestLoad(ElevationDataset* dataset)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+
+  //another thread might have requested it while we were not locked
+  if (dataset->getIsLoaded() || dataset->getIsLoading() || dataset->getLoadFailed())
+  {
+    return;
+  }
+
+  //every load starts a new tick, datasets used since then are the most recent
+  mUseTick++;
+
+  makeRoomFor(dataset);
+  dataset->setLastUsed(mUseTick);
+  dataset->startLoading(mNumberOfLoaderThreads);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unloads least recently used datasets until the given dataset fits in the
+ * memory budget. Pinned datasets are never unloaded. Must be called with the
+ * lock held for writing.
+ *
+ * @param dataset Dataset about to be loaded
+ */
+void ElevationManager::makeRoomFor(ElevationDataset* dataset)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  qint64 memoryUsage = 0;
+  for (int i = 0; i < mDatasets.size(); i++)
+  {
+    if (mDatasets[i] != dataset && (mDatasets[i]->getIsLoaded() || mDatasets[i]->getIsLoading()))
+    {
+      memoryUsage += mDatasets[i]->getMemorySize();
+    }
+  }
+
+  while (memoryUsage + dataset->getMemorySize() > mMemoryBudget)
+  {
+    //find least recently used dataset that is done loading
+    ElevationDataset* leastRecentlyUsed = NULL;
+    for (int i = 0; i < mDatasets.size(); i++)
+    {
+      if (mDatasets[i] != dataset && mDatasets[i]->getIsLoaded() && !mDatasets[i]->getIsPinned() &&
+          mDatasets[i]->getMemorySize() > 0 &&
+          (leastRecentlyUsed == NULL || mDatasets[i]->getLastUsed() < leastRecentlyUsed->getLastUsed()))
+      {
+        leastRecentlyUsed = mDatasets[i];
+      }
+    }
+
+    if (leastRecentlyUsed == NULL)
+    {
+      break;
+    }
+
+    memoryUsage -= leastRecentlyUsed->getMemorySize();
+    leastRecentlyUsed->unload();
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the key of the one degree cell that holds the given position.
+ * Longitudes are wrapped to [-180, 180) and latitudes clamped to [-90, 90],
+ * so every finite position maps to a cell of the globe.
+ *
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @return Cell key, -1 if the position is not finite
+ */
+int ElevationManager::getCellKey(double latitude, double longitude)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (!qIsFinite(latitude) || !qIsFinite(longitude))
+  {
+    return -1;
+  }
 
-  //return 0 if elevation not inside database
-  if (latitudeIndex < 0 || longitudeIndex < 0 ||
-      latitudeIndex >= mDatabaseHeight || longitudeIndex >= mDatabaseWidth)
+  //clamp and wrap as doubles, converting huge values to int is undefined
+  double latitudeCell = qBound(0.0, floor(latitude) + 90.0, 180.0);
+  double longitudeCell = fmod(floor(longitude) + 180.0, 360.0);
+  if (longitudeCell < 0.0)
   {
-    return 0.0f;
+    longitudeCell += 360.0;
   }
 
-  //return elevation in Km
-  return mDatabase[(latitudeIndex * mDatabaseWidth) + longitudeIndex]/1000.0f;
+  return ((int)latitudeCell * 360) + (int)longitudeCell;
 }
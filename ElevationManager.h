@@ -20,19 +20,41 @@
  *  <http://www.gnu.org/licenses/>.
  */
 
+
 #ifndef ELEVATION_MGR_H
 #define ELEVATION_MGR_H
 
 #include <QString>
+#include <QList>
+#include <QHash>
+#include <QReadWriteLock>
 #include "globals.h"
 
+class ElevationDataset;
+class QuantizedMeshManager;
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Singleton class that encapsulates the functionality to get an elevation
- * point. This class uses the GDAL library (see gdal.org) to load digital
- * terrain elevation data. The main methods are loadElevationDatabase and
- * getElevation. The latter takes a geodetic position and returns the
- * corresponding elevation in Km.
+ * value for a given geodetic position. Elevation databases (GeoTIFF, any other
+ * format GDAL can read, or ElevationCache files) are registered with addElevationDataset
+ * or addElevationDirectory and together form a mosaic. Then, use
+ * getElevation, which takes a geodetic position and returns the corresponding
+ * elevation in Km.
+ *
+ * Registering a dataset only reads its header. Dataset footprints are indexed
+ * in a grid of one degree cells, each cell listing the datasets that touch it
+ * from finest to coarsest resolution, so getElevation only looks at a handful
+ * of datasets no matter how many are registered, and overlaps are resolved in
+ * favor of the finest one. Samples are loaded the first time getElevation
+ * needs them (coarser datasets answer in the meantime), and the least recently
+ * used datasets are unloaded to stay within the memory budget. Every loaded
+ * dataset comes with a min/max pyramid, so getElevationBounds can bound any
+ * region without looking at samples. With setCompressedStorage, datasets are
+ * kept quantized and packed (see ElevationTileStore) so that about four times
+ * as many fit in the same budget, at the cost of slower sampling. Positions
+ * no dataset answers for fall back to the quantized-mesh terrain opened in
+ * QuantizedMeshManager, if any.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -44,20 +66,55 @@ class ElevationManager
     static ElevationManager* getInstance();
     ~ElevationManager();
 
-    void loadElevationDatabase(const QString& filePath);
+    bool addElevationDataset(const QString& filePath);
+    int addElevationDirectory(const QString& directoryPath);
+    void clearElevationDatasets();
+    int getNumberOfDatasets();
+    bool loadElevationDatabase(const QString& filePath);
+    bool startLoadingElevationDatabase(const QString& filePath);
+    bool loadRegion(double south, double west, double north, double east);
+    bool startLoadingRegion(double south, double west, double north, double east);
+    bool pinRegion(double south, double west, double north, double east, QList<ElevationDataset*>& datasets);
+    void unpinDatasets(const QList<ElevationDataset*>& datasets);
+    bool getIsLoading();
+    int getLoadProgress();
+    qint64 getLastLoadTime();
+    void setNumberOfLoaderThreads(int numberOfThreads);
+    void setMemoryBudget(qint64 bytes);
+    qint64 getMemoryBudget();
+    qint64 getMemoryUsage();
+    void setCompressedStorage(bool value);
+    bool getCompressedStorage();
     float getElevation(double latitude, double longitude);
+    void getElevations(const double* latitudes, const double* longitudes, float* elevations, int numberOfPoints);
+    bool getElevationBounds(double south, double west, double north, double east,
+                            float& minimum, float& maximum);
+
+    //called by datasets
+    void reportDatasetLoaded(ElevationDataset* dataset);
 
   private:
     ElevationManager();//private due to Singleton implementation
+    ElevationDataset* registerDataset(const QString& filePath);
+    ElevationDataset* findDataset(const QString& filePath, bool pin);
+    void findRegionDatasets(double south, double west, double north, double east,
+                            bool isSampledOnly, QList<ElevationDataset*>& datasets);
+    ElevationDataset* resolveDataset(const QList<ElevationDataset*>& datasets, double latitude, double longitude,
+                                     ElevationDataset** datasetToLoad);
+    void requestLoad(ElevationDataset* dataset);
+    void makeRoomFor(ElevationDataset* dataset);
+    static int getCellKey(double latitude, double longitude);
 
     static ElevationManager* mInstance;
-    float* mDatabase;
-    bool mDatabaseIsLoaded;
-    GeodeticPosition mDatabaseOrigin;
-    float mAreaSizeXDegrees;
-    float mAreaSizeYDegrees;
-    int mDatabaseWidth;
-    int mDatabaseHeight;
+    QList<ElevationDataset*> mDatasets;
+    QHash<int, QList<ElevationDataset*> > mCells;
+    QReadWriteLock mLock;
+    int mUseTick;
+    int mNumberOfLoaderThreads;
+    qint64 mMemoryBudget;
+    bool mUseCompressedStorage;
+    qint64 mLastLoadTime;
+    QuantizedMeshManager* mMeshManager;
 };
 
 #endif//ELEVATION_MGR_H
@@ -0,0 +1,241 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ElevationSampler.h"
+#include "math.h"
+
+//AVX2 kernel is only built with compilers that let us target AVX2 on a per
+//function basis, so the rest of the application still runs on any x86 CPU
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ELEVATION_SAMPLER_AVX2
+#include <immintrin.h>
+#endif
+
+bool ElevationSampler::mUseAvx2 = true;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Samples the given grid at the given positions with bilinear interpolation,
+ * using the AVX2 kernel if available and enabled. Positions outside the grid
+ * are clamped to its edges, NaN positions sample the first row or column.
+ *
+ * @param grid Grid to sample, must be at least 2x2
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ */
+void ElevationSampler::sampleBilinear(const Grid& grid, const double* latitudes, const double* longitudes,
+                                      float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mUseAvx2 && getHasAvx2() &&
+      sampleBilinearAvx2(grid, latitudes, longitudes, elevations, numberOfPoints))
+  {
+    return;
+  }
+
+  sampleBilinearScalar(grid, latitudes, longitudes, elevations, numberOfPoints);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Scalar bilinear kernel, see sampleBilinear.
+ *
+ * @param grid Grid to sample, must be at least 2x2
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ */
+void ElevationSampler::sampleBilinearScalar(const Grid& grid, const double* latitudes, const double* longitudes,
+                                            float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double maxRow = grid.height - 1;
+  double maxColumn = grid.width - 1;
+
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    //convert latitude and longitude into fractional database indeces
+    double row = (latitudes[i] - grid.originLatitude) * grid.inverseSampleSizeYDegrees;
+    double column = (longitudes[i] - grid.originLongitude) * grid.inverseSampleSizeXDegrees;
+
+    //clamp before converting to int, NaN fails every comparison and ends up
+    //at 0, as it does in the AVX2 kernel
+    row = (row > 0.0) ? ((row < maxRow) ? row : maxRow) : 0.0;
+    column = (column > 0.0) ? ((column < maxColumn) ? column : maxColumn) : 0.0;
+
+    //keep top left corner one sample away from the bottom and right edges
+    int row0 = (int)row;
+    int column0 = (int)column;
+    if (row0 > grid.height - 2) row0 = grid.height - 2;
+    if (column0 > grid.width - 2) column0 = grid.width - 2;
+
+    float fractionY = (float)(row - row0);
+    float fractionX = (float)(column - column0);
+    const float* topLeft = grid.samples + ((size_t)row0 * grid.width) + column0;
+
+    float top = topLeft[0] + (topLeft[1] - topLeft[0]) * fractionX;
+    float bottom = topLeft[grid.width] + (topLeft[grid.width + 1] - topLeft[grid.width]) * fractionX;
+
+    //return elevation in Km
+    elevations[i] = (top + (bottom - top) * fractionY) * 0.001f;
+  }
+}
+
+#ifdef ELEVATION_SAMPLER_AVX2
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * AVX2 bilinear kernel, see sampleBilinear. Gathers use 32 bit indeces, so
+ * grids bigger than 2^31 samples are left to the scalar kernel.
+ *
+ * @param grid Grid to sample, must be at least 2x2
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ * @return False if the grid is too big for this kernel
+ */
+__attribute__((target("avx2")))
+bool ElevationSampler::sampleBilinearAvx2(const Grid& grid, const double* latitudes, const double* longitudes,
+                                          float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if ((double)grid.width * (double)grid.height >= 2147483647.0)
+  {
+    return false;
+  }
+
+  const __m256d originLatitude = _mm256_set1_pd(grid.originLatitude);
+  const __m256d originLongitude = _mm256_set1_pd(grid.originLongitude);
+  const __m256d inverseSizeY = _mm256_set1_pd(grid.inverseSampleSizeYDegrees);
+  const __m256d inverseSizeX = _mm256_set1_pd(grid.inverseSampleSizeXDegrees);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d maxRow = _mm256_set1_pd(grid.height - 1);
+  const __m256d maxColumn = _mm256_set1_pd(grid.width - 1);
+  const __m256d maxRow0 = _mm256_set1_pd(grid.height - 2);
+  const __m256d maxColumn0 = _mm256_set1_pd(grid.width - 2);
+  const __m128i width = _mm_set1_epi32(grid.width);
+  const __m128 metersToKm = _mm_set1_ps(0.001f);
+  const float* samples = grid.samples;
+  const float* nextRowSamples = grid.samples + grid.width;
+
+  int i = 0;
+  for (; i + 4 <= numberOfPoints; i += 4)
+  {
+    //convert latitude and longitude into fractional database indeces
+    __m256d row = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(latitudes + i), originLatitude), inverseSizeY);
+    __m256d column = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(longitudes + i), originLongitude), inverseSizeX);
+    row = _mm256_min_pd(_mm256_max_pd(row, zero), maxRow);
+    column = _mm256_min_pd(_mm256_max_pd(column, zero), maxColumn);
+
+    //keep top left corner one sample away from the bottom and right edges
+    __m256d row0 = _mm256_min_pd(_mm256_floor_pd(row), maxRow0);
+    __m256d column0 = _mm256_min_pd(_mm256_floor_pd(column), maxColumn0);
+    __m128 fractionY = _mm256_cvtpd_ps(_mm256_sub_pd(row, row0));
+    __m128 fractionX = _mm256_cvtpd_ps(_mm256_sub_pd(column, column0));
+
+    //gather the 4 corners of every cell
+    __m128i index = _mm_add_epi32(_mm_mullo_epi32(_mm256_cvttpd_epi32(row0), width), _mm256_cvttpd_epi32(column0));
+    __m128 topLeft = _mm_i32gather_ps(samples, index, 4);
+    __m128 topRight = _mm_i32gather_ps(samples + 1, index, 4);
+    __m128 bottomLeft = _mm_i32gather_ps(nextRowSamples, index, 4);
+    __m128 bottomRight = _mm_i32gather_ps(nextRowSamples + 1, index, 4);
+
+    __m128 top = _mm_add_ps(topLeft, _mm_mul_ps(_mm_sub_ps(topRight, topLeft), fractionX));
+    __m128 bottom = _mm_add_ps(bottomLeft, _mm_mul_ps(_mm_sub_ps(bottomRight, bottomLeft), fractionX));
+    __m128 elevation = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fractionY));
+
+    //return elevation in Km
+    _mm_storeu_ps(elevations + i, _mm_mul_ps(elevation, metersToKm));
+  }
+
+  //clear the upper halves of the AVX registers, otherwise every SSE
+  //instruction that follows (e.g. in the math library) pays a transition
+  //penalty until something else clears them
+  _mm256_zeroupper();
+
+  //left over points
+  sampleBilinearScalar(grid, latitudes + i, longitudes + i, elevations + i, numberOfPoints - i);
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the CPU we are running on supports AVX2.
+ *
+ * @return True if AVX2 is supported
+ */
+bool ElevationSampler::getHasAvx2()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  static int hasAvx2 = -1;
+
+  if (hasAvx2 == -1)
+  {
+    __builtin_cpu_init();
+    hasAvx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+
+  return (hasAvx2 == 1);
+}
+#else
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * AVX2 kernel is not available with this compiler or CPU architecture.
+ *
+ * @return Always false
+ */
+bool ElevationSampler::sampleBilinearAvx2(const Grid&, const double*, const double*, float*, int)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * AVX2 kernel is not available with this compiler or CPU architecture.
+ *
+ * @return Always false
+ */
+bool ElevationSampler::getHasAvx2()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return false;
+}
+#endif//ELEVATION_SAMPLER_AVX2
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Enables or disables the AVX2 kernel, mostly useful for benchmarking. The
+ * AVX2 kernel is only used when the CPU supports it, regardless.
+ *
+ * @param value True to use the AVX2 kernel when available
+ */
+void ElevationSampler::setUseAvx2(bool value)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mUseAvx2 = value;
+}
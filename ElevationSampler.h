@@ -0,0 +1,71 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELEVATION_SAMPLER_H
+#define ELEVATION_SAMPLER_H
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This class encapsulates the bilinear interpolation kernels used by
+ * ElevationDataset to sample a grid of elevations in batch. There is a scalar
+ * kernel that works everywhere and an AVX2 kernel (4 points per iteration,
+ * using gathers for the 4 corner samples) that is picked at runtime on CPUs
+ * that support it. All functions are static, so there is no need to
+ * instantiate the class in order to use its functions.
+ *
+ * A grid is described by its samples (in meters, row by row), its size and the
+ * geodetic position of its first sample. Sample sizes are passed in as their
+ * inverse so that kernels never divide.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ElevationSampler
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    struct Grid
+    {
+      const float* samples;
+      int width;
+      int height;
+      double originLatitude;
+      double originLongitude;
+      double inverseSampleSizeXDegrees;
+      double inverseSampleSizeYDegrees;
+    };
+
+    static void sampleBilinear(const Grid& grid, const double* latitudes, const double* longitudes,
+                               float* elevations, int numberOfPoints);
+    static void sampleBilinearScalar(const Grid& grid, const double* latitudes, const double* longitudes,
+                                     float* elevations, int numberOfPoints);
+    static bool sampleBilinearAvx2(const Grid& grid, const double* latitudes, const double* longitudes,
+                                   float* elevations, int numberOfPoints);
+    static bool getHasAvx2();
+    static void setUseAvx2(bool value);
+
+  private:
+    static bool mUseAvx2;
+};
+
+#endif//ELEVATION_SAMPLER_H
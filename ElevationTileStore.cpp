@@ -0,0 +1,688 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <QtEndian>
+#include "ElevationTileStore.h"
+#include "math.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes, call allocate before compressing rows.
+ */
+ElevationTileStore::ElevationTileStore()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mWidth = 0;
+  mHeight = 0;
+  mTilesX = 0;
+  mTilesY = 0;
+  mTick = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+ElevationTileStore::~ElevationTileStore()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  clear();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets up the tiles for a grid of the given size, to be filled with
+ * compressRows.
+ *
+ * @param width Grid width in samples
+ * @param height Grid height in samples
+ */
+void ElevationTileStore::allocate(int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  clear();
+
+  QWriteLocker locker(&mLock);
+  mWidth = width;
+  mHeight = height;
+  mTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  mTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+  Tile tile;
+  tile.offset = 0.0f;
+  tile.step = (float)QUANTIZATION_STEP;
+  mTiles.fill(tile, mTilesX * mTilesY);
+  mHotTileIndices.fill(-1, mTilesX * mTilesY);
+  mTick = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Releases all tiles, packed and hot.
+ */
+void ElevationTileStore::clear()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+
+  for (int i = 0; i < mHotTiles.size(); i++)
+  {
+    delete [] mHotTiles[i].samples;
+  }
+  mHotTiles.clear();
+  mHotTileIndices.clear();
+  mTiles.clear();
+  mWidth = 0;
+  mHeight = 0;
+  mTilesX = 0;
+  mTilesY = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if allocate was called since the last clear.
+ *
+ * @return True if the store holds a grid
+ */
+bool ElevationTileStore::getIsAllocated()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return !mTiles.isEmpty();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Quantizes and packs a band of rows. The band must start on a tile row and
+ * hold whole tile rows (except at the bottom of the grid), so that loader
+ * threads working on different bands never share a tile. The samples are
+ * overwritten with their quantized values, so that whatever is computed from
+ * them afterwards (e.g. the min/max pyramid) matches what sampling returns.
+ *
+ * @param samples Samples of the band in meters, row by row
+ * @param firstRow First row of the band, a multiple of TILE_SIZE
+ * @param numberOfRows Number of rows in the band
+ */
+void ElevationTileStore::compressRows(float* samples, int firstRow, int numberOfRows)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  quint16 quantized[TILE_SIZE * TILE_SIZE];
+  int lastRow = qMin(firstRow + numberOfRows, mHeight);
+
+  for (int tileRow = firstRow / TILE_SIZE; tileRow * TILE_SIZE < lastRow; tileRow++)
+  {
+    int rowStart = tileRow * TILE_SIZE;
+    int rowEnd = qMin(rowStart + TILE_SIZE, lastRow);
+
+    for (int tileColumn = 0; tileColumn < mTilesX; tileColumn++)
+    {
+      int columnStart = tileColumn * TILE_SIZE;
+      int columnEnd = qMin(columnStart + TILE_SIZE, mWidth);
+      Tile& tile = mTiles[(tileRow * mTilesX) + tileColumn];
+
+      float minimum = samples[((size_t)(rowStart - firstRow) * mWidth) + columnStart];
+      float maximum = minimum;
+      for (int row = rowStart; row < rowEnd; row++)
+      {
+        const float* sample = samples + ((size_t)(row - firstRow) * mWidth);
+        for (int column = columnStart; column < columnEnd; column++)
+        {
+          minimum = qMin(minimum, sample[column]);
+          maximum = qMax(maximum, sample[column]);
+        }
+      }
+
+      //a fixed step keeps whole meter sources exact, only tiles with more
+      //relief than 16 bits of steps can hold get a coarser one
+      tile.offset = minimum;
+      tile.step = (float)QUANTIZATION_STEP;
+      if ((maximum - minimum) > 65535.0 * QUANTIZATION_STEP)
+      {
+        tile.step = (maximum - minimum) / 65535.0f;
+      }
+
+      //tiles on the right and bottom edges are padded by repeating the last
+      //column and row
+      double inverseStep = 1.0 / tile.step;
+      for (int row = 0; row < TILE_SIZE; row++)
+      {
+        int sourceRow = qMin(rowStart + row, rowEnd - 1) - firstRow;
+        float* sample = samples + ((size_t)sourceRow * mWidth);
+        quint16* value = quantized + (row * TILE_SIZE);
+
+        for (int column = 0; column < TILE_SIZE; column++)
+        {
+          int sourceColumn = qMin(columnStart + column, columnEnd - 1);
+          value[column] = (quint16)qBound(0, (int)floor((sample[sourceColumn] - tile.offset) * inverseStep + 0.5), 65535);
+        }
+
+        if (rowStart + row < rowEnd)
+        {
+          for (int column = columnStart; column < columnEnd; column++)
+          {
+            sample[column] = tile.offset + (float)value[column - columnStart] * tile.step;
+          }
+        }
+      }
+
+      encodeTile(quantized, tile.packed);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unpacks a band of rows back into floats, e.g. to write an ElevationCache
+ * file. Tiles are decoded straight into the band, the hot cache is left
+ * alone.
+ *
+ * @param samples Output samples of the band in meters, row by row
+ * @param firstRow First row of the band
+ * @param numberOfRows Number of rows in the band
+ */
+void ElevationTileStore::decompressRows(float* samples, int firstRow, int numberOfRows)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  quint16 decoded[TILE_SIZE * TILE_SIZE];
+  int lastRow = qMin(firstRow + numberOfRows, mHeight);
+
+  for (int tileRow = firstRow / TILE_SIZE; tileRow * TILE_SIZE < lastRow; tileRow++)
+  {
+    int rowStart = qMax(tileRow * TILE_SIZE, firstRow);
+    int rowEnd = qMin((tileRow + 1) * TILE_SIZE, lastRow);
+
+    for (int tileColumn = 0; tileColumn < mTilesX; tileColumn++)
+    {
+      int columnStart = tileColumn * TILE_SIZE;
+      int columnEnd = qMin(columnStart + TILE_SIZE, mWidth);
+      const Tile& tile = mTiles[(tileRow * mTilesX) + tileColumn];
+      decodeTile(tile, decoded);
+
+      for (int row = rowStart; row < rowEnd; row++)
+      {
+        const quint16* value = decoded + ((row - (tileRow * TILE_SIZE)) * TILE_SIZE);
+        float* sample = samples + ((size_t)(row - firstRow) * mWidth);
+        for (int column = columnStart; column < columnEnd; column++)
+        {
+          sample[column] = tile.offset + (float)value[column - columnStart] * tile.step;
+        }
+      }
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns a single sample, decoding its tile if it is not hot. This method is
+ * thread-safe.
+ *
+ * @param row Sample row
+ * @param column Sample column
+ * @return Sample in meters
+ */
+float ElevationTileStore::getSample(int row, int column)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLock.lockForRead();
+  float sample = getSampleLocked(row, column);
+  mLock.unlock();
+
+  return sample;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Batch bilinear sampling, same math as the scalar kernel in ElevationSampler.
+ * The 4 samples around a position almost always fall in the same tile. Hot
+ * tiles are read directly, cold ones by decoding the two rows involved up to
+ * the position, and a tile is made hot once HOT_TILE_RUN consecutive
+ * positions fall in it. This method is thread-safe.
+ *
+ * @param grid Grid geometry (samples are not used, they live in the store)
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ */
+void ElevationTileStore::sampleBilinear(const ElevationSampler::Grid& grid, const double* latitudes,
+                                        const double* longitudes, float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double maxRow = mHeight - 1;
+  double maxColumn = mWidth - 1;
+  quint16 topRow[TILE_SIZE];
+  quint16 bottomRow[TILE_SIZE];
+  int coldTile = -1;
+  int coldRun = 0;
+  int hotTile = -1;
+  const quint16* hotSamples = NULL;
+
+  mLock.lockForRead();
+
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    double row = (latitudes[i] - grid.originLatitude) * grid.inverseSampleSizeYDegrees;
+    double column = (longitudes[i] - grid.originLongitude) * grid.inverseSampleSizeXDegrees;
+    row = (row < 0.0) ? 0.0 : ((row > maxRow) ? maxRow : row);
+    column = (column < 0.0) ? 0.0 : ((column > maxColumn) ? maxColumn : column);
+
+    int row0 = qMin((int)row, mHeight - 2);
+    int column0 = qMin((int)column, mWidth - 2);
+    float fractionY = (float)(row - row0);
+    float fractionX = (float)(column - column0);
+
+    int tileRow = row0 / TILE_SIZE;
+    int tileColumn = column0 / TILE_SIZE;
+    int tileRowOffset = row0 - (tileRow * TILE_SIZE);
+    int tileColumnOffset = column0 - (tileColumn * TILE_SIZE);
+    float topLeft, topRight, bottomLeft, bottomRight;
+
+    if (tileRowOffset < TILE_SIZE - 1 && tileColumnOffset < TILE_SIZE - 1)
+    {
+      int tileIndex = (tileRow * mTilesX) + tileColumn;
+      const Tile& tile = mTiles[tileIndex];
+      const quint16* top = NULL;
+      const quint16* bottom = NULL;
+
+      if (tileIndex != hotTile && mHotTileIndices[tileIndex] < 0)
+      {
+        coldRun = (tileIndex == coldTile) ? coldRun + 1 : 1;
+        coldTile = tileIndex;
+      }
+
+      if (tileIndex == hotTile || mHotTileIndices[tileIndex] >= 0 || coldRun >= HOT_TILE_RUN)
+      {
+        //samples of the last hot tile stay put for as long as we hold the lock
+        if (tileIndex != hotTile)
+        {
+          hotSamples = getHotTile(tileIndex);
+          hotTile = tileIndex;
+        }
+        top = hotSamples + (tileRowOffset * TILE_SIZE) + tileColumnOffset;
+        bottom = top + TILE_SIZE;
+      }
+      else
+      {
+        const uchar* packedRow = findRow(tile, tileRowOffset);
+        decodeRow(packedRow, topRow, tileColumnOffset + 2);
+        decodeRow((packedRow != NULL) ? packedRow + getRowSize(packedRow[0]) : NULL, bottomRow,
+                  tileColumnOffset + 2);
+        top = topRow + tileColumnOffset;
+        bottom = bottomRow + tileColumnOffset;
+      }
+
+      topLeft = tile.offset + (float)top[0] * tile.step;
+      topRight = tile.offset + (float)top[1] * tile.step;
+      bottomLeft = tile.offset + (float)bottom[0] * tile.step;
+      bottomRight = tile.offset + (float)bottom[1] * tile.step;
+    }
+    else
+    {
+      topLeft = getSampleLocked(row0, column0);
+      topRight = getSampleLocked(row0, column0 + 1);
+      bottomLeft = getSampleLocked(row0 + 1, column0);
+      bottomRight = getSampleLocked(row0 + 1, column0 + 1);
+    }
+
+    float top = topLeft + (topRight - topLeft) * fractionX;
+    float bottom = bottomLeft + (bottomRight - bottomLeft) * fractionX;
+
+    //return elevation in Km
+    elevations[i] = (top + (bottom - top) * fractionY) * 0.001f;
+  }
+
+  mLock.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the memory taken by the packed tiles and the hot cache.
+ *
+ * @return Memory size in bytes
+ */
+qint64 ElevationTileStore::getMemorySize()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  qint64 memorySize = (qint64)mTiles.size() * (qint64)(sizeof(Tile) + sizeof(int));
+
+  for (int i = 0; i < mTiles.size(); i++)
+  {
+    memorySize += mTiles[i].packed.capacity();
+  }
+
+  memorySize += (qint64)mHotTiles.size() * (qint64)(sizeof(HotTile) + TILE_SIZE * TILE_SIZE * sizeof(quint16));
+
+  return memorySize;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of tiles in the hot cache.
+ *
+ * @return Number of decoded tiles
+ */
+int ElevationTileStore::getNumberOfHotTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  return mHotTiles.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns an upper bound for the memory a grid of the given size takes once
+ * compressed, used to budget datasets before they are loaded. Packed samples
+ * never take more than 16 bits each.
+ *
+ * @param width Grid width in samples
+ * @param height Grid height in samples
+ * @return Memory size in bytes
+ */
+qint64 ElevationTileStore::estimateMemorySize(int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  qint64 tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  qint64 tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+  qint64 numberOfHotTiles = qMin(tilesX * tilesY, (qint64)MAXIMUM_HOT_TILES);
+
+  return (tilesX * tilesY * (qint64)(sizeof(Tile) + sizeof(int) + (2 + getRowSize(16)) * TILE_SIZE + 8)) +
+         (numberOfHotTiles * (qint64)(sizeof(HotTile) + TILE_SIZE * TILE_SIZE * sizeof(quint16)));
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the decoded samples of the given tile, decoding it into the hot
+ * cache first if needed. Must be called with the lock held for reading. On a
+ * miss the lock is given up and taken for writing while decoding, so the
+ * returned samples are only good until the next call.
+ *
+ * @param tile Tile index
+ * @return Quantized samples of the tile, row by row
+ */
+const quint16* ElevationTileStore::getHotTile(int tile)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int index = mHotTileIndices[tile];
+
+  while (index < 0)
+  {
+    mLock.unlock();
+    mLock.lockForWrite();
+
+    //another thread might have decoded it while we were not locked
+    if (mHotTileIndices[tile] < 0)
+    {
+      mTick++;
+
+      if (mHotTiles.size() < MAXIMUM_HOT_TILES)
+      {
+        HotTile hotTile;
+        hotTile.tile = -1;
+        hotTile.lastUsed.fetchAndStoreOrdered(0);
+        hotTile.samples = new quint16[TILE_SIZE * TILE_SIZE];
+        mHotTiles.append(hotTile);
+        index = mHotTiles.size() - 1;
+      }
+      else
+      {
+        //recycle least recently used hot tile
+        index = 0;
+        int leastRecentTick = mHotTiles[0].lastUsed.fetchAndAddOrdered(0);//atomic read
+        for (int i = 1; i < mHotTiles.size(); i++)
+        {
+          int lastUsed = mHotTiles[i].lastUsed.fetchAndAddOrdered(0);//atomic read
+          if (lastUsed < leastRecentTick)
+          {
+            index = i;
+            leastRecentTick = lastUsed;
+          }
+        }
+        mHotTileIndices[mHotTiles[index].tile] = -1;
+      }
+
+      decodeTile(mTiles[tile], mHotTiles[index].samples);
+      mHotTiles[index].tile = tile;
+      mHotTiles[index].lastUsed.fetchAndStoreOrdered(mTick);
+      mHotTileIndices[tile] = index;
+    }
+
+    //tile might get recycled again before we get the lock back, so check
+    mLock.unlock();
+    mLock.lockForRead();
+    index = mHotTileIndices[tile];
+  }
+
+  //several readers may get here at once, hence the atomic store
+  mHotTiles[index].lastUsed.fetchAndStoreOrdered(mTick);
+
+  return mHotTiles[index].samples;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns a single sample, from the hot copy of its tile if there is one or
+ * by decoding its row otherwise. Must be called with the lock held for
+ * reading.
+ *
+ * @param row Sample row
+ * @param column Sample column
+ * @return Sample in meters
+ */
+float ElevationTileStore::getSampleLocked(int row, int column)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int tileRow = row / TILE_SIZE;
+  int tileColumn = column / TILE_SIZE;
+  int tileIndex = (tileRow * mTilesX) + tileColumn;
+  int tileRowOffset = row - (tileRow * TILE_SIZE);
+  int tileColumnOffset = column - (tileColumn * TILE_SIZE);
+  const Tile& tile = mTiles[tileIndex];
+  quint16 sample;
+
+  int index = mHotTileIndices[tileIndex];
+  if (index >= 0)
+  {
+    mHotTiles[index].lastUsed.fetchAndStoreOrdered(mTick);
+    sample = mHotTiles[index].samples[(tileRowOffset * TILE_SIZE) + tileColumnOffset];
+  }
+  else
+  {
+    quint16 samples[TILE_SIZE];
+    decodeRow(findRow(tile, tileRowOffset), samples, tileColumnOffset + 1);
+    sample = samples[tileColumnOffset];
+  }
+
+  return tile.offset + (float)sample * tile.step;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the start of the given row in a packed tile, looked up in the row
+ * offsets at the start of the tile.
+ *
+ * @param tile Packed tile
+ * @param row Row in the tile
+ * @return Packed row, NULL if the tile was never packed
+ */
+const uchar* ElevationTileStore::findRow(const Tile& tile, int row)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (tile.packed.isEmpty())
+  {
+    return NULL;
+  }
+
+  const uchar* packed = (const uchar*)tile.packed.constData();
+  const uchar* packedRow = packed + (packed[2 * row] | (packed[(2 * row) + 1] << 8));
+
+  return packedRow;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unpacks a tile written by encodeTile.
+ *
+ * @param tile Tile to decode
+ * @param samples Output quantized samples, TILE_SIZE x TILE_SIZE
+ */
+void ElevationTileStore::decodeTile(const Tile& tile, quint16* samples)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const uchar* packedRow = findRow(tile, 0);
+
+  for (int row = 0; row < TILE_SIZE; row++)
+  {
+    decodeRow(packedRow, samples + (row * TILE_SIZE), TILE_SIZE);
+    if (packedRow != NULL)
+    {
+      packedRow += getRowSize(packedRow[0]);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unpacks the first samples of a packed row. Residuals are read 8 bytes at a
+ * time, encodeTile pads every tile so this never reads past its end. Rows of
+ * tiles that were never packed (their rows failed to load) decode to 0.
+ *
+ * @param packedRow Packed row, see encodeTile
+ * @param samples Output quantized samples
+ * @param numberOfSamples Number of samples to decode, from the start of the row
+ */
+void ElevationTileStore::decodeRow(const uchar* packedRow, quint16* samples, int numberOfSamples)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (packedRow == NULL)
+  {
+    memset(samples, 0, numberOfSamples * sizeof(quint16));
+    return;
+  }
+
+  int bits = packedRow[0];
+  quint64 mask = (1u << bits) - 1u;
+  quint16 sample = (quint16)(packedRow[1] | (packedRow[2] << 8));
+  const uchar* residuals = packedRow + 3;
+  samples[0] = sample;
+
+  for (int column = 1; column < numberOfSamples; column++)
+  {
+    int bitOffset = (column - 1) * bits;
+    quint64 buffer;
+    memcpy(&buffer, residuals + (bitOffset >> 3), sizeof(buffer));
+    buffer = qFromLittleEndian(buffer);
+    quint32 zigzag = (quint32)((buffer >> (bitOffset & 7)) & mask);
+
+    //residuals wrap around 16 bits, like the deltas they came from
+    sample = (quint16)(sample + (quint16)((zigzag >> 1) ^ (0u - (zigzag & 1u))));
+    samples[column] = sample;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Packs a tile of quantized samples, every row on its own so that it can be
+ * decoded without the rows above it. The tile starts with the offset of every
+ * row (16 bits, little endian). A row holds one byte with the width of its
+ * residuals, its first sample (16 bits, little endian), then the difference
+ * between every other sample and its left neighbor, zigzag coded so that
+ * small negative ones stay small too and bit packed with the width of the
+ * largest one. The tile is padded with 8 bytes for decodeRow.
+ *
+ * @param samples Quantized samples, TILE_SIZE x TILE_SIZE
+ * @param packed Output packed tile
+ */
+void ElevationTileStore::encodeTile(const quint16* samples, QByteArray& packed)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QByteArray buffer(2 * TILE_SIZE, 0);
+  buffer.reserve((2 * TILE_SIZE) + (TILE_SIZE * getRowSize(16)) + 8);
+  quint16 residuals[TILE_SIZE];
+
+  for (int row = 0; row < TILE_SIZE; row++)
+  {
+    const quint16* sample = samples + (row * TILE_SIZE);
+    quint32 largest = 0;
+
+    //row offsets go first, so that any row can be found right away
+    buffer[2 * row] = (char)(buffer.size() & 0xFF);
+    buffer[(2 * row) + 1] = (char)(buffer.size() >> 8);
+
+    for (int column = 1; column < TILE_SIZE; column++)
+    {
+      qint16 residual = (qint16)(quint16)(sample[column] - sample[column - 1]);
+      residuals[column] = (quint16)((residual << 1) ^ (residual >> 15));
+      largest |= residuals[column];
+    }
+
+    int bits = 0;
+    while (largest >> bits)
+    {
+      bits++;
+    }
+    buffer.append((char)bits);
+    buffer.append((char)(sample[0] & 0xFF));
+    buffer.append((char)(sample[0] >> 8));
+
+    quint64 bitBuffer = 0;
+    int bitBufferBits = 0;
+    for (int column = 1; column < TILE_SIZE; column++)
+    {
+      bitBuffer |= (quint64)residuals[column] << bitBufferBits;
+      bitBufferBits += bits;
+      while (bitBufferBits >= 8)
+      {
+        buffer.append((char)(bitBuffer & 0xFF));
+        bitBuffer >>= 8;
+        bitBufferBits -= 8;
+      }
+    }
+    if (bitBufferBits > 0)
+    {
+      buffer.append((char)(bitBuffer & 0xFF));
+    }
+  }
+
+  for (int i = 0; i < 8; i++)
+  {
+    buffer.append((char)0);
+  }
+
+  //keep only what we need, tiles are kept around for as long as the dataset
+  packed = QByteArray(buffer.constData(), buffer.size());
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of a packed row whose residuals take the given width.
+ *
+ * @param bits Width of the residuals in bits
+ * @return Row size in bytes
+ */
+int ElevationTileStore::getRowSize(int bits)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return 3 + ((((TILE_SIZE - 1) * bits) + 7) / 8);
+}
@@ -0,0 +1,119 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ELEVATION_TILE_STORE_H
+#define ELEVATION_TILE_STORE_H
+
+#include <QVector>
+#include <QByteArray>
+#include <QReadWriteLock>
+#include <QAtomicInt>
+#include "ElevationSampler.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Compressed in-memory storage for the samples of an elevation database, used
+ * by ElevationDataset instead of a plain float grid when ElevationManager is
+ * set to compressed storage. The grid is cut into square tiles, samples are
+ * quantized to 16 bits per tile (an offset plus QUANTIZATION_STEP increments,
+ * or a coarser step for tiles with more relief than 16 bits can hold) and
+ * every row of a tile is delta coded and bit packed on its own. Sources stored
+ * in whole meters (SRTM, DTED) come back exactly, and smooth terrain packs to
+ * a few bits per sample.
+ *
+ * Scattered samples (e.g. the vertices of a far away terrain tile) are read
+ * from the packed tiles by decoding the start of a couple of rows. Once a
+ * batch keeps sampling the same tile, the tile is decoded whole into a small
+ * cache of hot tiles (least recently used ones get recycled) and read from
+ * there. Sampling is thread-safe: the hot cache is guarded by a read/write
+ * lock and only decoding a tile takes it for writing.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ElevationTileStore
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int TILE_SIZE = 64;
+    static const int MAXIMUM_HOT_TILES = 512;
+    static const int HOT_TILE_RUN = 4;
+    static const double QUANTIZATION_STEP = 0.125;//in meters
+
+    ElevationTileStore();
+    ~ElevationTileStore();
+
+    void allocate(int width, int height);
+    void clear();
+    bool getIsAllocated();
+    void compressRows(float* samples, int firstRow, int numberOfRows);
+    void decompressRows(float* samples, int firstRow, int numberOfRows);
+    float getSample(int row, int column);
+    void sampleBilinear(const ElevationSampler::Grid& grid, const double* latitudes, const double* longitudes,
+                        float* elevations, int numberOfPoints);
+    qint64 getMemorySize();
+    int getNumberOfHotTiles();
+
+    static qint64 estimateMemorySize(int width, int height);
+
+  private:
+    /**
+     * Quantization parameters and packed samples of a tile.
+     */
+    struct Tile
+    {
+      float offset;
+      float step;
+      QByteArray packed;
+    };
+
+    /**
+     * Hot cache entry, samples holds a decoded tile.
+     */
+    struct HotTile
+    {
+      int tile;
+      QAtomicInt lastUsed;//tick of last use, set by readers holding the read lock
+      quint16* samples;
+    };
+
+    const quint16* getHotTile(int tile);
+    float getSampleLocked(int row, int column);
+    const uchar* findRow(const Tile& tile, int row);
+    void decodeTile(const Tile& tile, quint16* samples);
+    static void decodeRow(const uchar* packedRow, quint16* samples, int numberOfSamples);
+    static void encodeTile(const quint16* samples, QByteArray& packed);
+    static int getRowSize(int bits);
+
+    int mWidth;
+    int mHeight;
+    int mTilesX;
+    int mTilesY;
+    QVector<Tile> mTiles;
+    QVector<int> mHotTileIndices;//hot cache entry of every tile, -1 if cold
+    QVector<HotTile> mHotTiles;
+    QReadWriteLock mLock;
+    int mTick;
+};
+
+#endif//ELEVATION_TILE_STORE_H
@@ -0,0 +1,267 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <QDir>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QElapsedTimer>
+#include "math.h"
+#include "ExampleElevationBenchmark.h"
+#include "ElevationManager.h"
+#include "ElevationDataset.h"
+#include "ElevationSampler.h"
+#include "ElevationTileStore.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor.
+ */
+ExampleElevationBenchmark::ExampleElevationBenchmark()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+ExampleElevationBenchmark::~ExampleElevationBenchmark()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Loads every elevation database in the given directory, first with one loader
+ * thread and then with one thread per core, and prints the load times. The
+ * databases stay registered with ElevationManager afterwards.
+ *
+ * @param directoryPath Directory that holds the elevation databases
+ */
+void ExampleElevationBenchmark::run(const QString& directoryPath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ElevationManager* elevationManager = ElevationManager::getInstance();
+
+  QStringList fileNames = QDir(directoryPath).entryList(QDir::Files, QDir::Name);
+
+  int numberOfCores = QThread::idealThreadCount();
+  qint64 singleThreadTime = 0;
+  qint64 multiThreadTime = 0;
+
+  for (int i = 0; i < fileNames.size(); i++)
+  {
+    QString filePath = directoryPath + "/" + fileNames[i];
+    if (!ElevationDataset::isElevationFile(filePath))
+    {
+      continue;
+    }
+
+    elevationManager->setNumberOfLoaderThreads(1);
+    if (!elevationManager->loadElevationDatabase(filePath))
+    {
+      continue;
+    }
+    singleThreadTime = elevationManager->getLastLoadTime();
+
+    elevationManager->setNumberOfLoaderThreads(numberOfCores);
+    elevationManager->loadElevationDatabase(filePath);
+    multiThreadTime = elevationManager->getLastLoadTime();
+
+    printf("ExampleElevationBenchmark: %s 1 thread: %lld ms, %d threads: %lld ms\n",
+           filePath.toStdString().c_str(), (long long)singleThreadTime,
+           numberOfCores, (long long)multiThreadTime);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Samples a synthetic 1 arc-second database (one degree square) at random
+ * positions with the scalar and the AVX2 kernels and prints points per second
+ * for both, along with the largest difference between their results.
+ *
+ * @param numberOfPoints Number of random positions to sample
+ */
+void ExampleElevationBenchmark::runSampling(int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int size = 3601;
+  QVector<float> samples(size * size);
+  for (int i = 0; i < samples.size(); i++)
+  {
+    samples[i] = (float)(rand() % 4000);
+  }
+
+  ElevationSampler::Grid grid;
+  grid.samples = samples.data();
+  grid.width = size;
+  grid.height = size;
+  grid.originLatitude = 33.0;
+  grid.originLongitude = -107.0;
+  grid.inverseSampleSizeXDegrees = 3600.0;
+  grid.inverseSampleSizeYDegrees = -3600.0;
+
+  QVector<double> latitudes(numberOfPoints);
+  QVector<double> longitudes(numberOfPoints);
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    latitudes[i] = 32.0 + (double)rand() / (double)RAND_MAX;
+    longitudes[i] = -107.0 + (double)rand() / (double)RAND_MAX;
+  }
+
+  QVector<float> scalarElevations(numberOfPoints);
+  QVector<float> avx2Elevations(numberOfPoints);
+  QElapsedTimer timer;
+
+  timer.start();
+  ElevationSampler::sampleBilinearScalar(grid, latitudes.data(), longitudes.data(), scalarElevations.data(), numberOfPoints);
+  qint64 scalarTime = timer.nsecsElapsed();
+
+  if (!ElevationSampler::getHasAvx2())
+  {
+    printf("ExampleElevationBenchmark: scalar: %.1f Mpoints/s, AVX2 not supported\n",
+           (numberOfPoints * 1000.0) / (double)(scalarTime + 1));
+    return;
+  }
+
+  timer.start();
+  ElevationSampler::sampleBilinearAvx2(grid, latitudes.data(), longitudes.data(), avx2Elevations.data(), numberOfPoints);
+  qint64 avx2Time = timer.nsecsElapsed();
+
+  float maxDifference = 0.0f;
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    maxDifference = qMax(maxDifference, (float)fabs(scalarElevations[i] - avx2Elevations[i]));
+  }
+
+  printf("ExampleElevationBenchmark: scalar: %.1f Mpoints/s, AVX2: %.1f Mpoints/s, max difference: %f Km\n",
+         (numberOfPoints * 1000.0) / (double)(scalarTime + 1),
+         (numberOfPoints * 1000.0) / (double)(avx2Time + 1), maxDifference);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Stores a synthetic 1 arc-second database (one degree square of rolling
+ * terrain in whole meters, like SRTM) in an ElevationTileStore and prints the
+ * memory it takes next to the float grid, the largest quantization error, and
+ * the time per point for both when sampling scattered positions (every point
+ * lands on a different tile, the worst case for the store) and a dense grid of
+ * positions (e.g. a viewshed, mostly served from hot tiles).
+ *
+ * @param numberOfPoints Number of positions to sample
+ */
+void ExampleElevationBenchmark::runCompressedStorage(int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int size = 3601;
+  QVector<float> samples(size * size);
+  for (int row = 0; row < size; row++)
+  {
+    for (int column = 0; column < size; column++)
+    {
+      double x = column / 3600.0;
+      double y = row / 3600.0;
+      samples[(row * size) + column] = (float)floor(1500.0 + 800.0 * sin(6.0 * x) * cos(5.0 * y) +
+                                                    300.0 * sin(23.0 * x + 3.0 * y) +
+                                                    80.0 * sin(97.0 * y) + (rand() % 3));
+    }
+  }
+
+  ElevationSampler::Grid grid;
+  grid.samples = samples.data();
+  grid.width = size;
+  grid.height = size;
+  grid.originLatitude = 33.0;
+  grid.originLongitude = -107.0;
+  grid.inverseSampleSizeXDegrees = 3600.0;
+  grid.inverseSampleSizeYDegrees = -3600.0;
+
+  //pack a copy in bands, the way loader threads do
+  QVector<float> quantized = samples;
+  ElevationTileStore store;
+  store.allocate(size, size);
+  QElapsedTimer timer;
+  timer.start();
+  for (int row = 0; row < size; row += ElevationTileStore::TILE_SIZE)
+  {
+    store.compressRows(quantized.data() + (row * size), row, qMin(ElevationTileStore::TILE_SIZE, size - row));
+  }
+  qint64 compressTime = timer.elapsed();
+
+  float maxError = 0.0f;
+  for (int i = 0; i < samples.size(); i++)
+  {
+    maxError = qMax(maxError, (float)fabs(samples[i] - quantized[i]));
+  }
+
+  printf("ExampleElevationBenchmark: floats: %.1f MB, compressed: %.1f MB (%.1fx smaller), "
+         "packed in %lld ms, max error: %.3f m\n",
+         (double)samples.size() * sizeof(float) / (1024.0 * 1024.0),
+         (double)store.getMemorySize() / (1024.0 * 1024.0),
+         (double)samples.size() * sizeof(float) / (double)store.getMemorySize(),
+         (long long)compressTime, maxError);
+
+  QVector<double> latitudes(numberOfPoints);
+  QVector<double> longitudes(numberOfPoints);
+  QVector<float> floatElevations(numberOfPoints);
+  QVector<float> storeElevations(numberOfPoints);
+
+  for (int pattern = 0; pattern < 2; pattern++)
+  {
+    //scattered positions first, then a dense grid over a quarter degree
+    int gridSize = (int)sqrt((double)numberOfPoints);
+    for (int i = 0; i < numberOfPoints; i++)
+    {
+      if (pattern == 0)
+      {
+        latitudes[i] = 32.0 + (double)rand() / (double)RAND_MAX;
+        longitudes[i] = -107.0 + (double)rand() / (double)RAND_MAX;
+      }
+      else
+      {
+        latitudes[i] = 32.5 + 0.25 * (double)(i / gridSize) / (double)gridSize;
+        longitudes[i] = -106.75 + 0.25 * (double)(i % gridSize) / (double)gridSize;
+      }
+    }
+
+    timer.start();
+    ElevationSampler::sampleBilinearScalar(grid, latitudes.data(), longitudes.data(), floatElevations.data(), numberOfPoints);
+    qint64 floatTime = timer.nsecsElapsed();
+
+    timer.start();
+    store.sampleBilinear(grid, latitudes.data(), longitudes.data(), storeElevations.data(), numberOfPoints);
+    qint64 storeTime = timer.nsecsElapsed();
+
+    float maxDifference = 0.0f;
+    for (int i = 0; i < numberOfPoints; i++)
+    {
+      maxDifference = qMax(maxDifference, (float)fabs(floatElevations[i] - storeElevations[i]));
+    }
+
+    printf("ExampleElevationBenchmark: %s: floats: %.1f ns/point, compressed: %.1f ns/point, "
+           "max difference: %f Km\n", (pattern == 0) ? "scattered" : "dense",
+           (double)floatTime / numberOfPoints, (double)storeTime / numberOfPoints, maxDifference);
+  }
+}
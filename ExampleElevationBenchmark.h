@@ -0,0 +1,60 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXAMPLE_ELEVATION_BENCHMARK_H
+#define EXAMPLE_ELEVATION_BENCHMARK_H
+
+#include <QString>
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This example measures how long it takes ElevationManager to load the
+ * elevation databases found in a directory (by default the elevation folder
+ * that ships with SimpleEarth). Every database is loaded with a single loader
+ * thread first and then with one thread per core, and the timings are printed
+ * to the console so you can tell how much faster your startup gets on your own
+ * data and hardware. runSampling measures how many points per second the
+ * batch bilinear sampling kernels (scalar and AVX2) get through, it uses a
+ * synthetic database so it runs without GDAL. runCompressedStorage compares
+ * the memory taken by a synthetic database stored as floats and compressed
+ * (see ElevationManager::setCompressedStorage) against how much slower
+ * sampling gets.
+ *
+ * Note: In order to load elevation databases other than GeoTIFF you must
+ * include the GDAL library dependency.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ExampleElevationBenchmark
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    ExampleElevationBenchmark();
+    ~ExampleElevationBenchmark();
+
+    void run(const QString& directoryPath = "elevation");
+    void runSampling(int numberOfPoints = 1000000);
+    void runCompressedStorage(int numberOfPoints = 1000000);
+};
+
+#endif//EXAMPLE_ELEVATION_BENCHMARK_H
@@ -0,0 +1,144 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include "ExampleTrackBenchmark.h"
+#include "WorldObjectManager.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor.
+ */
+ExampleTrackBenchmark::ExampleTrackBenchmark()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+ExampleTrackBenchmark::~ExampleTrackBenchmark()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds the given number of tracks, feeds them one second worth of random
+ * updates at every rate with both APIs and prints the timings. Updates go to
+ * the tracks round-robin, so at rates above 60 times the number of tracks the
+ * batch API gets to coalesce updates. The tracks are removed at the end.
+ *
+ * @param numberOfTracks Number of tracks to create
+ */
+void ExampleTrackBenchmark::run(int numberOfTracks)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  WorldObjectManager* worldObjectManager = WorldObjectManager::getInstance();
+  const int framesPerSecond = 60;
+  const int rates[] = {1000, 10000, 100000};
+
+  //create tracks
+  QVector<QString> names(numberOfTracks);
+  QVector<int> handles(numberOfTracks);
+  for (int i = 0; i < numberOfTracks; i++)
+  {
+    names[i] = QString("ExampleTrackBenchmark%1").arg(i);
+
+    WorldObject* worldObject = new WorldObject();
+    worldObject->setName(names[i]);
+    worldObject->setGroup(WorldObject::TRACK);
+    handles[i] = worldObjectManager->addWorldObject(worldObject);
+  }
+
+  for (int r = 0; r < 3; r++)
+  {
+    int updatesPerFrame = rates[r] / framesPerSecond;
+
+    //random updates for one second, made up front so they are not timed
+    QVector<WorldObjectManager::TrackUpdate> updates(updatesPerFrame * framesPerSecond);
+    for (int i = 0; i < updates.size(); i++)
+    {
+      updates[i].handle = handles[i % numberOfTracks];
+      updates[i].latitude = -80.0 + 160.0 * (double)rand() / (double)RAND_MAX;
+      updates[i].longitude = -180.0 + 360.0 * (double)rand() / (double)RAND_MAX;
+      updates[i].altitude = 10.0 * (double)rand() / (double)RAND_MAX;
+      updates[i].heading = 360.0f * (float)rand() / (float)RAND_MAX;
+      updates[i].speed = 0.25f;
+      updates[i].timestamp = i;
+    }
+
+    QElapsedTimer timer;
+
+    //per object: fetch every object by name and call its set methods
+    timer.start();
+    for (int i = 0; i < updates.size(); i++)
+    {
+      WorldObject* worldObject = worldObjectManager->getWorldObject(names[i % numberOfTracks]);
+      if (worldObject != NULL)
+      {
+        GeodeticPosition position;
+        position.latitude = updates[i].latitude;
+        position.longitude = updates[i].longitude;
+        position.altitude = updates[i].altitude;
+        worldObject->setGeodeticPosition(position);
+
+        SimpleVector rotation = worldObject->getRotation();
+        rotation.z = updates[i].heading;
+        worldObject->setRotation(rotation);
+        worldObject->setSpeed(updates[i].speed);
+      }
+    }
+    qint64 perObjectTime = timer.nsecsElapsed();
+
+    //batch: push every frame worth of updates at once, apply once per frame
+    qint64 ingestTime = 0;
+    qint64 applyTime = 0;
+    for (int frame = 0; frame < framesPerSecond; frame++)
+    {
+      timer.start();
+      worldObjectManager->updateTracks(updates.constData() + frame * updatesPerFrame, updatesPerFrame);
+      ingestTime += timer.nsecsElapsed();
+
+      timer.start();
+      worldObjectManager->applyTrackUpdates();
+      applyTime += timer.nsecsElapsed();
+    }
+
+    printf("ExampleTrackBenchmark: %d tracks, %d updates/s: per object: %.2f ms/s, "
+           "batch: %.2f ms/s ingest + %.2f ms/s apply\n",
+           numberOfTracks, rates[r], perObjectTime / 1000000.0,
+           ingestTime / 1000000.0, applyTime / 1000000.0);
+  }
+
+  //clean up
+  for (int i = 0; i < numberOfTracks; i++)
+  {
+    worldObjectManager->removeWorldObjectFromHandle(handles[i]);
+  }
+}
@@ -0,0 +1,49 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef EXAMPLE_TRACK_BENCHMARK_H
+#define EXAMPLE_TRACK_BENCHMARK_H
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This example measures the cost of feeding track updates into
+ * WorldObjectManager at 1k, 10k and 100k updates per second. One second of
+ * updates (split in 60 frames) is pushed the per-object way, fetching every
+ * object by name and calling its set methods, and then through the batch
+ * updateTracks/applyTrackUpdates API. The time spent on the feed (producer)
+ * side and on the render side is printed to the console for both.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ExampleTrackBenchmark
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    ExampleTrackBenchmark();
+    ~ExampleTrackBenchmark();
+
+    void run(int numberOfTracks = 10000);
+};
+
+#endif//EXAMPLE_TRACK_BENCHMARK_H
@@ -0,0 +1,94 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "ExampleViewshed.h"
+#include "Camera.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor.
+ */
+ExampleViewshed::ExampleViewshed()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //signal is emitted from a viewshed thread, Qt queues it to our thread
+  connect(&mViewshed, SIGNAL(analysisFinished()), this, SLOT(onViewshedFinished()));
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+ExampleViewshed::~ExampleViewshed()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mViewshed.removeFromEarth();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Checks the line of sight from the top of the Franklin Mountains down to the
+ * city, then starts computing the viewshed of an observer standing there.
+ *
+ * @param radius Radius of the viewshed in Km
+ */
+void ExampleViewshed::run(double radius)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  GeodeticPosition observer;
+  observer.latitude = 31.8946;
+  observer.longitude = -106.4926;
+  observer.altitude = 0.0;
+
+  GeodeticPosition target;
+  target.latitude = 31.7619;
+  target.longitude = -106.4850;
+  target.altitude = 0.0;
+
+  //observer and target are people, about 2m tall
+  bool lineOfSight = Viewshed::getLineOfSight(observer, 0.002, target, 0.002);
+  qDebug("Line of sight to downtown: %s", lineOfSight ? "yes" : "no");
+
+  mViewshed.start(observer, 0.002, 0.002, radius);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Qt SLOT. Gets called on the GUI thread once the viewshed is done. Shows it
+ * on the Earth and flies the camera over it.
+ */
+void ExampleViewshed::onViewshedFinished()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mViewshed.getWasCancelled())
+  {
+    return;
+  }
+
+  mViewshed.addToEarth();
+
+  GeodeticPosition cameraPosition = mViewshed.getObserver();
+  cameraPosition.altitude = mViewshed.getRadius() * 4.0;
+  Camera::getInstance()->moveByDestinationPoint(cameraPosition);
+}
@@ -0,0 +1,65 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef EXAMPLE_VIEWSHED_H
+#define EXAMPLE_VIEWSHED_H
+
+#include <QObject>
+#include "globals.h"
+#include "Viewshed.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This example shows how to run terrain visibility analyses. It checks the
+ * line of sight between two points, then computes the viewshed of an observer
+ * standing on the Franklin Mountains (covered by the elevation database that
+ * ships with SimpleEarth) and shows it on the Earth once it is done. The
+ * analysis runs on worker threads, so this object listens to the
+ * analysisFinished signal to add the overlay from the GUI thread.
+ *
+ * Note: In order to load elevation databases you must include the GDAL library
+ * dependency.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ExampleViewshed : public QObject
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  Q_OBJECT
+
+  public:
+    ExampleViewshed();
+    ~ExampleViewshed();
+
+    void run(double radius = 50.0);
+
+  public slots:
+    void onViewshedFinished();
+
+  private:
+    Viewshed mViewshed;
+};
+
+#endif//EXAMPLE_VIEWSHED_H
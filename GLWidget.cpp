@@ -21,7 +21,6 @@
  */
 
 #include <QtOpenGL>
-#include <GL/glu.h>
 
 #include "GLWidget.h"
 #include "MainWindow.h"
@@ -36,6 +35,8 @@
 #include "VolumeTool.h"
 #include "MeasuringTool.h"
 #include "Utilities.h"
+#include "TerrainPicker.h"
+#include "CameraProjection.h"
 
 #ifndef GL_MULTISAMPLE
 #define GL_MULTISAMPLE  0x809D
@@ -249,9 +250,18 @@ void GLWidget::paintEvent(QPaintEvent*)
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  gluLookAt(cameraPosition.x, cameraPosition.y, cameraPosition.z,
-            cameraLookAt.x, cameraLookAt.y, cameraLookAt.z,
-            cameraUpVector.x, cameraUpVector.y, cameraUpVector.z);
+  //build the camera matrix on the CPU, the rest of the frame
+  //projects positions against it instead of querying OpenGL
+  CameraProjection* cameraProjection = CameraProjection::getInstance();
+  cameraProjection->setLookAt(cameraPosition, cameraLookAt, cameraUpVector);
+  glLoadMatrixd(cameraProjection->getModelView());
+
+  //hand this frame's matrices over to the picker, picks are
+  //computed from them instead of reading back the depth buffer
+  TerrainPicker::getInstance()->setViewState(cameraProjection->getModelView(),
+                                             cameraProjection->getProjection(),
+                                             cameraProjection->getViewport(),
+                                             earth->getElevationMode());
 
   //render our planet first
   earth->render();
@@ -272,6 +282,9 @@ void GLWidget::paintEvent(QPaintEvent*)
   glDisable(GL_DEPTH_TEST);
   glDisable(GL_CULL_FACE);
 
+  //labels are drawn in OpenGL, before the painter takes over
+  hud->renderLabels();
+
   glMatrixMode(GL_MODELVIEW);
   glPopMatrix();
 
@@ -308,7 +321,8 @@ void GLWidget::resizeGL(int width, int height)
  * This method is called by resizeGL as well as the paintEvent to set the
  * viewport/frustrum. Notice that on a regular OpenGL application, you would
  * only call this method on resizeGL, but we are using a QPainter along with
- * OpenGL code, so this method needs to be called by the paintEvent.
+ * OpenGL code, so this method needs to be called by the paintEvent. The
+ * matrices are built in CameraProjection and loaded from there.
  *
  * @param width Screen width
  * @param height Screen height
@@ -316,27 +330,33 @@ void GLWidget::resizeGL(int width, int height)
 void GLWidget::setupViewport(int width, int height)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  glViewport(0, 0, width, height);
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
   float aspectRatio = (float)width/(float)height;
   float fieldOfView = 45.0f;
+  float nearPlane = 0.01f;
+  float farPlane = 1000.0f;
 
   //set near and far clipping according to camera altitude
   GeodeticPosition cameraPosition = camera->getGeodeticPosition();
   if (cameraPosition.altitude >= 10000.0f)
   {
-    gluPerspective(fieldOfView, aspectRatio, 1000.0f, 50000.0f);
+    nearPlane = 1000.0f;
+    farPlane = 50000.0f;
   }
   else if (cameraPosition.altitude < 10000.0f && cameraPosition.altitude >= 100.0f)
   {
-    gluPerspective(fieldOfView, aspectRatio, 50.0f, 20000.0f);
-  }
-  else if (cameraPosition.altitude < 100.0f)
-  {
-    gluPerspective(fieldOfView, aspectRatio, 0.01f, 1000.0f);
+    nearPlane = 50.0f;
+    farPlane = 20000.0f;
   }
 
+  //build the matrices on the CPU and load them into OpenGL
+  CameraProjection* cameraProjection = CameraProjection::getInstance();
+  cameraProjection->setViewport(0, 0, width, height);
+  cameraProjection->setPerspective(fieldOfView, aspectRatio, nearPlane, farPlane);
+
+  glViewport(0, 0, width, height);
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixd(cameraProjection->getProjection());
+
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
 }
@@ -451,9 +471,10 @@ void GLWidget::mouseReleaseEvent(QMouseEvent* event)
       WorldObject* worldObject;
       SimpleVector screenLocation;
       ScreenCoordinates screenSize;
-      for (int i = 0; i < worldObjectManager->getNumberOfObjects(); i++)
+      //only objects in view last frame can be under the mouse
+      for (int i = 0; i < worldObjectManager->getNumberOfVisibleObjects(); i++)
       {
-        worldObject = worldObjectManager->getWorldObject(i);
+        worldObject = worldObjectManager->getVisibleObject(i);
         if (worldObject!=NULL && !worldObject->getHasExpired() && worldObject->getIsClickable())
         {
           screenSize = camera->getScreenSize();
@@ -461,7 +482,7 @@ void GLWidget::mouseReleaseEvent(QMouseEvent* event)
           screenLocation.y = (float)screenSize.y - screenLocation.y;//reverse Y
           //only select objects if not behind camera and not obsucred
           if (screenLocation.z < 1.0f &&
-              !Utilities::checkObscure(camera->getGeodeticPosition(), worldObject->getGeodeticPosition()) &&
+              !Utilities::checkObscure(camera->getGeodeticPosition(), worldObject->getFrameGeodeticPosition()) &&
               (event->x() < screenLocation.x + 20.0) &&
               (event->x() > screenLocation.x - 20.0) &&
               (event->y() < screenLocation.y + 20.0) &&
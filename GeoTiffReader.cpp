@@ -0,0 +1,1341 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <QFileInfo>
+#include <QtGlobal>
+#include "GeoTiffReader.h"
+
+//TIFF tags we care about
+static const int TAG_NEW_SUBFILE_TYPE = 254;
+static const int TAG_IMAGE_WIDTH = 256;
+static const int TAG_IMAGE_LENGTH = 257;
+static const int TAG_BITS_PER_SAMPLE = 258;
+static const int TAG_COMPRESSION = 259;
+static const int TAG_PHOTOMETRIC = 262;
+static const int TAG_STRIP_OFFSETS = 273;
+static const int TAG_SAMPLES_PER_PIXEL = 277;
+static const int TAG_ROWS_PER_STRIP = 278;
+static const int TAG_STRIP_BYTE_COUNTS = 279;
+static const int TAG_PLANAR_CONFIGURATION = 284;
+static const int TAG_PREDICTOR = 317;
+static const int TAG_TILE_WIDTH = 322;
+static const int TAG_TILE_LENGTH = 323;
+static const int TAG_TILE_OFFSETS = 324;
+static const int TAG_TILE_BYTE_COUNTS = 325;
+static const int TAG_SAMPLE_FORMAT = 339;
+static const int TAG_JPEG_TABLES = 347;
+static const int TAG_MODEL_PIXEL_SCALE = 33550;
+static const int TAG_MODEL_TIEPOINT = 33922;
+static const int TAG_MODEL_TRANSFORMATION = 34264;
+static const int TAG_GEO_KEY_DIRECTORY = 34735;
+static const int TAG_GDAL_NODATA = 42113;
+
+//compression schemes
+static const int COMPRESSION_NONE = 1;
+static const int COMPRESSION_LZW = 5;
+static const int COMPRESSION_JPEG = 7;
+static const int COMPRESSION_DEFLATE = 8;
+static const int COMPRESSION_ADOBE_DEFLATE = 32946;
+
+//photometric interpretations
+static const int PHOTOMETRIC_WHITE_IS_ZERO = 0;
+static const int PHOTOMETRIC_RGB = 2;
+static const int PHOTOMETRIC_PALETTE = 3;
+static const int PHOTOMETRIC_YCBCR = 6;
+
+//predictors
+static const int PREDICTOR_HORIZONTAL = 2;
+static const int PREDICTOR_FLOATING_POINT = 3;
+
+//sample formats
+static const int FORMAT_UNSIGNED = 1;
+static const int FORMAT_SIGNED = 2;
+static const int FORMAT_FLOAT = 3;
+
+//GeoTIFF keys and values
+static const int KEY_MODEL_TYPE = 1024;
+static const int KEY_GEOGRAPHIC_TYPE = 2048;
+static const int KEY_GEOGRAPHIC_ANGULAR_UNITS = 2054;
+static const int KEY_PROJECTED_TYPE = 3072;
+static const int MODEL_TYPE_GEOGRAPHIC = 2;
+static const int ANGULAR_UNIT_DEGREE = 9102;
+static const int USER_DEFINED = 32767;
+
+//no codec expands a byte of input into more than this many bytes of output
+//(a 12 bit LZW code stands for 4096 bytes at most, DEFLATE tops out near 1032)
+static const qint64 MAXIMUM_EXPANSION = 4096;
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+static const bool IS_HOST_BIG_ENDIAN = true;
+#else
+static const bool IS_HOST_BIG_ENDIAN = false;
+#endif
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+GeoTiffReader::GeoTiffReader()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mMappedFile = NULL;
+  mFileSize = 0;
+  mIsBigEndian = false;
+  mIsBigTiff = false;
+  mBitsPerSample = 0;
+  mSamplesPerPixel = 0;
+  mSampleFormat = FORMAT_UNSIGNED;
+  mPhotometric = 1;
+  mHasGeoreference = false;
+  mOrigin.latitude = 0.0;
+  mOrigin.longitude = 0.0;
+  mOrigin.altitude = 0.0;
+  mSampleSizeXDegrees = 0.0;
+  mSampleSizeYDegrees = 0.0;
+  mHasNoData = false;
+  mNoData = 0.0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. Unmaps the file if one is open.
+ */
+GeoTiffReader::~GeoTiffReader()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  close();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Memory maps the given file and reads its image file directories. No pixels
+ * are read here.
+ *
+ * @param filePath The file path for the GeoTIFF file
+ * @return True if the file is a TIFF file this reader can decode
+ */
+bool GeoTiffReader::open(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  close();
+
+  mFile.setFileName(filePath);
+  if (!mFile.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  mFileSize = mFile.size();
+  if (mFileSize < 16)
+  {
+    mFile.close();
+    return false;
+  }
+
+  mMappedFile = mFile.map(0, mFileSize);
+  if (mMappedFile == NULL)
+  {
+    printf("GeoTiffReader.cpp: Error mapping %s.\n", filePath.toStdString().c_str());
+    mFile.close();
+    return false;
+  }
+
+  //II is little endian, MM big endian, then 42 for TIFF and 43 for BigTIFF
+  bool isValid = true;
+  qint64 offset = 0;
+  if (mMappedFile[0] == 'I' && mMappedFile[1] == 'I')
+  {
+    mIsBigEndian = false;
+  }
+  else if (mMappedFile[0] == 'M' && mMappedFile[1] == 'M')
+  {
+    mIsBigEndian = true;
+  }
+  else
+  {
+    isValid = false;
+  }
+
+  if (isValid)
+  {
+    int version = (int)readUnsigned(2, 2);
+    mIsBigTiff = (version == 43);
+    if (version == 42)
+    {
+      offset = (qint64)readUnsigned(4, 4);
+    }
+    else if (version == 43 && readUnsigned(4, 2) == 8)
+    {
+      offset = (qint64)readUnsigned(8, 8);
+    }
+    else
+    {
+      isValid = false;
+    }
+  }
+
+  //full resolution image first, then overviews (and masks, which are skipped)
+  int numberOfDirectories = 0;
+  while (isValid && offset != 0 && numberOfDirectories < 64)
+  {
+    qint64 nextOffset = 0;
+    isValid = readDirectory(offset, nextOffset);
+    offset = nextOffset;
+    numberOfDirectories++;
+  }
+
+  if (!isValid || mLevels.isEmpty())
+  {
+    printf("GeoTiffReader.cpp: %s is not a TIFF file this reader supports.\n", filePath.toStdString().c_str());
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unmaps and closes the file.
+ */
+void GeoTiffReader::close()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mMappedFile != NULL)
+  {
+    mFile.unmap((uchar*)mMappedFile);
+  }
+
+  mFile.close();
+  mMappedFile = NULL;
+  mFileSize = 0;
+  mLevels.clear();
+  mHasGeoreference = false;
+  mHasNoData = false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if a file is open.
+ *
+ * @return True if a file is open
+ */
+bool GeoTiffReader::getIsOpen()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mMappedFile != NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of levels, the full resolution image plus its overviews.
+ *
+ * @return Number of levels
+ */
+int GeoTiffReader::getNumberOfLevels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevels.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the width of the given level.
+ *
+ * @param level Level, 0 is the full resolution image
+ * @return Width in pixels
+ */
+int GeoTiffReader::getWidth(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevels[level].width;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the height of the given level.
+ *
+ * @param level Level, 0 is the full resolution image
+ * @return Height in pixels
+ */
+int GeoTiffReader::getHeight(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevels[level].height;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the height of the tiles (or strips) of the given level. Reading
+ * whole rows of tiles at a time avoids decoding tiles twice.
+ *
+ * @param level Level, 0 is the full resolution image
+ * @return Tile height in pixels
+ */
+int GeoTiffReader::getTileHeight(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevels[level].tileHeight;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Finds the finest level that fits in the given size, so that large images can
+ * be read from their overviews.
+ *
+ * @param maximumWidth Maximum width in pixels
+ * @param maximumHeight Maximum height in pixels
+ * @return Finest level that fits, or the coarsest level if none does
+ */
+int GeoTiffReader::findLevel(int maximumWidth, int maximumHeight)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int level = 0; level < mLevels.size(); level++)
+  {
+    if (mLevels[level].width <= maximumWidth && mLevels[level].height <= maximumHeight)
+    {
+      return level;
+    }
+  }
+
+  return mLevels.size() - 1;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the file holds elevation data: a single georeferenced band
+ * with no color palette.
+ *
+ * @return True if the file can be read with readSamples
+ */
+bool GeoTiffReader::getIsElevation()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mSamplesPerPixel == 1 && mPhotometric != PHOTOMETRIC_PALETTE && mHasGeoreference &&
+          mLevels[0].compression != COMPRESSION_JPEG);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the file holds an 8 bit gray, RGB or RGBA image.
+ *
+ * @return True if the file can be read with readImage
+ */
+bool GeoTiffReader::getIsImage()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mBitsPerSample == 8 && mSampleFormat == FORMAT_UNSIGNED && mPhotometric != PHOTOMETRIC_PALETTE &&
+          (mPhotometric != PHOTOMETRIC_YCBCR || mLevels[0].compression == COMPRESSION_JPEG));
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the file came with georeferencing tags.
+ *
+ * @return True if origin and sample sizes are known
+ */
+bool GeoTiffReader::getHasGeoreference()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mHasGeoreference;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the position of the outer corner of the first pixel.
+ *
+ * @return Origin, usually the north west corner
+ */
+GeodeticPosition GeoTiffReader::getOrigin()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mOrigin;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the pixel width of the full resolution image.
+ *
+ * @return Pixel width in decimal degrees
+ */
+double GeoTiffReader::getSampleSizeXDegrees()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSampleSizeXDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the pixel height of the full resolution image, negative for north
+ * up images.
+ *
+ * @return Pixel height in decimal degrees
+ */
+double GeoTiffReader::getSampleSizeYDegrees()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSampleSizeYDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads a window of samples of the first band as floats, decoding only the
+ * tiles that intersect the window. No data samples are read as 0 (sea level,
+ * which is what ElevationManager returns outside of datasets). This method is
+ * thread-safe.
+ *
+ * @param level Level to read from, 0 is the full resolution image
+ * @param x Window left column
+ * @param y Window top row
+ * @param width Window width
+ * @param height Window height
+ * @param samples Output buffer of width*height samples, row by row
+ * @return True if the window could be read
+ */
+bool GeoTiffReader::readSamples(int level, int x, int y, int width, int height, float* samples)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (level < 0 || level >= mLevels.size())
+  {
+    return false;
+  }
+
+  const Level& tiffLevel = mLevels[level];
+  if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+      x + width > tiffLevel.width || y + height > tiffLevel.height)
+  {
+    return false;
+  }
+
+  QByteArray tile;
+  int lastTileX = (x + width - 1) / tiffLevel.tileWidth;
+  int lastTileY = (y + height - 1) / tiffLevel.tileHeight;
+  for (int tileY = y / tiffLevel.tileHeight; tileY <= lastTileY; tileY++)
+  {
+    int tileTop = tileY * tiffLevel.tileHeight;
+    int fromY = qMax(y, tileTop);
+    int toY = qMin(y + height, tileTop + getTileRows(tiffLevel, tileY));
+
+    for (int tileX = x / tiffLevel.tileWidth; tileX <= lastTileX; tileX++)
+    {
+      if (!decodeTile(tiffLevel, tileY * tiffLevel.tilesX + tileX, tile))
+      {
+        printf("GeoTiffReader.cpp: Error decoding tile %d,%d of %s.\n", tileX, tileY,
+               mFile.fileName().toStdString().c_str());
+        return false;
+      }
+
+      int tileLeft = tileX * tiffLevel.tileWidth;
+      int fromX = qMax(x, tileLeft);
+      int toX = qMin(x + width, tileLeft + tiffLevel.tileWidth);
+      copyTileSamples((const uchar*)tile.constData(), tiffLevel.tileWidth, fromX - tileLeft, fromY - tileTop,
+                      toX - fromX, toY - fromY, &samples[(size_t)(fromY - y) * width + (fromX - x)], width);
+    }
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads a window of an 8 bit image, decoding only the tiles that intersect the
+ * window. This method is thread-safe.
+ *
+ * @param level Level to read from, 0 is the full resolution image
+ * @param x Window left column
+ * @param y Window top row
+ * @param width Window width
+ * @param height Window height
+ * @return The window as an ARGB image, a null image if it could not be read
+ */
+QImage GeoTiffReader::readImage(int level, int x, int y, int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (level < 0 || level >= mLevels.size() || !getIsImage())
+  {
+    return QImage();
+  }
+
+  const Level& tiffLevel = mLevels[level];
+  if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+      x + width > tiffLevel.width || y + height > tiffLevel.height)
+  {
+    return QImage();
+  }
+
+  QImage image(width, height, QImage::Format_ARGB32);
+  QByteArray tile;
+  QImage jpegTile;
+  int lastTileX = (x + width - 1) / tiffLevel.tileWidth;
+  int lastTileY = (y + height - 1) / tiffLevel.tileHeight;
+  for (int tileY = y / tiffLevel.tileHeight; tileY <= lastTileY; tileY++)
+  {
+    int tileTop = tileY * tiffLevel.tileHeight;
+    int fromY = qMax(y, tileTop);
+    int toY = qMin(y + height, tileTop + getTileRows(tiffLevel, tileY));
+
+    for (int tileX = x / tiffLevel.tileWidth; tileX <= lastTileX; tileX++)
+    {
+      int tileIndex = tileY * tiffLevel.tilesX + tileX;
+      int tileLeft = tileX * tiffLevel.tileWidth;
+      int fromX = qMax(x, tileLeft);
+      int toX = qMin(x + width, tileLeft + tiffLevel.tileWidth);
+
+      //JPEG tiles are decoded by Qt, which also takes care of YCbCr
+      if (tiffLevel.compression == COMPRESSION_JPEG)
+      {
+        jpegTile = decodeJpegTile(tiffLevel, tileIndex);
+        if (jpegTile.isNull())
+        {
+          return QImage();
+        }
+
+        for (int row = fromY; row < toY && row - tileTop < jpegTile.height(); row++)
+        {
+          const QRgb* source = (const QRgb*)jpegTile.constScanLine(row - tileTop);
+          QRgb* destination = (QRgb*)image.scanLine(row - y);
+          for (int column = fromX; column < toX && column - tileLeft < jpegTile.width(); column++)
+          {
+            destination[column - x] = source[column - tileLeft];
+          }
+        }
+        continue;
+      }
+
+      if (!decodeTile(tiffLevel, tileIndex, tile))
+      {
+        printf("GeoTiffReader.cpp: Error decoding tile %d,%d of %s.\n", tileX, tileY,
+               mFile.fileName().toStdString().c_str());
+        return QImage();
+      }
+
+      //gray, gray and alpha, RGB or RGBA
+      for (int row = fromY; row < toY; row++)
+      {
+        const uchar* source = (const uchar*)tile.constData() +
+          ((size_t)(row - tileTop) * tiffLevel.tileWidth + (fromX - tileLeft)) * mSamplesPerPixel;
+        QRgb* destination = (QRgb*)image.scanLine(row - y);
+        for (int column = fromX; column < toX; column++)
+        {
+          int red, green, blue;
+          int alpha = 255;
+          if (mSamplesPerPixel < 3)
+          {
+            red = green = blue = (mPhotometric == PHOTOMETRIC_WHITE_IS_ZERO) ? 255 - source[0] : source[0];
+            if (mSamplesPerPixel == 2)
+            {
+              alpha = source[1];
+            }
+          }
+          else
+          {
+            red = source[0];
+            green = source[1];
+            blue = source[2];
+            if (mSamplesPerPixel >= 4)
+            {
+              alpha = source[3];
+            }
+          }
+
+          destination[column - x] = qRgba(red, green, blue, alpha);
+          source += mSamplesPerPixel;
+        }
+      }
+    }
+  }
+
+  return image;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the given file name has a TIFF suffix.
+ *
+ * @param filePath File path
+ * @return True for .tif and .tiff files
+ */
+bool GeoTiffReader::isTiffFile(const QString& filePath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QString suffix = QFileInfo(filePath).suffix().toLower();
+  return (suffix == "tif" || suffix == "tiff");
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads the image file directory at the given offset. The first directory is
+ * the full resolution image and sets the sample layout and georeferencing,
+ * reduced resolution directories with the same layout become overviews and
+ * anything else (e.g. masks) is skipped.
+ *
+ * @param offset Directory offset in bytes
+ * @param nextOffset Set to the offset of the next directory, 0 if none
+ * @return False if the directory is broken or the full resolution image uses
+ *         a layout or compression this reader does not support
+ */
+bool GeoTiffReader::readDirectory(qint64 offset, qint64& nextOffset)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int countSize = mIsBigTiff ? 8 : 2;
+  int entrySize = mIsBigTiff ? 20 : 12;
+  int offsetSize = mIsBigTiff ? 8 : 4;
+  if (offset < 0 || offset + countSize > mFileSize)
+  {
+    return false;
+  }
+
+  qint64 numberOfEntries = (qint64)readUnsigned(offset, countSize);
+  qint64 firstEntry = offset + countSize;
+  if (numberOfEntries <= 0 || firstEntry + numberOfEntries * entrySize + offsetSize > mFileSize)
+  {
+    return false;
+  }
+  nextOffset = (qint64)readUnsigned(firstEntry + numberOfEntries * entrySize, offsetSize);
+
+  Level level;
+  level.width = 0;
+  level.height = 0;
+  level.tileWidth = 0;
+  level.tileHeight = 0;
+  level.isTiled = false;
+  level.compression = COMPRESSION_NONE;
+  level.predictor = 1;
+  int subfileType = 0;
+  int bitsPerSample = 1;
+  int samplesPerPixel = 1;
+  int sampleFormat = FORMAT_UNSIGNED;
+  int photometric = 1;
+  int planarConfiguration = 1;
+  int rowsPerStrip = 0;
+  QVector<double> pixelScale;
+  QVector<double> tiepoint;
+  QVector<double> transformation;
+  QVector<qint64> geoKeys;
+  QByteArray noData;
+  QVector<qint64> values;
+
+  for (qint64 i = 0; i < numberOfEntries; i++)
+  {
+    qint64 entry = firstEntry + i * entrySize;
+    int tag = (int)readUnsigned(entry, 2);
+
+    switch (tag)
+    {
+      case TAG_STRIP_OFFSETS:
+      case TAG_TILE_OFFSETS:
+        readValues(entry, level.offsets);
+        level.isTiled = (tag == TAG_TILE_OFFSETS);
+        break;
+      case TAG_STRIP_BYTE_COUNTS:
+      case TAG_TILE_BYTE_COUNTS:
+        readValues(entry, level.byteCounts);
+        break;
+      case TAG_MODEL_PIXEL_SCALE:
+        readDoubles(entry, pixelScale);
+        break;
+      case TAG_MODEL_TIEPOINT:
+        readDoubles(entry, tiepoint);
+        break;
+      case TAG_MODEL_TRANSFORMATION:
+        readDoubles(entry, transformation);
+        break;
+      case TAG_GEO_KEY_DIRECTORY:
+        readValues(entry, geoKeys);
+        break;
+      case TAG_JPEG_TABLES:
+      case TAG_GDAL_NODATA:
+        if (readValues(entry, values))
+        {
+          QByteArray& bytes = (tag == TAG_JPEG_TABLES) ? level.jpegTables : noData;
+          bytes.resize(values.size());
+          for (int j = 0; j < values.size(); j++)
+          {
+            bytes[j] = (char)values[j];
+          }
+        }
+        break;
+      default:
+        //the rest are single numbers
+        if (!readValues(entry, values) || values.isEmpty())
+        {
+          break;
+        }
+
+        switch (tag)
+        {
+          case TAG_NEW_SUBFILE_TYPE: subfileType = (int)values[0]; break;
+          case TAG_IMAGE_WIDTH: level.width = (int)values[0]; break;
+          case TAG_IMAGE_LENGTH: level.height = (int)values[0]; break;
+          case TAG_BITS_PER_SAMPLE: bitsPerSample = (int)values[0]; break;
+          case TAG_COMPRESSION: level.compression = (int)values[0]; break;
+          case TAG_PHOTOMETRIC: photometric = (int)values[0]; break;
+          case TAG_SAMPLES_PER_PIXEL: samplesPerPixel = (int)values[0]; break;
+          case TAG_ROWS_PER_STRIP: rowsPerStrip = (int)qMin(values[0], (qint64)0x7fffffff); break;
+          case TAG_PLANAR_CONFIGURATION: planarConfiguration = (int)values[0]; break;
+          case TAG_PREDICTOR: level.predictor = (int)values[0]; break;
+          case TAG_TILE_WIDTH: level.tileWidth = (int)values[0]; break;
+          case TAG_TILE_LENGTH: level.tileHeight = (int)values[0]; break;
+          case TAG_SAMPLE_FORMAT: sampleFormat = (int)values[0]; break;
+        }
+        break;
+    }
+  }
+
+  //masks are of no use to us
+  bool isFirst = mLevels.isEmpty();
+  if ((subfileType & 4) != 0)
+  {
+    return true;
+  }
+
+  if (!level.isTiled)
+  {
+    level.tileWidth = level.width;
+    level.tileHeight = (rowsPerStrip <= 0 || rowsPerStrip > level.height) ? level.height : rowsPerStrip;
+  }
+
+  bool isSupported = (level.width > 0 && level.height > 0 && level.tileWidth > 0 && level.tileHeight > 0 &&
+                      (bitsPerSample == 8 || bitsPerSample == 16 || bitsPerSample == 32 ||
+                       (bitsPerSample == 64 && sampleFormat == FORMAT_FLOAT)) &&
+                      samplesPerPixel >= 1 && (planarConfiguration == 1 || samplesPerPixel == 1) &&
+                      (level.compression == COMPRESSION_NONE || level.compression == COMPRESSION_LZW ||
+                       level.compression == COMPRESSION_DEFLATE || level.compression == COMPRESSION_ADOBE_DEFLATE ||
+                       (level.compression == COMPRESSION_JPEG && bitsPerSample == 8)));
+
+  if (isSupported)
+  {
+    level.tilesX = (level.width + level.tileWidth - 1) / level.tileWidth;
+    level.tilesY = (level.height + level.tileHeight - 1) / level.tileHeight;
+    isSupported = (level.offsets.size() >= level.tilesX * level.tilesY &&
+                   level.byteCounts.size() >= level.tilesX * level.tilesY);
+  }
+
+  if (!isFirst)
+  {
+    //overviews must be reduced resolution versions of the same samples
+    if (isSupported && (subfileType & 1) != 0 && bitsPerSample == mBitsPerSample &&
+        samplesPerPixel == mSamplesPerPixel && sampleFormat == mSampleFormat)
+    {
+      mLevels.append(level);
+    }
+    return true;
+  }
+
+  if (!isSupported)
+  {
+    return false;
+  }
+
+  mBitsPerSample = bitsPerSample;
+  mSamplesPerPixel = samplesPerPixel;
+  mSampleFormat = sampleFormat;
+  mPhotometric = photometric;
+
+  //pixel is area, so the tie point is the outer corner of the first pixel
+  if (transformation.size() >= 16 && transformation[1] == 0.0 && transformation[4] == 0.0)
+  {
+    mOrigin.longitude = transformation[3];
+    mOrigin.latitude = transformation[7];
+    mSampleSizeXDegrees = transformation[0];
+    mSampleSizeYDegrees = transformation[5];
+    mHasGeoreference = true;
+  }
+  else if (pixelScale.size() >= 2 && tiepoint.size() >= 6)
+  {
+    mSampleSizeXDegrees = pixelScale[0];
+    mSampleSizeYDegrees = -pixelScale[1];
+    mOrigin.longitude = tiepoint[3] - tiepoint[0] * mSampleSizeXDegrees;
+    mOrigin.latitude = tiepoint[4] - tiepoint[1] * mSampleSizeYDegrees;
+    mHasGeoreference = true;
+  }
+
+  //the rest of the elevation code works in decimal degrees, so projected (or
+  //geocentric) rasters would land in the wrong place
+  if (mHasGeoreference && !getIsGeographic(geoKeys))
+  {
+    printf("GeoTiffReader.cpp: Only geographic (latitude/longitude) GeoTIFFs are supported.\n");
+    mHasGeoreference = false;
+  }
+
+  //GDAL stores no data as text
+  bool isNumber = false;
+  mNoData = QString(noData).trimmed().toDouble(&isNumber);
+  mHasNoData = isNumber;
+
+  mLevels.append(level);
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads the integer values of a directory entry, wherever they are stored.
+ *
+ * @param entry Entry offset in bytes
+ * @param values Output values
+ * @return False if the entry is not of an integer type or points outside of
+ *         the file
+ */
+bool GeoTiffReader::readValues(qint64 entry, QVector<qint64>& values)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int type = (int)readUnsigned(entry + 2, 2);
+  int offsetSize = mIsBigTiff ? 8 : 4;
+  qint64 count = (qint64)readUnsigned(entry + 4, offsetSize);
+  int size = 0;
+
+  switch (type)
+  {
+    case 1: case 2: case 6: case 7: size = 1; break;//bytes, text and undefined
+    case 3: case 8: size = 2; break;//shorts
+    case 4: case 9: case 13: size = 4; break;//longs
+    case 16: case 17: case 18: size = 8; break;//BigTIFF longs
+    default: return false;
+  }
+
+  //small values are stored right in the entry
+  qint64 position = entry + 4 + offsetSize;
+  if (count * size > offsetSize)
+  {
+    position = (qint64)readUnsigned(position, offsetSize);
+  }
+
+  if (count < 0 || count > mFileSize || position < 0 || position + count * size > mFileSize)
+  {
+    return false;
+  }
+
+  values.resize((int)count);
+  for (int i = 0; i < (int)count; i++)
+  {
+    values[i] = (qint64)readUnsigned(position + (qint64)i * size, size);
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads the double values of a directory entry, used by the georeferencing
+ * tags.
+ *
+ * @param entry Entry offset in bytes
+ * @param values Output values
+ * @return False if the entry is not of double type or points outside of the
+ *         file
+ */
+bool GeoTiffReader::readDoubles(qint64 entry, QVector<double>& values)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int offsetSize = mIsBigTiff ? 8 : 4;
+  qint64 count = (qint64)readUnsigned(entry + 4, offsetSize);
+  if (readUnsigned(entry + 2, 2) != 12)
+  {
+    return false;
+  }
+
+  qint64 position = entry + 4 + offsetSize;
+  if (count * 8 > offsetSize)
+  {
+    position = (qint64)readUnsigned(position, offsetSize);
+  }
+
+  if (count < 0 || count > mFileSize || position < 0 || position + count * 8 > mFileSize)
+  {
+    return false;
+  }
+
+  values.resize((int)count);
+  for (int i = 0; i < (int)count; i++)
+  {
+    quint64 bits = readUnsigned(position + (qint64)i * 8, 8);
+    memcpy(&values[i], &bits, sizeof(double));
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads an unsigned number in the byte order of the file.
+ *
+ * @param offset Offset in bytes
+ * @param size Size of the number in bytes (1, 2, 4 or 8)
+ * @return The number
+ */
+quint64 GeoTiffReader::readUnsigned(qint64 offset, int size)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const uchar* bytes = mMappedFile + offset;
+  quint64 value = 0;
+
+  for (int i = 0; i < size; i++)
+  {
+    int shift = mIsBigEndian ? (size - 1 - i) * 8 : i * 8;
+    value |= (quint64)bytes[i] << shift;
+  }
+
+  return value;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Decompresses a tile (or strip) and undoes its predictor, leaving its samples
+ * in native byte order. Sparse tiles (no data written) come out as zeros.
+ *
+ * @param level Level the tile belongs to
+ * @param tileIndex Tile index, row by row
+ * @param tile Output samples, pixel by pixel and row by row
+ * @return True if the tile could be decoded
+ */
+bool GeoTiffReader::decodeTile(const Level& level, int tileIndex, QByteArray& tile)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int bytesPerSample = mBitsPerSample / 8;
+  int numberOfRows = getTileRows(level, tileIndex / level.tilesX);
+
+  //tile dimensions come from the file, a tile no part of the mapped file
+  //could decode to is broken (and would overflow the sizes below)
+  size_t tileSize = (size_t)level.tileWidth * (size_t)mSamplesPerPixel * (size_t)bytesPerSample * (size_t)numberOfRows;
+  if (tileSize > (size_t)0x7fffffff || tileSize > (size_t)mFileSize * (size_t)MAXIMUM_EXPANSION)
+  {
+    return false;
+  }
+
+  int valuesPerRow = level.tileWidth * mSamplesPerPixel;
+  int rowSize = valuesPerRow * bytesPerSample;
+  int size = (int)tileSize;
+  tile.resize(size);
+  uchar* output = (uchar*)tile.data();
+
+  qint64 offset = level.offsets[tileIndex];
+  qint64 byteCount = level.byteCounts[tileIndex];
+  if (offset == 0 || byteCount == 0)
+  {
+    memset(output, 0, size);
+    return true;
+  }
+  if (offset < 0 || byteCount < 0 || offset + byteCount > mFileSize ||
+      (qint64)size > byteCount * MAXIMUM_EXPANSION)
+  {
+    return false;
+  }
+
+  const uchar* input = mMappedFile + offset;
+  int decodedSize = 0;
+  if (level.compression == COMPRESSION_NONE)
+  {
+    decodedSize = (int)qMin((qint64)size, byteCount);
+    memcpy(output, input, decodedSize);
+  }
+  else if (level.compression == COMPRESSION_LZW)
+  {
+    decodedSize = decodeLzw(input, (int)byteCount, output, size);
+  }
+  else if (level.compression == COMPRESSION_DEFLATE || level.compression == COMPRESSION_ADOBE_DEFLATE)
+  {
+    //qUncompress takes zlib streams, prefixed by the (big endian) size to expect
+    QByteArray compressed;
+    compressed.reserve((int)byteCount + 4);
+    compressed.append((char)((size >> 24) & 0xff));
+    compressed.append((char)((size >> 16) & 0xff));
+    compressed.append((char)((size >> 8) & 0xff));
+    compressed.append((char)(size & 0xff));
+    compressed.append((const char*)input, (int)byteCount);
+
+    QByteArray decompressed = qUncompress(compressed);
+    decodedSize = qMin(size, decompressed.size());
+    memcpy(output, decompressed.constData(), decodedSize);
+  }
+  else
+  {
+    return false;
+  }
+
+  if (decodedSize <= 0)
+  {
+    return false;
+  }
+  memset(output + decodedSize, 0, size - decodedSize);
+
+  if (level.predictor == PREDICTOR_FLOATING_POINT)
+  {
+    //bytes of every row are differenced, then split in planes from the most
+    //significant byte down, no matter the byte order of the file
+    QVector<uchar> planes(rowSize);
+    for (int row = 0; row < numberOfRows; row++)
+    {
+      uchar* bytes = output + (size_t)row * rowSize;
+      for (int i = mSamplesPerPixel; i < rowSize; i++)
+      {
+        bytes[i] = (uchar)(bytes[i] + bytes[i - mSamplesPerPixel]);
+      }
+
+      memcpy(planes.data(), bytes, rowSize);
+      for (int i = 0; i < valuesPerRow; i++)
+      {
+        for (int byte = 0; byte < bytesPerSample; byte++)
+        {
+          int target = IS_HOST_BIG_ENDIAN ? byte : bytesPerSample - 1 - byte;
+          bytes[i * bytesPerSample + target] = planes[byte * valuesPerRow + i];
+        }
+      }
+    }
+
+    return true;
+  }
+
+  if (bytesPerSample > 1 && mIsBigEndian != IS_HOST_BIG_ENDIAN)
+  {
+    for (int i = 0; i < size; i += bytesPerSample)
+    {
+      for (int byte = 0; byte < bytesPerSample / 2; byte++)
+      {
+        uchar swap = output[i + byte];
+        output[i + byte] = output[i + bytesPerSample - 1 - byte];
+        output[i + bytesPerSample - 1 - byte] = swap;
+      }
+    }
+  }
+
+  //every value is the difference with the one to its left
+  if (level.predictor == PREDICTOR_HORIZONTAL)
+  {
+    for (int row = 0; row < numberOfRows; row++)
+    {
+      uchar* bytes = output + (size_t)row * rowSize;
+      for (int i = mSamplesPerPixel; i < valuesPerRow; i++)
+      {
+        if (bytesPerSample == 1)
+        {
+          bytes[i] = (uchar)(bytes[i] + bytes[i - mSamplesPerPixel]);
+        }
+        else if (bytesPerSample == 2)
+        {
+          quint16* values = (quint16*)bytes;
+          values[i] = (quint16)(values[i] + values[i - mSamplesPerPixel]);
+        }
+        else if (bytesPerSample == 4)
+        {
+          quint32* values = (quint32*)bytes;
+          values[i] = values[i] + values[i - mSamplesPerPixel];
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Decodes a JPEG compressed tile with Qt. Files written by GDAL keep the JPEG
+ * tables once per directory, so they are put back in front of the tile data.
+ *
+ * @param level Level the tile belongs to
+ * @param tileIndex Tile index, row by row
+ * @return The tile as an ARGB image, a null image if it could not be decoded
+ */
+QImage GeoTiffReader::decodeJpegTile(const Level& level, int tileIndex)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  qint64 offset = level.offsets[tileIndex];
+  qint64 byteCount = level.byteCounts[tileIndex];
+  if (offset <= 0 || byteCount <= 2 || offset + byteCount > mFileSize)
+  {
+    QImage empty(level.tileWidth, level.tileHeight, QImage::Format_ARGB32);
+    empty.fill(0);
+    return empty;
+  }
+
+  //tables end with an end of image marker and the tile starts with a start
+  //of image marker, both go away when merging them
+  QByteArray jpeg;
+  if (level.jpegTables.size() > 4)
+  {
+    jpeg = level.jpegTables.left(level.jpegTables.size() - 2);
+    jpeg.append((const char*)mMappedFile + offset + 2, (int)byteCount - 2);
+  }
+  else
+  {
+    jpeg = QByteArray((const char*)mMappedFile + offset, (int)byteCount);
+  }
+
+  QImage image;
+  if (!image.loadFromData(jpeg, "JPEG"))
+  {
+    printf("GeoTiffReader.cpp: Error decoding JPEG tile of %s.\n", mFile.fileName().toStdString().c_str());
+    return QImage();
+  }
+
+  return image.convertToFormat(QImage::Format_ARGB32);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Converts the first band of a block of decoded tile samples to floats.
+ *
+ * @param tile Decoded tile samples
+ * @param tileWidth Tile width in pixels
+ * @param fromX Block left column in the tile
+ * @param fromY Block top row in the tile
+ * @param width Block width
+ * @param height Block height
+ * @param samples Output for the top left sample of the block
+ * @param stride Number of samples between output rows
+ */
+void GeoTiffReader::copyTileSamples(const uchar* tile, int tileWidth, int fromX, int fromY,
+                                    int width, int height, float* samples, int stride)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int bytesPerSample = mBitsPerSample / 8;
+  int pixelSize = bytesPerSample * mSamplesPerPixel;
+  int type = mSampleFormat * 100 + mBitsPerSample;
+  float noData = (float)mNoData;
+
+  for (int row = 0; row < height; row++)
+  {
+    const uchar* source = tile + ((size_t)(fromY + row) * tileWidth + fromX) * pixelSize;
+    float* destination = samples + (size_t)row * stride;
+
+    for (int column = 0; column < width; column++)
+    {
+      float value = 0.0f;
+      switch (type)
+      {
+        case FORMAT_UNSIGNED * 100 + 8: value = *source; break;
+        case FORMAT_SIGNED * 100 + 8: value = *(const qint8*)source; break;
+        case FORMAT_UNSIGNED * 100 + 16: { quint16 v; memcpy(&v, source, 2); value = v; break; }
+        case FORMAT_SIGNED * 100 + 16: { qint16 v; memcpy(&v, source, 2); value = v; break; }
+        case FORMAT_UNSIGNED * 100 + 32: { quint32 v; memcpy(&v, source, 4); value = (float)v; break; }
+        case FORMAT_SIGNED * 100 + 32: { qint32 v; memcpy(&v, source, 4); value = (float)v; break; }
+        case FORMAT_FLOAT * 100 + 32: memcpy(&value, source, 4); break;
+        case FORMAT_FLOAT * 100 + 64: { double v; memcpy(&v, source, 8); value = (float)v; break; }
+      }
+
+      //no data (including NaN) is sea level
+      if ((mHasNoData && value == noData) || value != value)
+      {
+        value = 0.0f;
+      }
+
+      destination[column] = value;
+      source += pixelSize;
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of rows in the given row of tiles. Tiles are always
+ * full size, while the last strip of a stripped image stops at the last row.
+ *
+ * @param level Level
+ * @param tileRow Row of tiles
+ * @return Number of rows
+ */
+int GeoTiffReader::getTileRows(const Level& level, int tileRow)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (level.isTiled)
+  {
+    return level.tileHeight;
+  }
+
+  return qMin(level.tileHeight, level.height - tileRow * level.tileHeight);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the given GeoKey directory describes a geographic raster,
+ * i.e. one whose georeference is in degrees of latitude and longitude. Files
+ * with no GeoKey directory, or with no model type in it, are taken to be
+ * geographic unless they name a projected coordinate system.
+ *
+ * @param geoKeys Values of the GeoKeyDirectory tag: a 4 value header, then 4
+ *        values (id, location, count, value) per key
+ * @return False if the raster is projected, geocentric or not in degrees
+ */
+bool GeoTiffReader::getIsGeographic(const QVector<qint64>& geoKeys)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int modelType = 0;
+  int geographicType = 0;
+  int angularUnits = 0;
+  int projectedType = 0;
+
+  for (int i = 4; i + 3 < geoKeys.size(); i += 4)
+  {
+    //the keys we look at are single shorts stored right in the directory
+    if (geoKeys[i + 1] != 0)
+    {
+      continue;
+    }
+
+    switch ((int)geoKeys[i])
+    {
+      case KEY_MODEL_TYPE: modelType = (int)geoKeys[i + 3]; break;
+      case KEY_GEOGRAPHIC_TYPE: geographicType = (int)geoKeys[i + 3]; break;
+      case KEY_GEOGRAPHIC_ANGULAR_UNITS: angularUnits = (int)geoKeys[i + 3]; break;
+      case KEY_PROJECTED_TYPE: projectedType = (int)geoKeys[i + 3]; break;
+    }
+  }
+
+  if (modelType != 0 && modelType != MODEL_TYPE_GEOGRAPHIC)
+  {
+    return false;
+  }
+  if (modelType == 0 && projectedType != 0)
+  {
+    return false;
+  }
+
+  //EPSG geographic coordinate systems are numbered 4000 to 4999
+  if (geographicType != 0 && geographicType != USER_DEFINED &&
+      (geographicType < 4000 || geographicType > 4999))
+  {
+    return false;
+  }
+
+  return (angularUnits == 0 || angularUnits == ANGULAR_UNIT_DEGREE);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * TIFF flavored LZW decoder: codes are written most significant bit first and
+ * grow one bit early, right before the table fills up.
+ *
+ * @param input Compressed data
+ * @param inputSize Compressed size in bytes
+ * @param output Output buffer
+ * @param outputSize Output buffer size in bytes
+ * @return Number of bytes decoded, -1 if the data is corrupt
+ */
+int GeoTiffReader::decodeLzw(const uchar* input, int inputSize, uchar* output, int outputSize)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const int CLEAR_CODE = 256;
+  const int END_CODE = 257;
+  const int FIRST_CODE = 258;
+  const int MAXIMUM_CODES = 4096;
+
+  //strings are kept as a prefix code plus a last byte
+  QVector<int> prefixes(MAXIMUM_CODES);
+  QVector<uchar> suffixes(MAXIMUM_CODES);
+  QVector<uchar> firstBytes(MAXIMUM_CODES);
+  QVector<int> lengths(MAXIMUM_CODES);
+  for (int code = 0; code < 256; code++)
+  {
+    prefixes[code] = -1;
+    suffixes[code] = (uchar)code;
+    firstBytes[code] = (uchar)code;
+    lengths[code] = 1;
+  }
+
+  int nextCode = FIRST_CODE;
+  int codeWidth = 9;
+  int previousCode = -1;
+  quint32 bitBuffer = 0;
+  int numberOfBits = 0;
+  int inputPosition = 0;
+  int outputPosition = 0;
+
+  while (outputPosition < outputSize)
+  {
+    while (numberOfBits < codeWidth)
+    {
+      if (inputPosition >= inputSize)
+      {
+        return outputPosition;
+      }
+      bitBuffer = (bitBuffer << 8) | input[inputPosition++];
+      numberOfBits += 8;
+    }
+
+    int code = (int)((bitBuffer >> (numberOfBits - codeWidth)) & ((1u << codeWidth) - 1));
+    numberOfBits -= codeWidth;
+
+    if (code == END_CODE)
+    {
+      break;
+    }
+
+    if (code == CLEAR_CODE)
+    {
+      nextCode = FIRST_CODE;
+      codeWidth = 9;
+      previousCode = -1;
+      continue;
+    }
+
+    if (previousCode < 0)
+    {
+      if (code > 255)
+      {
+        return -1;
+      }
+      output[outputPosition++] = (uchar)code;
+      previousCode = code;
+      continue;
+    }
+
+    if (code > nextCode || (code == nextCode && nextCode >= MAXIMUM_CODES))
+    {
+      return -1;
+    }
+
+    //new string is the previous one plus the first byte of this one, which
+    //is also the case when this code is the one being added
+    if (nextCode < MAXIMUM_CODES)
+    {
+      prefixes[nextCode] = previousCode;
+      suffixes[nextCode] = firstBytes[code == nextCode ? previousCode : code];
+      firstBytes[nextCode] = firstBytes[previousCode];
+      lengths[nextCode] = lengths[previousCode] + 1;
+      nextCode++;
+    }
+
+    //strings are written back to front
+    int length = lengths[code];
+    int position = outputPosition + length - 1;
+    for (int stringCode = code; stringCode >= 0; stringCode = prefixes[stringCode])
+    {
+      if (position < outputSize)
+      {
+        output[position] = suffixes[stringCode];
+      }
+      position--;
+    }
+    outputPosition = qMin(outputPosition + length, outputSize);
+    previousCode = code;
+
+    if (nextCode + 1 >= (1 << codeWidth) && codeWidth < 12)
+    {
+      codeWidth++;
+    }
+  }
+
+  return outputPosition;
+}
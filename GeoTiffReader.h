@@ -0,0 +1,134 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#ifndef GEOTIFF_READER_H
+#define GEOTIFF_READER_H
+
+#include <QString>
+#include <QFile>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <QImage>
+#include "globals.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Built-in reader for tiled (and stripped) GeoTIFF files, Cloud Optimized
+ * GeoTIFFs in particular, so that elevation databases and imagery can be read
+ * without GDAL. The file is memory mapped and open only parses the image file
+ * directories: the full resolution image and its overviews become levels, the
+ * finest one first. Windowed reads then decode just the internal tiles that
+ * intersect the window, so the OS only pages in those.
+ *
+ * Classic TIFF and BigTIFF in either byte order are supported, with no
+ * compression, LZW, DEFLATE (through qUncompress) or JPEG (through QImage,
+ * 8 bit images only), and with horizontal or floating point predictors.
+ * Georeferencing is read from the ModelPixelScale/ModelTiepoint or
+ * ModelTransformation tags and must be in decimal degrees, like the rest of
+ * the elevation code: files whose GeoKeys describe a projected coordinate
+ * system are reported as not georeferenced.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class GeoTiffReader
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    /**
+     * One image file directory, strips are read as tiles as wide as the image.
+     */
+    struct Level
+    {
+      int width;
+      int height;
+      int tileWidth;
+      int tileHeight;
+      int tilesX;
+      int tilesY;
+      bool isTiled;
+      int compression;
+      int predictor;
+      QVector<qint64> offsets;
+      QVector<qint64> byteCounts;
+      QByteArray jpegTables;
+    };
+
+    GeoTiffReader();
+    ~GeoTiffReader();
+
+    bool open(const QString& filePath);
+    void close();
+    bool getIsOpen();
+    int getNumberOfLevels();
+    int getWidth(int level = 0);
+    int getHeight(int level = 0);
+    int getTileHeight(int level = 0);
+    int findLevel(int maximumWidth, int maximumHeight);
+    bool getIsElevation();
+    bool getIsImage();
+    bool getHasGeoreference();
+    GeodeticPosition getOrigin();
+    double getSampleSizeXDegrees();
+    double getSampleSizeYDegrees();
+    bool readSamples(int level, int x, int y, int width, int height, float* samples);
+    QImage readImage(int level, int x, int y, int width, int height);
+
+    static bool isTiffFile(const QString& filePath);
+
+  private:
+    bool readDirectory(qint64 offset, qint64& nextOffset);
+    bool readValues(qint64 entry, QVector<qint64>& values);
+    bool readDoubles(qint64 entry, QVector<double>& values);
+    quint64 readUnsigned(qint64 offset, int size);
+    bool decodeTile(const Level& level, int tileIndex, QByteArray& tile);
+    QImage decodeJpegTile(const Level& level, int tileIndex);
+    void copyTileSamples(const uchar* tile, int tileWidth, int fromX, int fromY,
+                         int width, int height, float* samples, int stride);
+    int getTileRows(const Level& level, int tileRow);
+
+    static bool getIsGeographic(const QVector<qint64>& geoKeys);
+    static int decodeLzw(const uchar* input, int inputSize, uchar* output, int outputSize);
+
+    QFile mFile;
+    const uchar* mMappedFile;
+    qint64 mFileSize;
+    bool mIsBigEndian;
+    bool mIsBigTiff;
+    QList<Level> mLevels;
+    int mBitsPerSample;
+    int mSamplesPerPixel;
+    int mSampleFormat;
+    int mPhotometric;
+    bool mHasGeoreference;
+    GeodeticPosition mOrigin;
+    double mSampleSizeXDegrees;
+    double mSampleSizeYDegrees;
+    bool mHasNoData;
+    double mNoData;
+};
+
+#endif//GEOTIFF_READER_H
@@ -0,0 +1,293 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QPainter>
+#include <QFontMetrics>
+#include <QtOpenGL>
+#include <math.h>
+#include "GlyphAtlas.h"
+
+GlyphAtlas* GlyphAtlas::mInstance = NULL;//Singleton implementation
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Sets up the font glyphs get rasterized with.
+ */
+GlyphAtlas::GlyphAtlas()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mFont = QFont("Arial");
+  mFont.setPixelSize(GLYPH_PIXEL_SIZE * SDF_SCALE);
+
+  //leave room for the distance field above the tallest glyph
+  QFontMetrics fontMetrics(mFont);
+  mAscent = (float)fontMetrics.ascent() / SDF_SCALE;
+  mDescent = (float)fontMetrics.descent() / SDF_SCALE;
+  mBaseline = SDF_SPREAD + mAscent;
+
+  mNumberOfCells = 0;
+  mTexture = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+GlyphAtlas::~GlyphAtlas()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mInstance = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton pattern implementation. Returns the single instance of this class.
+ *
+ * @return The single instance of this class
+ */
+GlyphAtlas* GlyphAtlas::getInstance()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mInstance == NULL)
+  {
+    mInstance = new GlyphAtlas();
+  }
+
+  return mInstance;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Lays out the given text on a single line. Quads are relative to the start
+ * of the text on the baseline, with Y going up. Glyphs are never moved within
+ * the atlas, so a run stays valid for as long as its text does not change.
+ *
+ * @param text Text to lay out
+ * @param pixelSize Font size in pixels
+ * @param run Returns the glyph quads and the extent of the text
+ */
+void GlyphAtlas::layoutText(const QString& text, float pixelSize, GlyphRun& run)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  float scale = pixelSize / GLYPH_PIXEL_SIZE;
+  float top = mBaseline * scale;
+  float bottom = (mBaseline - GLYPH_CELL_SIZE) * scale;
+  float penX = 0.0f;
+
+  run.quads.resize(0);
+  for (int i = 0; i < text.length(); i++)
+  {
+    const Glyph& glyph = getGlyph(text[i]);
+    if (glyph.hasQuad)
+    {
+      //quads cover the whole cell, the outline sits SDF_SPREAD pixels in
+      float left = penX - SDF_SPREAD * scale;
+      run.quads.append(left);
+      run.quads.append(bottom);
+      run.quads.append(left + GLYPH_CELL_SIZE * scale);
+      run.quads.append(top);
+      for (int j = 0; j < 4; j++)
+      {
+        run.quads.append(glyph.region[j]);
+      }
+    }
+    penX += glyph.advance * scale;
+  }
+  run.width = penX;
+  run.ascent = mAscent * scale;
+  run.descent = mDescent * scale;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * WARNING: This method is supposed to get called from within OpenGL context.
+ * Returns the OpenGL texture of the glyph atlas, alpha only. Glyphs added
+ * since the last call get uploaded into their cells first.
+ *
+ * @return OpenGL handle to atlas texture
+ */
+unsigned int GlyphAtlas::getTexture()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mTexture == 0)
+  {
+    QByteArray emptyAtlas(ATLAS_SIZE * ATLAS_SIZE, 0);
+    glGenTextures(1, &mTexture);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ATLAS_SIZE, ATLAS_SIZE,
+                 0, GL_ALPHA, GL_UNSIGNED_BYTE, emptyAtlas.constData());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    //distance fields rely on linear filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+
+  if (!mPendingCells.isEmpty())
+  {
+    const int cellsPerRow = ATLAS_SIZE / GLYPH_CELL_SIZE;
+
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < mPendingCells.size(); i++)
+    {
+      int x = (mPendingCells[i] % cellsPerRow) * GLYPH_CELL_SIZE;
+      int y = ATLAS_SIZE - (mPendingCells[i] / cellsPerRow + 1) * GLYPH_CELL_SIZE;
+      glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, GLYPH_CELL_SIZE, GLYPH_CELL_SIZE,
+                      GL_ALPHA, GL_UNSIGNED_BYTE, mPendingDistanceFields[i].constData());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    mPendingCells.clear();
+    mPendingDistanceFields.clear();
+  }
+
+  return mTexture;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the glyph of the given character, rasterizing it into the next free
+ * atlas cell the first time. Cells are filled row by row from the top left
+ * corner, like the icon atlas in IconModelManager.
+ *
+ * @param character Character to look up
+ * @return Glyph of the character
+ */
+const GlyphAtlas::Glyph& GlyphAtlas::getGlyph(QChar character)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QHash<ushort, Glyph>::const_iterator iterator = mGlyphs.constFind(character.unicode());
+  if (iterator != mGlyphs.constEnd())
+  {
+    return iterator.value();
+  }
+
+  QFontMetrics fontMetrics(mFont);
+  Glyph glyph;
+  glyph.advance = (float)fontMetrics.width(character) / SDF_SCALE;
+  glyph.hasQuad = false;
+
+  const int cellsPerRow = ATLAS_SIZE / GLYPH_CELL_SIZE;
+  if (character.isSpace())
+  {
+    //nothing to draw
+  }
+  else if (mNumberOfCells == cellsPerRow * cellsPerRow)
+  {
+    printf("GlyphAtlas.cpp: Glyph atlas is full, cannot add character %d.\n", character.unicode());
+  }
+  else
+  {
+    int cell = mNumberOfCells++;
+    QByteArray distanceField(GLYPH_CELL_SIZE * GLYPH_CELL_SIZE, 0);
+    createDistanceField(character, (unsigned char*)distanceField.data());
+    mPendingCells.append(cell);
+    mPendingDistanceFields.append(distanceField);
+
+    //the texture is flipped vertically relative to the cell layout
+    int x = (cell % cellsPerRow) * GLYPH_CELL_SIZE;
+    int y = (cell / cellsPerRow) * GLYPH_CELL_SIZE;
+    glyph.region[0] = (float)x / ATLAS_SIZE;
+    glyph.region[1] = 1.0f - (float)(y + GLYPH_CELL_SIZE) / ATLAS_SIZE;
+    glyph.region[2] = (float)(x + GLYPH_CELL_SIZE) / ATLAS_SIZE;
+    glyph.region[3] = 1.0f - (float)y / ATLAS_SIZE;
+    glyph.hasQuad = true;
+  }
+
+  return mGlyphs.insert(character.unicode(), glyph).value();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Rasterizes the given character at SDF_SCALE times the cell resolution and
+ * computes the signed distance field of its outline for one cell. Every cell
+ * pixel searches the oversampled image for the nearest pixel on the other side
+ * of the outline, up to SDF_SPREAD cell pixels away.
+ *
+ * @param character Character to rasterize
+ * @param distanceField Returns GLYPH_CELL_SIZE rows of GLYPH_CELL_SIZE values, bottom row first
+ */
+void GlyphAtlas::createDistanceField(QChar character, unsigned char* distanceField)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const int imageSize = GLYPH_CELL_SIZE * SDF_SCALE;
+  const int searchRadius = SDF_SPREAD * SDF_SCALE;
+
+  QImage image(imageSize, imageSize, QImage::Format_ARGB32);
+  image.fill(0);
+  QPainter painter(&image);
+  painter.setFont(mFont);
+  painter.setPen(Qt::white);
+  painter.drawText(QPointF(SDF_SPREAD * SDF_SCALE, mBaseline * SDF_SCALE), QString(character));
+  painter.end();
+
+  QVector<bool> inside(imageSize * imageSize);
+  for (int y = 0; y < imageSize; y++)
+  {
+    const QRgb* line = (const QRgb*)image.constScanLine(y);
+    for (int x = 0; x < imageSize; x++)
+    {
+      inside[y * imageSize + x] = (qAlpha(line[x]) > 127);
+    }
+  }
+
+  for (int cellY = 0; cellY < GLYPH_CELL_SIZE; cellY++)
+  {
+    for (int cellX = 0; cellX < GLYPH_CELL_SIZE; cellX++)
+    {
+      int centerX = cellX * SDF_SCALE + SDF_SCALE / 2;
+      int centerY = cellY * SDF_SCALE + SDF_SCALE / 2;
+      bool isInside = inside[centerY * imageSize + centerX];
+
+      int minimumDistance = searchRadius * searchRadius;
+      for (int y = qMax(0, centerY - searchRadius); y <= qMin(imageSize - 1, centerY + searchRadius); y++)
+      {
+        int dy2 = (y - centerY) * (y - centerY);
+        if (dy2 >= minimumDistance)
+        {
+          continue;
+        }
+        for (int x = qMax(0, centerX - searchRadius); x <= qMin(imageSize - 1, centerX + searchRadius); x++)
+        {
+          int distance = (x - centerX) * (x - centerX) + dy2;
+          if (distance < minimumDistance && inside[y * imageSize + x] != isInside)
+          {
+            minimumDistance = distance;
+          }
+        }
+      }
+
+      //map [-searchRadius, searchRadius] to [0, 255] with the outline at 0.5
+      float signedDistance = sqrt((float)minimumDistance) / searchRadius;
+      if (!isInside)
+      {
+        signedDistance = -signedDistance;
+      }
+      int value = (int)((0.5f + 0.5f * signedDistance) * 255.0f + 0.5f);
+      distanceField[(GLYPH_CELL_SIZE - 1 - cellY) * GLYPH_CELL_SIZE + cellX] = (unsigned char)qBound(0, value, 255);
+    }
+  }
+}
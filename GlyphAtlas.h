@@ -0,0 +1,97 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <QFont>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton class that keeps the glyphs used for label text in one OpenGL
+ * texture. Every glyph is rasterized once, the first time it shows up in a
+ * text, and stored as a signed distance field: each texel holds the distance
+ * to the glyph outline (0.5 on the outline, above inside the glyph). Drawn
+ * with linear filtering and an alpha test at 0.5, the outline stays sharp at
+ * any text size, so one set of glyphs serves every label size. Texts get laid
+ * out into glyph runs that can be kept as long as the text does not change
+ * and added to a SpriteBatch every frame. This class is supposed to be used
+ * from within the OpenGL thread.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class GlyphAtlas
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int ATLAS_SIZE = 1024;//in pixels
+    static const int GLYPH_CELL_SIZE = 32;//in pixels
+    static const int GLYPH_PIXEL_SIZE = 20;//font size glyphs are rasterized at
+    static const int SDF_SPREAD = 4;//largest distance stored, in cell pixels
+    static const int SDF_SCALE = 4;//oversampling of the glyph outline
+
+    struct Glyph
+    {
+      float region[4];//texture coordinates as left, bottom, right, top
+      float advance;//in pixels at GLYPH_PIXEL_SIZE
+      bool hasQuad;//false for blanks and glyphs not fitting in the atlas
+    };
+
+    struct GlyphRun
+    {
+      QVector<float> quads;//left, bottom, right, top and region of every glyph
+      float width;//in pixels
+      float ascent;//above the baseline, in pixels
+      float descent;//below the baseline, in pixels
+    };
+
+    static GlyphAtlas* getInstance();
+    ~GlyphAtlas();
+
+    void layoutText(const QString& text, float pixelSize, GlyphRun& run);
+    unsigned int getTexture();
+
+  private:
+    GlyphAtlas();//private due to Singleton implementation
+    const Glyph& getGlyph(QChar character);
+    void createDistanceField(QChar character, unsigned char* distanceField);
+
+    static GlyphAtlas* mInstance;
+    QFont mFont;
+    float mBaseline;//from the top of a cell, in cell pixels
+    float mAscent;//in cell pixels
+    float mDescent;//in cell pixels
+    QHash<ushort, Glyph> mGlyphs;
+    int mNumberOfCells;
+
+    //glyphs rasterized since the last upload
+    QList<int> mPendingCells;
+    QList<QByteArray> mPendingDistanceFields;
+    unsigned int mTexture;
+};
+
+#endif//GLYPH_ATLAS_H
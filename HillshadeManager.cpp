@@ -0,0 +1,563 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <QtOpenGL>
+#include <QDir>
+#include <QFile>
+#include "HillshadeManager.h"
+#include "HillshadeThread.h"
+#include "ElevationManager.h"
+#include "Utilities.h"
+#include "Constants.h"
+#include "math.h"
+
+//texture combiner tokens from OpenGL 1.3, missing from some gl.h headers
+#ifndef GL_COMBINE
+#define GL_COMBINE 0x8570
+#define GL_COMBINE_RGB 0x8571
+#define GL_CONSTANT 0x8576
+#define GL_SOURCE0_RGB 0x8580
+#define GL_SOURCE1_RGB 0x8581
+#define GL_OPERAND0_RGB 0x8590
+#define GL_OPERAND1_RGB 0x8591
+#endif
+#ifndef GL_DOT3_RGB
+#define GL_DOT3_RGB 0x86AE
+#endif
+
+HillshadeManager* HillshadeManager::mInstance = NULL;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes, the sun comes from the north west like
+ * in most shaded relief maps.
+ */
+HillshadeManager::HillshadeManager()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mCacheDirectory = "hillshade";
+  mIsEnabled = false;
+  mIsStopping.fetchAndStoreOrdered(0);
+  mSunAzimuth = 315.0;
+  mSunElevation = 45.0;
+  mFrame = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. Stops the hillshade threads and releases all tiles.
+ */
+HillshadeManager::~HillshadeManager()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  setEnabled(false);
+
+  QHash<QString, Tile*>::iterator i;
+  for (i = mTiles.begin(); i != mTiles.end(); ++i)
+  {
+    delete i.value();
+  }
+  mTiles.clear();
+
+  mInstance = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the singleton instance of this class.
+ *
+ * @return Singleton instance of this class
+ */
+HillshadeManager* HillshadeManager::getInstance()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mInstance == 0)
+  {
+    mInstance = new HillshadeManager();
+  }
+
+  return mInstance;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Enables or disables hillshading. Enabling creates the cache directory and
+ * starts the pool of hillshade threads, disabling stops them (waiting for the
+ * tiles being computed) but keeps the computed tiles around.
+ *
+ * @param value True to enable hillshading
+ */
+void HillshadeManager::setEnabled(bool value)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (value == mIsEnabled)
+  {
+    return;
+  }
+
+  if (value)
+  {
+    if (!QDir().mkpath(mCacheDirectory))
+    {
+      printf("HillshadeManager.cpp: Error creating cache directory, tiles will not be cached.\n");
+    }
+
+    mIsStopping.fetchAndStoreOrdered(0);
+
+    //leave a core for the GUI thread
+    int numberOfThreads = qMax(1, QThread::idealThreadCount() - 1);
+    for (int i = 0; i < numberOfThreads; i++)
+    {
+      HillshadeThread* thread = new HillshadeThread();
+      mThreads.append(thread);
+      thread->start();
+    }
+  }
+  else
+  {
+    mMutex.lock();
+    mRequests.clear();
+    mIsStopping.fetchAndStoreOrdered(1);
+    mMutex.unlock();
+
+    for (int i = 0; i < mThreads.size(); i++)
+    {
+      mThreads[i]->wait();
+      delete mThreads[i];
+    }
+    mThreads.clear();
+  }
+
+  mIsEnabled = value;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if hillshading is enabled.
+ *
+ * @return True if hillshading is enabled
+ */
+bool HillshadeManager::getIsEnabled()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mIsEnabled;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the directory where normal maps are cached. It only applies to tiles
+ * requested from then on, so it should be set before enabling hillshading.
+ *
+ * @param directoryPath Cache directory path
+ */
+void HillshadeManager::setCacheDirectory(const QString& directoryPath)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mCacheDirectory = directoryPath;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the directory where normal maps are cached.
+ *
+ * @return Cache directory path
+ */
+const QString& HillshadeManager::getCacheDirectory()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mCacheDirectory;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the direction the sun light comes from. Takes effect on the next frame
+ * without computing anything again.
+ *
+ * @param degrees Sun azimuth in decimal degrees, clockwise from north
+ */
+void HillshadeManager::setSunAzimuth(double degrees)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mSunAzimuth = degrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the direction the sun light comes from.
+ *
+ * @return Sun azimuth in decimal degrees, clockwise from north
+ */
+double HillshadeManager::getSunAzimuth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSunAzimuth;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the sun elevation above the horizon. From 30 degrees up flat ground
+ * keeps the imagery colors, lower suns darken it.
+ *
+ * @param degrees Sun elevation in decimal degrees
+ */
+void HillshadeManager::setSunElevation(double degrees)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mSunElevation = qBound(1.0, degrees, 90.0);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the sun elevation above the horizon.
+ *
+ * @return Sun elevation in decimal degrees
+ */
+double HillshadeManager::getSunElevation()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSunElevation;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts a new frame. Tiles requested in previous frames that did not get
+ * requested again are dropped from the request list, and the least recently
+ * used tiles are evicted.
+ * WARNING: This method is supposed to get called from the OpenGL (GUI) thread.
+ */
+void HillshadeManager::startFrame()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  mFrame++;
+  mRequests.clear();
+  evictTiles();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the normal map texture of the imagery tile with the given bounds.
+ * Tiles not computed yet get requested and return 0 until a hillshade thread
+ * is done with them.
+ * WARNING: This method creates textures, so it is supposed to get called from
+ * the OpenGL (GUI) thread.
+ *
+ * @param southWest Tile southwest geodetic position
+ * @param northEast Tile northeast geodetic position
+ * @return OpenGL handle to the normal map texture, 0 if it is not ready yet
+ */
+unsigned int HillshadeManager::getTexture(const GeodeticPosition& southWest, const GeodeticPosition& northEast)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QString key = getTileKey(southWest, northEast);
+
+  mMutex.lock();
+  Tile* tile = mTiles.value(key, NULL);
+  if (tile == NULL)
+  {
+    tile = new Tile();
+    tile->southWest = southWest;
+    tile->northEast = northEast;
+    tile->state = PENDING;
+    tile->lastUsed = 0;
+    tile->cacheFilePath = mCacheDirectory + "/" + key + ".png";
+    tile->isCached = QFile::exists(tile->cacheFilePath);
+    tile->texture = 0;
+    mTiles.insert(key, tile);
+  }
+
+  //tiles are only handed out once the elevations under them (and the extra
+  //half texel generateTile samples all around) are loaded, so hillshade
+  //threads never wait on ElevationManager
+  if (tile->state == PENDING && tile->lastUsed != mFrame)
+  {
+    double latitudeMargin = 0.5 * (northEast.latitude - southWest.latitude) / (double)NORMAL_MAP_SIZE;
+    double longitudeMargin = 0.5 * (northEast.longitude - southWest.longitude) / (double)NORMAL_MAP_SIZE;
+    if (tile->isCached ||
+        ElevationManager::getInstance()->startLoadingRegion(southWest.latitude - latitudeMargin,
+                                                            southWest.longitude - longitudeMargin,
+                                                            northEast.latitude + latitudeMargin,
+                                                            northEast.longitude + longitudeMargin))
+    {
+      mRequests.append(tile);
+    }
+  }
+  tile->lastUsed = mFrame;
+  TileState state = tile->state;
+  mMutex.unlock();
+
+  if (state != READY)
+  {
+    return 0;
+  }
+
+  //ready tiles are left alone by the hillshade threads
+  if (tile->texture == 0)
+  {
+    tile->texture = Utilities::imageToTexture(tile->normalMap);
+    tile->normalMap = QImage();
+  }
+
+  return tile->texture;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets up OpenGL to shade whatever gets drawn next with the bound normal map.
+ * The texture combiner takes the dot product of every normal with the sun
+ * direction, which is then multiplied (twice) by the imagery already in the
+ * frame buffer. The sun vector is scaled so that flat ground comes out at one
+ * half and keeps its colors. Drawing has to match the imagery depth, so
+ * elevation mode is assumed.
+ */
+void HillshadeManager::beginShading()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double azimuth = mSunAzimuth * Constants::DEGREES_TO_RADIANS;
+  double elevation = mSunElevation * Constants::DEGREES_TO_RADIANS;
+  double scale = qMin(1.0, 0.5 / sin(elevation));
+
+  //east, north and up, packed into colors like the normals
+  GLfloat sun[4];
+  sun[0] = (GLfloat)(0.5 + 0.5 * scale * sin(azimuth) * cos(elevation));
+  sun[1] = (GLfloat)(0.5 + 0.5 * scale * cos(azimuth) * cos(elevation));
+  sun[2] = (GLfloat)(0.5 + 0.5 * scale * sin(elevation));
+  sun[3] = 1.0f;
+
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+  glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_DOT3_RGB);
+  glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_TEXTURE);
+  glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+  glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_CONSTANT);
+  glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_COLOR);
+  glTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, sun);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_DST_COLOR, GL_SRC_COLOR);
+  glDepthFunc(GL_LEQUAL);
+  glDepthMask(GL_FALSE);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Restores the OpenGL state changed by beginShading.
+ */
+void HillshadeManager::endShading()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+  glDisable(GL_BLEND);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by hillshade threads. Returns true once the threads have been asked
+ * to stop.
+ *
+ * @return True if hillshade threads should stop
+ */
+bool HillshadeManager::getIsStopping()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mIsStopping.fetchAndAddOrdered(0) != 0);//atomic read
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by hillshade threads. Takes the next requested tile and marks it as
+ * busy. This method is thread-safe.
+ *
+ * @return Tile to compute, NULL if no tiles are requested
+ */
+HillshadeManager::Tile* HillshadeManager::takeRequest()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  if (mRequests.isEmpty())
+  {
+    return NULL;
+  }
+
+  Tile* tile = mRequests.takeFirst();
+  tile->state = BUSY;
+
+  return tile;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by hillshade threads. Reads the normal map of the given (busy) tile
+ * from the cache directory, or computes it and writes it there. Normals are
+ * taken at the texel centers from central differences, so the elevations are
+ * sampled in a single batch with an extra sample all around the tile.
+ *
+ * @param tile Tile to compute, taken with takeRequest
+ * @param latitudes Scratch buffer for sample latitudes
+ * @param longitudes Scratch buffer for sample longitudes
+ * @param elevations Scratch buffer for sample elevations
+ */
+void HillshadeManager::generateTile(Tile* tile, QVector<double>& latitudes, QVector<double>& longitudes,
+                                    QVector<float>& elevations)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QImage normalMap;
+  if (normalMap.load(tile->cacheFilePath) &&
+      normalMap.width() == NORMAL_MAP_SIZE && normalMap.height() == NORMAL_MAP_SIZE)
+  {
+    tile->normalMap = normalMap;
+    return;
+  }
+
+  int size = NORMAL_MAP_SIZE + 2;
+  double north = tile->northEast.latitude;
+  double west = tile->southWest.longitude;
+  double latitudeStep = (north - tile->southWest.latitude) / (double)NORMAL_MAP_SIZE;
+  double longitudeStep = (tile->northEast.longitude - west) / (double)NORMAL_MAP_SIZE;
+
+  //rows go south like image rows, sample 1,1 is the center of texel 0,0
+  latitudes.resize(size * size);
+  longitudes.resize(size * size);
+  elevations.resize(size * size);
+  for (int row = 0; row < size; row++)
+  {
+    double latitude = north - ((double)row - 0.5) * latitudeStep;
+    for (int column = 0; column < size; column++)
+    {
+      latitudes[row*size + column] = latitude;
+      longitudes[row*size + column] = west + ((double)column - 0.5) * longitudeStep;
+    }
+  }
+
+  //the region was loaded before the tile got handed out, only write the normal
+  //map to the cache if none of it got unloaded meanwhile
+  ElevationManager* elevationManager = ElevationManager::getInstance();
+  elevationManager->getElevations(latitudes.data(), longitudes.data(), elevations.data(), size * size);
+  bool isComplete = elevationManager->startLoadingRegion(latitudes[size*size - 1], longitudes[0],
+                                                         latitudes[0], longitudes[size*size - 1]);
+
+  float minimum, maximum;
+  bool hasElevation = elevationManager->getElevationBounds(tile->southWest.latitude, west, north,
+                                                           tile->northEast.longitude, minimum, maximum);
+
+  double kmPerDegree = Constants::EARTH_MEAN_RADIUS * Constants::DEGREES_TO_RADIANS;
+  double northSpacing = 2.0 * latitudeStep * kmPerDegree;
+  normalMap = QImage(NORMAL_MAP_SIZE, NORMAL_MAP_SIZE, QImage::Format_RGB32);
+  for (int row = 0; row < NORMAL_MAP_SIZE; row++)
+  {
+    double latitude = north - ((double)row + 0.5) * latitudeStep;
+    double eastSpacing = 2.0 * longitudeStep * kmPerDegree * qMax(cos(latitude * Constants::DEGREES_TO_RADIANS), 0.01);
+    QRgb* line = (QRgb*)normalMap.scanLine(row);
+    const float* center = elevations.constData() + (row + 1)*size + 1;
+
+    for (int column = 0; column < NORMAL_MAP_SIZE; column++)
+    {
+      //the normal of z = f(x, y) is (-dz/dx, -dz/dy, 1)
+      double eastSlope = (center[column + 1] - center[column - 1]) * VERTICAL_EXAGGERATION / eastSpacing;
+      double northSlope = (center[column - size] - center[column + size]) * VERTICAL_EXAGGERATION / northSpacing;
+      double length = sqrt(eastSlope*eastSlope + northSlope*northSlope + 1.0);
+
+      line[column] = qRgb((int)(127.5 - 127.5 * eastSlope / length + 0.5),
+                          (int)(127.5 - 127.5 * northSlope / length + 0.5),
+                          (int)(127.5 + 127.5 / length + 0.5));
+    }
+  }
+  tile->normalMap = normalMap;
+
+  //keep the cache free of tiles that may get elevation data later
+  if (isComplete && hasElevation && !normalMap.save(tile->cacheFilePath, "PNG"))
+  {
+    printf("HillshadeManager.cpp: Error writing cache file %s.\n", tile->cacheFilePath.toStdString().c_str());
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by hillshade threads. Hands the given tile over to getTexture.
+ *
+ * @param tile Tile computed with generateTile
+ */
+void HillshadeManager::reportTileGenerated(Tile* tile)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  tile->state = READY;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Evicts least recently used tiles until the cache is back to its maximum
+ * size. Tiles being computed are never evicted. The manager must be locked.
+ */
+void HillshadeManager::evictTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  while (mTiles.size() > MAXIMUM_NUMBER_OF_TILES)
+  {
+    QHash<QString, Tile*>::iterator leastRecentlyUsed = mTiles.end();
+    QHash<QString, Tile*>::iterator i;
+    for (i = mTiles.begin(); i != mTiles.end(); ++i)
+    {
+      Tile* tile = i.value();
+      if (tile->state != BUSY &&
+          (leastRecentlyUsed == mTiles.end() || tile->lastUsed < leastRecentlyUsed.value()->lastUsed))
+      {
+        leastRecentlyUsed = i;
+      }
+    }
+
+    if (leastRecentlyUsed == mTiles.end())
+    {
+      break;
+    }
+
+    Tile* tile = leastRecentlyUsed.value();
+    if (tile->texture != 0)
+    {
+      glDeleteTextures(1, &tile->texture);
+    }
+    delete tile;
+    mTiles.erase(leastRecentlyUsed);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the key of the tile with the given bounds, also used to name its
+ * cache file.
+ *
+ * @param southWest Tile southwest geodetic position
+ * @param northEast Tile northeast geodetic position
+ * @return Tile key
+ */
+QString HillshadeManager::getTileKey(const GeodeticPosition& southWest, const GeodeticPosition& northEast)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return QString::number(southWest.latitude, 'f', 6) + "_" + QString::number(southWest.longitude, 'f', 6) + "_" +
+         QString::number(northEast.latitude, 'f', 6) + "_" + QString::number(northEast.longitude, 'f', 6);
+}
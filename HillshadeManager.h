@@ -0,0 +1,129 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#ifndef HILLSHADE_MANAGER_H
+#define HILLSHADE_MANAGER_H
+
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QImage>
+#include <QString>
+#include "globals.h"
+
+class HillshadeThread;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton class that shades the relief of the imagery tiles rendered by
+ * Earth in elevation mode. Tiles do not get a shaded image but a normal map
+ * (surface normals in the east, north, up frame of the tile) computed from
+ * ElevationManager by a pool of HillshadeThread objects. The sun is applied
+ * when rendering with a DOT3 texture combiner, so changing the sun azimuth or
+ * elevation costs nothing and never waits on the threads.
+ *
+ * Normal maps are written to a cache directory as PNG files named after the
+ * tile bounds, so every tile is only computed once (relief is exaggerated by
+ * VERTICAL_EXAGGERATION, changing it calls for a new cache directory). Tiles that have no
+ * elevation data under them are not written. Tiles that are not cached are
+ * only handed out to the threads once ElevationManager has loaded the
+ * datasets under them. Textures are kept for the most recently rendered tiles
+ * only. The sun azimuth can be changed from the View menu.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class HillshadeManager
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int NORMAL_MAP_SIZE = 256;
+    static const int MAXIMUM_NUMBER_OF_TILES = 128;
+    static const double VERTICAL_EXAGGERATION = 2.0;
+
+    enum TileState
+    {
+      PENDING,
+      BUSY,
+      READY
+    };
+
+    struct Tile
+    {
+      GeodeticPosition southWest;
+      GeodeticPosition northEast;
+      TileState state;
+      int lastUsed;
+      QString cacheFilePath;
+      bool isCached;//normal map file found when the tile got created
+      QImage normalMap;
+      unsigned int texture;
+    };
+
+    ~HillshadeManager();
+    static HillshadeManager* getInstance();
+
+    void setEnabled(bool value);
+    bool getIsEnabled();
+    void setCacheDirectory(const QString& directoryPath);
+    const QString& getCacheDirectory();
+    void setSunAzimuth(double degrees);
+    double getSunAzimuth();
+    void setSunElevation(double degrees);
+    double getSunElevation();
+
+    void startFrame();
+    unsigned int getTexture(const GeodeticPosition& southWest, const GeodeticPosition& northEast);
+    void beginShading();
+    void endShading();
+
+    //called by hillshade threads
+    bool getIsStopping();
+    Tile* takeRequest();
+    void generateTile(Tile* tile, QVector<double>& latitudes, QVector<double>& longitudes,
+                      QVector<float>& elevations);
+    void reportTileGenerated(Tile* tile);
+
+  private:
+    HillshadeManager();//private due to Singleton implementation
+    void evictTiles();
+    static QString getTileKey(const GeodeticPosition& southWest, const GeodeticPosition& northEast);
+
+    static HillshadeManager* mInstance;
+    QHash<QString, Tile*> mTiles;
+    QList<Tile*> mRequests;
+    QList<HillshadeThread*> mThreads;
+    QMutex mMutex;
+    QString mCacheDirectory;
+    bool mIsEnabled;
+    QAtomicInt mIsStopping;//polled by hillshade threads
+    double mSunAzimuth;
+    double mSunElevation;
+    int mFrame;
+};
+
+#endif//HILLSHADE_MANAGER_H
@@ -20,11 +20,13 @@
  *  <http://www.gnu.org/licenses/>.
  */
 
+#include <math.h>
 #include "Hud.h"
 #include "globals.h"
 #include "WorldObjectManager.h"
 #include "Utilities.h"
 #include "Camera.h"
+#include "WorldObject.h"
 
 Hud* Hud::mInstance = NULL;//Singleton implementation
 
@@ -37,7 +39,12 @@ Hud::Hud()
 {
   mShowHud = true;
   mShowLabels = false;
+  mDeclutterLabels = true;
   mPainter = NULL;
+  mFrameNumber = 0;
+
+  //glyphs are signed distance fields, see GlyphAtlas
+  mLabelBatch.setAlphaThreshold(0.5f);
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -91,6 +98,18 @@ bool Hud::getShowLabels()
   return mShowLabels;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if overlapping world object labels are left out.
+ *
+ * @return True if labels are decluttered, false otherwise
+ */
+bool Hud::getDeclutterLabels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mDeclutterLabels;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Sets the value of flag to show/hide Heads Up Display (HUD).
@@ -115,6 +134,19 @@ void Hud::setShowLabels(bool show)
   mShowLabels = show;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the value of flag to leave out overlapping world object labels. If
+ * turned off, every label is drawn right of its object.
+ *
+ * @param declutter Set to true if you want labels to be decluttered
+ */
+void Hud::setDeclutterLabels(bool declutter)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mDeclutterLabels = declutter;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Sets the handle to the painter object. This handle is used to invoke Qt's
@@ -131,8 +163,8 @@ void Hud::setPainter(QPainter* painter)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Renders the Heads Up Display (HUD). Currently, the HUD renders the camera's
- * position on the upper left corner of the screen and also renders all the
- * world object labels.
+ * position on the upper left corner of the screen. World object labels are
+ * rendered separately in renderLabels.
  */
 void Hud::renderHud()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -167,7 +199,17 @@ void Hud::renderHud()
     mPainter->drawText(20, 50, lonStr);
     mPainter->drawText(20, 70, altStr);
   }
+}
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * WARNING: This method is supposed to get called from within OpenGL context,
+ * before the QPainter of the HUD is created. Renders the world object labels
+ * if they are shown.
+ */
+void Hud::renderLabels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
   if (mShowLabels)
   {
     //render world object labels
@@ -177,22 +219,27 @@ void Hud::renderHud()
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Renders the labels for all world objects.
+ * Renders the labels for the world objects in view, as found by the last
+ * WorldObjectManager::renderObjects call. Labels are laid out again only when
+ * their text changed and all of them go out in a single draw call. Glyph runs
+ * of objects that were not in view in the last frame get dropped.
  */
 void Hud::renderWorldObjectLabels()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   WorldObjectManager* worldObjectManager = WorldObjectManager::getInstance();
+  GlyphAtlas* glyphAtlas = GlyphAtlas::getInstance();
   Camera* camera = Camera::getInstance();
   WorldObject* worldObject = NULL;
   SimpleVector screenLocation;
-  QString label;
 
-  ScreenCoordinates screenSize = Camera::getInstance()->getScreenSize();
+  mFrameNumber++;
+  mLabelBatch.clear();
+  mLabelCandidates.resize(0);
 
-  for (int i = 0; i < worldObjectManager->getNumberOfObjects(); i++)
+  for (int i = 0; i < worldObjectManager->getNumberOfVisibleObjects(); i++)
   {
-    worldObject = worldObjectManager->getWorldObject(i);
+    worldObject = worldObjectManager->getVisibleObject(i);
     if (worldObject != NULL && !worldObject->getHasExpired())
     {
       screenLocation = worldObject->getScreenLocation();
@@ -200,24 +247,211 @@ void Hud::renderWorldObjectLabels()
       //only draw the label if world object is not being obscured by the earth
       //and if projection is not negative (not behind the camera, which means
       //screenZ is below 1.0)
+      const WorldObject::FrameState& state = worldObject->getFrameState();
       if (screenLocation.z < 1.0f &&
-          !Utilities::checkObscure(camera->getGeodeticPosition(),worldObject->getGeodeticPosition()) &&
-          worldObject->getIsVisible())
+          !Utilities::checkObscure(camera->getGeodeticPosition(),worldObject->getFrameGeodeticPosition()) &&
+          state.isVisible && !state.label.isEmpty())
       {
-        label = worldObject->getLabel();
+        //lay out label again only if its text changed
+        QHash<WorldObject*, LabelRun>::iterator iterator = mLabelRuns.find(worldObject);
+        if (iterator == mLabelRuns.end())
+        {
+          iterator = mLabelRuns.insert(worldObject, LabelRun());
+          iterator.value().placement = NOT_PLACED;
+        }
+        LabelRun& labelRun = iterator.value();
+        if (labelRun.text != state.label)
+        {
+          labelRun.text = state.label;
+          glyphAtlas->layoutText(labelRun.text, LABEL_PIXEL_SIZE, labelRun.run);
+        }
+        labelRun.frameNumber = mFrameNumber;
 
-        //set pen color to world object color
-        SimpleColor color = worldObject->getColor();
-        int red = color.red * 255.0f;
-        int green = color.green * 255.0f;
-        int blue = color.blue * 255.0f;
-        mPainter->setPen(QColor(red, green, blue));
+        //draw label in world object color
+        LabelCandidate candidate;
+        candidate.worldObject = worldObject;
+        candidate.screenLocation = screenLocation;
+        candidate.color = state.color;
+        candidate.color.alpha = 1.0f;
+        mLabelCandidates.append(candidate);
+      }
+    }
+  }
 
-        //reverse Y to screen coordinates
-        screenLocation.y = (float)screenSize.y - screenLocation.y;
+  if (mDeclutterLabels)
+  {
+    declutterLabels();
+  }
+  else
+  {
+    for (int i = 0; i < mLabelCandidates.size(); i++)
+    {
+      LabelRun& labelRun = mLabelRuns[mLabelCandidates[i].worldObject];
+      labelRun.placement = PLACE_RIGHT;
+      addLabel(labelRun, mLabelCandidates[i]);
+    }
+  }
 
-        mPainter->drawText((int)(screenLocation.x+20.0), (int)screenLocation.y, label);
+  //drop runs of objects that went out of view, might have been deleted
+  if (mLabelRuns.size() > 2 * mLabelCandidates.size() + 64)
+  {
+    QHash<WorldObject*, LabelRun>::iterator iterator = mLabelRuns.begin();
+    while (iterator != mLabelRuns.end())
+    {
+      if (iterator.value().frameNumber != mFrameNumber)
+      {
+        iterator = mLabelRuns.erase(iterator);
+      }
+      else
+      {
+        ++iterator;
       }
     }
   }
+
+  mLabelBatch.render(glyphAtlas->getTexture());
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Places the label candidates of this frame on the occupancy grid and adds the
+ * ones that found a free spot to the label batch. Labels placed in the last
+ * frame go first, trying their last spot before the others. The remaining
+ * labels follow nearest object first and must keep LABEL_MARGIN pixels away
+ * from labels already placed.
+ */
+void Hud::declutterLabels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ScreenCoordinates screenSize = Camera::getInstance()->getScreenSize();
+  mLabelGrid.reset(screenSize.x, screenSize.y);
+  mNewLabels.resize(0);
+
+  //labels shown in the last frame keep priority
+  for (int i = 0; i < mLabelCandidates.size(); i++)
+  {
+    const LabelCandidate& candidate = mLabelCandidates[i];
+    LabelRun& labelRun = mLabelRuns[candidate.worldObject];
+    if (labelRun.placement != NOT_PLACED && placeLabel(labelRun, candidate, 0.0f))
+    {
+      addLabel(labelRun, candidate);
+    }
+    else
+    {
+      mNewLabels.append(qMakePair((float)candidate.screenLocation.z, i));
+    }
+  }
+
+  //then the others, nearest object first
+  qSort(mNewLabels);
+  for (int i = 0; i < mNewLabels.size(); i++)
+  {
+    const LabelCandidate& candidate = mLabelCandidates[mNewLabels[i].second];
+    LabelRun& labelRun = mLabelRuns[candidate.worldObject];
+    if (placeLabel(labelRun, candidate, LABEL_MARGIN))
+    {
+      addLabel(labelRun, candidate);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Looks for a free spot around the object of the given label, starting with
+ * the spot of the last frame, and takes it on the occupancy grid.
+ *
+ * @param labelRun Label to place, returns the spot taken
+ * @param candidate Object the label belongs to
+ * @param margin Free space needed around the label, in pixels
+ * @return False if no spot was free, the label is then not placed
+ */
+bool Hud::placeLabel(LabelRun& labelRun, const LabelCandidate& candidate, float margin)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int firstPlacement = (labelRun.placement != NOT_PLACED) ? labelRun.placement : PLACE_RIGHT;
+  const GlyphAtlas::GlyphRun& run = labelRun.run;
+
+  for (int i = 0; i < NUMBER_OF_PLACEMENTS; i++)
+  {
+    labelRun.placement = (firstPlacement + i) % NUMBER_OF_PLACEMENTS;
+
+    //the label box starts at the origin on the baseline
+    float x, y;
+    getLabelOrigin(labelRun, candidate, x, y);
+    float left = x;
+    float bottom = y - run.descent;
+    float right = x + run.width;
+    float top = y + run.ascent;
+
+    if (mLabelGrid.isFree(left - margin, bottom - margin, right + margin, top + margin))
+    {
+      mLabelGrid.occupy(left, bottom, right, top);
+      return true;
+    }
+  }
+
+  labelRun.placement = NOT_PLACED;
+  return false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes where the text of the given label starts on screen for the spot
+ * the label is placed at. Origins are snapped to whole pixels.
+ *
+ * @param labelRun Label to draw
+ * @param candidate Object the label belongs to
+ * @param x Returns the screen X coordinate of the start of the text
+ * @param y Returns the screen Y coordinate of the baseline
+ */
+void Hud::getLabelOrigin(const LabelRun& labelRun, const LabelCandidate& candidate,
+                         float& x, float& y)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const GlyphAtlas::GlyphRun& run = labelRun.run;
+  x = candidate.screenLocation.x;
+  y = candidate.screenLocation.y;
+
+  switch (labelRun.placement)
+  {
+    case PLACE_LEFT:
+      x -= LABEL_OFFSET + run.width;
+      break;
+    case PLACE_ABOVE:
+      x -= run.width / 2.0f;
+      y += LABEL_OFFSET + run.descent;
+      break;
+    case PLACE_BELOW:
+      x -= run.width / 2.0f;
+      y -= LABEL_OFFSET + run.ascent;
+      break;
+    default:
+      x += LABEL_OFFSET;
+      break;
+  }
+
+  x = floor(x);
+  y = floor(y);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds the glyphs of the given label to the label batch, at the spot the label
+ * is placed at.
+ *
+ * @param labelRun Label to draw
+ * @param candidate Object the label belongs to
+ */
+void Hud::addLabel(const LabelRun& labelRun, const LabelCandidate& candidate)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  float x, y;
+  getLabelOrigin(labelRun, candidate, x, y);
+
+  const QVector<float>& quads = labelRun.run.quads;
+  for (int i = 0; i < quads.size(); i += 8)
+  {
+    mLabelBatch.addQuad(x + quads[i], y + quads[i+1], x + quads[i+2], y + quads[i+3],
+                        &quads[i+4], 0.0f, candidate.color);
+  }
 }
@@ -24,13 +24,28 @@
 #define HUD_H
 
 #include <QPainter>
+#include <QHash>
+#include <QPair>
+#include "globals.h"
+#include "SpriteBatch.h"
+#include "GlyphAtlas.h"
+#include "OccupancyGrid.h"
+
+class WorldObject;
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * This class encapsulates the functionality to render the Heads Up Display
  * (HUD). Currently, the HUD renders text representing the camera position on
  * the upper left corner of the screen and also renders the labels for world
- * objects.
+ * objects. Labels are drawn in OpenGL out of the GlyphAtlas, all of them in
+ * one SpriteBatch. The glyph run of every label is kept until its text
+ * changes. Unless decluttering is turned off, labels are placed on a screen
+ * OccupancyGrid every frame: each label takes the first free spot around its
+ * object (right, left, above, below) and labels without a free spot are not
+ * drawn. Labels placed in the last frame go first and keep their spot while
+ * it stays free, new labels go nearest object first and need some margin,
+ * which keeps labels from jumping around or flickering as objects move.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -39,24 +54,70 @@ class Hud
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   public:
+    static const int LABEL_PIXEL_SIZE = 17;//label font size in pixels
+    static const int LABEL_OFFSET = 20;//distance of labels to object, in pixels
+    static const int LABEL_MARGIN = 4;//free space new labels need, in pixels
+
     static Hud* getInstance();
     ~Hud();
 
     bool getShowHud();
     bool getShowLabels();
+    bool getDeclutterLabels();
     void setShowHud(bool show);
     void setShowLabels(bool show);
+    void setDeclutterLabels(bool declutter);
     void setPainter(QPainter* painter);
     void renderHud();
+    void renderLabels();
 
   private:
+    enum LabelPlacement
+    {
+      NOT_PLACED = -1,
+      PLACE_RIGHT,
+      PLACE_LEFT,
+      PLACE_ABOVE,
+      PLACE_BELOW,
+      NUMBER_OF_PLACEMENTS
+    };
+
+    struct LabelRun
+    {
+      QString text;
+      GlyphAtlas::GlyphRun run;
+      int frameNumber;//last frame the label was a candidate in
+      int placement;//spot taken in the last frame
+    };
+
+    struct LabelCandidate
+    {
+      WorldObject* worldObject;
+      SimpleVector screenLocation;
+      SimpleColor color;
+    };
+
     Hud();//private due to Singleton implementation
     void renderWorldObjectLabels();
+    void declutterLabels();
+    bool placeLabel(LabelRun& labelRun, const LabelCandidate& candidate, float margin);
+    void getLabelOrigin(const LabelRun& labelRun, const LabelCandidate& candidate,
+                        float& x, float& y);
+    void addLabel(const LabelRun& labelRun, const LabelCandidate& candidate);
 
     static Hud* mInstance;
     bool mShowHud;
     bool mShowLabels;
+    bool mDeclutterLabels;
     QPainter* mPainter;
+    QHash<WorldObject*, LabelRun> mLabelRuns;
+    SpriteBatch mLabelBatch;
+    int mFrameNumber;
+
+    //scratch buffers for decluttering, kept around to avoid allocating every frame
+    QVector<LabelCandidate> mLabelCandidates;
+    QVector<QPair<float, int> > mNewLabels;//depth and candidate index
+    OccupancyGrid mLabelGrid;
 };
 
 #endif//HUD_H
@@ -20,7 +20,11 @@
  *  <http://www.gnu.org/licenses/>.
  */
 
+
 #include <QStringList>
+#include <QPainter>
+#include <QMutexLocker>
+#include <QtOpenGL>
 #include "IconModelManager.h"
 #include "Utilities.h"
 
@@ -39,6 +43,10 @@ IconModelManager* IconModelManager::mInstance = NULL;//Singleton implementation
 IconModelManager::IconModelManager()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  mNextHandle = INVALID_HANDLE + 1;
+  mNumberOfAtlasCells = 0;
+  mAtlasTexture = 0;
+  mUnusedModelMemory = 0;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -49,24 +57,24 @@ IconModelManager::~IconModelManager()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   mInstance = NULL;
-  int i = 0;
 
   //release icon/image data
-  for (i = 0; i < mIconList.size(); i++)
+  QHash<int, Icon>::iterator icon;
+  for (icon = mIcons.begin(); icon != mIcons.end(); ++icon)
   {
-    delete mIconList[i].image;
+    delete icon.value().image;
   }
-  mIconList.clear();
+  mIcons.clear();
+  mIconHandles.clear();
 
-#ifdef USING_ASSIMP
   //release model data
-  for (i = 0; i < mModelList.size(); i++)
+  QHash<int, Model>::iterator model;
+  for (model = mModels.begin(); model != mModels.end(); ++model)
   {
-    const struct aiScene* scene = (const struct aiScene*)mModelList[i].modelData;
-    aiReleaseImport(scene);
+    deleteModel(model.value());
   }
-  mModelList.clear();
-#endif
+  mModels.clear();
+  mModelHandles.clear();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -88,204 +96,452 @@ IconModelManager* IconModelManager::getInstance()
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Checks if icon has been loaded already, loads icon into local database if not.
+ * Checks if icon has been loaded already, loads icon into local database if
+ * not, and adds a reference to it. Every successful call must be matched by a
+ * call to releaseIcon. This method is thread-safe.
  *
  * @param filePath Path to icon/image file
- * @return True if image was loaded successfully
+ * @return Handle to icon, INVALID_HANDLE if image could not be loaded
  */
-bool IconModelManager::loadIcon(const QString& filePath)
+int IconModelManager::loadIcon(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  bool returnValue = false;
-  bool iconAlreadyLoaded = false;
+  QMutexLocker locker(&mMutex);
 
   //check if image was already loaded
-  for (int i = 0; i < mIconList.size(); i++)
+  int handle = mIconHandles.value(filePath, INVALID_HANDLE);
+  if (handle != INVALID_HANDLE)
   {
-    if (mIconList[i].filePath == filePath)
+    Icon& icon = mIcons[handle];
+    if (icon.referenceCount == 0)
     {
-      iconAlreadyLoaded = true;
-      returnValue = true;
-      break;
+      mUnusedIcons.removeOne(handle);
     }
+    icon.referenceCount++;
+
+    return handle;
   }
 
-  if (!iconAlreadyLoaded)
+  //load image
+  QImage* image = new QImage();
+  if (!image->load(filePath))
   {
-    //load image
-    QImage* image = new QImage();
-    if (image->load(filePath))
-    {
-      //save icon in local database
-      Icon icon;
-      icon.filePath = filePath;
-      icon.image = image;
-      icon.texture = -1;
-      icon.depth = (float)mIconList.size()/1000.0f;
-      mIconList.append(icon);
-      returnValue = true;
-    }
-    else
-    {
-      printf("IconModelManager.cpp: Error loading image file.\n");
-      delete image;
-    }
+    printf("IconModelManager.cpp: Error loading image file.\n");
+    delete image;
+    return INVALID_HANDLE;
+  }
+
+  //save icon in local database
+  Icon icon;
+  icon.filePath = filePath;
+  icon.image = image;
+  icon.depth = (float)mIconHandles.size()/1000.0f;
+  icon.referenceCount = 1;
+  if (!reserveAtlasCell(icon))
+  {
+    printf("IconModelManager.cpp: Icon atlas is full, cannot add %s.\n", filePath.toLatin1().data());
+    delete image;
+    return INVALID_HANDLE;
   }
 
-  return returnValue;
+  handle = mNextHandle++;
+  mIcons.insert(handle, icon);
+  mIconHandles.insert(filePath, handle);
+  mPendingIcons.append(handle);
+
+  return handle;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Checks if model has been loaded already, loads model into local database if
- * not. This method uses the Assimp library to load model (assimp.sourceforge.net).
+ * not, and adds a reference to it. Every successful call must be matched by a
+ * call to releaseModel. This method uses the Assimp library to load model
+ * (assimp.sourceforge.net) and is thread-safe.
  *
  * @param filePath Path to model file
- * @return True if model was loaded successfully
+ * @return Handle to model, INVALID_HANDLE if model could not be loaded
  */
-bool IconModelManager::loadModel(const QString& filePath)
+int IconModelManager::loadModel(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  bool returnValue = false;
-  bool modelAlreadyLoaded = false;
+  QMutexLocker locker(&mMutex);
 
   //check if model was already loaded
-  for (int i = 0; i < mModelList.size(); i++)
+  int handle = mModelHandles.value(filePath, INVALID_HANDLE);
+  if (handle != INVALID_HANDLE)
   {
-    if (mModelList[i].filePath == filePath)
+    Model& model = mModels[handle];
+    if (model.referenceCount == 0)
     {
-      modelAlreadyLoaded = true;
-      returnValue = true;
-      break;
+      mUnusedModels.removeOne(handle);
+      mUnusedModelMemory -= model.memorySize;
     }
+    model.referenceCount++;
+
+    return handle;
   }
 
-  if (!modelAlreadyLoaded)
-  {
-    //load model
+  //load model
 #ifdef USING_ASSIMP
-    const struct aiScene* scene = NULL;
-    scene = aiImportFile(filePath.toStdString().c_str(), aiProcessPreset_TargetRealtime_MaxQuality);
-    if (scene != NULL)
-    {
-      returnValue = true;
-
-      //save model in local database
-      Model model;
-      model.filePath = filePath;
-      model.modelData = (void*)scene;
-      model.texture = -1;
+  const struct aiScene* scene = NULL;
+  scene = aiImportFile(filePath.toStdString().c_str(), aiProcessPreset_TargetRealtime_MaxQuality);
+  if (scene != NULL)
+  {
+    //save model in local database
+    Model model;
+    model.filePath = filePath;
+    model.modelData = (void*)scene;
+    model.image = NULL;
+    model.texture = -1;
+    model.referenceCount = 1;
+    model.memorySize = 0;
 
-      //load texture as images first
-      for (unsigned int materialIndex = 0; materialIndex < scene->mNumMaterials; materialIndex++)
+    //load texture as images first
+    for (unsigned int materialIndex = 0; materialIndex < scene->mNumMaterials; materialIndex++)
+    {
+      const aiMaterial* pMaterial = scene->mMaterials[materialIndex];
+      if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0)
       {
-        const aiMaterial* pMaterial = scene->mMaterials[materialIndex];
-        if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+        aiString relativePath;
+        if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &relativePath, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
         {
-          aiString relativePath;
-          if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &relativePath, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
+          //get full path from model file path
+          QStringList stringList = model.filePath.split("/");
+
+          QString directoryPath = "";
+          //to get directory path we just ignore the last element in string list
+          for (int stringListIndex = 0; stringListIndex < stringList.length()-1; stringListIndex++)
           {
-            //get full path from model file path
-            QStringList stringList = model.filePath.split("/");
-
-            QString directoryPath = "";
-            //to get directory path we just ignore the last element in string list
-            for (int stringListIndex = 0; stringListIndex < stringList.length()-1; stringListIndex++)
-            {
-              directoryPath += stringList[stringListIndex] + "/";
-            }
-            QString fullPath = directoryPath + relativePath.data;
-
-            QImage* image = new QImage();
-            if (!image->load(fullPath))
-            {
-              printf("IconModelManager.cpp: Error loading texture for model.\n");
-              delete image;
-            }
-            model.image = image;
+            directoryPath += stringList[stringListIndex] + "/";
           }
+          QString fullPath = directoryPath + relativePath.data;
+
+          QImage* image = new QImage();
+          if (!image->load(fullPath))
+          {
+            printf("IconModelManager.cpp: Error loading texture for model.\n");
+            delete image;
+            image = NULL;
+          }
+          else
+          {
+            //the texture stays on the graphics card after the image is gone
+            model.memorySize += image->width() * image->height() * 4;
+          }
+          delete model.image;
+          model.image = image;
         }
       }
+    }
 
-      mModelList.append(model);
-    }//end of if (scene != NULL)
-    else
+    //estimate vertex data size
+    for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++)
     {
-      printf("IconModelManager.cpp: Error loading model data.\n");
+      const aiMesh* mesh = scene->mMeshes[meshIndex];
+      model.memorySize += mesh->mNumVertices * sizeof(aiVector3D) * (mesh->HasTextureCoords(0) ? 3 : 2);
+      model.memorySize += mesh->mNumFaces * (sizeof(aiFace) + 3 * sizeof(unsigned int));
     }
+
+    handle = mNextHandle++;
+    mModels.insert(handle, model);
+    mModelHandles.insert(filePath, handle);
+  }//end of if (scene != NULL)
+  else
+  {
+    printf("IconModelManager.cpp: Error loading model data.\n");
+  }
 #endif
-  }// end of if (!modelAlreadyLoaded)
 
-  return returnValue;
+  return handle;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * WARNING: This method is supposed to get called from within OpenGL context.
- * It returns the OpenGL texture index and texture depth for the given icon file.
+ * Gives back a reference to an icon. Icons nobody references stay loaded
+ * until their atlas cell is needed for another icon. This method is
+ * thread-safe.
  *
- * @param filePath Path to icon/image file
- * @param texture Texture index value returned
- * @param depth Depth value returned
- * @return True if texture was found
+ * @param handle Handle returned by loadIcon
  */
-bool IconModelManager::getIcon(const QString& filePath, int& texture, float& depth)
+void IconModelManager::releaseIcon(int handle)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  int returnValue = false;
+  QMutexLocker locker(&mMutex);
 
-  //find icon
-  for (int i = 0; i < mIconList.size(); i++)
+  QHash<int, Icon>::iterator icon = mIcons.find(handle);
+  if (icon != mIcons.end() && icon.value().referenceCount > 0)
   {
-    if (mIconList[i].filePath == filePath)
+    icon.value().referenceCount--;
+    if (icon.value().referenceCount == 0)
     {
-      //load texture to graphics card if not done so already
-      if (mIconList[i].texture == -1)
-      {
-        mIconList[i].texture = Utilities::imageToTexture(*mIconList[i].image);
-      }
-      texture = mIconList[i].texture;
-      depth = mIconList[i].depth;
-      returnValue = true;
-      break;
+      mUnusedIcons.append(handle);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Gives back a reference to a model. Models nobody references stay loaded
+ * until unused models take more than MODEL_MEMORY_BUDGET. This method is
+ * thread-safe.
+ *
+ * @param handle Handle returned by loadModel
+ */
+void IconModelManager::releaseModel(int handle)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  QHash<int, Model>::iterator model = mModels.find(handle);
+  if (model != mModels.end() && model.value().referenceCount > 0)
+  {
+    model.value().referenceCount--;
+    if (model.value().referenceCount == 0)
+    {
+      mUnusedModels.append(handle);
+      mUnusedModelMemory += model.value().memorySize;
+      evictModels();
     }
   }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns where the given icon sits in the atlas texture, see getAtlasTexture.
+ * This method does not need an OpenGL context and is thread-safe.
+ *
+ * @param handle Handle returned by loadIcon
+ * @param region Returns the texture coordinates as left, bottom, right, top
+ * @param depth Depth value returned
+ * @return True if icon was found
+ */
+bool IconModelManager::getIconRegion(int handle, float* region, float& depth)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  QHash<int, Icon>::const_iterator icon = mIcons.constFind(handle);
+  if (icon == mIcons.constEnd())
+  {
+    return false;
+  }
 
-  return returnValue;
+  for (int i = 0; i < 4; i++)
+  {
+    region[i] = icon.value().region[i];
+  }
+  depth = icon.value().depth;
+
+  return true;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * WARNING: This method is supposed to get called from within OpenGL context.
  * It returns the model data (previosuly loaded with Assimp) and OpenGL texture
- * index for the given model file.
+ * index for the given model. The texture gets uploaded the first time and its
+ * image released.
  *
- * @param filePath Path to model file
+ * @param handle Handle returned by loadModel
  * @param modelData Model data returned (actual type is aiScene* but cast as void to ease dependency)
  * @param texture Texture index value returned
  * @return True if model was found
  */
-bool IconModelManager::getModel(const QString& filePath, void*& modelData, int& texture)
+bool IconModelManager::getModel(int handle, void*& modelData, int& texture)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  QHash<int, Model>::iterator iterator = mModels.find(handle);
+  if (iterator == mModels.end())
+  {
+    return false;
+  }
+
+  //load texture to graphics card if not done so already
+  Model& model = iterator.value();
+  if (model.image != NULL)
+  {
+    model.texture = Utilities::imageToTexture(*model.image);
+    delete model.image;
+    model.image = NULL;
+  }
+  modelData = model.modelData;
+  texture = model.texture;
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * WARNING: This method is supposed to get called from within OpenGL context.
+ * Returns the OpenGL texture of the icon atlas. Icons added since the last
+ * call get uploaded into their cells and their images released. Textures of
+ * evicted models get deleted here too, WorldObjectManager calls this method
+ * once per frame.
+ *
+ * @return OpenGL handle to atlas texture
+ */
+unsigned int IconModelManager::getAtlasTexture()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  int returnValue = false;
+  QMutexLocker locker(&mMutex);
+
+  for (int i = 0; i < mReleasedTextures.size(); i++)
+  {
+    glDeleteTextures(1, &mReleasedTextures[i]);
+  }
+  mReleasedTextures.clear();
 
-  //find model
-  for (int i = 0; i < mModelList.size(); i++)
+  if (mAtlasTexture == 0)
   {
-    if (mModelList[i].filePath == filePath)
+    //start out transparent, cell borders are never written otherwise
+    QImage emptyImage(ATLAS_SIZE, ATLAS_SIZE, QImage::Format_ARGB32);
+    emptyImage.fill(0);
+    mAtlasTexture = Utilities::imageToTexture(emptyImage);
+  }
+
+  for (int i = 0; i < mPendingIcons.size(); i++)
+  {
+    //icons might have been evicted before they ever got uploaded
+    QHash<int, Icon>::iterator icon = mIcons.find(mPendingIcons[i]);
+    if (icon != mIcons.end())
     {
-      //load textures to graphics card if not done so already
-      if (mModelList[i].texture == -1)
-      {
-        mModelList[i].texture = Utilities::imageToTexture(*mModelList[i].image);
-      }
-      texture = mModelList[i].texture;
-      modelData = mModelList[i].modelData;
-      returnValue = true;
-      break;
+      uploadIcon(icon.value());
+    }
+  }
+  mPendingIcons.clear();
+
+  return mAtlasTexture;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Hands out an atlas cell for the given icon and fills in its texture
+ * coordinates. When all cells are taken, the least recently released icon
+ * nobody references gets evicted to free its cell. The icon gets drawn into
+ * the cell one pixel in from the cell border, which keeps neighbor icons from
+ * bleeding in when the atlas is filtered. The manager must be locked.
+ *
+ * @param icon Returns the atlas cell and region of the icon
+ * @return False if the atlas is full
+ */
+bool IconModelManager::reserveAtlasCell(Icon& icon)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const int cellsPerRow = ATLAS_SIZE / ATLAS_CELL_SIZE;
+
+  if (mFreeAtlasCells.isEmpty() && mNumberOfAtlasCells == cellsPerRow * cellsPerRow)
+  {
+    if (mUnusedIcons.isEmpty())
+    {
+      return false;
     }
+
+    int handle = mUnusedIcons.takeFirst();
+    Icon evictedIcon = mIcons.take(handle);
+    mIconHandles.remove(evictedIcon.filePath);
+    mFreeAtlasCells.append(evictedIcon.atlasCell);
+    delete evictedIcon.image;
+  }
+
+  if (!mFreeAtlasCells.isEmpty())
+  {
+    icon.atlasCell = mFreeAtlasCells.takeLast();
+  }
+  else
+  {
+    icon.atlasCell = mNumberOfAtlasCells++;
+  }
+
+  //cells are filled row by row from the top left corner of the image
+  int x = (icon.atlasCell % cellsPerRow) * ATLAS_CELL_SIZE + 1;
+  int y = (icon.atlasCell / cellsPerRow) * ATLAS_CELL_SIZE + 1;
+  int size = ATLAS_CELL_SIZE - 2;
+
+  //the texture is flipped vertically relative to the image
+  icon.region[0] = (float)x / ATLAS_SIZE;
+  icon.region[1] = 1.0f - (float)(y + size) / ATLAS_SIZE;
+  icon.region[2] = (float)(x + size) / ATLAS_SIZE;
+  icon.region[3] = 1.0f - (float)y / ATLAS_SIZE;
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * WARNING: This method is supposed to get called from within OpenGL context.
+ * Draws the icon image scaled into a transparent cell sized image, uploads it
+ * into the icon's atlas cell and releases the image. The manager must be
+ * locked.
+ *
+ * @param icon Icon to upload
+ */
+void IconModelManager::uploadIcon(Icon& icon)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const int cellsPerRow = ATLAS_SIZE / ATLAS_CELL_SIZE;
+
+  QImage cellImage(ATLAS_CELL_SIZE, ATLAS_CELL_SIZE, QImage::Format_ARGB32);
+  cellImage.fill(0);
+  QPainter painter(&cellImage);
+  painter.setCompositionMode(QPainter::CompositionMode_Source);
+  painter.drawImage(QRect(1, 1, ATLAS_CELL_SIZE - 2, ATLAS_CELL_SIZE - 2), *icon.image);
+  painter.end();
+
+  //texture rows go from the bottom up
+  QImage glFormatImage = QGLWidget::convertToGLFormat(cellImage);
+  int x = (icon.atlasCell % cellsPerRow) * ATLAS_CELL_SIZE;
+  int y = ATLAS_SIZE - (icon.atlasCell / cellsPerRow + 1) * ATLAS_CELL_SIZE;
+  glBindTexture(GL_TEXTURE_2D, mAtlasTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, ATLAS_CELL_SIZE, ATLAS_CELL_SIZE,
+                  GL_RGBA, GL_UNSIGNED_BYTE, glFormatImage.bits());
+
+  delete icon.image;
+  icon.image = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Deletes the least recently released models nobody references until unused
+ * models fit in MODEL_MEMORY_BUDGET. The manager must be locked.
+ */
+void IconModelManager::evictModels()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  while (mUnusedModelMemory > MODEL_MEMORY_BUDGET && !mUnusedModels.isEmpty())
+  {
+    int handle = mUnusedModels.takeFirst();
+    Model model = mModels.take(handle);
+    mModelHandles.remove(model.filePath);
+    mUnusedModelMemory -= model.memorySize;
+    deleteModel(model);
   }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Releases the data of the given model. Its texture gets queued to be deleted
+ * within OpenGL context, see getAtlasTexture.
+ *
+ * @param model Model to release
+ */
+void IconModelManager::deleteModel(Model& model)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+#ifdef USING_ASSIMP
+  const struct aiScene* scene = (const struct aiScene*)model.modelData;
+  aiReleaseImport(scene);
+#endif
+  model.modelData = NULL;
+
+  delete model.image;
+  model.image = NULL;
 
-  return returnValue;
+  if (model.texture != -1)
+  {
+    mReleasedTextures.append(model.texture);
+    model.texture = -1;
+  }
 }
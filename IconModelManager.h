@@ -25,16 +25,33 @@
 
 #include <QString>
 #include <QList>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * This class handles the loading of images and models to avoid duplicity.
  * It loads images onto graphics card and keeps track of texture indices. It
  * also loads model data by using the Assimp library (assimp.sourceforge.net).
- * World Objetcs call loadIcon and loadModel during initialization time, then
- * they call getIcon and getModel during render time. This class is implemented
- * as a Singleton.
+ * This class is implemented as a Singleton.
+ *
+ * Icons and models are kept in a registry keyed by integer handles. File paths
+ * are only hashed when loading, loadIcon and loadModel return the handle and
+ * add a reference to the resource, users give it back with releaseIcon and
+ * releaseModel. IconRenderer and ModelRenderer hold one reference each while
+ * they use a resource, and look it up by handle during render time. Images
+ * are only kept on the CPU until they get uploaded to the graphics card.
+ *
+ * Icons are packed into a single atlas texture, one ATLAS_CELL_SIZE cell per
+ * icon, so that all icons of a frame can be drawn in one batch (see
+ * SpriteBatch). getIconRegion returns where an icon sits in the atlas and
+ * getAtlasTexture uploads the icons added since the last frame.
+ *
+ * Resources nobody references anymore stay loaded in case they get used
+ * again, until they have to make room: unused icons when the atlas runs out of
+ * cells, unused models when they take more than MODEL_MEMORY_BUDGET. The least
+ * recently released ones go first.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -43,36 +60,68 @@ class IconModelManager
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   public:
+    static const int INVALID_HANDLE = 0;
+    static const int ATLAS_SIZE = 2048;//in pixels
+    static const int ATLAS_CELL_SIZE = 64;//in pixels, icons get scaled to fit
+    static const int MODEL_MEMORY_BUDGET = 64 * 1024 * 1024;//in bytes, for unused models
+
     struct Icon
     {
       QString filePath;
-      QImage* image;
-      int texture;
+      QImage* image;//released once uploaded into the atlas
+      int atlasCell;
       float depth;
+      float region[4];//atlas texture coordinates as left, bottom, right, top
+      int referenceCount;
     };
 
     struct Model
     {
       QString filePath;
       void* modelData;
-      QImage* image;
+      QImage* image;//released once uploaded
       int texture;
+      int referenceCount;
+      int memorySize;//estimated, in bytes
     };
 
     static IconModelManager* getInstance();
     ~IconModelManager();
 
-    bool loadIcon(const QString& filePath);
-    bool loadModel(const QString& filePath);
-    bool getIcon(const QString& filePath, int& texture, float& depth);
-    bool getModel(const QString& filePath, void*& modelData, int& texture);
+    int loadIcon(const QString& filePath);
+    int loadModel(const QString& filePath);
+    void releaseIcon(int handle);
+    void releaseModel(int handle);
+    bool getIconRegion(int handle, float* region, float& depth);
+    bool getModel(int handle, void*& modelData, int& texture);
+    unsigned int getAtlasTexture();
 
   private:
     IconModelManager();//private due to Singleton implementation
+    bool reserveAtlasCell(Icon& icon);
+    void uploadIcon(Icon& icon);
+    void evictModels();
+    void deleteModel(Model& model);
 
     static IconModelManager* mInstance;
-    QList<Icon> mIconList;
-    QList<Model> mModelList;
+    int mNextHandle;
+    QMutex mMutex;
+
+    //icons
+    QHash<int, Icon> mIcons;//by handle
+    QHash<QString, int> mIconHandles;//handle of every icon file path
+    QList<int> mUnusedIcons;//least recently released first
+    QList<int> mPendingIcons;//not uploaded into the atlas yet
+    QList<int> mFreeAtlasCells;//cells of evicted icons
+    int mNumberOfAtlasCells;//cells handed out so far
+    unsigned int mAtlasTexture;
+
+    //models
+    QHash<int, Model> mModels;//by handle
+    QHash<QString, int> mModelHandles;//handle of every model file path
+    QList<int> mUnusedModels;//least recently released first
+    int mUnusedModelMemory;//in bytes
+    QList<unsigned int> mReleasedTextures;//to be deleted within OpenGL context
 };
 
 #endif//ICON_MODEL_MGR_H
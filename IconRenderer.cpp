@@ -26,6 +26,7 @@
 #include "Utilities.h"
 #include "IconModelManager.h"
 #include "WorldObject.h"
+#include "SpriteBatch.h"
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
@@ -37,18 +38,32 @@ IconRenderer::IconRenderer(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   mFilePath = filePath;
+  mIconHandle = IconModelManager::INVALID_HANDLE;
+  if (!mFilePath.isEmpty())
+  {
+    mIconHandle = IconModelManager::getInstance()->loadIcon(mFilePath);
+  }
   mWorldObject = NULL;
   mTexture = -1;
   mDepth = 0.0f;
+  mTint.red = 1.0f;
+  mTint.green = 1.0f;
+  mTint.blue = 1.0f;
+  mTint.alpha = 1.0f;
+  mHasRegion = false;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Destructor.
+ * Destructor. Gives back the reference on the icon.
  */
 IconRenderer::~IconRenderer()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  if (mIconHandle != IconModelManager::INVALID_HANDLE)
+  {
+    IconModelManager::getInstance()->releaseIcon(mIconHandle);
+  }
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -77,7 +92,8 @@ QString IconRenderer::getFilePath()
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Returns the OpenGL texture handle for the icon.
+ * Returns the OpenGL texture handle for the icon, i.e. the icon atlas once
+ * the icon got rendered.
  *
  * @return OpenGL texture handle
  */
@@ -101,6 +117,19 @@ float IconRenderer::getDepth()
   return mDepth;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the color the icon gets multiplied with. White by default, which
+ * leaves the icon as is.
+ *
+ * @return Icon tint
+ */
+const SimpleColor& IconRenderer::getTint() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mTint;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Sets the handle to the world object associated with this renderer.
@@ -115,14 +144,30 @@ void IconRenderer::setWorldObject(WorldObject* worldObject)
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Sets the file path of the icon associated with this renderer.
+ * Sets the file path of the icon associated with this renderer. The new icon
+ * is referenced before the old one is released, so an icon set again does not
+ * get evicted in between.
  *
  * @param filePath File path to icon
  */
 void IconRenderer::setFilePath(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  IconModelManager* iconModelManager = IconModelManager::getInstance();
+
+  int iconHandle = IconModelManager::INVALID_HANDLE;
+  if (!filePath.isEmpty())
+  {
+    iconHandle = iconModelManager->loadIcon(filePath);
+  }
+  if (mIconHandle != IconModelManager::INVALID_HANDLE)
+  {
+    iconModelManager->releaseIcon(mIconHandle);
+  }
+
   mFilePath = filePath;
+  mIconHandle = iconHandle;
+  mHasRegion = false;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -155,72 +200,57 @@ void IconRenderer::setDepth(float depth)
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Builds the geometry to render an icon. Also computes the location of the
- * icon on the screen.
+ * Sets the color the icon gets multiplied with, e.g. to color code icons
+ * without loading an image for every color.
+ *
+ * @param tint Icon tint
  */
-void IconRenderer::render()
+void IconRenderer::setTint(const SimpleColor& tint)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  //get texture and depth from current file path
-  IconModelManager::getInstance()->getIcon(mFilePath, mTexture, mDepth);
+  mTint = tint;
+}
 
-  if (mTexture >= 0)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds the icon to the given sprite batch at the screen location of the world
+ * object, unless it is obscured by the earth or behind the camera. Without a
+ * batch, the icon is drawn right away in a batch of its own. The atlas region
+ * is looked up once per icon handle.
+ *
+ * @param batch Sprite batch of the frame, or NULL to draw the icon right away
+ */
+void IconRenderer::render(SpriteBatch* batch)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //get atlas region and depth from current icon handle
+  if (!mHasRegion)
   {
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-
-    //get current screen size and set ortho
-    ScreenCoordinates screenSize = Camera::getInstance()->getScreenSize();
-    glOrtho(0, screenSize.x, 0, screenSize.y, -1, 1);
-
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-
-    SimpleVector screenLocation = mWorldObject->getScreenLocation();
-
-    //only render if world object is not being obscured by the earth
-    //and if projection is not negative (behind the camera, which means screenZ
-    //is below 1.0)
-    if (!Utilities::checkObscure(Camera::getInstance()->getGeodeticPosition(),
-        mWorldObject->getGeodeticPosition()) && screenLocation.z < 1.0)
+    mHasRegion = IconModelManager::getInstance()->getIconRegion(mIconHandle, mRegion, mDepth);
+    if (!mHasRegion)
     {
-      //enable png transparency
-      glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-      glEnable(GL_BLEND);
-      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-      glEnable(GL_TEXTURE_2D);
-      glBindTexture(GL_TEXTURE_2D, mTexture);
-
-      glBegin(GL_QUADS);
-
-      float iconSize = 40.0f;
-
-      glTexCoord3f(0.0f, 0.0f, mDepth);
-      glVertex3f(screenLocation.x - (iconSize/2.0f), screenLocation.y - (iconSize/2.0f), mDepth);
-
-      glTexCoord3f(1.0f, 0.0f, mDepth);
-      glVertex3f(screenLocation.x + (iconSize/2.0f), screenLocation.y - (iconSize/2.0f), mDepth);
-
-      glTexCoord3f(1.0f, 1.0f, mDepth);
-      glVertex3f(screenLocation.x + (iconSize/2.0f), screenLocation.y + (iconSize/2.0f), mDepth);
-
-      glTexCoord3f(0.0f, 1.0f, mDepth);
-      glVertex3f(screenLocation.x - (iconSize/2.0f), screenLocation.y + (iconSize/2.0f), mDepth);
-
-      glEnd();//GL_QUADS
-
-      glDisable(GL_TEXTURE_2D);
-      glDisable(GL_BLEND);
-      glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+      return;
     }
+  }
 
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
+  SimpleVector screenLocation = mWorldObject->getScreenLocation();
 
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
+  //only render if world object is not being obscured by the earth
+  //and if projection is not negative (behind the camera, which means screenZ
+  //is below 1.0)
+  if (!Utilities::checkObscure(Camera::getInstance()->getGeodeticPosition(),
+      mWorldObject->getFrameGeodeticPosition()) && screenLocation.z < 1.0)
+  {
+    if (batch != NULL)
+    {
+      batch->addSprite(screenLocation.x, screenLocation.y, ICON_SIZE, mRegion, mDepth, mTint);
+    }
+    else
+    {
+      SpriteBatch iconBatch;
+      iconBatch.addSprite(screenLocation.x, screenLocation.y, ICON_SIZE, mRegion, mDepth, mTint);
+      mTexture = IconModelManager::getInstance()->getAtlasTexture();
+      iconBatch.render(mTexture);
+    }
   }
 }
@@ -27,11 +27,15 @@
 #include "globals.h"
 
 class WorldObject;
+class SpriteBatch;
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * This class encapsulates the functionality to render an icon (wich is just
- * a 2D image representation of an object).
+ * a 2D image representation of an object). Icons are cut out of the
+ * IconModelManager atlas, the renderer holds a reference on its icon for as
+ * long as it shows it. WorldObjectManager collects the icons of a frame
+ * into one SpriteBatch, icons rendered on their own are drawn right away.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -40,28 +44,36 @@ class IconRenderer
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   public:
+    static const int ICON_SIZE = 40;//in pixels
+
     IconRenderer(const QString& filePath = "");
     ~IconRenderer();
 
-    void render();
+    void render(SpriteBatch* batch = NULL);
 
     //get methods
     WorldObject* getWorldObject();
     QString getFilePath();
     int getTexture();
     float getDepth();
+    const SimpleColor& getTint() const;
 
     //set methods
     void setWorldObject(WorldObject* worldObject);
     void setFilePath(const QString& filePath);
     void setTexture(int texture);
     void setDepth(float depth);
+    void setTint(const SimpleColor& tint);
 
   private:
     WorldObject* mWorldObject;
     QString mFilePath;
+    int mIconHandle;//reference held on the IconModelManager icon
     int mTexture;
     float mDepth;
+    SimpleColor mTint;
+    float mRegion[4];//atlas texture coordinates, see IconModelManager
+    bool mHasRegion;//atlas region looked up for the current icon handle
 };
 
 #endif//ICON_RENDERER_H
@@ -22,6 +22,7 @@
 
 #include <QFileDialog>
 #include <QProgressDialog>
+#include <QInputDialog>
 #include <QDesktopServices>
 #include <QUrl>
 
@@ -34,6 +35,7 @@
 #include "VolumeTool.h"
 #include "MeasuringTool.h"
 #include "Earth.h"
+#include "HillshadeManager.h"
 
 MainWindow* MainWindow::mInstance = NULL;//Singleton implementation
 static ToolManager* toolManager = NULL;
@@ -125,6 +127,9 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
   connect(ui->actionLabels, SIGNAL(triggered()), this, SLOT(onLabels()));
   connect(ui->actionToolbar, SIGNAL(triggered()), this, SLOT(onToolbar()));
   connect(ui->actionLatLonGrid, SIGNAL(triggered()), this, SLOT(onLatLonGrid()));
+  connect(ui->actionContours, SIGNAL(triggered()), this, SLOT(onContours()));
+  connect(ui->actionHillshade, SIGNAL(triggered()), this, SLOT(onHillshade()));
+  connect(ui->actionSunAzimuth, SIGNAL(triggered()), this, SLOT(onSunAzimuth()));
   connect(ui->actionPlaces, SIGNAL(triggered()), this, SLOT(onPlaces()));
   connect(ui->actionTrackInfo, SIGNAL(triggered()), this, SLOT(onTrackInfo()));
   connect(ui->actionPathVolume, SIGNAL(triggered()), this, SLOT(onPathVolume()));
@@ -579,6 +584,46 @@ void MainWindow::onLatLonGrid()
   Earth::getInstance()->setRenderLatLonGrid(ui->actionLatLonGrid->isChecked());
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Qt SLOT. Gets called when the Contour Lines item is selected under the View
+ * menu. Shows/Hides the terrain contour lines around the camera.
+ */
+void MainWindow::onContours()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  Earth::getInstance()->setRenderContours(ui->actionContours->isChecked());
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Qt SLOT. Gets called when the Hillshade item is selected under the View
+ * menu. Shows/Hides the shaded relief on top of the maps.
+ */
+void MainWindow::onHillshade()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  Earth::getInstance()->setRenderHillshade(ui->actionHillshade->isChecked());
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Qt SLOT. Gets called when the Sun Azimuth item is selected under the View
+ * menu. Asks for the direction the hillshade light comes from.
+ */
+void MainWindow::onSunAzimuth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  HillshadeManager* hillshadeManager = HillshadeManager::getInstance();
+  bool isAccepted = false;
+  double azimuth = QInputDialog::getDouble(this, "Sun Azimuth", "Degrees, clockwise from north:",
+                                           hillshadeManager->getSunAzimuth(), 0.0, 360.0, 0, &isAccepted);
+  if (isAccepted)
+  {
+    hillshadeManager->setSunAzimuth(azimuth);
+  }
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Qt SLOT. Gets called when the Places menu item is selected.
@@ -93,6 +93,9 @@ class MainWindow : public QMainWindow, public EventPublisher
     void onLabels();
     void onToolbar();
     void onLatLonGrid();
+    void onContours();
+    void onHillshade();
+    void onSunAzimuth();
     void onPlaces();
     void onTrackInfo();
     void onPathVolume();
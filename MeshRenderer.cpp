@@ -43,6 +43,22 @@ MeshRenderer::~MeshRenderer()
 {
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the XYZ bounding box of the mesh. Override it in renderers whose
+ * extents are known, the default implementation reports unknown extents and
+ * the mesh then gets rendered no matter where the camera is.
+ *
+ * @param minimum Returns the minimum corner of the box
+ * @param maximum Returns the maximum corner of the box
+ * @return True if the extents of the mesh are known
+ */
+bool MeshRenderer::getBounds(SimpleVector&, SimpleVector&)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return false;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Get method for world object attribute.
@@ -23,12 +23,16 @@
 #ifndef MESH_RENDERER_H
 #define MESH_RENDERER_H
 
+#include "globals.h"
+
 class WorldObject;
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Interface definition for a Mesh Renderer. A mesh renderer encapsulates the
- * functionality to render a mesh (a collection of vertices).
+ * functionality to render a mesh (a collection of vertices). Renderers that
+ * know the extents of their mesh report them in getBounds, which lets
+ * WorldObjectManager skip them when they are out of view.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -41,6 +45,7 @@ class MeshRenderer
     virtual ~MeshRenderer();
 
     virtual void render() = 0;//forced override
+    virtual bool getBounds(SimpleVector& minimum, SimpleVector& maximum);
 
     WorldObject* getWorldObject();
     void setWorldObject(WorldObject* worldObject);
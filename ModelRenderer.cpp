@@ -39,15 +39,24 @@ ModelRenderer::ModelRenderer(const QString& filePath) : MeshRenderer()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   mFilePath = filePath;
+  mModelHandle = IconModelManager::INVALID_HANDLE;
+  if (!mFilePath.isEmpty())
+  {
+    mModelHandle = IconModelManager::getInstance()->loadModel(mFilePath);
+  }
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Destructor.
+ * Destructor. Gives back the reference on the model.
  */
 ModelRenderer::~ModelRenderer()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  if (mModelHandle != IconModelManager::INVALID_HANDLE)
+  {
+    IconModelManager::getInstance()->releaseModel(mModelHandle);
+  }
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -62,8 +71,9 @@ void ModelRenderer::render()
 
   //first rotate and translate coordinate system to object
   //coordinate system
-  SimpleVector position = mWorldObject->getPosition();
-  GeodeticPosition geoPosition = mWorldObject->getGeodeticPosition();
+  const WorldObject::FrameState& state = mWorldObject->getFrameState();
+  SimpleVector position = state.position;
+  GeodeticPosition geoPosition = mWorldObject->getFrameGeodeticPosition();
   glRotatef(geoPosition.longitude - 180.0f, 0.0f, 0.0f, 1.0f);
   glRotatef(-1.0f * (90.0f - geoPosition.latitude), 0.0f, 1.0f, 0.0f);
   float radius = sqrt(position.x*position.x + position.y*position.y + position.z*position.z);
@@ -72,19 +82,19 @@ void ModelRenderer::render()
   //rotate around X, Y and Z axis, note rotations
   //are counterclockwise in OpenGL, that is why we
   //give the negative rotation values
-  SimpleVector rotation = mWorldObject->getRotation();
+  SimpleVector rotation = state.rotation;
   glRotatef(-rotation.x, 1.0f, 0.0f, 0.0f);
   glRotatef(-rotation.y, 0.0f, 1.0f, 0.0f);
   glRotatef(-rotation.z, 0.0f, 0.0f, 1.0f);
 
   //set scale
-  SimpleVector scale = mWorldObject->getScale();
+  SimpleVector scale = state.scale;
   glScalef(scale.x, scale.y, scale.z);
 
   void* modelData = NULL;
   int texture = -1;
 
-  bool modelLoaded = IconModelManager::getInstance()->getModel(mFilePath, modelData, texture);
+  bool modelLoaded = IconModelManager::getInstance()->getModel(mModelHandle, modelData, texture);
   if (modelLoaded)
   {
 #ifdef USING_ASSIMP
@@ -111,14 +121,29 @@ const QString& ModelRenderer::getFilePath() const
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Sets the file path of the model associated with this renderer.
+ * Sets the file path of the model associated with this renderer. The new model
+ * is referenced before the old one is released, so a model set again does not
+ * get evicted in between.
  *
  * @param filePath File path to model
  */
 void ModelRenderer::setFilePath(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  IconModelManager* iconModelManager = IconModelManager::getInstance();
+
+  int modelHandle = IconModelManager::INVALID_HANDLE;
+  if (!filePath.isEmpty())
+  {
+    modelHandle = iconModelManager->loadModel(filePath);
+  }
+  if (mModelHandle != IconModelManager::INVALID_HANDLE)
+  {
+    iconModelManager->releaseModel(mModelHandle);
+  }
+
   mFilePath = filePath;
+  mModelHandle = modelHandle;
 }
 
 
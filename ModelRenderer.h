@@ -30,7 +30,8 @@
 /**
  * This class encapsulates the functionality to render a model whose data was
  * previously loaded by the Assimp library (assimp.sourceforge.net). It uses
- * the Assimp library to fetch vertex data. This class inherits from
+ * the Assimp library to fetch vertex data. The renderer holds a reference on
+ * its model for as long as it shows it. This class inherits from
  * MeshRenderer.
  *
  * @version 1.1
@@ -51,6 +52,7 @@ class ModelRenderer : public MeshRenderer
   private:
     void recursiveRender(void* scene, void* node, int texture);
     QString mFilePath;
+    int mModelHandle;//reference held on the IconModelManager model
 };
 
 #endif//MODEL_RENDERER_H
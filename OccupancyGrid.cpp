@@ -0,0 +1,186 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "OccupancyGrid.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. The grid is empty until reset gets called.
+ *
+ * @param cellSize Width and height of a cell in pixels
+ */
+OccupancyGrid::OccupancyGrid(int cellSize)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mCellSize = cellSize;
+  mNumberOfColumns = 0;
+  mNumberOfRows = 0;
+  mWordsPerRow = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+OccupancyGrid::~OccupancyGrid()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Frees the whole grid and sizes it to the given screen. Memory is kept around
+ * for the next frame.
+ *
+ * @param width Screen width in pixels
+ * @param height Screen height in pixels
+ */
+void OccupancyGrid::reset(int width, int height)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mNumberOfColumns = (width + mCellSize - 1) / mCellSize;
+  mNumberOfRows = (height + mCellSize - 1) / mCellSize;
+  mWordsPerRow = (mNumberOfColumns + 63) / 64;
+  mCells.resize(mWordsPerRow * mNumberOfRows);
+  mCells.fill(0);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if no cell covered by the given rectangle is taken. Parts of
+ * the rectangle off the screen are not checked.
+ *
+ * @param left Left edge in pixels
+ * @param bottom Bottom edge in pixels
+ * @param right Right edge in pixels
+ * @param top Top edge in pixels
+ * @return True if the rectangle is free
+ */
+bool OccupancyGrid::isFree(float left, float bottom, float right, float top) const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int firstColumn, firstRow, lastColumn, lastRow;
+  if (!getCellRange(left, bottom, right, top, firstColumn, firstRow, lastColumn, lastRow))
+  {
+    return true;
+  }
+
+  for (int row = firstRow; row <= lastRow; row++)
+  {
+    const quint64* cells = mCells.constData() + row * mWordsPerRow;
+    for (int word = firstColumn / 64; word <= lastColumn / 64; word++)
+    {
+      if ((cells[word] & getColumnMask(word, firstColumn, lastColumn)) != 0)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Marks all cells covered by the given rectangle as taken.
+ *
+ * @param left Left edge in pixels
+ * @param bottom Bottom edge in pixels
+ * @param right Right edge in pixels
+ * @param top Top edge in pixels
+ */
+void OccupancyGrid::occupy(float left, float bottom, float right, float top)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int firstColumn, firstRow, lastColumn, lastRow;
+  if (!getCellRange(left, bottom, right, top, firstColumn, firstRow, lastColumn, lastRow))
+  {
+    return;
+  }
+
+  for (int row = firstRow; row <= lastRow; row++)
+  {
+    quint64* cells = mCells.data() + row * mWordsPerRow;
+    for (int word = firstColumn / 64; word <= lastColumn / 64; word++)
+    {
+      cells[word] |= getColumnMask(word, firstColumn, lastColumn);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the cells covered by the given rectangle, clipped to the screen.
+ *
+ * @param left Left edge in pixels
+ * @param bottom Bottom edge in pixels
+ * @param right Right edge in pixels
+ * @param top Top edge in pixels
+ * @param firstColumn Returns the leftmost column covered
+ * @param firstRow Returns the lowest row covered
+ * @param lastColumn Returns the rightmost column covered
+ * @param lastRow Returns the highest row covered
+ * @return False if the rectangle is completely off the screen
+ */
+bool OccupancyGrid::getCellRange(float left, float bottom, float right, float top,
+                                 int& firstColumn, int& firstRow, int& lastColumn, int& lastRow) const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //edges are rounded to whole pixels, right and top edges being exclusive,
+  //and are positive past this check so truncating rounds down
+  if (right <= 0.5f || top <= 0.5f)
+  {
+    return false;
+  }
+
+  firstColumn = (left > 0.0f) ? (int)(left / mCellSize) : 0;
+  firstRow = (bottom > 0.0f) ? (int)(bottom / mCellSize) : 0;
+  lastColumn = qMin(mNumberOfColumns - 1, (int)((right - 0.5f) / mCellSize));
+  lastRow = qMin(mNumberOfRows - 1, (int)((top - 0.5f) / mCellSize));
+
+  return (firstColumn <= lastColumn && firstRow <= lastRow);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the bits of the given row word that fall within the given columns.
+ *
+ * @param word Index of the 64 column word within a row
+ * @param firstColumn Leftmost column
+ * @param lastColumn Rightmost column
+ * @return Bit mask of the columns within the word
+ */
+quint64 OccupancyGrid::getColumnMask(int word, int firstColumn, int lastColumn)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int firstBit = qMax(firstColumn - word * 64, 0);
+  int lastBit = qMin(lastColumn - word * 64, 63);
+
+  quint64 mask = ~Q_UINT64_C(0) << firstBit;
+  if (lastBit < 63)
+  {
+    mask &= (Q_UINT64_C(1) << (lastBit + 1)) - 1;
+  }
+
+  return mask;
+}
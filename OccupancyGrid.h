@@ -0,0 +1,67 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <QVector>
+#include <QtGlobal>
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This class keeps track of which parts of the screen are taken, e.g. by the
+ * labels placed so far in a frame. The screen is split into square cells and
+ * rectangles are rounded out to whole cells, so testing or taking a rectangle
+ * only touches the few cells it covers, no matter how many rectangles were
+ * placed before. Rectangles are in pixels with the origin at the lower left
+ * corner of the screen, like OpenGL window coordinates.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class OccupancyGrid
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int DEFAULT_CELL_SIZE = 8;//in pixels
+
+    OccupancyGrid(int cellSize = DEFAULT_CELL_SIZE);
+    ~OccupancyGrid();
+
+    void reset(int width, int height);
+    bool isFree(float left, float bottom, float right, float top) const;
+    void occupy(float left, float bottom, float right, float top);
+
+  private:
+    bool getCellRange(float left, float bottom, float right, float top,
+                      int& firstColumn, int& firstRow, int& lastColumn, int& lastRow) const;
+    static quint64 getColumnMask(int word, int firstColumn, int lastColumn);
+
+    int mCellSize;
+    int mNumberOfColumns;
+    int mNumberOfRows;
+    int mWordsPerRow;
+    QVector<quint64> mCells;//row by row from the bottom, bit set if taken
+};
+
+#endif//OCCUPANCY_GRID_H
@@ -0,0 +1,540 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "PathProfile.h"
+#include "ElevationManager.h"
+#include "Constants.h"
+#include "math.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+PathProfile::PathProfile()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mSampleSpacing = 0.03;//Km, about 1 arc-second
+  mVertexHeight = 0.002;//Km
+  mRefractionCoefficient = 0.13;
+  clear();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+PathProfile::~PathProfile()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Builds the profile of the given path. Every leg is split into samples along
+ * the great circle between its two vertices, then all samples are read from
+ * ElevationManager in a single batch. Elevations that are not loaded yet are
+ * not waited for, the profile is flagged as incomplete instead so the caller
+ * can build it again later on (see getIsIncomplete).
+ *
+ * @param points Path vertices in XYZ coordinates
+ */
+void PathProfile::build(const QList<SimpleVector>& points)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  clear();
+
+  int numberOfVertices = points.size();
+  if (numberOfVertices < 2)
+  {
+    return;
+  }
+
+  //unit vectors to the vertices and angles between consecutive ones
+  QVector<SimpleVector> directions(numberOfVertices);
+  QVector<double> legAngles(numberOfVertices - 1);
+  double totalAngle = 0.0;
+  for (int i = 0; i < numberOfVertices; i++)
+  {
+    const SimpleVector& point = points[i];
+    double length = sqrt(point.x*point.x + point.y*point.y + point.z*point.z);
+    if (length > 0.0)
+    {
+      directions[i].x = point.x / length;
+      directions[i].y = point.y / length;
+      directions[i].z = point.z / length;
+    }
+    else
+    {
+      directions[i].x = 1.0;
+      directions[i].y = 0.0;
+      directions[i].z = 0.0;
+    }
+
+    if (i > 0)
+    {
+      const SimpleVector& a = directions[i - 1];
+      const SimpleVector& b = directions[i];
+      double crossX = a.y*b.z - a.z*b.y;
+      double crossY = a.z*b.x - a.x*b.z;
+      double crossZ = a.x*b.y - a.y*b.x;
+      double dot = a.x*b.x + a.y*b.y + a.z*b.z;
+      legAngles[i - 1] = atan2(sqrt(crossX*crossX + crossY*crossY + crossZ*crossZ), dot);
+      totalAngle += legAngles[i - 1];
+    }
+  }
+
+  //long paths get a wider spacing so the number of samples stays bounded
+  double totalLength = totalAngle * Constants::EARTH_MEAN_RADIUS;
+  double sampleSpacing = qMax(mSampleSpacing, totalLength / (double)(MAXIMUM_NUMBER_OF_SAMPLES - 1));
+
+  QVector<double> latitudes;
+  QVector<double> longitudes;
+  int estimatedNumberOfSamples = (int)(totalLength / sampleSpacing) + numberOfVertices + 1;
+  latitudes.reserve(estimatedNumberOfSamples);
+  longitudes.reserve(estimatedNumberOfSamples);
+  mDistances.reserve(estimatedNumberOfSamples);
+  mVertexSamples.resize(numberOfVertices);
+
+  //spherical interpolation along every leg, the last vertex is added below
+  double distance = 0.0;
+  for (int leg = 0; leg < numberOfVertices - 1; leg++)
+  {
+    const SimpleVector& a = directions[leg];
+    const SimpleVector& b = directions[leg + 1];
+    double angle = legAngles[leg];
+    double sinAngle = sin(angle);
+    double legLength = angle * Constants::EARTH_MEAN_RADIUS;
+    int numberOfSteps = qMax(1, (int)ceil(legLength / sampleSpacing));
+
+    mVertexSamples[leg] = latitudes.size();
+    for (int step = 0; step < numberOfSteps; step++)
+    {
+      double fraction = (double)step / (double)numberOfSteps;
+      double weightA = 1.0;
+      double weightB = 0.0;
+      if (sinAngle > 1e-12)
+      {
+        weightA = sin((1.0 - fraction) * angle) / sinAngle;
+        weightB = sin(fraction * angle) / sinAngle;
+      }
+
+      double x = weightA*a.x + weightB*b.x;
+      double y = weightA*a.y + weightB*b.y;
+      double z = weightA*a.z + weightB*b.z;
+      latitudes.append(atan2(z, sqrt(x*x + y*y)) * Constants::RADIANS_TO_DEGREES);
+      longitudes.append(atan2(y, x) * Constants::RADIANS_TO_DEGREES);
+      mDistances.append(distance + legLength * fraction);
+    }
+
+    distance += legLength;
+  }
+
+  const SimpleVector& last = directions[numberOfVertices - 1];
+  mVertexSamples[numberOfVertices - 1] = latitudes.size();
+  latitudes.append(atan2(last.z, sqrt(last.x*last.x + last.y*last.y)) * Constants::RADIANS_TO_DEGREES);
+  longitudes.append(atan2(last.y, last.x) * Constants::RADIANS_TO_DEGREES);
+  mDistances.append(distance);
+
+  //sample the whole path in one batch
+  ElevationManager* elevationManager = ElevationManager::getInstance();
+  mElevations.resize(latitudes.size());
+  elevationManager->getElevations(latitudes.data(), longitudes.data(), mElevations.data(), latitudes.size());
+  mIsIncomplete = elevationManager->getIsLoading();
+
+  computeSlopes();
+  computeStatistics();
+  findBlockers();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Empties the profile. Settings are kept.
+ */
+void PathProfile::clear()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mIsIncomplete = false;
+  mDistances.clear();
+  mElevations.clear();
+  mSlopes.clear();
+  mVertexSamples.clear();
+  mBlockers.clear();
+  mMinimumElevation = 0.0f;
+  mMaximumElevation = 0.0f;
+  mMaximumSlope = 0.0f;
+  mTotalClimb = 0.0;
+  mTotalDescent = 0.0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the slope at every sample as the grade between its neighbouring
+ * samples.
+ */
+void PathProfile::computeSlopes()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int numberOfSamples = mElevations.size();
+  mSlopes.resize(numberOfSamples);
+
+  for (int i = 0; i < numberOfSamples; i++)
+  {
+    int previous = qMax(i - 1, 0);
+    int next = qMin(i + 1, numberOfSamples - 1);
+    double run = mDistances[next] - mDistances[previous];
+
+    //repeated vertices give samples with no run in between
+    if (run > 0.0)
+    {
+      mSlopes[i] = (float)((mElevations[next] - mElevations[previous]) / run * 100.0);
+    }
+    else
+    {
+      mSlopes[i] = 0.0f;
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the elevation range, the steepest slope and the total climb and
+ * descent of the profile.
+ */
+void PathProfile::computeStatistics()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int numberOfSamples = mElevations.size();
+  const float* elevations = mElevations.constData();
+  const float* slopes = mSlopes.constData();
+
+  mMinimumElevation = elevations[0];
+  mMaximumElevation = elevations[0];
+  mMaximumSlope = fabs(slopes[0]);
+  for (int i = 1; i < numberOfSamples; i++)
+  {
+    float elevation = elevations[i];
+    mMinimumElevation = qMin(mMinimumElevation, elevation);
+    mMaximumElevation = qMax(mMaximumElevation, elevation);
+    mMaximumSlope = qMax(mMaximumSlope, (float)fabs(slopes[i]));
+
+    float rise = elevation - elevations[i - 1];
+    if (rise > 0.0f)
+    {
+      mTotalClimb += rise;
+    }
+    else
+    {
+      mTotalDescent -= rise;
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Checks every leg for line of sight between its two vertices (raised by the
+ * vertex height) and records the samples where terrain gets above the sight
+ * line. Terrain is raised by the Earth's bulge between both vertices, reduced
+ * by refraction, which is equivalent to the curvature drop used by Viewshed.
+ */
+void PathProfile::findBlockers()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double curvatureFactor = (1.0 - mRefractionCoefficient) / (2.0 * Constants::EARTH_MEAN_RADIUS);
+  const double* distances = mDistances.constData();
+  const float* elevations = mElevations.constData();
+
+  for (int leg = 0; leg < mVertexSamples.size() - 1; leg++)
+  {
+    int first = mVertexSamples[leg];
+    int last = mVertexSamples[leg + 1];
+    double legLength = distances[last] - distances[first];
+    if (last - first < 2 || legLength <= 0.0)
+    {
+      continue;
+    }
+
+    double start = elevations[first] + mVertexHeight;
+    double slope = (elevations[last] + mVertexHeight - start) / legLength;
+    for (int i = first + 1; i < last; i++)
+    {
+      double distance = distances[i] - distances[first];
+      double terrain = elevations[i] + distance*(legLength - distance)*curvatureFactor;
+      if (terrain > start + slope*distance)
+      {
+        mBlockers.append(i);
+      }
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the profile has no samples, i.e. it has not been built or
+ * the path had less than two vertices.
+ *
+ * @return True if the profile is empty
+ */
+bool PathProfile::getIsEmpty() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mElevations.isEmpty();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if elevation datasets were still being loaded when the profile
+ * was built, in which case some of its elevations might be coarser than they
+ * will be once loading is done.
+ *
+ * @return True if the profile should be built again
+ */
+bool PathProfile::getIsIncomplete() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mIsIncomplete;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of samples along the path.
+ *
+ * @return Number of samples
+ */
+int PathProfile::getNumberOfSamples() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mElevations.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the distance of every sample from the start of the path.
+ *
+ * @return Distances in Km
+ */
+const QVector<double>& PathProfile::getDistances() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mDistances;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the terrain elevation of every sample.
+ *
+ * @return Elevations in Km
+ */
+const QVector<float>& PathProfile::getElevations() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mElevations;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the terrain slope at every sample, positive going uphill.
+ *
+ * @return Slopes as a grade in percent
+ */
+const QVector<float>& PathProfile::getSlopes() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSlopes;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the index of the sample at every vertex of the path.
+ *
+ * @return Sample indices, one per vertex
+ */
+const QVector<int>& PathProfile::getVertexSamples() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mVertexSamples;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the samples where terrain blocks the line of sight between the two
+ * vertices of their leg, in increasing order.
+ *
+ * @return Sample indices of line of sight blockers
+ */
+const QVector<int>& PathProfile::getBlockers() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mBlockers;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the length of the path along the surface.
+ *
+ * @return Length in Km
+ */
+double PathProfile::getLength() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mDistances.isEmpty() ? 0.0 : mDistances.last();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the lowest terrain elevation along the path.
+ *
+ * @return Minimum elevation in Km
+ */
+float PathProfile::getMinimumElevation() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mMinimumElevation;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the highest terrain elevation along the path.
+ *
+ * @return Maximum elevation in Km
+ */
+float PathProfile::getMaximumElevation() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mMaximumElevation;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the steepest slope along the path, uphill or downhill.
+ *
+ * @return Maximum absolute slope as a grade in percent
+ */
+float PathProfile::getMaximumSlope() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mMaximumSlope;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the sum of all elevation gains along the path.
+ *
+ * @return Total climb in Km
+ */
+double PathProfile::getTotalClimb() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mTotalClimb;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the sum of all elevation losses along the path.
+ *
+ * @return Total descent in Km
+ */
+double PathProfile::getTotalDescent() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mTotalDescent;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the distance between samples. Takes effect on the next build, long
+ * paths might get a wider spacing (see MAXIMUM_NUMBER_OF_SAMPLES).
+ *
+ * @param kilometers Sample spacing in Km
+ */
+void PathProfile::setSampleSpacing(double kilometers)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (kilometers > 0.0)
+  {
+    mSampleSpacing = kilometers;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the distance between samples.
+ *
+ * @return Sample spacing in Km
+ */
+double PathProfile::getSampleSpacing() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSampleSpacing;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the height above ground of the vertices for the line of sight check.
+ * Takes effect on the next build.
+ *
+ * @param kilometers Vertex height in Km
+ */
+void PathProfile::setVertexHeight(double kilometers)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mVertexHeight = kilometers;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the height above ground of the vertices for the line of sight check.
+ *
+ * @return Vertex height in Km
+ */
+double PathProfile::getVertexHeight() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mVertexHeight;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the atmospheric refraction coefficient for the line of sight check.
+ * Takes effect on the next build.
+ *
+ * @param refractionCoefficient Refraction coefficient, 0.13 for standard
+ *        atmosphere
+ */
+void PathProfile::setRefractionCoefficient(double refractionCoefficient)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mRefractionCoefficient = refractionCoefficient;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the atmospheric refraction coefficient.
+ *
+ * @return Refraction coefficient
+ */
+double PathProfile::getRefractionCoefficient() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mRefractionCoefficient;
+}
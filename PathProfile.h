@@ -0,0 +1,105 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef PATH_PROFILE_H
+#define PATH_PROFILE_H
+
+#include <QList>
+#include <QVector>
+#include "globals.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Terrain elevation profile along a path. build densifies the legs of the path
+ * along great circles, samples ElevationManager once for the whole path and
+ * derives distance, elevation and slope series from the samples, along with
+ * summary statistics. Every leg is also checked for line of sight between its
+ * two vertices (accounting for Earth curvature and refraction), samples where
+ * the terrain blocks it are reported as blockers.
+ *
+ * The number of samples is capped at about MAXIMUM_NUMBER_OF_SAMPLES by
+ * widening the sample spacing on long paths, so building a profile stays
+ * cheap enough to be done interactively even for paths with thousands of
+ * vertices. Profiles are plain values, copying one is cheap since the series
+ * are implicitly shared.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class PathProfile
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int MAXIMUM_NUMBER_OF_SAMPLES = 8192;
+    PathProfile();
+    ~PathProfile();
+
+    void build(const QList<SimpleVector>& points);
+    void clear();
+
+    bool getIsEmpty() const;
+    bool getIsIncomplete() const;
+    int getNumberOfSamples() const;
+    const QVector<double>& getDistances() const;
+    const QVector<float>& getElevations() const;
+    const QVector<float>& getSlopes() const;
+    const QVector<int>& getVertexSamples() const;
+    const QVector<int>& getBlockers() const;
+    double getLength() const;
+    float getMinimumElevation() const;
+    float getMaximumElevation() const;
+    float getMaximumSlope() const;
+    double getTotalClimb() const;
+    double getTotalDescent() const;
+
+    void setSampleSpacing(double kilometers);
+    double getSampleSpacing() const;
+    void setVertexHeight(double kilometers);
+    double getVertexHeight() const;
+    void setRefractionCoefficient(double refractionCoefficient);
+    double getRefractionCoefficient() const;
+
+  private:
+    void computeSlopes();
+    void computeStatistics();
+    void findBlockers();
+
+    double mSampleSpacing;
+    double mVertexHeight;
+    double mRefractionCoefficient;
+    bool mIsIncomplete;
+
+    QVector<double> mDistances;
+    QVector<float> mElevations;
+    QVector<float> mSlopes;
+    QVector<int> mVertexSamples;
+    QVector<int> mBlockers;
+    float mMinimumElevation;
+    float mMaximumElevation;
+    float mMaximumSlope;
+    double mTotalClimb;
+    double mTotalDescent;
+};
+
+#endif//PATH_PROFILE_H
@@ -0,0 +1,176 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <QPainter>
+#include "PathProfileWidget.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor.
+ *
+ * @param parent Handle to parent widget
+ */
+PathProfileWidget::PathProfileWidget(QWidget *parent) : QWidget(parent)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+PathProfileWidget::~PathProfileWidget()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the profile to plot and repaints the widget. The profile is copied, so
+ * it can be rebuilt afterwards without affecting the plot.
+ *
+ * @param profile Profile to plot
+ */
+void PathProfileWidget::setProfile(const PathProfile& profile)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mProfile = profile;
+  update();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the plotted profile.
+ *
+ * @return Plotted profile
+ */
+const PathProfile& PathProfileWidget::getProfile() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mProfile;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * OVERRIDE FOR QWidget. Plots the profile. Every pixel column is filled up to
+ * the highest terrain within it (interpolated when columns are narrower than
+ * the sample spacing) and marked in red if any of its samples blocks the line
+ * of sight.
+ *
+ * @param event Qt's paint event (not used but necessary for override)
+ */
+void PathProfileWidget::paintEvent(QPaintEvent*)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QPainter painter(this);
+  int width = this->width();
+  int height = this->height();
+  painter.fillRect(0, 0, width, height, QColor(20, 20, 30));
+
+  int numberOfSamples = mProfile.getNumberOfSamples();
+  double length = mProfile.getLength();
+  if (numberOfSamples < 2 || length <= 0.0 || width < 2 || height < 2)
+  {
+    return;
+  }
+
+  const double* distances = mProfile.getDistances().constData();
+  const float* elevations = mProfile.getElevations().constData();
+  const QVector<int>& blockers = mProfile.getBlockers();
+  const QVector<int>& vertexSamples = mProfile.getVertexSamples();
+
+  //leave some room on top for the sight lines, flat paths get a 10m range
+  double minimum = mProfile.getMinimumElevation();
+  double range = qMax(mProfile.getMaximumElevation() - minimum, 0.01) * 1.2;
+  double scaleX = (double)(width - 1) / length;
+  double scaleY = (double)(height - 1) / range;
+
+  QColor terrainColor(120, 150, 90);
+  QColor blockerColor(230, 40, 40);
+  int sample = 0;
+  int blocker = 0;
+  for (int column = 0; column < width; column++)
+  {
+    double columnStart = (double)column / scaleX;
+    double columnEnd = (double)(column + 1) / scaleX;
+
+    //terrain at the left edge of the column
+    double top;
+    if (sample == 0)
+    {
+      top = elevations[0];
+    }
+    else if (sample >= numberOfSamples)
+    {
+      top = elevations[numberOfSamples - 1];
+    }
+    else
+    {
+      double run = distances[sample] - distances[sample - 1];
+      double fraction = run > 0.0 ? (columnStart - distances[sample - 1]) / run : 1.0;
+      top = elevations[sample - 1] + (elevations[sample] - elevations[sample - 1]) * fraction;
+    }
+
+    //plus every sample falling inside it
+    bool isBlocked = false;
+    while (sample < numberOfSamples && distances[sample] < columnEnd)
+    {
+      top = qMax(top, (double)elevations[sample]);
+      while (blocker < blockers.size() && blockers[blocker] < sample)
+      {
+        blocker++;
+      }
+      if (blocker < blockers.size() && blockers[blocker] == sample)
+      {
+        isBlocked = true;
+      }
+      sample++;
+    }
+
+    int y = height - 1 - (int)((top - minimum) * scaleY);
+    painter.setPen(terrainColor);
+    painter.drawLine(column, height - 1, column, y);
+    if (isBlocked)
+    {
+      painter.setPen(blockerColor);
+      painter.drawLine(column, y, column, y + 2);
+    }
+  }
+
+  //sight lines, only while legs are wide enough to tell them apart
+  if ((vertexSamples.size() - 1) * 4 <= width)
+  {
+    double vertexHeight = mProfile.getVertexHeight();
+    painter.setPen(QColor(240, 220, 60));
+    for (int leg = 0; leg < vertexSamples.size() - 1; leg++)
+    {
+      int first = vertexSamples[leg];
+      int last = vertexSamples[leg + 1];
+      painter.drawLine((int)(distances[first] * scaleX),
+                       height - 1 - (int)((elevations[first] + vertexHeight - minimum) * scaleY),
+                       (int)(distances[last] * scaleX),
+                       height - 1 - (int)((elevations[last] + vertexHeight - minimum) * scaleY));
+    }
+  }
+}
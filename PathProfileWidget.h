@@ -0,0 +1,58 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef PATH_PROFILE_WIDGET_H
+#define PATH_PROFILE_WIDGET_H
+
+#include <QWidget>
+#include "PathProfile.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This class encapsulates a widget that plots a PathProfile: terrain elevation
+ * against distance, with the samples blocking line of sight marked in red and
+ * the sight line of every leg on top. The profile is reduced to one column per
+ * pixel when painting, so paint time does not depend on the path length.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class PathProfileWidget : public QWidget
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  Q_OBJECT
+
+  public:
+    PathProfileWidget(QWidget *parent = 0);
+    ~PathProfileWidget();
+
+    void setProfile(const PathProfile& profile);
+    const PathProfile& getProfile() const;
+    void paintEvent(QPaintEvent* event);//OVERRIDE
+
+  private:
+    PathProfile mProfile;
+};
+
+#endif//PATH_PROFILE_WIDGET_H
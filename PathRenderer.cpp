@@ -25,6 +25,7 @@
 #include "Utilities.h"
 #include "WorldObject.h"
 #include "Camera.h"
+#include "ElevationManager.h"
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
@@ -33,6 +34,7 @@
 PathRenderer::PathRenderer() : MeshRenderer()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  mProfileIsDirty = true;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -60,7 +62,7 @@ void PathRenderer::render()
     //only render if first point is not being obscured by the earth
     if (!Utilities::checkObscure(Camera::getInstance()->getGeodeticPosition(), pointGeodetic))
     {
-      SimpleColor color = mWorldObject->getColor();
+      SimpleColor color = mWorldObject->getFrameState().color;
       glColor4f(color.red, color.green, color.blue, 1.0f);
 
       glDisable(GL_DEPTH_TEST);
@@ -77,6 +79,37 @@ void PathRenderer::render()
   }
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * OVERRIDE FOR MeshRenderer. Returns the bounding box of the path points.
+ *
+ * @param minimum Returns the minimum corner of the box
+ * @param maximum Returns the maximum corner of the box
+ * @return True if the path has points
+ */
+bool PathRenderer::getBounds(SimpleVector& minimum, SimpleVector& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mPoints.isEmpty())
+  {
+    return false;
+  }
+
+  minimum = mPoints[0];
+  maximum = mPoints[0];
+  for (int i = 1; i < mPoints.size(); i++)
+  {
+    minimum.x = qMin(minimum.x, mPoints[i].x);
+    minimum.y = qMin(minimum.y, mPoints[i].y);
+    minimum.z = qMin(minimum.z, mPoints[i].z);
+    maximum.x = qMax(maximum.x, mPoints[i].x);
+    maximum.y = qMax(maximum.y, mPoints[i].y);
+    maximum.z = qMax(maximum.z, mPoints[i].z);
+  }
+
+  return true;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Adds a point to the path.
@@ -87,6 +120,7 @@ void PathRenderer::addPoint(SimpleVector point)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   mPoints.append(point);
+  mProfileIsDirty = true;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -100,3 +134,48 @@ QList<SimpleVector>* PathRenderer::getPoints()
 {
   return &mPoints;
 }
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the terrain profile along the path, building it if the path changed
+ * since it was last built, or if elevations were still being loaded back then
+ * and loading is done by now.
+ *
+ * @return Terrain profile of the path
+ */
+const PathProfile& PathRenderer::getProfile()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (getIsProfileOutdated())
+  {
+    mProfile.build(mPoints);
+    mProfileIsDirty = false;
+  }
+
+  return mProfile;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the next getProfile call builds the profile again, i.e. if
+ * the path changed or elevations got loaded since it was last built.
+ *
+ * @return True if the cached profile is out of date
+ */
+bool PathRenderer::getIsProfileOutdated()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (mProfileIsDirty ||
+          (mProfile.getIsIncomplete() && !ElevationManager::getInstance()->getIsLoading()));
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Drops the cached terrain profile. Needs to be called after modifying the
+ * points through getPoints.
+ */
+void PathRenderer::invalidateProfile()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mProfileIsDirty = true;
+}
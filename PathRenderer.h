@@ -24,6 +24,7 @@
 #define PATH_RENDERER_H
 
 #include "MeshRenderer.h"
+#include "PathProfile.h"
 #include "globals.h"
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -31,7 +32,8 @@
  * This class encapsulates the functionality to render a path. A path is a line
  * that connects multiple segments. This class inherits from MeshRenderer. Even
  * though a path is not really a "mesh", this is done for orthogonality
- * purposes.
+ * purposes. The terrain profile along the path is built the first time it is
+ * asked for and cached until the path changes.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -44,11 +46,17 @@ class PathRenderer : public MeshRenderer
     ~PathRenderer();
 
     void render();//OVERRIDE
+    bool getBounds(SimpleVector& minimum, SimpleVector& maximum);//OVERRIDE
     void addPoint(SimpleVector point);
     QList<SimpleVector>* getPoints();
+    const PathProfile& getProfile();
+    bool getIsProfileOutdated();
+    void invalidateProfile();
 
   private:
     QList<SimpleVector> mPoints;
+    PathProfile mProfile;
+    bool mProfileIsDirty;
 };
 
 #endif//PATH_RENDERER_H
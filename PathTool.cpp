@@ -22,7 +22,7 @@
 
 #include <QtOpenGL>
 #include "PathTool.h"
-#include "PathRenderer.h"
+#include "PathWindow.h"
 #include "WorldObjectManager.h"
 #include "Utilities.h"
 
@@ -37,7 +37,6 @@
 PathTool::PathTool(QToolButton* toolButton, QDialog* dialog) : Tool("Path", toolButton, dialog)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  mCurrentNumberOfPoints = 0;
   mClickCordinates.x = 0;
   mClickCordinates.y = 0;
   mAddPoint = false;
@@ -63,7 +62,8 @@ PathTool::~PathTool()
 void PathTool::initialize()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  mCurrentNumberOfPoints = 0;
+  mPath.getPoints()->clear();
+  mPath.invalidateProfile();
   mAddPoint = false;
 }
 
@@ -76,29 +76,46 @@ void PathTool::render()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   //check if we need a projection computation because we are adding a point
-  if (mAddPoint && mCurrentNumberOfPoints < MAX_NUMBER_OF_POINTS)
+  if (mAddPoint)
   {
-    //convert click coordinates and add point to our list
-    mPoints[mCurrentNumberOfPoints] = Utilities::screenToWorld(mClickCordinates);
-
+    //convert click coordinates and add point to our path
+    mPath.addPoint(Utilities::screenToWorld(mClickCordinates));
     mAddPoint = false;
-    mCurrentNumberOfPoints++;
+  }
+
+  //the path changed or elevations got loaded after the profile was built
+  if (mPath.getIsProfileOutdated())
+  {
+    updateProfile();
   }
 
   //render path
   glColor4f(mColor.red, mColor.green, mColor.blue, 1.0f);
   glDisable(GL_DEPTH_TEST);
   glLineWidth(2.0f);
+  QList<SimpleVector>* points = mPath.getPoints();
   glBegin(GL_LINE_STRIP);
-  for (int i = 0; i < mCurrentNumberOfPoints; i++)
+  for (int i = 0; i < points->size(); i++)
   {
-    glVertex3f(mPoints[i].x, mPoints[i].y, mPoints[i].z);
+    glVertex3f((*points)[i].x, (*points)[i].y, (*points)[i].z);
   }
   glEnd();
   glLineWidth(1.0f);
   glEnable(GL_DEPTH_TEST);
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Rebuilds the terrain profile of the current path and shows it on the path
+ * window.
+ */
+void PathTool::updateProfile()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  PathWindow* pathWindow = (PathWindow*)mDialog;
+  pathWindow->setProfile(mPath.getProfile());
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Sets the name for this path.
@@ -134,7 +151,8 @@ bool PathTool::addCurrent()
   bool returnValue = true;
 
   //only add path if it has more than 1 point
-  if (mCurrentNumberOfPoints > 1)
+  QList<SimpleVector>* points = mPath.getPoints();
+  if (points->size() > 1)
   {
     WorldObject* worldObject = new WorldObject();
     worldObject->setName(mName);
@@ -143,9 +161,9 @@ bool PathTool::addCurrent()
 
     //instantiate path renderer and associate it with world object
     PathRenderer* pathRenderer = new PathRenderer();
-    for (int i = 0; i < mCurrentNumberOfPoints; i++)
+    for (int i = 0; i < points->size(); i++)
     {
-      pathRenderer->addPoint(mPoints[i]);
+      pathRenderer->addPoint((*points)[i]);
     }
     worldObject->setMeshRenderer(pathRenderer);
 
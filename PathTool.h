@@ -25,12 +25,15 @@
 
 #include <QMouseEvent>
 #include "Tool.h"
+#include "PathRenderer.h"
 #include "globals.h"
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * This class encapsulates the functionality behind path tool rendering. This
- * class inherits from Tool.
+ * class inherits from Tool. The path being drawn is kept in a PathRenderer,
+ * whose terrain profile is shown on the PathWindow and rebuilt every time a
+ * point is added.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -39,7 +42,6 @@ class PathTool : public Tool
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   public:
-    static const int MAX_NUMBER_OF_POINTS = 50;
     PathTool(QToolButton* toolButton = 0, QDialog* dialog = 0);
     ~PathTool();
 
@@ -51,8 +53,9 @@ class PathTool : public Tool
     void onMouseReleaseEvent(QMouseEvent* event);
 
   private:
-    SimpleVector mPoints[MAX_NUMBER_OF_POINTS];
-    int mCurrentNumberOfPoints;
+    void updateProfile();
+
+    PathRenderer mPath;//path being drawn, not managed by any world object
     ScreenCoordinates mClickCordinates;
     bool mAddPoint;
     QString mName;
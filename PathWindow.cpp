@@ -82,6 +82,36 @@ void PathWindow::initialize()
   //get handle to PathTool
   PathTool* pathTool = (PathTool*)ToolManager::getInstance()->getTool("Path");
   pathTool->initialize();
+
+  setProfile(PathProfile());
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Shows the terrain profile of the current path along with its statistics.
+ *
+ * @param profile Terrain profile of the current path
+ */
+void PathWindow::setProfile(const PathProfile& profile)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ui->profile->setProfile(profile);
+
+  if (profile.getIsEmpty())
+  {
+    ui->statistics->setText("Click on the map to add points to the path.");
+  }
+  else
+  {
+    ui->statistics->setText(
+      "Length: " + QString::number(profile.getLength(), 'f', 2) + " Km" +
+      "   Min: " + QString::number(profile.getMinimumElevation() * 1000.0f, 'f', 0) + " m" +
+      "   Max: " + QString::number(profile.getMaximumElevation() * 1000.0f, 'f', 0) + " m" +
+      "   Max slope: " + QString::number(profile.getMaximumSlope(), 'f', 1) + "%\n" +
+      "Climb: " + QString::number(profile.getTotalClimb() * 1000.0, 'f', 0) + " m" +
+      "   Descent: " + QString::number(profile.getTotalDescent() * 1000.0, 'f', 0) + " m" +
+      "   Line of sight blockers: " + QString::number(profile.getBlockers().size()));
+  }
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -24,6 +24,7 @@
 #define PATH_WINDOW_H
 
 #include <QDialog>
+#include "PathProfile.h"
 
 namespace Ui
 {
@@ -34,7 +35,7 @@ namespace Ui
 /**
  * This class encapsulates the Path Tool window for the system. Refer to
  * PathWindow.ui for a description of the GUI layout and widget variable
- * names.
+ * names. The window shows the terrain profile of the path being drawn.
  *
  * @version 1.1
  * @author Hector Mendoza
@@ -49,6 +50,7 @@ class PathWindow : public QDialog
     ~PathWindow();
 
     void initialize();
+    void setProfile(const PathProfile& profile);
     void closeEvent(QCloseEvent* event);//OVERRIDE
 
   public slots:
@@ -0,0 +1,877 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QThread>
+#include <stdio.h>
+#include "QuantizedMeshManager.h"
+#include "QuantizedMeshThread.h"
+#include "math.h"
+
+//zip archive record signatures
+static const quint32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const quint32 CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static const quint32 END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+static const int END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+static const int METHOD_STORED = 0;
+static const int METHOD_DEFLATED = 8;
+
+QuantizedMeshManager* QuantizedMeshManager::mInstance = NULL;
+
+static quint16 readUint16(const uchar* data)
+{
+  return (quint16)(data[0] | (data[1] << 8));
+}
+
+static quint32 readUint32(const uchar* data)
+{
+  return (quint32)data[0] | ((quint32)data[1] << 8) | ((quint32)data[2] << 16) | ((quint32)data[3] << 24);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+QuantizedMeshManager::QuantizedMeshManager()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mIsOpen = false;
+  mIsPack = false;
+  mMappedPack = NULL;
+  mPackSize = 0;
+  mMaximumLevel = -1;
+  mIsStopping = false;
+  mFrame = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. Stops the threads and releases all tiles.
+ */
+QuantizedMeshManager::~QuantizedMeshManager()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  closeTerrain();
+  mInstance = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the singleton instance of this class.
+ *
+ * @return Singleton instance of this class
+ */
+QuantizedMeshManager* QuantizedMeshManager::getInstance()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mInstance == 0)
+  {
+    mInstance = new QuantizedMeshManager();
+  }
+
+  return mInstance;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Opens a quantized-mesh terrain, closing the one open before. The path is
+ * either a directory with level/x/y.terrain files in it (as terrain tilers
+ * write them) or a zip archive with the same layout. Only the list of levels
+ * (or the archive directory) is read here, tiles are read as needed.
+ *
+ * @param path Terrain directory or zip archive
+ * @return True if the terrain was opened
+ */
+bool QuantizedMeshManager::openTerrain(const QString& path)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  closeTerrain();
+
+  mPath = path;
+  mIsPack = !QFileInfo(path).isDir();
+  bool isOpen = mIsPack ? openPack(path) : openDirectory(path);
+  if (!isOpen)
+  {
+    closeTerrain();
+    return false;
+  }
+
+  mIsOpen = true;
+  startThreads();
+
+  qDebug("Opened quantized-mesh terrain %s, levels 0 to %d", path.toLatin1().data(), mMaximumLevel);
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Closes the terrain, stopping the threads (waiting for the tiles being
+ * decoded) and releasing all tiles.
+ * WARNING: Tiles returned by getMapTiles are released too.
+ */
+void QuantizedMeshManager::closeTerrain()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  stopThreads();
+
+  QWriteLocker locker(&mLock);
+
+  QHash<qint64, Tile*>::iterator i;
+  for (i = mTiles.begin(); i != mTiles.end(); ++i)
+  {
+    delete i.value();
+  }
+  mTiles.clear();
+  mRequests.clear();
+
+  if (mMappedPack != NULL)
+  {
+    mPackFile.unmap((uchar*)mMappedPack);
+    mMappedPack = NULL;
+  }
+  mPackFile.close();
+  mPackSize = 0;
+  mPackEntries.clear();
+
+  mMaximumLevel = -1;
+  mIsOpen = false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if a terrain is open.
+ *
+ * @return True if a terrain is open
+ */
+bool QuantizedMeshManager::getIsOpen()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mIsOpen;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the finest level of the open terrain.
+ *
+ * @return Finest level, -1 if no terrain is open
+ */
+int QuantizedMeshManager::getMaximumLevel()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mMaximumLevel;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of tiles in the cache, missing ones included.
+ *
+ * @return Number of cached tiles
+ */
+int QuantizedMeshManager::getNumberOfTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  return mTiles.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of tiles waiting for a thread.
+ *
+ * @return Number of requested tiles
+ */
+int QuantizedMeshManager::getNumberOfPendingTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  return mRequests.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the elevations of the given positions in Km, interpolated within the
+ * triangle under every position of the finest decoded tile that covers it.
+ * Positions no decoded tile covers return 0. The finest missing tile under the
+ * first position that could use one is requested, so repeated queries refine.
+ * This method is thread-safe.
+ *
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param elevations Output elevations in Km
+ * @param numberOfPoints Number of positions
+ */
+void QuantizedMeshManager::getElevations(const double* latitudes, const double* longitudes,
+                                         float* elevations, int numberOfPoints)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  qint64 keyToRequest = -1;
+  Tile* tile = NULL;
+
+  mLock.lockForRead();
+
+  for (int i = 0; i < numberOfPoints; i++)
+  {
+    //nearby positions usually fall on the same tile
+    if (tile == NULL || !tile->mesh.contains(latitudes[i], longitudes[i]))
+    {
+      tile = findReadyTile(latitudes[i], longitudes[i], &keyToRequest);
+    }
+
+    if (tile != NULL)
+    {
+      tile->lastUsed.fetchAndStoreOrdered(mFrame);
+      elevations[i] = tile->mesh.getElevation(latitudes[i], longitudes[i]);
+    }
+    else
+    {
+      elevations[i] = 0.0f;
+    }
+  }
+
+  mLock.unlock();
+
+  if (keyToRequest >= 0)
+  {
+    QWriteLocker locker(&mLock);
+    int level = (int)(keyToRequest >> 56);
+    int y = (int)((keyToRequest >> 28) & 0xfffffff);
+    int x = (int)(keyToRequest & 0xfffffff);
+
+    //another thread might have requested it while we were not locked
+    if (mIsOpen && findTile(level, x, y) == NULL)
+    {
+      requestTile(level, x, y);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns elevation bounds for the given region from the decoded tiles that
+ * overlap it. Bounds of coarse tiles stand in for the finer tiles not decoded
+ * yet, so they are not strictly conservative.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param minimum Set to the minimum elevation in Km
+ * @param maximum Set to the maximum elevation in Km
+ * @return False if no decoded tile overlaps the region
+ */
+bool QuantizedMeshManager::getElevationBounds(double south, double west, double north, double east,
+                                              float& minimum, float& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  bool foundTile = false;
+
+  QHash<qint64, Tile*>::const_iterator i;
+  for (i = mTiles.constBegin(); i != mTiles.constEnd(); ++i)
+  {
+    QuantizedMeshTile& mesh = i.value()->mesh;
+    if (i.value()->state != READY || mesh.getSouth() > north || mesh.getNorth() < south ||
+        mesh.getWest() > east || mesh.getEast() < west)
+    {
+      continue;
+    }
+
+    if (!foundTile)
+    {
+      minimum = mesh.getMinimumHeight();
+      maximum = mesh.getMaximumHeight();
+      foundTile = true;
+    }
+    else
+    {
+      minimum = qMin(minimum, mesh.getMinimumHeight());
+      maximum = qMax(maximum, mesh.getMaximumHeight());
+    }
+  }
+
+  return foundTile;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if decoded tiles cover the whole region, i.e. if getElevations
+ * answers every position in it from a tile instead of returning 0. The region
+ * is checked against the few tiles of the level with tiles at least as big as
+ * the region, every one of them must be decoded or have a decoded ancestor.
+ * Regions only covered by finer tiles are reported as not covered.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @return True if decoded tiles cover the region
+ */
+bool QuantizedMeshManager::getIsCovered(double south, double west, double north, double east)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QReadLocker locker(&mLock);
+  if (!mIsOpen)
+  {
+    return false;
+  }
+
+  double extent = qMax(north - south, east - west);
+  int level = (int)floor(log(180.0 / qMax(extent, 1.0e-6)) / log(2.0));
+  level = qBound(0, level, mMaximumLevel);
+
+  double tileSize = QuantizedMeshTile::getTileSizeDegrees(level);
+  int numberOfColumns = 2 << level;
+  int numberOfRows = 1 << level;
+  int firstX = qBound(0, (int)floor((west + 180.0) / tileSize), numberOfColumns - 1);
+  int lastX = qBound(0, (int)ceil((east + 180.0) / tileSize) - 1, numberOfColumns - 1);
+  int firstY = qBound(0, (int)floor((south + 90.0) / tileSize), numberOfRows - 1);
+  int lastY = qBound(0, (int)ceil((north + 90.0) / tileSize) - 1, numberOfRows - 1);
+
+  for (int y = firstY; y <= lastY; y++)
+  {
+    for (int x = firstX; x <= lastX; x++)
+    {
+      bool isReady = false;
+      for (int parentLevel = level; parentLevel >= 0 && !isReady; parentLevel--)
+      {
+        int shift = level - parentLevel;
+        Tile* tile = findTile(parentLevel, x >> shift, y >> shift);
+        isReady = (tile != NULL && tile->state == READY);
+      }
+
+      if (!isReady)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts a new frame, tiles not used in a while get evicted here so that the
+ * tiles returned by getMapTiles stay around until the next frame.
+ * WARNING: This method is supposed to get called from the OpenGL (GUI) thread.
+ */
+void QuantizedMeshManager::startFrame()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+
+  mFrame++;
+  evictTiles();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Collects the decoded tiles that cover the given map, at a level with tiles
+ * about as big as the map. Tiles not decoded yet get requested and their
+ * closest decoded ancestor stands in for them, tiles the terrain does not
+ * have request their parent instead.
+ * WARNING: This method is supposed to get called from the OpenGL (GUI) thread.
+ *
+ * @param southWest Map southwest geodetic position
+ * @param northEast Map northeast geodetic position
+ * @param tiles Set to the tiles covering the map
+ * @return False if part of the map is not covered yet
+ */
+bool QuantizedMeshManager::getMapTiles(const GeodeticPosition& southWest, const GeodeticPosition& northEast,
+                                       QList<QuantizedMeshTile*>& tiles)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  tiles.clear();
+  if (!mIsOpen)
+  {
+    return false;
+  }
+
+  double extent = qMax(northEast.latitude - southWest.latitude, northEast.longitude - southWest.longitude);
+  int level = (int)ceil(log(180.0 / qMax(extent, 1.0e-6)) / log(2.0)) + MAP_LEVEL_BIAS;
+  level = qBound(0, level, mMaximumLevel);
+
+  double tileSize = QuantizedMeshTile::getTileSizeDegrees(level);
+  int numberOfColumns = 2 << level;
+  int numberOfRows = 1 << level;
+  int firstX = qBound(0, (int)floor((southWest.longitude + 180.0) / tileSize), numberOfColumns - 1);
+  int lastX = qBound(0, (int)ceil((northEast.longitude + 180.0) / tileSize) - 1, numberOfColumns - 1);
+  int firstY = qBound(0, (int)floor((southWest.latitude + 90.0) / tileSize), numberOfRows - 1);
+  int lastY = qBound(0, (int)ceil((northEast.latitude + 90.0) / tileSize) - 1, numberOfRows - 1);
+  bool isCovered = true;
+
+  QWriteLocker locker(&mLock);
+
+  for (int y = firstY; y <= lastY; y++)
+  {
+    for (int x = firstX; x <= lastX; x++)
+    {
+      Tile* tile = findTile(level, x, y);
+      if (tile == NULL)
+      {
+        tile = requestTile(level, x, y);
+      }
+      tile->lastUsed.fetchAndStoreOrdered(mFrame);
+
+      //walk up to the closest decoded tile
+      for (int parentLevel = level; tile->state != READY && parentLevel > 0; parentLevel--)
+      {
+        int shift = level - parentLevel + 1;
+        Tile* parent = findTile(parentLevel - 1, x >> shift, y >> shift);
+        if (parent == NULL)
+        {
+          if (tile->state == MISSING)
+          {
+            parent = requestTile(parentLevel - 1, x >> shift, y >> shift);
+          }
+          else
+          {
+            break;
+          }
+        }
+        tile = parent;
+        tile->lastUsed.fetchAndStoreOrdered(mFrame);
+      }
+
+      if (tile->state != READY)
+      {
+        isCovered = false;
+      }
+      else if (!tiles.contains(&tile->mesh))
+      {
+        tiles.append(&tile->mesh);
+      }
+    }
+  }
+
+  return isCovered;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the threads have been asked to stop.
+ *
+ * @return True if the threads have to stop
+ */
+bool QuantizedMeshManager::getIsStopping()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mIsStopping;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by quantized mesh threads. Takes the oldest requested tile.
+ *
+ * @return Tile to decode, NULL if there are no requests
+ */
+QuantizedMeshManager::Tile* QuantizedMeshManager::takeRequest()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+
+  if (mRequests.isEmpty())
+  {
+    return NULL;
+  }
+
+  Tile* tile = mRequests.takeFirst();
+  tile->state = BUSY;
+
+  return tile;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by quantized mesh threads. Reads the file of the given (busy) tile
+ * from the terrain directory, or extracts it from the zip archive.
+ *
+ * @param tile Tile to read, taken with takeRequest
+ * @param data Set to the contents of the tile file
+ * @return False if the terrain does not have the tile
+ */
+bool QuantizedMeshManager::readTile(Tile* tile, QByteArray& data)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (!mIsPack)
+  {
+    QFile file(QString("%1/%2/%3/%4.terrain").arg(mPath).arg(tile->level).arg(tile->x).arg(tile->y));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+      return false;
+    }
+    data = file.readAll();
+    return !data.isEmpty();
+  }
+
+  //the pack index and mapping do not change while threads run
+  QHash<qint64, PackEntry>::const_iterator entry = mPackEntries.constFind(getTileKey(tile->level, tile->x, tile->y));
+  if (entry == mPackEntries.constEnd())
+  {
+    return false;
+  }
+
+  qint64 headerOffset = entry.value().headerOffset;
+  if (headerOffset + 30 > mPackSize || readUint32(mMappedPack + headerOffset) != LOCAL_HEADER_SIGNATURE)
+  {
+    printf("QuantizedMeshManager.cpp: Error reading tile %d/%d/%d from %s\n",
+           tile->level, tile->x, tile->y, mPath.toLatin1().data());
+    return false;
+  }
+
+  qint64 dataOffset = headerOffset + 30 + readUint16(mMappedPack + headerOffset + 26) +
+    readUint16(mMappedPack + headerOffset + 28);
+  qint64 compressedSize = entry.value().compressedSize;
+  if (dataOffset + compressedSize > mPackSize)
+  {
+    return false;
+  }
+
+  if (entry.value().method == METHOD_STORED)
+  {
+    data = QByteArray((const char*)mMappedPack + dataOffset, (int)compressedSize);
+    return true;
+  }
+
+  return QuantizedMeshTile::inflate(mMappedPack + dataOffset, (int)compressedSize, data);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by quantized mesh threads once a tile has been decoded, or found
+ * missing.
+ *
+ * @param tile Tile taken with takeRequest
+ * @param isDecoded True if the tile was read and decoded
+ */
+void QuantizedMeshManager::reportTileDecoded(Tile* tile, bool isDecoded)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QWriteLocker locker(&mLock);
+
+  tile->state = isDecoded ? READY : MISSING;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Finds the finest level in a terrain directory, levels are the numerically
+ * named subdirectories.
+ *
+ * @param path Terrain directory
+ * @return False if the directory has no levels
+ */
+bool QuantizedMeshManager::openDirectory(const QString& path)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QStringList levels = QDir(path).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+  for (int i = 0; i < levels.size(); i++)
+  {
+    bool isNumber = false;
+    int level = levels[i].toInt(&isNumber);
+    if (isNumber && level >= 0 && level <= MAXIMUM_LEVEL)
+    {
+      mMaximumLevel = qMax(mMaximumLevel, level);
+    }
+  }
+
+  if (mMaximumLevel < 0)
+  {
+    printf("QuantizedMeshManager.cpp: Error, no terrain levels found in %s\n", path.toLatin1().data());
+    return false;
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Maps a zip archive of tiles and indexes its .terrain entries by level, x and
+ * y, taken from the last three components of the entry names. Entries have to
+ * be stored or deflated, ZIP64 archives are not supported.
+ *
+ * @param path Zip archive
+ * @return False if the archive could not be read or has no tiles
+ */
+bool QuantizedMeshManager::openPack(const QString& path)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mPackFile.setFileName(path);
+  if (!mPackFile.open(QIODevice::ReadOnly))
+  {
+    printf("QuantizedMeshManager.cpp: Error opening %s\n", path.toLatin1().data());
+    return false;
+  }
+
+  mPackSize = mPackFile.size();
+  mMappedPack = mPackFile.map(0, mPackSize);
+  if (mMappedPack == NULL || mPackSize < END_OF_CENTRAL_DIRECTORY_SIZE)
+  {
+    printf("QuantizedMeshManager.cpp: Error mapping %s\n", path.toLatin1().data());
+    return false;
+  }
+
+  //end of central directory record is at the end, before an optional comment
+  qint64 endOffset = -1;
+  qint64 lowestOffset = qMax((qint64)0, mPackSize - END_OF_CENTRAL_DIRECTORY_SIZE - 65535);
+  for (qint64 offset = mPackSize - END_OF_CENTRAL_DIRECTORY_SIZE; offset >= lowestOffset; offset--)
+  {
+    if (readUint32(mMappedPack + offset) == END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+    {
+      endOffset = offset;
+      break;
+    }
+  }
+  if (endOffset < 0)
+  {
+    printf("QuantizedMeshManager.cpp: Error, %s is not a zip archive\n", path.toLatin1().data());
+    return false;
+  }
+
+  int numberOfEntries = readUint16(mMappedPack + endOffset + 10);
+  qint64 offset = readUint32(mMappedPack + endOffset + 16);
+  for (int i = 0; i < numberOfEntries; i++)
+  {
+    if (offset + 46 > mPackSize || readUint32(mMappedPack + offset) != CENTRAL_HEADER_SIGNATURE)
+    {
+      printf("QuantizedMeshManager.cpp: Error reading the directory of %s\n", path.toLatin1().data());
+      return false;
+    }
+
+    int nameLength = readUint16(mMappedPack + offset + 28);
+    int extraLength = readUint16(mMappedPack + offset + 30);
+    int commentLength = readUint16(mMappedPack + offset + 32);
+    if (offset + 46 + nameLength > mPackSize)
+    {
+      return false;
+    }
+
+    PackEntry entry;
+    entry.method = readUint16(mMappedPack + offset + 10);
+    entry.compressedSize = readUint32(mMappedPack + offset + 20);
+    entry.headerOffset = readUint32(mMappedPack + offset + 42);
+    QString name = QString::fromUtf8((const char*)mMappedPack + offset + 46, nameLength);
+    offset += 46 + nameLength + extraLength + commentLength;
+
+    QStringList components = name.split('/');
+    if (components.size() < 3 || !name.endsWith(".terrain") ||
+        (entry.method != METHOD_STORED && entry.method != METHOD_DEFLATED))
+    {
+      continue;
+    }
+
+    bool isLevelValid = false;
+    bool isXValid = false;
+    bool isYValid = false;
+    int n = components.size();
+    int level = components[n - 3].toInt(&isLevelValid);
+    int x = components[n - 2].toInt(&isXValid);
+    int y = components[n - 1].left(components[n - 1].size() - 8).toInt(&isYValid);
+    if (isLevelValid && isXValid && isYValid && level >= 0 && level <= MAXIMUM_LEVEL)
+    {
+      mPackEntries.insert(getTileKey(level, x, y), entry);
+      mMaximumLevel = qMax(mMaximumLevel, level);
+    }
+  }
+
+  if (mPackEntries.isEmpty())
+  {
+    printf("QuantizedMeshManager.cpp: Error, no terrain tiles found in %s\n", path.toLatin1().data());
+    return false;
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the cached tile with the given coordinates. The manager must be
+ * locked.
+ *
+ * @param level Tile level
+ * @param x Tile column
+ * @param y Tile row
+ * @return The tile, NULL if it is not in the cache
+ */
+QuantizedMeshManager::Tile* QuantizedMeshManager::findTile(int level, int x, int y)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mTiles.value(getTileKey(level, x, y), NULL);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds the given tile to the cache and to the request list. The manager must
+ * be locked for writing.
+ *
+ * @param level Tile level
+ * @param x Tile column
+ * @param y Tile row
+ * @return The requested tile
+ */
+QuantizedMeshManager::Tile* QuantizedMeshManager::requestTile(int level, int x, int y)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  Tile* tile = new Tile();
+  tile->level = level;
+  tile->x = x;
+  tile->y = y;
+  tile->state = PENDING;
+  tile->lastUsed.fetchAndStoreOrdered(mFrame);
+
+  mTiles.insert(getTileKey(level, x, y), tile);
+  mRequests.append(tile);
+
+  return tile;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the finest decoded tile that covers the given position. The manager
+ * must be locked.
+ *
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @param keyToRequest Set to the finest tile not in the cache, unless already set
+ * @return The tile, NULL if no decoded tile covers the position
+ */
+QuantizedMeshManager::Tile* QuantizedMeshManager::findReadyTile(double latitude, double longitude,
+                                                                qint64* keyToRequest)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int level = mMaximumLevel; level >= 0; level--)
+  {
+    double tileSize = QuantizedMeshTile::getTileSizeDegrees(level);
+    int x = qBound(0, (int)((longitude + 180.0) / tileSize), (2 << level) - 1);
+    int y = qBound(0, (int)((latitude + 90.0) / tileSize), (1 << level) - 1);
+    qint64 key = getTileKey(level, x, y);
+
+    Tile* tile = mTiles.value(key, NULL);
+    if (tile == NULL)
+    {
+      if (*keyToRequest < 0)
+      {
+        *keyToRequest = key;
+      }
+    }
+    else if (tile->state == READY)
+    {
+      return tile;
+    }
+  }
+
+  return NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Evicts least recently used tiles until the cache is within its maximum size.
+ * Tiles used this frame and tiles waiting for or owned by a thread are kept.
+ * The manager must be locked for writing.
+ */
+void QuantizedMeshManager::evictTiles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  while (mTiles.size() > MAXIMUM_NUMBER_OF_TILES)
+  {
+    QHash<qint64, Tile*>::iterator leastRecentlyUsed = mTiles.end();
+    int leastRecentFrame = 0;
+    QHash<qint64, Tile*>::iterator i;
+    for (i = mTiles.begin(); i != mTiles.end(); ++i)
+    {
+      Tile* tile = i.value();
+      int lastUsed = tile->lastUsed.fetchAndAddOrdered(0);//atomic read
+      if ((tile->state == READY || tile->state == MISSING) && lastUsed != mFrame &&
+          (leastRecentlyUsed == mTiles.end() || lastUsed < leastRecentFrame))
+      {
+        leastRecentlyUsed = i;
+        leastRecentFrame = lastUsed;
+      }
+    }
+
+    if (leastRecentlyUsed == mTiles.end())
+    {
+      break;
+    }
+
+    delete leastRecentlyUsed.value();
+    mTiles.erase(leastRecentlyUsed);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts the pool of quantized mesh threads.
+ */
+void QuantizedMeshManager::startThreads()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mIsStopping = false;
+
+  //leave a core for the GUI thread
+  int numberOfThreads = qMax(1, QThread::idealThreadCount() - 1);
+  for (int i = 0; i < numberOfThreads; i++)
+  {
+    QuantizedMeshThread* thread = new QuantizedMeshThread();
+    mThreads.append(thread);
+    thread->start();
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Stops the pool of quantized mesh threads, waiting for the tiles being
+ * decoded.
+ */
+void QuantizedMeshManager::stopThreads()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLock.lockForWrite();
+  mRequests.clear();
+  mIsStopping = true;
+  mLock.unlock();
+
+  for (int i = 0; i < mThreads.size(); i++)
+  {
+    mThreads[i]->wait();
+    delete mThreads[i];
+  }
+  mThreads.clear();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the cache key of the given tile.
+ *
+ * @param level Tile level
+ * @param x Tile column
+ * @param y Tile row
+ * @return Unique key for the tile
+ */
+qint64 QuantizedMeshManager::getTileKey(int level, int x, int y)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return ((qint64)level << 56) | ((qint64)y << 28) | (qint64)x;
+}
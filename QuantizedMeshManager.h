@@ -0,0 +1,145 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef QUANTIZED_MESH_MANAGER_H
+#define QUANTIZED_MESH_MANAGER_H
+
+#include <QList>
+#include <QHash>
+#include <QFile>
+#include <QString>
+#include <QReadWriteLock>
+#include <QAtomicInt>
+#include "globals.h"
+#include "QuantizedMeshTile.h"
+
+class QuantizedMeshThread;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton class that serves terrain from quantized-mesh tiles (see
+ * QuantizedMeshTile) stored locally, either as a directory tree of
+ * level/x/y.terrain files or packed in a zip archive. Tiles are read and
+ * decoded on demand by a pool of QuantizedMeshThread objects and cached (least
+ * recently used ones get evicted).
+ *
+ * Earth renders the maps in elevation mode with the triangles of these tiles
+ * instead of a regular grid, see getMapTiles, so terrain is drawn exactly as
+ * it was triangulated, without resampling. ElevationManager hands the
+ * positions none of its raster datasets answer for over to getElevations,
+ * which interpolates the triangle under every position. Like raster datasets,
+ * the finest decoded tile answers and a finer one gets requested in the
+ * meantime.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class QuantizedMeshManager
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int MAXIMUM_NUMBER_OF_TILES = 1024;
+    static const int MAXIMUM_LEVEL = 24;
+    static const int MAP_LEVEL_BIAS = 1;
+
+    enum TileState
+    {
+      PENDING,
+      BUSY,
+      READY,
+      MISSING
+    };
+
+    struct Tile
+    {
+      int level;
+      int x;
+      int y;
+      TileState state;
+      QAtomicInt lastUsed;//frame of last use, getElevations sets it holding the read lock
+      QuantizedMeshTile mesh;
+    };
+
+    ~QuantizedMeshManager();
+    static QuantizedMeshManager* getInstance();
+
+    bool openTerrain(const QString& path);
+    void closeTerrain();
+    bool getIsOpen();
+    int getMaximumLevel();
+    int getNumberOfTiles();
+    int getNumberOfPendingTiles();
+    void getElevations(const double* latitudes, const double* longitudes, float* elevations, int numberOfPoints);
+    bool getElevationBounds(double south, double west, double north, double east,
+                            float& minimum, float& maximum);
+    bool getIsCovered(double south, double west, double north, double east);
+    void startFrame();
+    bool getMapTiles(const GeodeticPosition& southWest, const GeodeticPosition& northEast,
+                     QList<QuantizedMeshTile*>& tiles);
+
+    //called by quantized mesh threads
+    bool getIsStopping();
+    Tile* takeRequest();
+    bool readTile(Tile* tile, QByteArray& data);
+    void reportTileDecoded(Tile* tile, bool isDecoded);
+
+  private:
+    /**
+     * Tile stored in the zip archive, data is found after the local header.
+     */
+    struct PackEntry
+    {
+      qint64 headerOffset;
+      qint64 compressedSize;
+      int method;
+    };
+
+    QuantizedMeshManager();//private due to Singleton implementation
+    bool openDirectory(const QString& path);
+    bool openPack(const QString& path);
+    Tile* findTile(int level, int x, int y);
+    Tile* requestTile(int level, int x, int y);
+    Tile* findReadyTile(double latitude, double longitude, qint64* keyToRequest);
+    void evictTiles();
+    void startThreads();
+    void stopThreads();
+    static qint64 getTileKey(int level, int x, int y);
+
+    static QuantizedMeshManager* mInstance;
+    QString mPath;
+    bool mIsOpen;
+    bool mIsPack;
+    QFile mPackFile;
+    const uchar* mMappedPack;
+    qint64 mPackSize;
+    QHash<qint64, PackEntry> mPackEntries;
+    int mMaximumLevel;
+    QHash<qint64, Tile*> mTiles;
+    QList<Tile*> mRequests;
+    QList<QuantizedMeshThread*> mThreads;
+    QReadWriteLock mLock;
+    bool mIsStopping;
+    int mFrame;
+};
+
+#endif//QUANTIZED_MESH_MANAGER_H
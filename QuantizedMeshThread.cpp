@@ -0,0 +1,68 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "QuantizedMeshThread.h"
+#include "QuantizedMeshManager.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor.
+ */
+QuantizedMeshThread::QuantizedMeshThread()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+QuantizedMeshThread::~QuantizedMeshThread()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * OVERRIDE FOR QThread. This method runs on a separate thread. Reads and
+ * decodes the requested tiles until QuantizedMeshManager stops the thread.
+ */
+void QuantizedMeshThread::run()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QuantizedMeshManager* meshManager = QuantizedMeshManager::getInstance();
+
+  while (!meshManager->getIsStopping())
+  {
+    QuantizedMeshManager::Tile* tile = meshManager->takeRequest();
+    if (tile == NULL)
+    {
+      msleep(20);
+      continue;
+    }
+
+    bool isDecoded = meshManager->readTile(tile, mData) &&
+      tile->mesh.decode(mData, tile->level, tile->x, tile->y);
+    meshManager->reportTileDecoded(tile, isDecoded);
+  }
+}
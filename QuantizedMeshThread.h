@@ -0,0 +1,52 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef QUANTIZED_MESH_THREAD_H
+#define QUANTIZED_MESH_THREAD_H
+
+#include <QThread>
+#include <QByteArray>
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Worker thread used by QuantizedMeshManager to read and decode terrain tiles
+ * in the background. Threads keep taking the oldest requested tile until the
+ * manager stops them, and sleep for a bit whenever there is nothing to do.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class QuantizedMeshThread : public QThread
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    QuantizedMeshThread();
+    ~QuantizedMeshThread();
+
+    void run();//OVERRIDE
+
+  private:
+    QByteArray mData;//scratch buffer for the tile file
+};
+
+#endif//QUANTIZED_MESH_THREAD_H
@@ -0,0 +1,1301 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QtAlgorithms>
+#include <stdio.h>
+#include <string.h>
+#include "QuantizedMeshTile.h"
+#include "Constants.h"
+#include "Utilities.h"
+
+static const int HEADER_SIZE = 88;
+
+//DEFLATE (RFC 1951) tables
+static const short LENGTH_BASES[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                       35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const short LENGTH_EXTRA_BITS[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int DISTANCE_BASES[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                       257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                       8193, 12289, 16385, 24577};
+static const short DISTANCE_EXTRA_BITS[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                              7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uchar CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/**
+ * Bit reader over a DEFLATE stream, bits come least significant first.
+ */
+struct InflateStream
+{
+  const uchar* input;
+  int inputSize;
+  int position;
+  unsigned int bits;
+  int numberOfBits;
+  bool isOverrun;
+  QByteArray* output;
+  int outputSize;
+};
+
+/**
+ * Canonical Huffman code, number of codes per length and symbols sorted by code.
+ */
+struct HuffmanTable
+{
+  short counts[16];
+  short symbols[288];
+};
+
+static quint16 readUint16(const uchar* data)
+{
+  return (quint16)(data[0] | (data[1] << 8));
+}
+
+static quint32 readUint32(const uchar* data)
+{
+  return (quint32)data[0] | ((quint32)data[1] << 8) | ((quint32)data[2] << 16) | ((quint32)data[3] << 24);
+}
+
+static float readFloat(const uchar* data)
+{
+  quint32 bits = readUint32(data);
+  float value;
+  memcpy(&value, &bits, sizeof(float));
+  return value;
+}
+
+static int readBits(InflateStream& stream, int count)
+{
+  unsigned int value = stream.bits;
+  while (stream.numberOfBits < count)
+  {
+    if (stream.position >= stream.inputSize)
+    {
+      stream.isOverrun = true;
+      return 0;
+    }
+    value |= (unsigned int)stream.input[stream.position++] << stream.numberOfBits;
+    stream.numberOfBits += 8;
+  }
+
+  stream.bits = value >> count;
+  stream.numberOfBits -= count;
+
+  return (int)(value & ((1u << count) - 1u));
+}
+
+static bool buildHuffmanTable(HuffmanTable& table, const short* lengths, int numberOfSymbols)
+{
+  short offsets[16];
+  int left = 1;
+
+  memset(table.counts, 0, sizeof(table.counts));
+  for (int symbol = 0; symbol < numberOfSymbols; symbol++)
+  {
+    table.counts[lengths[symbol]]++;
+  }
+
+  //reject over-subscribed codes, incomplete ones are fine
+  for (int length = 1; length < 16; length++)
+  {
+    left = (left << 1) - table.counts[length];
+    if (left < 0)
+    {
+      return false;
+    }
+  }
+
+  offsets[1] = 0;
+  for (int length = 1; length < 15; length++)
+  {
+    offsets[length + 1] = offsets[length] + table.counts[length];
+  }
+
+  for (int symbol = 0; symbol < numberOfSymbols; symbol++)
+  {
+    if (lengths[symbol] != 0)
+    {
+      table.symbols[offsets[lengths[symbol]]++] = (short)symbol;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Fixed Huffman codes of DEFLATE block type 1. Several QuantizedMeshThread
+ * objects inflate at once, so they are built once up front and only read.
+ */
+struct FixedHuffmanTables
+{
+  HuffmanTable lengthTable;
+  HuffmanTable distanceTable;
+
+  FixedHuffmanTables()
+  {
+    short lengths[288];
+    for (int i = 0; i < 288; i++)
+    {
+      lengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    }
+    buildHuffmanTable(lengthTable, lengths, 288);
+    for (int i = 0; i < 30; i++)
+    {
+      lengths[i] = 5;
+    }
+    buildHuffmanTable(distanceTable, lengths, 30);
+  }
+};
+
+Q_GLOBAL_STATIC(FixedHuffmanTables, fixedHuffmanTables)
+
+static int decodeSymbol(InflateStream& stream, const HuffmanTable& table)
+{
+  int code = 0;
+  int first = 0;
+  int index = 0;
+
+  for (int length = 1; length < 16; length++)
+  {
+    code |= readBits(stream, 1);
+    int count = table.counts[length];
+    if (code - count < first)
+    {
+      return table.symbols[index + (code - first)];
+    }
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+
+    if (stream.isOverrun)
+    {
+      return -1;
+    }
+  }
+
+  return -1;
+}
+
+static void appendByte(InflateStream& stream, char value)
+{
+  if (stream.outputSize == stream.output->size())
+  {
+    stream.output->resize(qMax(4096, stream.outputSize * 2));
+  }
+  (*stream.output).data()[stream.outputSize++] = value;
+}
+
+static bool inflateCodes(InflateStream& stream, const HuffmanTable& lengthTable, const HuffmanTable& distanceTable)
+{
+  while (true)
+  {
+    int symbol = decodeSymbol(stream, lengthTable);
+    if (symbol < 0)
+    {
+      return false;
+    }
+    if (symbol < 256)
+    {
+      appendByte(stream, (char)symbol);
+      continue;
+    }
+    if (symbol == 256)
+    {
+      return true;
+    }
+
+    symbol -= 257;
+    if (symbol >= 29)
+    {
+      return false;
+    }
+    int length = LENGTH_BASES[symbol] + readBits(stream, LENGTH_EXTRA_BITS[symbol]);
+
+    symbol = decodeSymbol(stream, distanceTable);
+    if (symbol < 0 || symbol >= 30)
+    {
+      return false;
+    }
+    int distance = DISTANCE_BASES[symbol] + readBits(stream, DISTANCE_EXTRA_BITS[symbol]);
+    if (stream.isOverrun || distance > stream.outputSize)
+    {
+      return false;
+    }
+
+    //copies can overlap the bytes they produce
+    for (int i = 0; i < length; i++)
+    {
+      appendByte(stream, stream.output->constData()[stream.outputSize - distance]);
+    }
+  }
+}
+
+static bool inflateDynamicBlock(InflateStream& stream)
+{
+  short lengths[320];
+  HuffmanTable lengthTable;
+  HuffmanTable distanceTable;
+
+  int numberOfLengths = readBits(stream, 5) + 257;
+  int numberOfDistances = readBits(stream, 5) + 1;
+  int numberOfCodes = readBits(stream, 4) + 4;
+  if (numberOfLengths > 286 || numberOfDistances > 30)
+  {
+    return false;
+  }
+
+  memset(lengths, 0, sizeof(lengths));
+  for (int i = 0; i < numberOfCodes; i++)
+  {
+    lengths[CODE_LENGTH_ORDER[i]] = (short)readBits(stream, 3);
+  }
+  if (!buildHuffmanTable(lengthTable, lengths, 19))
+  {
+    return false;
+  }
+
+  //code lengths of both codes, with run length encoding
+  int index = 0;
+  while (index < numberOfLengths + numberOfDistances)
+  {
+    int symbol = decodeSymbol(stream, lengthTable);
+    if (symbol < 0)
+    {
+      return false;
+    }
+    if (symbol < 16)
+    {
+      lengths[index++] = (short)symbol;
+      continue;
+    }
+
+    short length = 0;
+    int repeat = 0;
+    if (symbol == 16)
+    {
+      if (index == 0)
+      {
+        return false;
+      }
+      length = lengths[index - 1];
+      repeat = 3 + readBits(stream, 2);
+    }
+    else if (symbol == 17)
+    {
+      repeat = 3 + readBits(stream, 3);
+    }
+    else
+    {
+      repeat = 11 + readBits(stream, 7);
+    }
+
+    if (index + repeat > numberOfLengths + numberOfDistances)
+    {
+      return false;
+    }
+    while (repeat-- > 0)
+    {
+      lengths[index++] = length;
+    }
+  }
+
+  //end of block code is required
+  if (lengths[256] == 0 ||
+      !buildHuffmanTable(lengthTable, lengths, numberOfLengths) ||
+      !buildHuffmanTable(distanceTable, lengths + numberOfLengths, numberOfDistances))
+  {
+    return false;
+  }
+
+  return inflateCodes(stream, lengthTable, distanceTable);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. The tile is empty until decoded.
+ */
+QuantizedMeshTile::QuantizedMeshTile()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLevel = 0;
+  mX = 0;
+  mY = 0;
+  mSouth = 0.0;
+  mWest = 0.0;
+  mSize = 0.0;
+  mMinimumHeight = 0.0f;
+  mMaximumHeight = 0.0f;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+QuantizedMeshTile::~QuantizedMeshTile()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Decodes the given quantized-mesh file contents, gzipped or not. Extensions
+ * (normals, water mask, metadata) are ignored.
+ *
+ * @param data Contents of the .terrain file
+ * @param level Level of the tile
+ * @param x Column of the tile, from the anti-meridian eastwards
+ * @param y Row of the tile, from the south pole northwards
+ * @return True if the tile was decoded
+ */
+bool QuantizedMeshTile::decode(const QByteArray& data, int level, int x, int y)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mLevel = level;
+  mX = x;
+  mY = y;
+  mSize = getTileSizeDegrees(level);
+  mSouth = -90.0 + (double)y * mSize;
+  mWest = -180.0 + (double)x * mSize;
+
+  bool isDecoded = false;
+  if (data.size() >= 2 && (uchar)data.at(0) == 0x1f && (uchar)data.at(1) == 0x8b)
+  {
+    QByteArray uncompressed;
+    isDecoded = gunzip(data, uncompressed) &&
+      parse((const uchar*)uncompressed.constData(), uncompressed.size());
+  }
+  else
+  {
+    isDecoded = parse((const uchar*)data.constData(), data.size());
+  }
+
+  if (!isDecoded)
+  {
+    printf("QuantizedMeshTile.cpp: Error decoding tile %d/%d/%d\n", level, x, y);
+    mIndices.clear();
+    return false;
+  }
+
+  buildGrid();
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the level of the tile.
+ *
+ * @return Level, 0 is the coarsest
+ */
+int QuantizedMeshTile::getLevel()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mLevel;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the column of the tile.
+ *
+ * @return Column, from the anti-meridian eastwards
+ */
+int QuantizedMeshTile::getX()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mX;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the row of the tile.
+ *
+ * @return Row, from the south pole northwards
+ */
+int QuantizedMeshTile::getY()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mY;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the southern edge of the tile.
+ *
+ * @return Latitude in decimal degrees
+ */
+double QuantizedMeshTile::getSouth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSouth;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the western edge of the tile.
+ *
+ * @return Longitude in decimal degrees
+ */
+double QuantizedMeshTile::getWest()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mWest;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the northern edge of the tile.
+ *
+ * @return Latitude in decimal degrees
+ */
+double QuantizedMeshTile::getNorth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mSouth + mSize;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the eastern edge of the tile.
+ *
+ * @return Longitude in decimal degrees
+ */
+double QuantizedMeshTile::getEast()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mWest + mSize;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of vertices of the mesh.
+ *
+ * @return Number of vertices
+ */
+int QuantizedMeshTile::getNumberOfVertices()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mU.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of triangles of the mesh, skirts not included.
+ *
+ * @return Number of triangles
+ */
+int QuantizedMeshTile::getNumberOfTriangles()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mIndices.size() / 3;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the lowest height of the tile.
+ *
+ * @return Minimum height in Km
+ */
+float QuantizedMeshTile::getMinimumHeight()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mMinimumHeight / 1000.0f;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the highest height of the tile.
+ *
+ * @return Maximum height in Km
+ */
+float QuantizedMeshTile::getMaximumHeight()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mMaximumHeight / 1000.0f;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the memory taken by the decoded mesh.
+ *
+ * @return Size in bytes
+ */
+qint64 QuantizedMeshTile::getMemorySize()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return (qint64)mU.size() * (2 * sizeof(quint16) + sizeof(float) + sizeof(SimpleVector)) +
+    (qint64)(mIndices.size() + mSkirtSegments.size() + mGridStarts.size() + mGridTriangles.size()) * sizeof(int);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the given position is within the tile extent.
+ *
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @return True if the tile covers the position
+ */
+bool QuantizedMeshTile::contains(double latitude, double longitude)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return latitude >= mSouth && latitude <= mSouth + mSize &&
+    longitude >= mWest && longitude <= mWest + mSize;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the elevation of the given position, interpolated with barycentric
+ * coordinates within the triangle under it. Positions off the tile are clamped
+ * to its edges.
+ *
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @return Elevation in Km
+ */
+float QuantizedMeshTile::getElevation(double latitude, double longitude)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double u = qBound(0.0, (longitude - mWest) / mSize, 1.0) * (double)MAXIMUM_QUANTIZED_VALUE;
+  double v = qBound(0.0, (latitude - mSouth) / mSize, 1.0) * (double)MAXIMUM_QUANTIZED_VALUE;
+  int column = qMin((int)(u * GRID_SIZE / (MAXIMUM_QUANTIZED_VALUE + 1)), GRID_SIZE - 1);
+  int row = qMin((int)(v * GRID_SIZE / (MAXIMUM_QUANTIZED_VALUE + 1)), GRID_SIZE - 1);
+  int cell = row * GRID_SIZE + column;
+
+  //position might fall in a crack between triangles, use the closest one then
+  double bestSmallestWeight = -1.0e30;
+  double bestWeights[3] = {0.0, 0.0, 0.0};
+  int bestTriangle = -1;
+
+  for (int i = mGridStarts[cell]; i < mGridStarts[cell + 1]; i++)
+  {
+    const int* triangle = mIndices.constData() + 3 * mGridTriangles[i];
+    double u0 = mU[triangle[0]];
+    double v0 = mV[triangle[0]];
+    double u1 = mU[triangle[1]];
+    double v1 = mV[triangle[1]];
+    double u2 = mU[triangle[2]];
+    double v2 = mV[triangle[2]];
+
+    double denominator = (v1 - v2) * (u0 - u2) + (u2 - u1) * (v0 - v2);
+    if (denominator == 0.0)
+    {
+      continue;
+    }
+
+    double weights[3];
+    weights[0] = ((v1 - v2) * (u - u2) + (u2 - u1) * (v - v2)) / denominator;
+    weights[1] = ((v2 - v0) * (u - u2) + (u0 - u2) * (v - v2)) / denominator;
+    weights[2] = 1.0 - weights[0] - weights[1];
+
+    double smallestWeight = qMin(weights[0], qMin(weights[1], weights[2]));
+    if (smallestWeight > bestSmallestWeight)
+    {
+      bestSmallestWeight = smallestWeight;
+      bestTriangle = mGridTriangles[i];
+      bestWeights[0] = weights[0];
+      bestWeights[1] = weights[1];
+      bestWeights[2] = weights[2];
+
+      if (smallestWeight >= 0.0)
+      {
+        break;
+      }
+    }
+  }
+
+  if (bestTriangle < 0)
+  {
+    return mMinimumHeight / 1000.0f;
+  }
+
+  //outside of the closest triangle, project onto it
+  double sum = 0.0;
+  for (int i = 0; i < 3; i++)
+  {
+    bestWeights[i] = qMax(bestWeights[i], 0.0);
+    sum += bestWeights[i];
+  }
+
+  const int* triangle = mIndices.constData() + 3 * bestTriangle;
+  double height = (bestWeights[0] * mHeights[triangle[0]] + bestWeights[1] * mHeights[triangle[1]] +
+                   bestWeights[2] * mHeights[triangle[2]]) / sum;
+
+  return (float)(height / 1000.0);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Appends the triangles of the mesh that fall within the given region (a map
+ * tile), clipped to it, along with the skirts hanging from the tile edges that
+ * hide cracks against neighbors of another level. Texture coordinates go from
+ * 0,0 at the south west corner of the region to 1,1 at its north east corner.
+ * Vertices that are not clipped reuse their precomputed positions.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param positions Vertex positions, three per triangle, get appended here
+ * @param textureCoordinates Texture coordinates, two per vertex, get appended here
+ */
+void QuantizedMeshTile::appendTriangles(double south, double west, double north, double east,
+                                        QVector<SimpleVector>& positions, QVector<float>& textureCoordinates)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mIndices.isEmpty() || south >= mSouth + mSize || north <= mSouth ||
+      west >= mWest + mSize || east <= mWest)
+  {
+    return;
+  }
+
+  bool isInside = south <= mSouth && north >= mSouth + mSize && west <= mWest && east >= mWest + mSize;
+  ClipVertex polygon[8];
+  ClipVertex clipped[8];
+
+  for (int i = 0; i < mIndices.size(); i += 3)
+  {
+    int size = 3;
+    double minimumLongitude = 180.0;
+    double maximumLongitude = -180.0;
+    double minimumLatitude = 90.0;
+    double maximumLatitude = -90.0;
+    for (int j = 0; j < 3; j++)
+    {
+      polygon[j] = getClipVertex(mIndices[i + j]);
+      minimumLongitude = qMin(minimumLongitude, polygon[j].longitude);
+      maximumLongitude = qMax(maximumLongitude, polygon[j].longitude);
+      minimumLatitude = qMin(minimumLatitude, polygon[j].latitude);
+      maximumLatitude = qMax(maximumLatitude, polygon[j].latitude);
+    }
+
+    if (!isInside)
+    {
+      if (minimumLongitude >= east || maximumLongitude <= west ||
+          minimumLatitude >= north || maximumLatitude <= south)
+      {
+        continue;
+      }
+
+      //clip against the west, east, south and north edges in turn
+      if (minimumLongitude < west)
+      {
+        size = clipPolygon(polygon, size, 0, west, clipped);
+        memcpy(polygon, clipped, size * sizeof(ClipVertex));
+      }
+      if (maximumLongitude > east)
+      {
+        size = clipPolygon(polygon, size, 1, east, clipped);
+        memcpy(polygon, clipped, size * sizeof(ClipVertex));
+      }
+      if (minimumLatitude < south)
+      {
+        size = clipPolygon(polygon, size, 2, south, clipped);
+        memcpy(polygon, clipped, size * sizeof(ClipVertex));
+      }
+      if (maximumLatitude > north)
+      {
+        size = clipPolygon(polygon, size, 3, north, clipped);
+        memcpy(polygon, clipped, size * sizeof(ClipVertex));
+      }
+    }
+
+    //clipped triangles are convex, draw them as fans
+    for (int j = 1; j + 1 < size; j++)
+    {
+      appendVertex(polygon[0], south, west, north, east, positions, textureCoordinates);
+      appendVertex(polygon[j], south, west, north, east, positions, textureCoordinates);
+      appendVertex(polygon[j + 1], south, west, north, east, positions, textureCoordinates);
+    }
+  }
+
+  appendSkirts(south, west, north, east, positions, textureCoordinates);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of the tiles of the given level.
+ *
+ * @param level Level of detail, 0 is the coarsest
+ * @return Tile width and height in decimal degrees
+ */
+double QuantizedMeshTile::getTileSizeDegrees(int level)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return 180.0 / (double)(1 << level);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Decompresses a raw DEFLATE stream. qUncompress only takes zlib streams with
+ * their checksum, which gzipped files and zip archives do not have.
+ *
+ * @param input Compressed data
+ * @param inputSize Size of the compressed data in bytes
+ * @param output Set to the decompressed data
+ * @return False if the stream is corrupt or truncated
+ */
+bool QuantizedMeshTile::inflate(const uchar* input, int inputSize, QByteArray& output)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  InflateStream stream;
+  stream.input = input;
+  stream.inputSize = inputSize;
+  stream.position = 0;
+  stream.bits = 0;
+  stream.numberOfBits = 0;
+  stream.isOverrun = false;
+  stream.output = &output;
+  stream.outputSize = 0;
+  output.resize(qMax(4096, inputSize * 4));
+
+  bool isLastBlock = false;
+  bool isValid = true;
+  while (!isLastBlock && isValid)
+  {
+    isLastBlock = readBits(stream, 1) == 1;
+    int type = readBits(stream, 2);
+
+    if (type == 0)
+    {
+      //stored block, byte aligned
+      stream.bits = 0;
+      stream.numberOfBits = 0;
+      if (stream.position + 4 > inputSize)
+      {
+        isValid = false;
+        break;
+      }
+      int length = readUint16(input + stream.position);
+      int complement = readUint16(input + stream.position + 2);
+      stream.position += 4;
+      if (length != (~complement & 0xffff) || stream.position + length > inputSize)
+      {
+        isValid = false;
+        break;
+      }
+      for (int i = 0; i < length; i++)
+      {
+        appendByte(stream, (char)input[stream.position + i]);
+      }
+      stream.position += length;
+    }
+    else if (type == 1)
+    {
+      const FixedHuffmanTables* tables = fixedHuffmanTables();
+      isValid = inflateCodes(stream, tables->lengthTable, tables->distanceTable);
+    }
+    else if (type == 2)
+    {
+      isValid = inflateDynamicBlock(stream);
+    }
+    else
+    {
+      isValid = false;
+    }
+
+    isValid = isValid && !stream.isOverrun;
+  }
+
+  output.resize(isValid ? stream.outputSize : 0);
+
+  return isValid;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Decompresses gzipped data, the way terrain servers usually store tiles.
+ *
+ * @param input Gzipped data
+ * @param output Set to the decompressed data
+ * @return False if the data is not gzipped or is corrupt
+ */
+bool QuantizedMeshTile::gunzip(const QByteArray& input, QByteArray& output)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const uchar* data = (const uchar*)input.constData();
+  int size = input.size();
+
+  //magic number, DEFLATE method, flags and a trailer with CRC and size
+  if (size < 18 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8)
+  {
+    return false;
+  }
+
+  int flags = data[3];
+  int position = 10;
+  if (flags & 4)//extra field
+  {
+    position += 2 + readUint16(data + position);
+  }
+  if (flags & 8)//file name
+  {
+    while (position < size && data[position] != 0)
+    {
+      position++;
+    }
+    position++;
+  }
+  if (flags & 16)//comment
+  {
+    while (position < size && data[position] != 0)
+    {
+      position++;
+    }
+    position++;
+  }
+  if (flags & 2)//header CRC
+  {
+    position += 2;
+  }
+
+  if (position > size - 8 || !inflate(data + position, size - 8 - position, output))
+  {
+    return false;
+  }
+
+  return (quint32)output.size() == readUint32(data + size - 4);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Parses the header, vertices, triangles and edge vertices of an uncompressed
+ * tile. Vertex coordinates are zig-zag and delta encoded, triangle indices use
+ * high water mark encoding. The XYZ position of every vertex is computed here
+ * as well.
+ *
+ * @param data Uncompressed tile
+ * @param size Size of the tile in bytes
+ * @return False if the tile is truncated or refers to missing vertices
+ */
+bool QuantizedMeshTile::parse(const uchar* data, int size)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (size < HEADER_SIZE + 4)
+  {
+    return false;
+  }
+
+  mMinimumHeight = readFloat(data + 24);
+  mMaximumHeight = readFloat(data + 28);
+
+  int position = HEADER_SIZE;
+  qint64 numberOfVertices = readUint32(data + position);
+  position += 4;
+  if (numberOfVertices == 0 || position + 6 * numberOfVertices > size)
+  {
+    return false;
+  }
+
+  mU.resize((int)numberOfVertices);
+  mV.resize((int)numberOfVertices);
+  mHeights.resize((int)numberOfVertices);
+  mPositions.resize((int)numberOfVertices);
+
+  int u = 0;
+  int v = 0;
+  int height = 0;
+  float heightScale = (mMaximumHeight - mMinimumHeight) / (float)MAXIMUM_QUANTIZED_VALUE;
+  const uchar* uData = data + position;
+  const uchar* vData = uData + 2 * numberOfVertices;
+  const uchar* heightData = vData + 2 * numberOfVertices;
+  GeodeticPosition geoPosition;
+  for (int i = 0; i < numberOfVertices; i++)
+  {
+    //zig-zag decoding of deltas
+    int value = readUint16(uData + 2 * i);
+    u += (value >> 1) ^ -(value & 1);
+    value = readUint16(vData + 2 * i);
+    v += (value >> 1) ^ -(value & 1);
+    value = readUint16(heightData + 2 * i);
+    height += (value >> 1) ^ -(value & 1);
+
+    mU[i] = (quint16)qBound(0, u, (int)MAXIMUM_QUANTIZED_VALUE);
+    mV[i] = (quint16)qBound(0, v, (int)MAXIMUM_QUANTIZED_VALUE);
+    mHeights[i] = mMinimumHeight + (float)height * heightScale;
+
+    geoPosition.latitude = mSouth + (double)mV[i] * mSize / (double)MAXIMUM_QUANTIZED_VALUE;
+    geoPosition.longitude = mWest + (double)mU[i] * mSize / (double)MAXIMUM_QUANTIZED_VALUE;
+    geoPosition.altitude = mHeights[i] / 1000.0;
+    mPositions[i] = Utilities::geodeticToXYZ(geoPosition);
+  }
+  position += 6 * numberOfVertices;
+
+  //indices are 32 bit (and 4 byte aligned) only when they have to
+  int indexSize = (numberOfVertices > 65536) ? 4 : 2;
+  if (position % indexSize != 0)
+  {
+    position += indexSize - position % indexSize;
+  }
+  if (position + 4 > size)
+  {
+    return false;
+  }
+  qint64 numberOfTriangles = readUint32(data + position);
+  position += 4;
+  if (position + 3 * numberOfTriangles * indexSize > size)
+  {
+    return false;
+  }
+
+  mIndices.resize(3 * (int)numberOfTriangles);
+  int highest = 0;
+  for (int i = 0; i < mIndices.size(); i++)
+  {
+    quint32 code = (indexSize == 4) ? readUint32(data + position) : readUint16(data + position);
+    position += indexSize;
+
+    //kept in 64 bits, 32 bit codes would overflow an int
+    qint64 index = (qint64)highest - (qint64)code;
+    if (code == 0)
+    {
+      highest++;
+    }
+    if (index < 0 || index >= numberOfVertices)
+    {
+      return false;
+    }
+    mIndices[i] = (int)index;
+  }
+
+  //triangles have to be counter-clockwise to face up
+  for (int i = 0; i < mIndices.size(); i += 3)
+  {
+    qint64 area = (qint64)(mU[mIndices[i + 1]] - mU[mIndices[i]]) * (mV[mIndices[i + 2]] - mV[mIndices[i]]) -
+      (qint64)(mV[mIndices[i + 1]] - mV[mIndices[i]]) * (mU[mIndices[i + 2]] - mU[mIndices[i]]);
+    if (area < 0)
+    {
+      qSwap(mIndices[i + 1], mIndices[i + 2]);
+    }
+  }
+
+  //west, south, east and north edge vertices
+  QVector<int> edges[4];
+  for (int edge = 0; edge < 4; edge++)
+  {
+    if (position + 4 > size)
+    {
+      return false;
+    }
+    qint64 numberOfEdgeVertices = readUint32(data + position);
+    position += 4;
+    if (position + numberOfEdgeVertices * indexSize > size)
+    {
+      return false;
+    }
+
+    edges[edge].resize((int)numberOfEdgeVertices);
+    for (int i = 0; i < numberOfEdgeVertices; i++)
+    {
+      quint32 index = (indexSize == 4) ? readUint32(data + position) : readUint16(data + position);
+      position += indexSize;
+      if ((qint64)index >= numberOfVertices)
+      {
+        return false;
+      }
+      edges[edge][i] = (int)index;
+    }
+  }
+
+  //skirt segments go around the tile counter-clockwise, so they face out
+  mSkirtSegments.clear();
+  buildSkirts(edges[0], false, true);
+  buildSkirts(edges[1], true, false);
+  buildSkirts(edges[2], false, false);
+  buildSkirts(edges[3], true, true);
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Builds the grid used by getElevation, every cell lists the triangles whose
+ * bounding box overlaps it.
+ */
+void QuantizedMeshTile::buildGrid()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int numberOfCells = GRID_SIZE * GRID_SIZE;
+  int numberOfTriangles = mIndices.size() / 3;
+  int cellScale = (MAXIMUM_QUANTIZED_VALUE + 1) / GRID_SIZE;
+
+  mGridStarts.fill(0, numberOfCells + 1);
+
+  //count first, then fill in place
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int triangle = 0; triangle < numberOfTriangles; triangle++)
+    {
+      const int* indices = mIndices.constData() + 3 * triangle;
+      int firstColumn = qMin(mU[indices[0]], qMin(mU[indices[1]], mU[indices[2]])) / cellScale;
+      int lastColumn = qMax(mU[indices[0]], qMax(mU[indices[1]], mU[indices[2]])) / cellScale;
+      int firstRow = qMin(mV[indices[0]], qMin(mV[indices[1]], mV[indices[2]])) / cellScale;
+      int lastRow = qMax(mV[indices[0]], qMax(mV[indices[1]], mV[indices[2]])) / cellScale;
+
+      for (int row = firstRow; row <= lastRow; row++)
+      {
+        for (int column = firstColumn; column <= lastColumn; column++)
+        {
+          int cell = row * GRID_SIZE + column;
+          if (pass == 0)
+          {
+            mGridStarts[cell + 1]++;
+          }
+          else
+          {
+            mGridTriangles[mGridStarts[cell]++] = triangle;
+          }
+        }
+      }
+    }
+
+    if (pass == 0)
+    {
+      for (int cell = 0; cell < numberOfCells; cell++)
+      {
+        mGridStarts[cell + 1] += mGridStarts[cell];
+      }
+      mGridTriangles.resize(mGridStarts[numberOfCells]);
+    }
+  }
+
+  //filling moved every start to the next cell
+  for (int cell = numberOfCells; cell > 0; cell--)
+  {
+    mGridStarts[cell] = mGridStarts[cell - 1];
+  }
+  mGridStarts[0] = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sorts the vertices of one tile edge along it and adds a skirt segment for
+ * every pair of consecutive vertices.
+ *
+ * @param edge Vertices of the edge, in file order
+ * @param isSortedByU True for the south and north edges
+ * @param isDescending True to walk the edge westwards or southwards
+ */
+void QuantizedMeshTile::buildSkirts(QVector<int>& edge, bool isSortedByU, bool isDescending)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QVector<qint64> keys(edge.size());
+  for (int i = 0; i < edge.size(); i++)
+  {
+    qint64 coordinate = isSortedByU ? mU[edge[i]] : mV[edge[i]];
+    keys[i] = (coordinate << 32) | edge[i];
+  }
+  qSort(keys);
+
+  for (int i = 0; i + 1 < keys.size(); i++)
+  {
+    int first = (int)(keys[i] & 0xffffffff);
+    int second = (int)(keys[i + 1] & 0xffffffff);
+    mSkirtSegments.append(isDescending ? second : first);
+    mSkirtSegments.append(isDescending ? first : second);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Appends the skirt quads of the segments that fall within the given region,
+ * as pairs of triangles. Skirts hang straight down from the tile edges.
+ *
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param positions Vertex positions get appended here
+ * @param textureCoordinates Texture coordinates get appended here
+ */
+void QuantizedMeshTile::appendSkirts(double south, double west, double north, double east,
+                                     QVector<SimpleVector>& positions, QVector<float>& textureCoordinates)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double skirtHeight = mSize * Constants::DEGREES_TO_RADIANS * Constants::EARTH_MEAN_RADIUS * SKIRT_HEIGHT_RATIO;
+
+  for (int i = 0; i < mSkirtSegments.size(); i += 2)
+  {
+    ClipVertex top[2];
+    top[0] = getClipVertex(mSkirtSegments[i]);
+    top[1] = getClipVertex(mSkirtSegments[i + 1]);
+
+    //clip the segment to the region (Liang-Barsky)
+    double start = 0.0;
+    double end = 1.0;
+    double deltaLongitude = top[1].longitude - top[0].longitude;
+    double deltaLatitude = top[1].latitude - top[0].latitude;
+    double p[4] = {-deltaLongitude, deltaLongitude, -deltaLatitude, deltaLatitude};
+    double q[4] = {top[0].longitude - west, east - top[0].longitude,
+                   top[0].latitude - south, north - top[0].latitude};
+    bool isVisible = true;
+    for (int side = 0; side < 4 && isVisible; side++)
+    {
+      if (p[side] == 0.0)
+      {
+        isVisible = q[side] >= 0.0;
+      }
+      else
+      {
+        double t = q[side] / p[side];
+        if (p[side] < 0.0)
+        {
+          start = qMax(start, t);
+        }
+        else
+        {
+          end = qMin(end, t);
+        }
+        isVisible = start < end;
+      }
+    }
+    if (!isVisible)
+    {
+      continue;
+    }
+
+    ClipVertex clippedTop[2];
+    ClipVertex bottom[2];
+    double t[2] = {start, end};
+    for (int j = 0; j < 2; j++)
+    {
+      clippedTop[j] = top[j];
+      if (t[j] != (double)j)
+      {
+        clippedTop[j].longitude = top[0].longitude + t[j] * deltaLongitude;
+        clippedTop[j].latitude = top[0].latitude + t[j] * deltaLatitude;
+        clippedTop[j].height = top[0].height + t[j] * (top[1].height - top[0].height);
+        clippedTop[j].index = -1;
+      }
+      bottom[j] = clippedTop[j];
+      bottom[j].height -= skirtHeight;
+      bottom[j].index = -1;
+    }
+
+    appendVertex(clippedTop[0], south, west, north, east, positions, textureCoordinates);
+    appendVertex(bottom[0], south, west, north, east, positions, textureCoordinates);
+    appendVertex(bottom[1], south, west, north, east, positions, textureCoordinates);
+    appendVertex(clippedTop[0], south, west, north, east, positions, textureCoordinates);
+    appendVertex(bottom[1], south, west, north, east, positions, textureCoordinates);
+    appendVertex(clippedTop[1], south, west, north, east, positions, textureCoordinates);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Appends the position and texture coordinates of the given vertex.
+ *
+ * @param vertex Vertex to append
+ * @param south Southern edge of the region in decimal degrees
+ * @param west Western edge of the region in decimal degrees
+ * @param north Northern edge of the region in decimal degrees
+ * @param east Eastern edge of the region in decimal degrees
+ * @param positions Vertex positions
+ * @param textureCoordinates Texture coordinates
+ */
+void QuantizedMeshTile::appendVertex(const ClipVertex& vertex, double south, double west, double north, double east,
+                                     QVector<SimpleVector>& positions, QVector<float>& textureCoordinates)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (vertex.index >= 0)
+  {
+    positions.append(mPositions[vertex.index]);
+  }
+  else
+  {
+    GeodeticPosition geoPosition;
+    geoPosition.latitude = vertex.latitude;
+    geoPosition.longitude = vertex.longitude;
+    geoPosition.altitude = vertex.height;
+    positions.append(Utilities::geodeticToXYZ(geoPosition));
+  }
+
+  textureCoordinates.append((float)((vertex.longitude - west) / (east - west)));
+  textureCoordinates.append((float)((vertex.latitude - south) / (north - south)));
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the given vertex of the mesh, ready for clipping.
+ *
+ * @param index Vertex index
+ * @return Vertex with its geodetic position and height in Km
+ */
+QuantizedMeshTile::ClipVertex QuantizedMeshTile::getClipVertex(int index)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  ClipVertex vertex;
+  vertex.longitude = mWest + (double)mU[index] * mSize / (double)MAXIMUM_QUANTIZED_VALUE;
+  vertex.latitude = mSouth + (double)mV[index] * mSize / (double)MAXIMUM_QUANTIZED_VALUE;
+  vertex.height = mHeights[index] / 1000.0;
+  vertex.index = index;
+
+  return vertex;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Clips a convex polygon against one edge of a region (Sutherland-Hodgman).
+ *
+ * @param input Polygon vertices
+ * @param inputSize Number of polygon vertices
+ * @param side 0 keeps longitudes east of value, 1 west of it, 2 keeps
+ *             latitudes north of value and 3 south of it
+ * @param value Longitude or latitude of the edge
+ * @param output Clipped polygon vertices, room for inputSize + 1 of them
+ * @return Number of clipped polygon vertices
+ */
+int QuantizedMeshTile::clipPolygon(const ClipVertex* input, int inputSize, int side, double value,
+                                   ClipVertex* output)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int outputSize = 0;
+  bool isLongitude = side < 2;
+  double sign = (side == 0 || side == 2) ? 1.0 : -1.0;
+
+  for (int i = 0; i < inputSize; i++)
+  {
+    const ClipVertex& current = input[i];
+    const ClipVertex& next = input[(i + 1) % inputSize];
+    double currentCoordinate = isLongitude ? current.longitude : current.latitude;
+    double nextCoordinate = isLongitude ? next.longitude : next.latitude;
+    bool isCurrentInside = sign * (currentCoordinate - value) >= 0.0;
+    bool isNextInside = sign * (nextCoordinate - value) >= 0.0;
+
+    if (isCurrentInside)
+    {
+      output[outputSize++] = current;
+    }
+
+    //edge crosses the clipping line
+    if (isCurrentInside != isNextInside)
+    {
+      double t = (value - currentCoordinate) / (nextCoordinate - currentCoordinate);
+      ClipVertex& vertex = output[outputSize++];
+      vertex.longitude = isLongitude ? value : current.longitude + t * (next.longitude - current.longitude);
+      vertex.latitude = isLongitude ? current.latitude + t * (next.latitude - current.latitude) : value;
+      vertex.height = current.height + t * (next.height - current.height);
+      vertex.index = -1;
+    }
+  }
+
+  return outputSize;
+}
@@ -0,0 +1,122 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef QUANTIZED_MESH_TILE_H
+#define QUANTIZED_MESH_TILE_H
+
+#include <QVector>
+#include <QByteArray>
+#include "globals.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * One terrain tile in quantized-mesh 1.0 format, the triangulated irregular
+ * network (TIN) tiles produced by Cesium terrain tilers. Tiles follow the
+ * geographic TMS scheme: level 0 has two tiles, each one 180 degrees wide, and
+ * rows are counted from the south pole. Vertices are quantized to 0-32767
+ * within the tile extent and the height range of the tile.
+ *
+ * decode takes the raw (or gzipped) file contents and keeps the vertices, the
+ * triangles and the edge vertices, and precomputes the XYZ position of every
+ * vertex, so tiles can be decoded on worker threads and drawn as they are.
+ * getElevation finds the triangle under a position through a coarse grid of
+ * triangle lists and interpolates its heights with barycentric coordinates.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class QuantizedMeshTile
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int MAXIMUM_QUANTIZED_VALUE = 32767;
+    static const int GRID_SIZE = 16;
+    static const double SKIRT_HEIGHT_RATIO = 0.005;
+
+    QuantizedMeshTile();
+    ~QuantizedMeshTile();
+
+    bool decode(const QByteArray& data, int level, int x, int y);
+    int getLevel();
+    int getX();
+    int getY();
+    double getSouth();
+    double getWest();
+    double getNorth();
+    double getEast();
+    int getNumberOfVertices();
+    int getNumberOfTriangles();
+    float getMinimumHeight();
+    float getMaximumHeight();
+    qint64 getMemorySize();
+    bool contains(double latitude, double longitude);
+    float getElevation(double latitude, double longitude);
+    void appendTriangles(double south, double west, double north, double east,
+                         QVector<SimpleVector>& positions, QVector<float>& textureCoordinates);
+
+    static double getTileSizeDegrees(int level);
+    static bool inflate(const uchar* input, int inputSize, QByteArray& output);
+    static bool gunzip(const QByteArray& input, QByteArray& output);
+
+  private:
+    /**
+     * Vertex of a triangle being clipped, index is -1 for vertices created by
+     * clipping.
+     */
+    struct ClipVertex
+    {
+      double longitude;
+      double latitude;
+      double height;
+      int index;
+    };
+
+    bool parse(const uchar* data, int size);
+    void buildGrid();
+    void buildSkirts(QVector<int>& edge, bool isSortedByU, bool isDescending);
+    void appendSkirts(double south, double west, double north, double east,
+                      QVector<SimpleVector>& positions, QVector<float>& textureCoordinates);
+    void appendVertex(const ClipVertex& vertex, double south, double west, double north, double east,
+                      QVector<SimpleVector>& positions, QVector<float>& textureCoordinates);
+    ClipVertex getClipVertex(int index);
+    static int clipPolygon(const ClipVertex* input, int inputSize, int side, double value, ClipVertex* output);
+
+    int mLevel;
+    int mX;
+    int mY;
+    double mSouth;
+    double mWest;
+    double mSize;
+    float mMinimumHeight;//meters
+    float mMaximumHeight;//meters
+    QVector<quint16> mU;
+    QVector<quint16> mV;
+    QVector<float> mHeights;//meters
+    QVector<SimpleVector> mPositions;
+    QVector<int> mIndices;
+    QVector<int> mSkirtSegments;//pairs of consecutive edge vertices
+    QVector<int> mGridStarts;//first entry of every grid cell in mGridTriangles
+    QVector<int> mGridTriangles;
+};
+
+#endif//QUANTIZED_MESH_TILE_H
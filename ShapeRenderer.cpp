@@ -111,7 +111,7 @@ void ShapeRenderer::render()
     mDisplayListIndex = glGenLists(1);
     glNewList(mDisplayListIndex, GL_COMPILE);
 
-    SimpleColor color = mWorldObject->getColor();
+    SimpleColor color = mWorldObject->getFrameState().color;
     glColor4f(color.red, color.green, color.blue, 0.5f);
 
     //draw outline
@@ -139,6 +139,39 @@ void ShapeRenderer::render()
   }
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * OVERRIDE FOR MeshRenderer. Returns the bounding box of the ground and height
+ * points.
+ *
+ * @param minimum Returns the minimum corner of the box
+ * @param maximum Returns the maximum corner of the box
+ * @return True if the shape has points
+ */
+bool ShapeRenderer::getBounds(SimpleVector& minimum, SimpleVector& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QList<SimpleVector> points = mGroundPointList + mHeightPointList;
+  if (points.isEmpty())
+  {
+    return false;
+  }
+
+  minimum = points[0];
+  maximum = points[0];
+  for (int i = 1; i < points.size(); i++)
+  {
+    minimum.x = qMin(minimum.x, points[i].x);
+    minimum.y = qMin(minimum.y, points[i].y);
+    minimum.z = qMin(minimum.z, points[i].z);
+    maximum.x = qMax(maximum.x, points[i].x);
+    maximum.y = qMax(maximum.y, points[i].y);
+    maximum.z = qMax(maximum.z, points[i].z);
+  }
+
+  return true;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Builds the vertices for the shape. A basic shape is just a polygon, if there
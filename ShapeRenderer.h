@@ -50,6 +50,7 @@ class ShapeRenderer : public MeshRenderer
     void addHeightPoint(SimpleVector point);
 
     void render();//OVERRIDE
+    bool getBounds(SimpleVector& minimum, SimpleVector& maximum);//OVERRIDE
 
   private:
     void createVertices();
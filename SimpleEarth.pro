@@ -5,7 +5,7 @@ QT = core gui opengl network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-#uncomment next line if you want to use elevation databases
+#uncomment next line if you want to use elevation databases other than GeoTIFF
 #CONFIG += using_gdal
 #uncomment next line if you want to use satellite imagery
 #CONFIG += using_proj4
@@ -51,19 +51,35 @@ CONFIG(using_assimp) {
 HEADERS += AboutWindow.h \
     Atmosphere.h \
     Camera.h \
+    CameraProjection.h \
     ColorSelectWidget.h \
     Constants.h \
+    ContourManager.h \
+    ContourThread.h \
     CrossPlatformSleep.h \
     Earth.h \
+    ElevationBounds.h \
+    ElevationCache.h \
+    ElevationDataset.h \
+    ElevationLoaderThread.h \
     ElevationManager.h \
+    ElevationSampler.h \
+    ElevationTileStore.h \
     EventListener.h \
     EventPublisher.h \
+    ExampleElevationBenchmark.h \
     ExampleExpirableObject.h \
     ExampleFlyObject.h \
     ExampleHelloWorld.h \
+    ExampleTrackBenchmark.h \
+    ExampleViewshed.h \
     FileIO.h \
+    GeoTiffReader.h \
     globals.h \
     GLWidget.h \
+    GlyphAtlas.h \
+    HillshadeManager.h \
+    HillshadeThread.h \
     Hud.h \
     IconModelManager.h \
     IconRenderer.h \
@@ -75,18 +91,29 @@ HEADERS += AboutWindow.h \
     MeshRenderer.h \
     ModelRenderer.h \
     NewPlaceDialog.h \
+    OccupancyGrid.h \
+    PathProfile.h \
+    PathProfileWidget.h \
     PathRenderer.h \
     PathTool.h \
     PathVolumeWindow.h \
     PathWindow.h \
     PlacesWindow.h \
+    QuantizedMeshManager.h \
+    QuantizedMeshThread.h \
+    QuantizedMeshTile.h \
     SatelliteImageDownloader.h \
     ShapefileReader.h \
     ShapeRenderer.h \
+    SpatialIndex.h \
+    SpriteBatch.h \
+    TerrainPicker.h \
     Tool.h \
     ToolManager.h \
     TrackInfoWindow.h \
     Utilities.h \
+    Viewshed.h \
+    ViewshedThread.h \
     VolumeRenderer.h \
     VolumeTool.h \
     VolumeWindow.h \
@@ -97,16 +124,32 @@ HEADERS += AboutWindow.h \
 SOURCES += AboutWindow.cpp \
     Atmosphere.cpp \
     Camera.cpp \
+    CameraProjection.cpp \
     ColorSelectWidget.cpp \
+    ContourManager.cpp \
+    ContourThread.cpp \
     CrossPlatformSleep.cpp \
     Earth.cpp \
+    ElevationBounds.cpp \
+    ElevationCache.cpp \
+    ElevationDataset.cpp \
+    ElevationLoaderThread.cpp \
     ElevationManager.cpp \
+    ElevationSampler.cpp \
+    ElevationTileStore.cpp \
     EventPublisher.cpp \
+    ExampleElevationBenchmark.cpp \
     ExampleExpirableObject.cpp \
     ExampleFlyObject.cpp \
     ExampleHelloWorld.cpp \
+    ExampleTrackBenchmark.cpp \
+    ExampleViewshed.cpp \
     FileIO.cpp \
+    GeoTiffReader.cpp \
     GLWidget.cpp \
+    GlyphAtlas.cpp \
+    HillshadeManager.cpp \
+    HillshadeThread.cpp \
     Hud.cpp \
     IconModelManager.cpp \
     IconRenderer.cpp \
@@ -119,18 +162,29 @@ SOURCES += AboutWindow.cpp \
     MeshRenderer.cpp \
     ModelRenderer.cpp \
     NewPlaceDialog.cpp \
+    OccupancyGrid.cpp \
+    PathProfile.cpp \
+    PathProfileWidget.cpp \
     PathRenderer.cpp \
     PathTool.cpp \
     PathVolumeWindow.cpp \    
     PathWindow.cpp \
     PlacesWindow.cpp \
+    QuantizedMeshManager.cpp \
+    QuantizedMeshThread.cpp \
+    QuantizedMeshTile.cpp \
     SatelliteImageDownloader.cpp \
     ShapefileReader.cpp \
     ShapeRenderer.cpp \
+    SpatialIndex.cpp \
+    SpriteBatch.cpp \
+    TerrainPicker.cpp \
     Tool.cpp \
     ToolManager.cpp \
     TrackInfoWindow.cpp \
     Utilities.cpp \
+    Viewshed.cpp \
+    ViewshedThread.cpp \
     VolumeRenderer.cpp \
     VolumeTool.cpp \
     VolumeWindow.cpp \
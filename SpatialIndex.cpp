@@ -0,0 +1,881 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <math.h>
+#include "SpatialIndex.h"
+#include "WorldObject.h"
+#include "MeshRenderer.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Creates the root node, which covers the whole globe.
+ */
+SpatialIndex::SpatialIndex()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //nodes start out as clusters of query 0, which is never the last one
+  mClusterQuery = 1;
+  clear();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. The index does not own the world objects, they are not deleted.
+ */
+SpatialIndex::~SpatialIndex()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mNodes.clear();
+  mUnboundedItems.clear();
+  mEntries.clear();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds the given world object to the index. Objects already in the index are
+ * ignored. This method is thread-safe.
+ *
+ * @param object Pointer to world object
+ * @param handle Handle findVisible reports the object with
+ */
+void SpatialIndex::insert(WorldObject* object, int handle)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  if (mEntries.contains(object))
+  {
+    return;
+  }
+
+  Item item;
+  if (getItem(object, handle, item))
+  {
+    addItem(item);
+  }
+  else
+  {
+    Entry entry;
+    entry.node = -1;
+    entry.slot = mUnboundedItems.size();
+    mEntries.insert(object, entry);
+    mUnboundedItems.append(item);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Reads the position and mesh extents of the given world object again. The
+ * object only changes leaves if it left the cell of its current one. This
+ * method is thread-safe.
+ *
+ * @param object Pointer to world object
+ * @return False if the object is not in the index
+ */
+bool SpatialIndex::update(WorldObject* object)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  QHash<WorldObject*, Entry>::iterator iterator = mEntries.find(object);
+  if (iterator == mEntries.end())
+  {
+    return false;
+  }
+
+  Entry entry = iterator.value();
+  int handle = (entry.node == -1) ? mUnboundedItems[entry.slot].handle :
+                                    mNodes[entry.node].items[entry.slot].handle;
+
+  Item item;
+  bool isBounded = getItem(object, handle, item);
+
+  if (isBounded && entry.node != -1 && findLeaf(item.latitude, item.longitude) == entry.node)
+  {
+    //still in the same cell, only the box of the leaf changes
+    mNodes[entry.node].items[entry.slot] = item;
+    markDirty(entry.node);
+  }
+  else
+  {
+    removeItem(entry);
+    mEntries.remove(object);
+
+    if (isBounded)
+    {
+      addItem(item);
+    }
+    else
+    {
+      entry.node = -1;
+      entry.slot = mUnboundedItems.size();
+      mEntries.insert(object, entry);
+      mUnboundedItems.append(item);
+    }
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Removes the given world object from the index. This method is thread-safe.
+ *
+ * @param object Pointer to world object
+ */
+void SpatialIndex::remove(WorldObject* object)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  QHash<WorldObject*, Entry>::iterator iterator = mEntries.find(object);
+  if (iterator != mEntries.end())
+  {
+    Entry entry = iterator.value();
+    mEntries.erase(iterator);
+    removeItem(entry);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Removes all world objects and nodes from the index, leaving an empty root
+ * node. This method is thread-safe.
+ */
+void SpatialIndex::clear()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  mNodes.clear();
+  mUnboundedItems.clear();
+  mEntries.clear();
+
+  Node root;
+  root.south = -90.0;
+  root.west = -180.0;
+  root.north = 90.0;
+  root.east = 180.0;
+  root.depth = 0;
+  root.parent = -1;
+  root.firstChild = -1;
+  root.count = 0;
+  root.positionSum.x = 0.0;
+  root.positionSum.y = 0.0;
+  root.positionSum.z = 0.0;
+  root.clusterQuery = 0;
+  root.isEmpty = true;
+  root.isDirty = false;
+  mNodes.append(root);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Get method for the number of world objects in the index.
+ *
+ * @return Number of world objects
+ */
+int SpatialIndex::getNumberOfObjects()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mEntries.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Get method for the number of quadtree nodes, leaves included.
+ *
+ * @return Number of nodes
+ */
+int SpatialIndex::getNumberOfNodes()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mNodes.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Finds the world objects whose bounding box is at least partly on the inner
+ * side of the given planes, see getFrustumPlanes. Nodes entirely inside the
+ * frustum hand over all their objects without further tests. This method is
+ * thread-safe.
+ *
+ * @param planes NUMBER_OF_PLANES planes, four coefficients (a,b,c,d) each
+ * @param handles Returns the handles of the objects found
+ */
+void SpatialIndex::findVisible(const double* planes, QVector<int>& handles)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  handles.clear();
+
+  refreshBounds(0);
+  findVisible(0, planes, false, handles);
+
+  for (int i = 0; i < mUnboundedItems.size(); i++)
+  {
+    handles.append(mUnboundedItems[i].handle);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Finds the world objects in the frustum like findVisible, but groups the
+ * ones that are close together as seen from the camera. A node holding more
+ * than one visible object becomes a cluster once its box spans less than the given
+ * angle from the eye, its objects are then not reported on their own. Nodes
+ * that were clusters in the last call to this method and are not anymore get
+ * reported as expansions, once for every object and cluster that came out of
+ * them. This method is thread-safe.
+ *
+ * @param planes NUMBER_OF_PLANES planes, four coefficients (a,b,c,d) each
+ * @param eye Camera position
+ * @param clusterAngle Largest angle a cluster may span from the eye, in radians
+ * @param handles Returns the handles of the objects found on their own
+ * @param clusters Returns the clusters found
+ * @param expansions Returns the objects and clusters that came out of a cluster
+ */
+void SpatialIndex::findVisible(const double* planes, const SimpleVector& eye, double clusterAngle,
+                               QVector<int>& handles, QVector<Cluster>& clusters,
+                               QVector<Expansion>& expansions)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  handles.clear();
+  clusters.clear();
+  expansions.clear();
+
+  mClusterQuery++;
+  refreshBounds(0);
+  findClusters(0, planes, false, eye, clusterAngle, -1, handles, clusters, expansions);
+
+  for (int i = 0; i < mUnboundedItems.size(); i++)
+  {
+    handles.append(mUnboundedItems[i].handle);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Extracts the planes of the view frustum out of the given OpenGL matrices.
+ * A point is inside when a*x + b*y + c*z + d >= 0 for all planes. The side
+ * planes can be pushed out by a margin so that icons and labels of objects
+ * right outside the screen still get drawn.
+ *
+ * @param modelView Model-view matrix (column-major)
+ * @param projection Projection matrix (column-major)
+ * @param marginX Horizontal margin in normalized device coordinates
+ * @param marginY Vertical margin in normalized device coordinates
+ * @param planes Returns NUMBER_OF_PLANES planes, four coefficients each
+ */
+void SpatialIndex::getFrustumPlanes(const double* modelView, const double* projection,
+                                    double marginX, double marginY, double* planes)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //combined matrix, projection * model-view
+  double clip[16];
+  for (int column = 0; column < 4; column++)
+  {
+    for (int row = 0; row < 4; row++)
+    {
+      clip[column*4 + row] = projection[row] * modelView[column*4] +
+                             projection[4 + row] * modelView[column*4 + 1] +
+                             projection[8 + row] * modelView[column*4 + 2] +
+                             projection[12 + row] * modelView[column*4 + 3];
+    }
+  }
+
+  //x, y and z have to stay within -w and w (pushed out by the margins)
+  double scaleX = 1.0 + marginX;
+  double scaleY = 1.0 + marginY;
+  for (int i = 0; i < 4; i++)
+  {
+    double rowX = clip[i*4];
+    double rowY = clip[i*4 + 1];
+    double rowZ = clip[i*4 + 2];
+    double rowW = clip[i*4 + 3];
+
+    planes[i] = scaleX * rowW + rowX;//left
+    planes[4 + i] = scaleX * rowW - rowX;//right
+    planes[8 + i] = scaleY * rowW + rowY;//bottom
+    planes[12 + i] = scaleY * rowW - rowY;//top
+    planes[16 + i] = rowW + rowZ;//near
+    planes[20 + i] = rowW - rowZ;//far
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Fills in the index item of the given world object from its frame state: the
+ * cell coordinates of its position and the box around the position and its
+ * mesh.
+ *
+ * @param object Pointer to world object
+ * @param handle Handle of world object
+ * @param item Returns the item
+ * @return False if the mesh of the object has unknown extents
+ */
+bool SpatialIndex::getItem(WorldObject* object, int handle, Item& item)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const SimpleVector& position = object->getFrameState().position;
+
+  item.object = object;
+  item.handle = handle;
+  item.latitude = 0.0;
+  item.longitude = 0.0;
+  item.position = position;
+  item.isVisible = object->getFrameState().isVisible;
+  item.minimum = position;
+  item.maximum = position;
+
+  //objects that were not placed yet sit at the center of the earth
+  if (position.x != 0.0 || position.y != 0.0 || position.z != 0.0)
+  {
+    GeodeticPosition geodeticPosition = object->getFrameGeodeticPosition();
+    item.latitude = geodeticPosition.latitude;
+    item.longitude = geodeticPosition.longitude;
+  }
+
+  MeshRenderer* meshRenderer = object->getMeshRenderer();
+  if (meshRenderer != NULL)
+  {
+    SimpleVector meshMinimum, meshMaximum;
+    if (!meshRenderer->getBounds(meshMinimum, meshMaximum))
+    {
+      return false;
+    }
+
+    mergeBox(meshMinimum, meshMaximum, item.minimum, item.maximum);
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the leaf whose cell holds the given coordinates.
+ *
+ * @param latitude Latitude in decimal degrees
+ * @param longitude Longitude in decimal degrees
+ * @return Index of leaf node
+ */
+int SpatialIndex::findLeaf(double latitude, double longitude)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int node = 0;
+
+  while (mNodes[node].firstChild != -1)
+  {
+    const Node& parent = mNodes[node];
+    double middleLatitude = (parent.south + parent.north) * 0.5;
+    double middleLongitude = (parent.west + parent.east) * 0.5;
+
+    node = parent.firstChild;
+    if (latitude >= middleLatitude)
+    {
+      node += 2;
+    }
+    if (longitude >= middleLongitude)
+    {
+      node += 1;
+    }
+  }
+
+  return node;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Files the given item in the leaf of its cell, splitting the leaf if it gets
+ * too crowded.
+ *
+ * @param item Item to add
+ */
+void SpatialIndex::addItem(const Item& item)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int leaf = findLeaf(item.latitude, item.longitude);
+
+  Entry entry;
+  entry.node = leaf;
+  entry.slot = mNodes[leaf].items.size();
+  mEntries.insert(item.object, entry);
+  mNodes[leaf].items.append(item);
+  markDirty(leaf);
+
+  if (mNodes[leaf].items.size() > LEAF_CAPACITY && mNodes[leaf].depth < MAXIMUM_DEPTH)
+  {
+    split(leaf);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Takes the item of the given entry out of its leaf. The last item of the leaf
+ * is moved into the freed slot. The entry itself is left to the caller.
+ *
+ * @param entry Entry of the item to remove
+ */
+void SpatialIndex::removeItem(const Entry& entry)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QVector<Item>& items = (entry.node == -1) ? mUnboundedItems : mNodes[entry.node].items;
+
+  int lastSlot = items.size() - 1;
+  if (entry.slot != lastSlot)
+  {
+    items[entry.slot] = items[lastSlot];
+    mEntries[items[entry.slot].object].slot = entry.slot;
+  }
+  items.remove(lastSlot);
+
+  if (entry.node != -1)
+  {
+    markDirty(entry.node);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Splits the given leaf in four children, one per quadrant of its cell, and
+ * hands its items down to them. Children that are still too crowded get split
+ * as well.
+ *
+ * @param node Index of leaf node
+ */
+void SpatialIndex::split(int node)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int firstChild = mNodes.size();
+  double middleLatitude = (mNodes[node].south + mNodes[node].north) * 0.5;
+  double middleLongitude = (mNodes[node].west + mNodes[node].east) * 0.5;
+
+  for (int i = 0; i < 4; i++)
+  {
+    Node child;
+    child.south = (i < 2) ? mNodes[node].south : middleLatitude;
+    child.north = (i < 2) ? middleLatitude : mNodes[node].north;
+    child.west = (i % 2 == 0) ? mNodes[node].west : middleLongitude;
+    child.east = (i % 2 == 0) ? middleLongitude : mNodes[node].east;
+    child.depth = mNodes[node].depth + 1;
+    child.parent = node;
+    child.firstChild = -1;
+    child.count = 0;
+    child.positionSum.x = 0.0;
+    child.positionSum.y = 0.0;
+    child.positionSum.z = 0.0;
+    child.clusterQuery = 0;
+    child.isEmpty = true;
+    child.isDirty = true;
+    mNodes.append(child);
+  }
+
+  QVector<Item> items = mNodes[node].items;
+  mNodes[node].items.clear();
+  mNodes[node].firstChild = firstChild;
+  markDirty(node);
+
+  for (int i = 0; i < items.size(); i++)
+  {
+    int child = firstChild;
+    if (items[i].latitude >= middleLatitude)
+    {
+      child += 2;
+    }
+    if (items[i].longitude >= middleLongitude)
+    {
+      child += 1;
+    }
+
+    Entry& entry = mEntries[items[i].object];
+    entry.node = child;
+    entry.slot = mNodes[child].items.size();
+    mNodes[child].items.append(items[i]);
+  }
+
+  for (int i = firstChild; i < firstChild + 4; i++)
+  {
+    if (mNodes[i].items.size() > LEAF_CAPACITY && mNodes[i].depth < MAXIMUM_DEPTH)
+    {
+      split(i);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Marks the box of the given node and of its ancestors as out of date. The
+ * ancestors of a dirty node are always dirty too, so the walk stops at the
+ * first node that already is.
+ *
+ * @param node Index of node
+ */
+void SpatialIndex::markDirty(int node)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  while (node != -1 && !mNodes[node].isDirty)
+  {
+    mNodes[node].isDirty = true;
+    node = mNodes[node].parent;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Recomputes the boxes, object counts and position sums of the dirty nodes
+ * under (and including) the given one.
+ *
+ * @param node Index of node
+ */
+void SpatialIndex::refreshBounds(int node)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (!mNodes[node].isDirty)
+  {
+    return;
+  }
+
+  int firstChild = mNodes[node].firstChild;
+  if (firstChild != -1)
+  {
+    for (int i = firstChild; i < firstChild + 4; i++)
+    {
+      refreshBounds(i);
+    }
+  }
+
+  Node& current = mNodes[node];
+  current.isEmpty = true;
+  current.count = 0;
+  current.positionSum.x = 0.0;
+  current.positionSum.y = 0.0;
+  current.positionSum.z = 0.0;
+
+  if (firstChild == -1)
+  {
+    for (int i = 0; i < current.items.size(); i++)
+    {
+      if (current.items[i].isVisible)
+      {
+        current.count++;
+        current.positionSum.x += current.items[i].position.x;
+        current.positionSum.y += current.items[i].position.y;
+        current.positionSum.z += current.items[i].position.z;
+      }
+
+      if (current.isEmpty)
+      {
+        current.minimum = current.items[i].minimum;
+        current.maximum = current.items[i].maximum;
+        current.isEmpty = false;
+      }
+      else
+      {
+        mergeBox(current.items[i].minimum, current.items[i].maximum, current.minimum, current.maximum);
+      }
+    }
+  }
+  else
+  {
+    for (int i = firstChild; i < firstChild + 4; i++)
+    {
+      const Node& child = mNodes[i];
+      if (child.isEmpty)
+      {
+        continue;
+      }
+
+      current.count += child.count;
+      current.positionSum.x += child.positionSum.x;
+      current.positionSum.y += child.positionSum.y;
+      current.positionSum.z += child.positionSum.z;
+
+      if (current.isEmpty)
+      {
+        current.minimum = child.minimum;
+        current.maximum = child.maximum;
+        current.isEmpty = false;
+      }
+      else
+      {
+        mergeBox(child.minimum, child.maximum, current.minimum, current.maximum);
+      }
+    }
+  }
+
+  current.isDirty = false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Recursive part of findVisible.
+ *
+ * @param node Index of node
+ * @param planes Frustum planes
+ * @param isInside True if an ancestor is entirely inside the frustum
+ * @param handles Returns the handles of the objects found
+ */
+void SpatialIndex::findVisible(int node, const double* planes, bool isInside, QVector<int>& handles)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const Node& current = mNodes[node];
+  if (current.isEmpty)
+  {
+    return;
+  }
+
+  if (!isInside)
+  {
+    int classification = classifyBox(planes, current.minimum, current.maximum);
+    if (classification < 0)
+    {
+      return;
+    }
+    isInside = (classification > 0);
+  }
+
+  if (current.firstChild == -1)
+  {
+    for (int i = 0; i < current.items.size(); i++)
+    {
+      const Item& item = current.items[i];
+      if (isInside || classifyBox(planes, item.minimum, item.maximum) >= 0)
+      {
+        handles.append(item.handle);
+      }
+    }
+  }
+  else
+  {
+    for (int i = current.firstChild; i < current.firstChild + 4; i++)
+    {
+      findVisible(i, planes, isInside, handles);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Recursive part of the clustering findVisible.
+ *
+ * @param node Index of node
+ * @param planes Frustum planes
+ * @param isInside True if an ancestor is entirely inside the frustum
+ * @param eye Camera position
+ * @param clusterAngle Largest angle a cluster may span from the eye, in radians
+ * @param brokenCluster Ancestor that broke up in this query, -1 if none did
+ * @param handles Returns the handles of the objects found on their own
+ * @param clusters Returns the clusters found
+ * @param expansions Returns the objects and clusters that came out of a cluster
+ */
+void SpatialIndex::findClusters(int node, const double* planes, bool isInside, const SimpleVector& eye,
+                                double clusterAngle, int brokenCluster, QVector<int>& handles,
+                                QVector<Cluster>& clusters, QVector<Expansion>& expansions)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  Node& current = mNodes[node];
+  if (current.isEmpty)
+  {
+    return;
+  }
+
+  if (!isInside)
+  {
+    int classification = classifyBox(planes, current.minimum, current.maximum);
+    if (classification < 0)
+    {
+      return;
+    }
+    isInside = (classification > 0);
+  }
+
+  bool wasCluster = (current.clusterQuery == mClusterQuery - 1);
+
+  if (current.count > 1)
+  {
+    //compare the box diagonal with the distance to its center
+    double sizeX = current.maximum.x - current.minimum.x;
+    double sizeY = current.maximum.y - current.minimum.y;
+    double sizeZ = current.maximum.z - current.minimum.z;
+    double distanceX = (current.minimum.x + current.maximum.x) * 0.5 - eye.x;
+    double distanceY = (current.minimum.y + current.maximum.y) * 0.5 - eye.y;
+    double distanceZ = (current.minimum.z + current.maximum.z) * 0.5 - eye.z;
+    double size = sqrt(sizeX*sizeX + sizeY*sizeY + sizeZ*sizeZ);
+    double distance = sqrt(distanceX*distanceX + distanceY*distanceY + distanceZ*distanceZ);
+
+    if (size < clusterAngle * distance)
+    {
+      current.clusterQuery = mClusterQuery;
+
+      Cluster cluster;
+      cluster.node = node;
+      cluster.count = current.count;
+      cluster.position = getAveragePosition(node);
+      clusters.append(cluster);
+
+      if (brokenCluster != -1 && !wasCluster)
+      {
+        Expansion expansion;
+        expansion.handle = -1;
+        expansion.node = node;
+        expansion.origin = getAveragePosition(brokenCluster);
+        expansions.append(expansion);
+      }
+      return;
+    }
+  }
+
+  //everything under a cluster that broke up comes out of it
+  if (wasCluster && brokenCluster == -1)
+  {
+    brokenCluster = node;
+  }
+
+  if (current.firstChild == -1)
+  {
+    for (int i = 0; i < current.items.size(); i++)
+    {
+      const Item& item = current.items[i];
+      if (isInside || classifyBox(planes, item.minimum, item.maximum) >= 0)
+      {
+        handles.append(item.handle);
+
+        if (brokenCluster != -1)
+        {
+          Expansion expansion;
+          expansion.handle = item.handle;
+          expansion.node = -1;
+          expansion.origin = getAveragePosition(brokenCluster);
+          expansions.append(expansion);
+        }
+      }
+    }
+  }
+  else
+  {
+    int firstChild = current.firstChild;
+    for (int i = firstChild; i < firstChild + 4; i++)
+    {
+      findClusters(i, planes, isInside, eye, clusterAngle, brokenCluster, handles, clusters, expansions);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the average position of the visible objects under the given node,
+ * the center of its box if none is visible. The node must not be empty or
+ * dirty.
+ *
+ * @param node Index of node
+ * @return Average position
+ */
+SimpleVector SpatialIndex::getAveragePosition(int node)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const Node& current = mNodes[node];
+
+  SimpleVector position;
+  if (current.count == 0)
+  {
+    position.x = (current.minimum.x + current.maximum.x) * 0.5;
+    position.y = (current.minimum.y + current.maximum.y) * 0.5;
+    position.z = (current.minimum.z + current.maximum.z) * 0.5;
+    return position;
+  }
+
+  position.x = current.positionSum.x / current.count;
+  position.y = current.positionSum.y / current.count;
+  position.z = current.positionSum.z / current.count;
+
+  return position;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Tests the given box against the given planes.
+ *
+ * @param planes Frustum planes
+ * @param minimum Minimum corner of the box
+ * @param maximum Maximum corner of the box
+ * @return -1 if the box is outside, 1 if it is entirely inside and 0 if it
+ * crosses a plane
+ */
+int SpatialIndex::classifyBox(const double* planes, const SimpleVector& minimum,
+                              const SimpleVector& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int classification = 1;
+
+  for (int i = 0; i < NUMBER_OF_PLANES; i++)
+  {
+    const double* plane = planes + i*4;
+
+    //corner furthest along the plane normal, and the one opposite to it
+    double farthest = plane[3];
+    double nearest = plane[3];
+    farthest += plane[0] * (plane[0] >= 0.0 ? maximum.x : minimum.x);
+    nearest += plane[0] * (plane[0] >= 0.0 ? minimum.x : maximum.x);
+    farthest += plane[1] * (plane[1] >= 0.0 ? maximum.y : minimum.y);
+    nearest += plane[1] * (plane[1] >= 0.0 ? minimum.y : maximum.y);
+    farthest += plane[2] * (plane[2] >= 0.0 ? maximum.z : minimum.z);
+    nearest += plane[2] * (plane[2] >= 0.0 ? minimum.z : maximum.z);
+
+    if (farthest < 0.0)
+    {
+      return -1;
+    }
+    if (nearest < 0.0)
+    {
+      classification = 0;
+    }
+  }
+
+  return classification;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Grows the merged box to include the given box.
+ *
+ * @param minimum Minimum corner of the box to include
+ * @param maximum Maximum corner of the box to include
+ * @param mergedMinimum Minimum corner of the merged box
+ * @param mergedMaximum Maximum corner of the merged box
+ */
+void SpatialIndex::mergeBox(const SimpleVector& minimum, const SimpleVector& maximum,
+                            SimpleVector& mergedMinimum, SimpleVector& mergedMaximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mergedMinimum.x = qMin(mergedMinimum.x, minimum.x);
+  mergedMinimum.y = qMin(mergedMinimum.y, minimum.y);
+  mergedMinimum.z = qMin(mergedMinimum.z, minimum.z);
+  mergedMaximum.x = qMax(mergedMaximum.x, maximum.x);
+  mergedMaximum.y = qMax(mergedMaximum.y, maximum.y);
+  mergedMaximum.z = qMax(mergedMaximum.z, maximum.z);
+}
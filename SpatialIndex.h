@@ -0,0 +1,163 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include "globals.h"
+
+class WorldObject;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Geodetic quadtree over the world objects of WorldObjectManager, used to find
+ * the objects inside the view frustum without visiting all of them. Objects
+ * are filed in the leaf whose latitude/longitude cell holds their position,
+ * leaves split in four once they hold more than LEAF_CAPACITY objects. Every
+ * node also keeps the XYZ bounding box of everything under it, meshes
+ * included, and that box is what gets tested against the frustum planes.
+ *
+ * Objects are indexed with their frame state (see WorldObject::FrameState),
+ * WorldObjectManager updates them as it acquires new states. An object is
+ * moved to another leaf only if it left its cell. Boxes of the nodes
+ * that changed are only marked dirty and get recomputed on the next query, so
+ * objects moving many times between frames cost little. Objects whose mesh
+ * has unknown extents (see MeshRenderer::getBounds) are always returned.
+ *
+ * Nodes also keep the number and average position of the visible objects
+ * under them (see WorldObject::FrameState::isVisible),
+ * which makes the quadtree a cluster hierarchy. The clustering query stops at
+ * nodes whose box looks smaller than a given angle from the camera and
+ * reports them as one cluster, so the clusters follow the camera distance and
+ * are kept up to date with the boxes. Nodes that were clusters in the last
+ * query and broke up are reported as expansions, along with what came out of
+ * them, so that callers can animate the break up.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class SpatialIndex
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static const int LEAF_CAPACITY = 32;
+    static const int MAXIMUM_DEPTH = 16;
+    static const int NUMBER_OF_PLANES = 6;
+
+    struct Cluster
+    {
+      int node;//quadtree node the cluster stands for
+      int count;//number of objects in the cluster
+      SimpleVector position;//average position of the objects
+    };
+
+    struct Expansion
+    {
+      int handle;//object that came out of a cluster, -1 for clusters
+      int node;//cluster that came out of a bigger one, -1 for objects
+      SimpleVector origin;//position of the cluster that broke up
+    };
+
+    SpatialIndex();
+    ~SpatialIndex();
+
+    void insert(WorldObject* object, int handle);
+    bool update(WorldObject* object);
+    void remove(WorldObject* object);
+    void clear();
+    int getNumberOfObjects();
+    int getNumberOfNodes();
+    void findVisible(const double* planes, QVector<int>& handles);
+    void findVisible(const double* planes, const SimpleVector& eye, double clusterAngle,
+                     QVector<int>& handles, QVector<Cluster>& clusters,
+                     QVector<Expansion>& expansions);
+
+    static void getFrustumPlanes(const double* modelView, const double* projection,
+                                 double marginX, double marginY, double* planes);
+
+  private:
+    struct Item
+    {
+      WorldObject* object;
+      int handle;
+      double latitude;
+      double longitude;
+      SimpleVector position;
+      SimpleVector minimum;
+      SimpleVector maximum;
+      bool isVisible;//hidden objects are not counted in clusters
+    };
+
+    struct Node
+    {
+      double south;
+      double west;
+      double north;
+      double east;
+      int depth;
+      int parent;
+      int firstChild;//children are stored next to each other, -1 for leaves
+      QVector<Item> items;
+      SimpleVector minimum;
+      SimpleVector maximum;
+      int count;//visible objects under the node
+      SimpleVector positionSum;//of the visible objects under the node
+      unsigned int clusterQuery;//last clustering query the node was a cluster in
+      bool isEmpty;
+      bool isDirty;
+    };
+
+    struct Entry
+    {
+      int node;//-1 for objects with unknown extents
+      int slot;
+    };
+
+    static bool getItem(WorldObject* object, int handle, Item& item);
+    int findLeaf(double latitude, double longitude);
+    void addItem(const Item& item);
+    void removeItem(const Entry& entry);
+    void split(int node);
+    void markDirty(int node);
+    void refreshBounds(int node);
+    void findVisible(int node, const double* planes, bool isInside, QVector<int>& handles);
+    void findClusters(int node, const double* planes, bool isInside, const SimpleVector& eye,
+                      double clusterAngle, int brokenCluster, QVector<int>& handles,
+                      QVector<Cluster>& clusters, QVector<Expansion>& expansions);
+    SimpleVector getAveragePosition(int node);
+    static int classifyBox(const double* planes, const SimpleVector& minimum,
+                           const SimpleVector& maximum);
+    static void mergeBox(const SimpleVector& minimum, const SimpleVector& maximum,
+                         SimpleVector& mergedMinimum, SimpleVector& mergedMaximum);
+
+    QMutex mMutex;
+    QVector<Node> mNodes;
+    QVector<Item> mUnboundedItems;
+    QHash<WorldObject*, Entry> mEntries;
+    unsigned int mClusterQuery;//number of the current clustering query
+};
+
+#endif//SPATIAL_INDEX_H
@@ -0,0 +1,208 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QtOpenGL>
+#include "SpriteBatch.h"
+#include "Camera.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor.
+ */
+SpriteBatch::SpriteBatch()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mAlphaThreshold = 0.0f;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+SpriteBatch::~SpriteBatch()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Removes all sprites. Memory is kept around for the next frame.
+ */
+void SpriteBatch::clear()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mVertices.resize(0);
+  mTextureCoordinates.resize(0);
+  mColors.resize(0);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds a sprite centered at the given screen location.
+ *
+ * @param x Screen X coordinate of the center, in pixels
+ * @param y Screen Y coordinate of the center, in pixels
+ * @param size Width and height in pixels
+ * @param region Texture coordinates of the sprite as left, bottom, right, top
+ * @param depth Depth of the sprite, sprites with higher depth end up on top
+ * @param tint Color the texture gets multiplied with
+ */
+void SpriteBatch::addSprite(float x, float y, float size, const float* region, float depth,
+                            const SimpleColor& tint)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  float halfSize = size / 2.0f;
+  addQuad(x - halfSize, y - halfSize, x + halfSize, y + halfSize, region, depth, tint);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds a sprite covering the given screen rectangle.
+ *
+ * @param left Screen X coordinate of the left edge, in pixels
+ * @param bottom Screen Y coordinate of the bottom edge, in pixels
+ * @param right Screen X coordinate of the right edge, in pixels
+ * @param top Screen Y coordinate of the top edge, in pixels
+ * @param region Texture coordinates of the sprite as left, bottom, right, top
+ * @param depth Depth of the sprite, sprites with higher depth end up on top
+ * @param tint Color the texture gets multiplied with
+ */
+void SpriteBatch::addQuad(float left, float bottom, float right, float top, const float* region,
+                          float depth, const SimpleColor& tint)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  float corners[4][4] =
+  {
+    {left, bottom, region[0], region[1]},
+    {right, bottom, region[2], region[1]},
+    {right, top, region[2], region[3]},
+    {left, top, region[0], region[3]}
+  };
+
+  for (int i = 0; i < 4; i++)
+  {
+    mVertices.append(corners[i][0]);
+    mVertices.append(corners[i][1]);
+    mVertices.append(depth);
+    mTextureCoordinates.append(corners[i][2]);
+    mTextureCoordinates.append(corners[i][3]);
+    mColors.append(tint.red);
+    mColors.append(tint.green);
+    mColors.append(tint.blue);
+    mColors.append(tint.alpha);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Get method for the number of sprites in the batch.
+ *
+ * @return Number of sprites
+ */
+int SpriteBatch::getNumberOfSprites()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mVertices.size() / 12;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the alpha below which texels are not drawn at all. Use 0.5 for signed
+ * distance field textures, 0 (the default) turns the alpha test off.
+ *
+ * @param threshold Alpha threshold between 0 and 1
+ */
+void SpriteBatch::setAlphaThreshold(float threshold)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mAlphaThreshold = threshold;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * WARNING: This method is supposed to get called from within OpenGL rendering
+ * context. Draws all sprites with the given texture in screen coordinates.
+ * Projection and blending are set up once for the whole batch and the
+ * sprites go out in a single draw call.
+ *
+ * @param texture OpenGL handle to the texture the sprites are cut out of
+ */
+void SpriteBatch::render(unsigned int texture)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int numberOfSprites = getNumberOfSprites();
+  if (numberOfSprites == 0)
+  {
+    return;
+  }
+
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+
+  //get current screen size and set ortho
+  ScreenCoordinates screenSize = Camera::getInstance()->getScreenSize();
+  glOrtho(0, screenSize.x, 0, screenSize.y, -1, 1);
+
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+
+  //enable png transparency, tint by multiplying with vertex colors
+  glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  if (mAlphaThreshold > 0.0f)
+  {
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GEQUAL, mAlphaThreshold);
+  }
+
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, mVertices.constData());
+  glTexCoordPointer(2, GL_FLOAT, 0, mTextureCoordinates.constData());
+  glColorPointer(4, GL_FLOAT, 0, mColors.constData());
+
+  glDrawArrays(GL_QUADS, 0, numberOfSprites * 4);
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+
+  glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+  glDisable(GL_TEXTURE_2D);
+  glDisable(GL_BLEND);
+  glDisable(GL_ALPHA_TEST);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+
+  glMatrixMode(GL_MODELVIEW);
+  glPopMatrix();
+}
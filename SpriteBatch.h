@@ -0,0 +1,66 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <QVector>
+#include "globals.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * This class collects screen-aligned textured quads (sprites) that share one
+ * texture, e.g. the icons of a frame drawn out of the IconModelManager atlas,
+ * and draws all of them with a single call. Sprites are kept as vertex,
+ * texture coordinate and color arrays that are streamed to OpenGL as client
+ * side vertex arrays. Every sprite keeps its own depth and tint. With an alpha
+ * threshold set, texels below it are dropped, which is how the signed distance
+ * field glyphs of GlyphAtlas get their sharp outline.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class SpriteBatch
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    SpriteBatch();
+    ~SpriteBatch();
+
+    void clear();
+    void addSprite(float x, float y, float size, const float* region, float depth,
+                   const SimpleColor& tint);
+    void addQuad(float left, float bottom, float right, float top, const float* region,
+                 float depth, const SimpleColor& tint);
+    int getNumberOfSprites();
+    void setAlphaThreshold(float threshold);
+    void render(unsigned int texture);
+
+  private:
+    QVector<float> mVertices;//x, y, z of every corner
+    QVector<float> mTextureCoordinates;//s, t of every corner
+    QVector<float> mColors;//red, green, blue, alpha of every corner
+    float mAlphaThreshold;//alpha test disabled at 0
+};
+
+#endif//SPRITE_BATCH_H
@@ -0,0 +1,645 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <QMutexLocker>
+#include "TerrainPicker.h"
+#include "ElevationManager.h"
+#include "Constants.h"
+#include "Utilities.h"
+#include "math.h"
+
+//Singleton implementation
+TerrainPicker* TerrainPicker::mInstance = NULL;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+TerrainPicker::TerrainPicker()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < 16; i++)
+  {
+    mInverseViewProjection[i] = 0.0;
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    mViewport[i] = 0;
+  }
+  mHasViewState = false;
+  mElevationMode = false;
+  mLeafLength = 0.25;//Km, sampled in LEAF_STEPS steps of about 30m
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+TerrainPicker::~TerrainPicker()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mInstance = NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton pattern implementation. Returns the single instance of this class.
+ *
+ * @return The single instance of this object.
+ */
+TerrainPicker* TerrainPicker::getInstance()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mInstance == NULL)
+  {
+    mInstance = new TerrainPicker();
+  }
+
+  return mInstance;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Caches the camera matrices and viewport that picks are made against. This
+ * method gets called by GLWidget once per frame, right after the camera has
+ * been set up. Matrices are in OpenGL (column-major) order. This method is
+ * thread-safe.
+ *
+ * @param modelView Model-view matrix
+ * @param projection Projection matrix
+ * @param viewport Viewport as x, y, width and height
+ * @param elevationMode True if the terrain is drawn with elevations
+ */
+void TerrainPicker::setViewState(const double* modelView, const double* projection, const int* viewport,
+                                 bool elevationMode)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double viewProjection[16];
+  double inverse[16];
+
+  //projection * model-view, column-major
+  for (int column = 0; column < 4; column++)
+  {
+    for (int row = 0; row < 4; row++)
+    {
+      double sum = 0.0;
+      for (int k = 0; k < 4; k++)
+      {
+        sum += projection[k*4 + row] * modelView[column*4 + k];
+      }
+      viewProjection[column*4 + row] = sum;
+    }
+  }
+
+  bool isInvertible = invertMatrix(viewProjection, inverse);
+
+  QMutexLocker locker(&mViewMutex);
+  if (isInvertible)
+  {
+    for (int i = 0; i < 16; i++)
+    {
+      mInverseViewProjection[i] = inverse[i];
+    }
+    for (int i = 0; i < 4; i++)
+    {
+      mViewport[i] = viewport[i];
+    }
+  }
+  mHasViewState = isInvertible;
+  mElevationMode = elevationMode;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true once camera matrices have been provided through setViewState.
+ *
+ * @return True if picks can be made
+ */
+bool TerrainPicker::getHasViewState()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mViewMutex);
+  return mHasViewState;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the ray that goes through the given pixel. This method is
+ * thread-safe.
+ *
+ * @param screenPosition Screen coordinates (origin at the top left corner)
+ * @param origin Set to the ray origin on the near clipping plane (XYZ)
+ * @param direction Set to the unit direction of the ray
+ * @return False if no camera matrices have been provided yet
+ */
+bool TerrainPicker::getRay(const ScreenCoordinates& screenPosition, SimpleVector& origin, SimpleVector& direction)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  SimpleVector farPosition;
+  if (!getRayEnds(screenPosition, origin, farPosition))
+  {
+    return false;
+  }
+
+  direction.x = farPosition.x - origin.x;
+  direction.y = farPosition.y - origin.y;
+  direction.z = farPosition.z - origin.z;
+  double length = sqrt(direction.x*direction.x + direction.y*direction.y + direction.z*direction.z);
+  if (length <= 0.0)
+  {
+    return false;
+  }
+
+  direction.x /= length;
+  direction.y /= length;
+  direction.z /= length;
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Finds the point of the terrain under the given pixel. If the pixel does not
+ * show the Earth, worldPosition is set to the point on the far clipping plane,
+ * like a depth buffer read would do. This method is thread-safe.
+ *
+ * @param screenPosition Screen coordinates (origin at the top left corner)
+ * @param worldPosition Set to the picked position (XYZ)
+ * @return True if the terrain was hit
+ */
+bool TerrainPicker::pick(const ScreenCoordinates& screenPosition, SimpleVector& worldPosition)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  SimpleVector nearPosition, farPosition, direction;
+
+  worldPosition.x = 0.0;
+  worldPosition.y = 0.0;
+  worldPosition.z = 0.0;
+
+  if (!getRayEnds(screenPosition, nearPosition, farPosition))
+  {
+    return false;
+  }
+
+  direction.x = farPosition.x - nearPosition.x;
+  direction.y = farPosition.y - nearPosition.y;
+  direction.z = farPosition.z - nearPosition.z;
+  double length = sqrt(direction.x*direction.x + direction.y*direction.y + direction.z*direction.z);
+  if (length > 0.0)
+  {
+    direction.x /= length;
+    direction.y /= length;
+    direction.z /= length;
+
+    if (intersectRay(nearPosition, direction, worldPosition))
+    {
+      return true;
+    }
+  }
+
+  worldPosition = farPosition;
+
+  return false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Intersects the given ray with the terrain, i.e. the Earth sphere raised by
+ * the elevation databases currently loaded, or the plain sphere when Earth is
+ * not in elevation mode. This method is thread-safe.
+ *
+ * @param origin Ray origin (XYZ)
+ * @param direction Unit direction of the ray
+ * @param worldPosition Set to the first intersection with the terrain (XYZ)
+ * @return True if the ray hits the terrain
+ */
+bool TerrainPicker::intersectRay(const SimpleVector& origin, const SimpleVector& direction, SimpleVector& worldPosition)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  float minimum = 0.0f;
+  float maximum = 0.0f;
+  double outerNear, outerFar, innerNear, innerFar;
+
+  bool elevationMode;
+  {
+    QMutexLocker locker(&mViewMutex);
+    elevationMode = mElevationMode;
+  }
+
+  //the terrain lies in the shell between the lowest and highest elevations,
+  //without elevation mode both are at sea level and the sphere is hit
+  if (elevationMode)
+  {
+    ElevationManager::getInstance()->getElevationBounds(-90.0, -180.0, 90.0, 180.0, minimum, maximum);
+  }
+  if (!intersectSphere(origin, direction, Constants::EARTH_MEAN_RADIUS + maximum, outerNear, outerFar) ||
+      outerFar < 0.0)
+  {
+    return false;
+  }
+
+  double start = qMax(outerNear, 0.0);
+  double end = outerFar;
+
+  //by the time the ray reaches the inner sphere it is under the terrain
+  if (intersectSphere(origin, direction, Constants::EARTH_MEAN_RADIUS + minimum, innerNear, innerFar) &&
+      innerNear >= start)
+  {
+    end = innerNear;
+  }
+
+  double hit = start;
+  if (elevationMode && end - start > 0.0 && !intersectSegment(origin, direction, start, end, 0, hit))
+  {
+    return false;
+  }
+
+  worldPosition.x = origin.x + direction.x * hit;
+  worldPosition.y = origin.y + direction.y * hit;
+  worldPosition.z = origin.z + direction.z * hit;
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Looks for the first intersection with the terrain between the given ray
+ * distances. The segment is discarded if it stays above the highest elevation
+ * of the region it flies over, otherwise it is split in two halves that are
+ * checked front to back, down to mLeafLength.
+ *
+ * @param origin Ray origin (XYZ)
+ * @param direction Unit direction of the ray
+ * @param start Distance along the ray where the segment starts
+ * @param end Distance along the ray where the segment ends
+ * @param depth Recursion depth
+ * @param hit Set to the distance along the ray of the intersection
+ * @return True if the segment hits the terrain
+ */
+bool TerrainPicker::intersectSegment(const SimpleVector& origin, const SimpleVector& direction,
+                                     double start, double end, int depth, double& hit)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  SimpleVector startPosition, endPosition, closestPosition;
+
+  startPosition.x = origin.x + direction.x * start;
+  startPosition.y = origin.y + direction.y * start;
+  startPosition.z = origin.z + direction.z * start;
+  endPosition.x = origin.x + direction.x * end;
+  endPosition.y = origin.y + direction.y * end;
+  endPosition.z = origin.z + direction.z * end;
+
+  //lowest point of the segment
+  double closest = -(origin.x*direction.x + origin.y*direction.y + origin.z*direction.z);
+  closest = qBound(start, closest, end);
+  closestPosition.x = origin.x + direction.x * closest;
+  closestPosition.y = origin.y + direction.y * closest;
+  closestPosition.z = origin.z + direction.z * closest;
+  double minimumRadius = sqrt(closestPosition.x*closestPosition.x + closestPosition.y*closestPosition.y +
+                              closestPosition.z*closestPosition.z);
+
+  //region the segment flies over, padded by its angular length so that
+  //the bulge of the great circle between both ends is covered
+  GeodeticPosition startGeo = Utilities::xyzToGeodetic(startPosition);
+  GeodeticPosition endGeo = Utilities::xyzToGeodetic(endPosition);
+  double padding = (end - start) / qMax(minimumRadius, 1.0) * Constants::RADIANS_TO_DEGREES;
+  double south = qMin(startGeo.latitude, endGeo.latitude) - padding;
+  double north = qMax(startGeo.latitude, endGeo.latitude) + padding;
+  double west = -180.0;
+  double east = 180.0;
+
+  if (south > -89.0 && north < 89.0 && fabs(startGeo.longitude - endGeo.longitude) < 180.0)
+  {
+    double maximumLatitude = qMax(fabs(south), fabs(north)) * Constants::DEGREES_TO_RADIANS;
+    double longitudePadding = padding / cos(maximumLatitude);
+    west = qMin(startGeo.longitude, endGeo.longitude) - longitudePadding;
+    east = qMax(startGeo.longitude, endGeo.longitude) + longitudePadding;
+
+    //no wrapping around the anti-meridian, just take all longitudes
+    if (west < -180.0 || east > 180.0)
+    {
+      west = -180.0;
+      east = 180.0;
+    }
+  }
+
+  float minimum = 0.0f;
+  float maximum = 0.0f;
+  ElevationManager::getInstance()->getElevationBounds(qMax(south, -90.0), west, qMin(north, 90.0), east,
+                                                      minimum, maximum);
+  if (minimumRadius > Constants::EARTH_MEAN_RADIUS + maximum)
+  {
+    return false;
+  }
+
+  if (end - start <= mLeafLength || depth >= MAXIMUM_DEPTH)
+  {
+    return intersectLeaf(origin, direction, start, end, hit);
+  }
+
+  double middle = (start + end) * 0.5;
+  if (intersectSegment(origin, direction, start, middle, depth + 1, hit))
+  {
+    return true;
+  }
+
+  return intersectSegment(origin, direction, middle, end, depth + 1, hit);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Marches a short segment in LEAF_STEPS steps, sampling all of them in a
+ * single batch, and refines the first step that goes under the terrain by
+ * bisection.
+ *
+ * @param origin Ray origin (XYZ)
+ * @param direction Unit direction of the ray
+ * @param start Distance along the ray where the segment starts
+ * @param end Distance along the ray where the segment ends
+ * @param hit Set to the distance along the ray of the intersection
+ * @return True if the segment hits the terrain
+ */
+bool TerrainPicker::intersectLeaf(const SimpleVector& origin, const SimpleVector& direction,
+                                  double start, double end, double& hit)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double distances[LEAF_STEPS + 1];
+  double altitudes[LEAF_STEPS + 1];
+  double latitudes[LEAF_STEPS + 1];
+  double longitudes[LEAF_STEPS + 1];
+  float elevations[LEAF_STEPS + 1];
+  SimpleVector position;
+  GeodeticPosition geoPosition;
+
+  for (int i = 0; i <= LEAF_STEPS; i++)
+  {
+    distances[i] = start + (end - start) * (double)i / (double)LEAF_STEPS;
+    position.x = origin.x + direction.x * distances[i];
+    position.y = origin.y + direction.y * distances[i];
+    position.z = origin.z + direction.z * distances[i];
+    geoPosition = Utilities::xyzToGeodetic(position);
+    latitudes[i] = geoPosition.latitude;
+    longitudes[i] = geoPosition.longitude;
+    altitudes[i] = geoPosition.altitude;
+  }
+
+  ElevationManager::getInstance()->getElevations(latitudes, longitudes, elevations, LEAF_STEPS + 1);
+
+  for (int i = 0; i <= LEAF_STEPS; i++)
+  {
+    if (altitudes[i] - elevations[i] > 0.0)
+    {
+      continue;
+    }
+
+    if (i == 0)
+    {
+      hit = start;
+      return true;
+    }
+
+    //bisect the step down to a few centimeters
+    double above = distances[i - 1];
+    double below = distances[i];
+    for (int j = 0; j < 12; j++)
+    {
+      double middle = (above + below) * 0.5;
+      if (getHeightAboveTerrain(origin, direction, middle) > 0.0)
+      {
+        above = middle;
+      }
+      else
+      {
+        below = middle;
+      }
+    }
+
+    hit = below;
+    return true;
+  }
+
+  return false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the height above the terrain of the given point of a ray.
+ *
+ * @param origin Ray origin (XYZ)
+ * @param direction Unit direction of the ray
+ * @param t Distance along the ray
+ * @return Height above the terrain in Km, negative under it
+ */
+double TerrainPicker::getHeightAboveTerrain(const SimpleVector& origin, const SimpleVector& direction, double t)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  SimpleVector position;
+  position.x = origin.x + direction.x * t;
+  position.y = origin.y + direction.y * t;
+  position.z = origin.z + direction.z * t;
+  GeodeticPosition geoPosition = Utilities::xyzToGeodetic(position);
+
+  return geoPosition.altitude -
+    ElevationManager::getInstance()->getElevation(geoPosition.latitude, geoPosition.longitude);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Unprojects the given pixel onto the near and far clipping planes using the
+ * cached camera matrices.
+ *
+ * @param screenPosition Screen coordinates (origin at the top left corner)
+ * @param nearPosition Set to the point on the near clipping plane (XYZ)
+ * @param farPosition Set to the point on the far clipping plane (XYZ)
+ * @return False if no camera matrices have been provided yet
+ */
+bool TerrainPicker::getRayEnds(const ScreenCoordinates& screenPosition, SimpleVector& nearPosition,
+                               SimpleVector& farPosition)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double inverse[16];
+  int viewport[4];
+
+  mViewMutex.lock();
+  bool hasViewState = mHasViewState;
+  for (int i = 0; i < 16; i++)
+  {
+    inverse[i] = mInverseViewProjection[i];
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    viewport[i] = mViewport[i];
+  }
+  mViewMutex.unlock();
+
+  if (!hasViewState)
+  {
+    return false;
+  }
+
+  //window coordinates have their origin at the bottom left corner
+  double windowX = screenPosition.x;
+  double windowY = viewport[3] - screenPosition.y;
+
+  return unproject(inverse, viewport, windowX, windowY, 0.0, nearPosition) &&
+         unproject(inverse, viewport, windowX, windowY, 1.0, farPosition);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Same as gluUnProject, with the inverse of projection * model-view given.
+ *
+ * @param inverse Inverse of the projection * model-view matrix
+ * @param viewport Viewport as x, y, width and height
+ * @param windowX Window x coordinate
+ * @param windowY Window y coordinate
+ * @param windowZ Window depth (0 near plane, 1 far plane)
+ * @param worldPosition Set to the unprojected position (XYZ)
+ * @return False if the point can not be unprojected
+ */
+bool TerrainPicker::unproject(const double* inverse, const int* viewport, double windowX, double windowY,
+                              double windowZ, SimpleVector& worldPosition)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (viewport[2] <= 0 || viewport[3] <= 0)
+  {
+    return false;
+  }
+
+  //normalized device coordinates
+  double in[4];
+  in[0] = (windowX - viewport[0]) / viewport[2] * 2.0 - 1.0;
+  in[1] = (windowY - viewport[1]) / viewport[3] * 2.0 - 1.0;
+  in[2] = windowZ * 2.0 - 1.0;
+  in[3] = 1.0;
+
+  double out[4];
+  for (int row = 0; row < 4; row++)
+  {
+    out[row] = inverse[row] * in[0] + inverse[4 + row] * in[1] +
+               inverse[8 + row] * in[2] + inverse[12 + row] * in[3];
+  }
+
+  if (out[3] == 0.0)
+  {
+    return false;
+  }
+
+  worldPosition.x = out[0] / out[3];
+  worldPosition.y = out[1] / out[3];
+  worldPosition.z = out[2] / out[3];
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Inverts a 4x4 matrix by cofactors.
+ *
+ * @param matrix Matrix to invert (column-major)
+ * @param inverse Set to the inverse matrix (column-major)
+ * @return False if the matrix is singular
+ */
+bool TerrainPicker::invertMatrix(const double* matrix, double* inverse)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  const double* m = matrix;
+  double cofactors[16];
+
+  cofactors[0] = m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] +
+                 m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+  cofactors[4] = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] -
+                 m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+  cofactors[8] = m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] +
+                 m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+  cofactors[12] = -m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] -
+                  m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+  cofactors[1] = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] -
+                 m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+  cofactors[5] = m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] +
+                 m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+  cofactors[9] = -m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] -
+                 m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+  cofactors[13] = m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] +
+                  m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+  cofactors[2] = m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15] +
+                 m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6];
+  cofactors[6] = -m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15] -
+                 m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6];
+  cofactors[10] = m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15] +
+                  m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5];
+  cofactors[14] = -m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14] -
+                  m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5];
+  cofactors[3] = -m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11] -
+                 m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6];
+  cofactors[7] = m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11] +
+                 m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6];
+  cofactors[11] = -m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11] -
+                  m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5];
+  cofactors[15] = m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10] +
+                  m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5];
+
+  double determinant = m[0]*cofactors[0] + m[1]*cofactors[4] + m[2]*cofactors[8] + m[3]*cofactors[12];
+  if (determinant == 0.0)
+  {
+    return false;
+  }
+
+  for (int i = 0; i < 16; i++)
+  {
+    inverse[i] = cofactors[i] / determinant;
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Intersects a ray with a sphere centered at the center of the Earth.
+ *
+ * @param origin Ray origin (XYZ)
+ * @param direction Unit direction of the ray
+ * @param radius Sphere radius in Km
+ * @param nearDistance Set to the distance along the ray where it enters the sphere
+ * @param farDistance Set to the distance along the ray where it leaves the sphere
+ * @return False if the ray misses the sphere
+ */
+bool TerrainPicker::intersectSphere(const SimpleVector& origin, const SimpleVector& direction,
+                                    double radius, double& nearDistance, double& farDistance)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double b = origin.x*direction.x + origin.y*direction.y + origin.z*direction.z;
+  double c = origin.x*origin.x + origin.y*origin.y + origin.z*origin.z - radius*radius;
+  double discriminant = b*b - c;
+  if (discriminant < 0.0)
+  {
+    return false;
+  }
+
+  double root = sqrt(discriminant);
+  nearDistance = -b - root;
+  farDistance = -b + root;
+
+  return true;
+}
@@ -0,0 +1,91 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef TERRAIN_PICKER_H
+#define TERRAIN_PICKER_H
+
+#include <QMutex>
+#include "globals.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Singleton class that finds the point of the terrain under a given pixel
+ * without reading back the depth buffer. GLWidget hands over the camera
+ * matrices once per frame (see setViewState), picks unproject a ray out of
+ * them and intersect it with the Earth and the elevation databases loaded in
+ * ElevationManager.
+ *
+ * The ray is clipped against the shell of the highest and lowest elevations,
+ * then split in halves recursively. Halves that stay above the terrain, as
+ * told by ElevationManager::getElevationBounds, are discarded right away, so
+ * only the few short pieces that are close to the ground get sampled. When
+ * Earth is not in elevation mode the terrain is not drawn, so picks hit the
+ * smooth sphere instead. Picks never touch OpenGL and can be made from any
+ * thread.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class TerrainPicker
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    static TerrainPicker* getInstance();
+    ~TerrainPicker();
+
+    void setViewState(const double* modelView, const double* projection, const int* viewport,
+                      bool elevationMode);
+    bool getHasViewState();
+    bool getRay(const ScreenCoordinates& screenPosition, SimpleVector& origin, SimpleVector& direction);
+    bool pick(const ScreenCoordinates& screenPosition, SimpleVector& worldPosition);
+    bool intersectRay(const SimpleVector& origin, const SimpleVector& direction, SimpleVector& worldPosition);
+
+  private:
+    static const int LEAF_STEPS = 8;
+    static const int MAXIMUM_DEPTH = 32;
+
+    TerrainPicker();//private due to Singleton implementation
+    bool intersectSegment(const SimpleVector& origin, const SimpleVector& direction,
+                          double start, double end, int depth, double& hit);
+    bool intersectLeaf(const SimpleVector& origin, const SimpleVector& direction,
+                       double start, double end, double& hit);
+    double getHeightAboveTerrain(const SimpleVector& origin, const SimpleVector& direction, double t);
+    bool getRayEnds(const ScreenCoordinates& screenPosition, SimpleVector& nearPosition,
+                    SimpleVector& farPosition);
+    static bool unproject(const double* inverse, const int* viewport, double windowX, double windowY,
+                          double windowZ, SimpleVector& worldPosition);
+    static bool invertMatrix(const double* matrix, double* inverse);
+    static bool intersectSphere(const SimpleVector& origin, const SimpleVector& direction,
+                                double radius, double& nearDistance, double& farDistance);
+
+    static TerrainPicker* mInstance;
+    QMutex mViewMutex;
+    double mInverseViewProjection[16];
+    int mViewport[4];
+    bool mHasViewState;
+    bool mElevationMode;//terrain is a smooth sphere when not set
+    double mLeafLength;
+};
+
+#endif//TERRAIN_PICKER_H
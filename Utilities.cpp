@@ -22,10 +22,12 @@
 
 #include <QStringList>
 #include <QGLWidget>
-#include <GL/glu.h>
 #include "math.h"
 #include "Utilities.h"
 #include "Constants.h"
+#include "TerrainPicker.h"
+#include "WorldObjectManager.h"
+#include "CameraProjection.h"
 
 #ifndef GL_CLAMP_TO_EDGE
 #define GL_CLAMP_TO_EDGE 0x812F
@@ -59,6 +61,37 @@ GeodeticPosition Utilities::xyzToGeodetic(const SimpleVector& xyzPosition)
   return geodeticPosition;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Batch version of xyzToGeodetic for arrays of positions, e.g. the frame
+ * states of the objects updated since the last frame. Coordinates go in and
+ * out as separate arrays and the loop has no branches, so the compiler can
+ * vectorize it.
+ *
+ * @param x X coordinates
+ * @param y Y coordinates
+ * @param z Z coordinates
+ * @param latitudes Returns the latitudes in decimal degrees
+ * @param longitudes Returns the longitudes in decimal degrees
+ * @param altitudes Returns the altitudes in Km
+ * @param count Number of positions
+ */
+void Utilities::xyzToGeodetic(const double* x, const double* y, const double* z,
+                              double* latitudes, double* longitudes, double* altitudes, int count)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < count; i++)
+  {
+    double radius = sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]);
+    double theta = acos(z[i] / radius);
+    double phi = atan2(y[i], x[i]);
+
+    latitudes[i] = ((theta * Constants::RADIANS_TO_DEGREES) - 90.0) * -1;
+    longitudes[i] = phi * Constants::RADIANS_TO_DEGREES;
+    altitudes[i] = radius - Constants::EARTH_MEAN_RADIUS;
+  }
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Converts the given geodetic position to XYZ. Our XYZ coordinates are very
@@ -87,6 +120,38 @@ SimpleVector Utilities::geodeticToXYZ(const GeodeticPosition& geodeticPosition)
   return xyzPosition;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Batch version of geodeticToXYZ for arrays of positions, e.g. a batch of
+ * track updates. Coordinates go in and out as separate arrays and the loop
+ * has no branches, so the compiler can vectorize it.
+ *
+ * @param latitudes Latitudes in decimal degrees
+ * @param longitudes Longitudes in decimal degrees
+ * @param altitudes Altitudes in Km
+ * @param x Returns the X coordinates
+ * @param y Returns the Y coordinates
+ * @param z Returns the Z coordinates
+ * @param count Number of positions
+ */
+void Utilities::geodeticToXYZ(const double* latitudes, const double* longitudes, const double* altitudes,
+                              double* x, double* y, double* z, int count)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < count; i++)
+  {
+    //same as the single position version, with sin(theta) = cos(latitude)
+    double latitude = latitudes[i] * Constants::DEGREES_TO_RADIANS;
+    double longitude = longitudes[i] * Constants::DEGREES_TO_RADIANS;
+    double radius = Constants::EARTH_MEAN_RADIUS + altitudes[i];
+    double horizontalRadius = radius * cos(latitude);
+
+    x[i] = horizontalRadius * cos(longitude);
+    y[i] = horizontalRadius * sin(longitude);
+    z[i] = radius * sin(latitude);
+  }
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Converts the given string in the format [D]DD:MM:SS.S(N/S/E/W) e.g.
@@ -438,8 +503,14 @@ unsigned int Utilities::imageToTexture(const QImage& image)
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * WARNING: This method is supposed to get called from within OpenGL rendering
- * context. Converts the given screen coordinates to world coordinates.
+ * Converts the given screen coordinates to world coordinates, i.e. the point
+ * of the terrain or world object under the given pixel. The pick is made by
+ * TerrainPicker and WorldObjectManager::intersectRay against the camera
+ * matrices and visible objects of the last frame, so it does not read back the
+ * depth buffer. Only the render thread may call this method, use
+ * TerrainPicker::pick for terrain picks from other threads. If the pixel does
+ * not show the Earth or an object, a point on the far clipping plane is
+ * returned.
  *
  * @param screenPosition Screen coordinates
  * @return World coordinates
@@ -448,39 +519,34 @@ SimpleVector Utilities::screenToWorld(const ScreenCoordinates& screenPosition)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   SimpleVector returnValue;
+  SimpleVector origin, direction;
+  TerrainPicker* picker = TerrainPicker::getInstance();
 
-  //get model-view and viewport
-  GLdouble model[16];
-  glGetDoublev(GL_MODELVIEW_MATRIX, model);
-  GLdouble projection[16];
-  glGetDoublev(GL_PROJECTION_MATRIX, projection);
-  GLint view[4];
-  glGetIntegerv(GL_VIEWPORT, view);
-  GLdouble x,y,z;
-  float winX, winY, winZ;
-
-  winX = screenPosition.x;
-  winY = view[3] - screenPosition.y;
-
-  //IMPORTANT NOTE: You gotta be careful, if you give a glDouble to read pixels
-  //for the output it won't populate the least significant bits which always
-  //gives you a 0.0
-  glReadPixels((int)winX, (int)winY, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ);
-
-  //get current projected coordinates
-  gluUnProject(winX, winY, winZ, model, projection, view, &x, &y, &z);
+  picker->pick(screenPosition, returnValue);
+  if (!picker->getRay(screenPosition, origin, direction))
+  {
+    return returnValue;
+  }
 
-  returnValue.x = x;
-  returnValue.y = y;
-  returnValue.z = z;
+  //objects drawn in front of the terrain win, as they did in the depth buffer
+  double distance = sqrt((returnValue.x - origin.x)*(returnValue.x - origin.x) +
+                         (returnValue.y - origin.y)*(returnValue.y - origin.y) +
+                         (returnValue.z - origin.z)*(returnValue.z - origin.z));
+  if (WorldObjectManager::getInstance()->intersectRay(origin, direction, distance))
+  {
+    returnValue.x = origin.x + direction.x * distance;
+    returnValue.y = origin.y + direction.y * distance;
+    returnValue.z = origin.z + direction.z * distance;
+  }
 
   return returnValue;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * WARNING: This method is supposed to get called from within OpenGL rendering
- * context. Converts the given world coordinates to screen coordinates.
+ * Converts the given world coordinates to screen coordinates, using the
+ * camera matrices of the current frame (see CameraProjection). Only the render
+ * thread may call this method.
  *
  * @param worldPosition Woorld coordinates
  * @return Screen coordiates (z value is used to determine if object lies
@@ -489,24 +555,5 @@ SimpleVector Utilities::screenToWorld(const ScreenCoordinates& screenPosition)
 SimpleVector Utilities::worldToScreen(const SimpleVector& worldPosition)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  SimpleVector returnValue;
-
-  //get model-view and viewport
-  GLdouble model[16];
-  glGetDoublev(GL_MODELVIEW_MATRIX, model);
-  GLdouble projection[16];
-  glGetDoublev(GL_PROJECTION_MATRIX, projection);
-  GLint view[4];
-  glGetIntegerv(GL_VIEWPORT, view);
-  GLdouble screenX, screenY, screenZ;
-
-  //get current projected location
-  gluProject(worldPosition.x, worldPosition.y, worldPosition.z, model,
-             projection, view, &screenX, &screenY, &screenZ);
-
-  returnValue.x = screenX;
-  returnValue.y = screenY;
-  returnValue.z = screenZ;//z coordinate is used to know if icon lies behind the camera
-
-  return returnValue;
+  return CameraProjection::getInstance()->worldToScreen(worldPosition);
 }
@@ -41,7 +41,11 @@ class Utilities
 {
   public:
     static GeodeticPosition xyzToGeodetic(const SimpleVector& xyzPosition);
+    static void xyzToGeodetic(const double* x, const double* y, const double* z,
+                              double* latitudes, double* longitudes, double* altitudes, int count);
     static SimpleVector geodeticToXYZ(const GeodeticPosition& geodeticPosition);
+    static void geodeticToXYZ(const double* latitudes, const double* longitudes, const double* altitudes,
+                              double* x, double* y, double* z, int count);
     static double dmsToDecimalDegrees(const QString& dmsString);
     static QString decimalDegreesToDMS(double decimalDegrees, bool isLatitude);
     static GeodeticPosition ecefToGeodetic(const SimpleVector& ecefPosition);
@@ -0,0 +1,822 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include "Viewshed.h"
+#include "ViewshedThread.h"
+#include "ElevationManager.h"
+#include "Earth.h"
+#include "Constants.h"
+#include "math.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ */
+Viewshed::Viewshed()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mObserver.latitude = 0.0;
+  mObserver.longitude = 0.0;
+  mObserver.altitude = 0.0;
+  mObserverHeight = 0.0;
+  mObserverElevation = 0.0;
+  mTargetHeight = 0.0;
+  mRadius = 0.0;
+  mCellSizeDegrees = 1.0/3600.0;//1 arc-second
+  mCellSizeXKm = 0.0;
+  mCellSizeYKm = 0.0;
+  mRefractionCoefficient = 0.13;
+  mWidth = 0;
+  mHeight = 0;
+  mObserverRow = 0;
+  mObserverColumn = 0;
+  mCells = NULL;
+  mOverlayTexture = 0;
+  mNumberOfFinishedThreads = 0;
+  mRaysTraced = 0;
+  mIsRunning = false;
+  mCancelRequested = false;
+  mWasCancelled = false;
+  mLastRunTime = 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor. Stops a running analysis. Note the overlay (if any) is left on
+ * the Earth, call removeFromEarth first to get rid of it.
+ */
+Viewshed::~Viewshed()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  cancel();
+  releaseThreads();
+  delete [] mCells;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts computing the viewshed of the given observer. The elevation
+ * databases under the viewshed are loaded first if needed, and stay pinned
+ * until the analysis is done. Then returns right away, the analysis runs on
+ * the given number of threads.
+ *
+ * @param observer Observer position (altitude is ignored)
+ * @param observerHeight Observer height above the ground in Km
+ * @param targetHeight Height above the ground of the targets in Km
+ * @param radius Radius of the analysis in Km
+ * @param numberOfThreads Number of worker threads
+ * @return False if an analysis is running already or parameters are invalid
+ */
+bool Viewshed::start(const GeodeticPosition& observer, double observerHeight, double targetHeight,
+                     double radius, int numberOfThreads)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (getIsRunning())
+  {
+    return false;
+  }
+
+  //make sure no previous analysis is still writing to the cells
+  releaseThreads();
+
+  if (radius <= 0.0 || fabs(observer.latitude) > 85.0)
+  {
+    printf("Viewshed.cpp: Error, invalid viewshed radius or observer position.\n");
+    return false;
+  }
+
+  //cells are square in degrees, so their east-west size in Km shrinks with latitude
+  double kmPerDegree = Constants::EARTH_MEAN_RADIUS * Constants::DEGREES_TO_RADIANS;
+  mCellSizeYKm = mCellSizeDegrees * kmPerDegree;
+  mCellSizeXKm = mCellSizeYKm * cos(observer.latitude * Constants::DEGREES_TO_RADIANS);
+  mObserverRow = (int)ceil(radius / mCellSizeYKm);
+  mObserverColumn = (int)ceil(radius / mCellSizeXKm);
+
+  qint64 numberOfCells = (qint64)(2*mObserverRow + 1) * (qint64)(2*mObserverColumn + 1);
+  if (numberOfCells > 256LL * 1024LL * 1024LL)
+  {
+    printf("Viewshed.cpp: Error, viewshed is too large for the cell size.\n");
+    return false;
+  }
+
+  mObserver = observer;
+  mObserverHeight = observerHeight;
+  mTargetHeight = targetHeight;
+  mRadius = radius;
+  mHeight = 2*mObserverRow + 1;
+  mWidth = 2*mObserverColumn + 1;
+
+  delete [] mCells;
+  mCells = new unsigned char[(size_t)numberOfCells];
+  memset(mCells, OUTSIDE, (size_t)numberOfCells);
+
+  if (numberOfThreads < 1)
+  {
+    numberOfThreads = 1;
+  }
+
+  //load the region once for all threads, it stays pinned until the last one is done
+  ElevationManager* elevationManager = ElevationManager::getInstance();
+  elevationManager->pinRegion(getSouth(), getWest(), getNorth(), getEast(), mPinnedDatasets);
+  mObserverElevation = elevationManager->getElevation(mObserver.latitude, mObserver.longitude) + mObserverHeight;
+
+  mMutex.lock();
+  mRaysTraced = 0;
+  mNumberOfFinishedThreads = 0;
+  mIsRunning = true;
+  mCancelRequested = false;
+  mWasCancelled = false;
+
+  //rays are interleaved between threads so that they all get rays of
+  //every length and finish at about the same time
+  for (int i = 0; i < numberOfThreads; i++)
+  {
+    mThreads.append(new ViewshedThread(this, i, numberOfThreads));
+  }
+  mMutex.unlock();
+
+  mRunTimer.start();
+  for (int i = 0; i < mThreads.size(); i++)
+  {
+    mThreads[i]->start();
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Asks a running analysis to stop. Threads stop after their current ray, and
+ * analysisFinished is emitted with no cells marked. This method is
+ * thread-safe.
+ */
+void Viewshed::cancel()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mMutex.lock();
+  if (mIsRunning)
+  {
+    mCancelRequested = true;
+  }
+  mMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Blocks until all viewshed threads are done.
+ */
+void Viewshed::waitForFinished()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < mThreads.size(); i++)
+  {
+    mThreads[i]->wait();
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true while the analysis is running. This method is thread-safe.
+ *
+ * @return True if the analysis is running
+ */
+bool Viewshed::getIsRunning()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mIsRunning;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if the last analysis was cancelled before it was done.
+ *
+ * @return True if the last analysis was cancelled
+ */
+bool Viewshed::getWasCancelled()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mWasCancelled;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the progress of the analysis. This method is thread-safe.
+ *
+ * @return Progress in percent of rays traced, 100 if not running
+ */
+int Viewshed::getProgress()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  if (!mIsRunning)
+  {
+    return 100;
+  }
+
+  return (int)(((qint64)mRaysTraced * 100) / getNumberOfRays());
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns how long the last analysis took, elevation loading included.
+ *
+ * @return Time in milliseconds
+ */
+qint64 Viewshed::getLastRunTime()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mLastRunTime;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the observer position of the last analysis.
+ *
+ * @return Observer position
+ */
+const GeodeticPosition& Viewshed::getObserver() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mObserver;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the radius of the last analysis.
+ *
+ * @return Radius in Km
+ */
+double Viewshed::getRadius()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mRadius;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of columns of the viewshed grid.
+ *
+ * @return Grid width in cells
+ */
+int Viewshed::getWidth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mWidth;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of rows of the viewshed grid.
+ *
+ * @return Grid height in cells
+ */
+int Viewshed::getHeight()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mHeight;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the latitude of the northern edge of the grid (row 0).
+ *
+ * @return Northern edge in decimal degrees
+ */
+double Viewshed::getNorth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mObserver.latitude + ((double)mObserverRow + 0.5) * mCellSizeDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the latitude of the southern edge of the grid.
+ *
+ * @return Southern edge in decimal degrees
+ */
+double Viewshed::getSouth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mObserver.latitude - ((double)mObserverRow + 0.5) * mCellSizeDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the longitude of the eastern edge of the grid.
+ *
+ * @return Eastern edge in decimal degrees
+ */
+double Viewshed::getEast()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mObserver.longitude + ((double)mObserverColumn + 0.5) * mCellSizeDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the longitude of the western edge of the grid (column 0).
+ *
+ * @return Western edge in decimal degrees
+ */
+double Viewshed::getWest()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mObserver.longitude - ((double)mObserverColumn + 0.5) * mCellSizeDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the state of the given cell, only meaningful once the analysis is
+ * done. Row 0 is the northern edge and column 0 the western edge of the grid.
+ *
+ * @param row Cell row
+ * @param column Cell column
+ * @return See CellState enum for valid values
+ */
+int Viewshed::getCellState(int row, int column)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mCells == NULL || row < 0 || row >= mHeight || column < 0 || column >= mWidth)
+  {
+    return OUTSIDE;
+  }
+
+  return mCells[(size_t)row * (size_t)mWidth + column];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Paints the result of the last analysis, north up. Cells outside of the
+ * radius are left transparent. The grid is subsampled if it does not fit in
+ * the given size.
+ *
+ * @param visibleColor Color for visible cells (alpha is honored)
+ * @param hiddenColor Color for hidden cells (alpha is honored)
+ * @param maximumSize Maximum width and height of the image in pixels
+ * @return The image, null if there is no result to paint
+ */
+QImage Viewshed::createImage(const QColor& visibleColor, const QColor& hiddenColor, int maximumSize)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mCells == NULL || getIsRunning())
+  {
+    return QImage();
+  }
+
+  int imageWidth = qMin(mWidth, maximumSize);
+  int imageHeight = qMin(mHeight, maximumSize);
+  QImage image(imageWidth, imageHeight, QImage::Format_ARGB32);
+  QRgb colors[3];
+  colors[OUTSIDE] = qRgba(0, 0, 0, 0);
+  colors[HIDDEN] = hiddenColor.rgba();
+  colors[VISIBLE] = visibleColor.rgba();
+
+  for (int y = 0; y < imageHeight; y++)
+  {
+    QRgb* line = (QRgb*)image.scanLine(y);
+    const unsigned char* cells = &mCells[(size_t)((qint64)y * mHeight / imageHeight) * (size_t)mWidth];
+    for (int x = 0; x < imageWidth; x++)
+    {
+      line[x] = colors[cells[(qint64)x * mWidth / imageWidth]];
+    }
+  }
+
+  return image;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Shows the result of the last analysis as an overlay on the Earth, visible
+ * cells in green and hidden ones in red. Replaces the overlay of a previous
+ * call. WARNING: This method is supposed to get called from the OpenGL (GUI)
+ * thread, e.g. from a slot connected to analysisFinished.
+ *
+ * @param visibleAltitude Camera altitude in Km under which the overlay shows
+ */
+void Viewshed::addToEarth(float visibleAltitude)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QImage image = createImage(QColor(0, 255, 0, 100), QColor(255, 0, 0, 100));
+  if (image.isNull())
+  {
+    return;
+  }
+
+  removeFromEarth();
+
+  GeodeticPosition southWest;
+  southWest.latitude = getSouth();
+  southWest.longitude = getWest();
+  southWest.altitude = 0.0;
+  GeodeticPosition northEast;
+  northEast.latitude = getNorth();
+  northEast.longitude = getEast();
+  northEast.altitude = 0.0;
+
+  //overlays get the highest draw priority so they go on top of all maps
+  mOverlayTexture = Earth::getInstance()->addMap(southWest, northEast, visibleAltitude, 10, image, true);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Removes the overlay added by addToEarth, if any. WARNING: This method is
+ * supposed to get called from the OpenGL (GUI) thread.
+ */
+void Viewshed::removeFromEarth()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mOverlayTexture != 0)
+  {
+    Earth::getInstance()->removeMap(mOverlayTexture);
+    mOverlayTexture = 0;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the size of the grid cells used by the next analysis. It should match
+ * the resolution of the elevation databases, 1 arc-second by default.
+ *
+ * @param cellSize Cell size in decimal degrees
+ */
+void Viewshed::setCellSizeDegrees(double cellSize)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (cellSize > 0.0)
+  {
+    mCellSizeDegrees = cellSize;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the size of the grid cells.
+ *
+ * @return Cell size in decimal degrees
+ */
+double Viewshed::getCellSizeDegrees()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mCellSizeDegrees;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the atmospheric refraction coefficient used by the next analysis. Light
+ * bends along the Earth, which makes the terrain drop less than the Earth
+ * curvature alone would. 0.13 is the usual value for visible light, 0 turns
+ * refraction off.
+ *
+ * @param coefficient Refraction coefficient
+ */
+void Viewshed::setRefractionCoefficient(double coefficient)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mRefractionCoefficient = coefficient;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the atmospheric refraction coefficient.
+ *
+ * @return Refraction coefficient
+ */
+double Viewshed::getRefractionCoefficient()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mRefractionCoefficient;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Tells whether the target can be seen from the observer, sampling the terrain
+ * between both about every 30m. Distances are computed on a plane tangent to
+ * the Earth at mid way, which is accurate enough for a few hundred Km. This
+ * method blocks while the elevation databases along the line get loaded.
+ *
+ * @param observer Observer position (altitude is ignored)
+ * @param observerHeight Observer height above the ground in Km
+ * @param target Target position (altitude is ignored)
+ * @param targetHeight Target height above the ground in Km
+ * @param refractionCoefficient Atmospheric refraction coefficient
+ * @return True if there is line of sight
+ */
+bool Viewshed::getLineOfSight(const GeodeticPosition& observer, double observerHeight,
+                              const GeodeticPosition& target, double targetHeight,
+                              double refractionCoefficient)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double kmPerDegree = Constants::EARTH_MEAN_RADIUS * Constants::DEGREES_TO_RADIANS;
+  double cosine = cos((observer.latitude + target.latitude) * 0.5 * Constants::DEGREES_TO_RADIANS);
+  double northKm = (target.latitude - observer.latitude) * kmPerDegree;
+  double eastKm = (target.longitude - observer.longitude) * kmPerDegree * cosine;
+  double distance = sqrt(northKm*northKm + eastKm*eastKm);
+  double sampleSpacing = 0.03;//Km, about 1 arc-second
+  double curvatureFactor = (1.0 - refractionCoefficient) / (2.0 * Constants::EARTH_MEAN_RADIUS);
+  int numberOfSamples = (int)ceil(distance / sampleSpacing) + 1;
+
+  if (numberOfSamples < 2)
+  {
+    return true;
+  }
+
+  ElevationManager* elevationManager = ElevationManager::getInstance();
+  elevationManager->loadRegion(qMin(observer.latitude, target.latitude), qMin(observer.longitude, target.longitude),
+                               qMax(observer.latitude, target.latitude), qMax(observer.longitude, target.longitude));
+
+  //sample the whole line in one batch, both ends included
+  QVector<double> latitudes(numberOfSamples);
+  QVector<double> longitudes(numberOfSamples);
+  QVector<float> elevations(numberOfSamples);
+  for (int i = 0; i < numberOfSamples; i++)
+  {
+    double fraction = (double)i / (double)(numberOfSamples - 1);
+    latitudes[i] = observer.latitude + (target.latitude - observer.latitude) * fraction;
+    longitudes[i] = observer.longitude + (target.longitude - observer.longitude) * fraction;
+  }
+  elevationManager->getElevations(latitudes.data(), longitudes.data(), elevations.data(), numberOfSamples);
+
+  double observerElevation = elevations[0] + observerHeight;
+  double targetElevation = elevations[numberOfSamples - 1] + targetHeight - distance*distance*curvatureFactor;
+  double targetSlope = (targetElevation - observerElevation) / distance;
+
+  //line of sight is blocked by any terrain steeper than the target
+  for (int i = 1; i < numberOfSamples - 1; i++)
+  {
+    double sampleDistance = distance * (double)i / (double)(numberOfSamples - 1);
+    double terrain = elevations[i] - sampleDistance*sampleDistance*curvatureFactor;
+    if ((terrain - observerElevation) / sampleDistance > targetSlope)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by viewshed threads before tracing any ray. Returns the elevation of
+ * the observer, sampled by start once the region got loaded.
+ *
+ * @return Elevation of the observer (ground plus observer height) in Km
+ */
+double Viewshed::getObserverElevation()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mObserverElevation;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of rays of the analysis, one per cell on the border of
+ * the grid.
+ *
+ * @return Number of rays
+ */
+int Viewshed::getNumberOfRays()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return 2*(mWidth - 1) + 2*(mHeight - 1);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by viewshed threads. Traces the given ray from the observer to a cell
+ * on the border of the grid, one sample per row or column crossed (whichever
+ * there are more of), and marks the cells it finds visible. The ray stops at
+ * the analysis radius.
+ *
+ * @param rayIndex Index of the ray, border cells are numbered clockwise from
+ *        the north west corner
+ * @param observerElevation Elevation of the observer in Km (see getObserverElevation)
+ * @param latitudes Scratch buffer for the sample latitudes
+ * @param longitudes Scratch buffer for the sample longitudes
+ * @param elevations Scratch buffer for the sample elevations
+ */
+void Viewshed::traceRay(int rayIndex, double observerElevation, QVector<double>& latitudes,
+                        QVector<double>& longitudes, QVector<float>& elevations)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  int targetRow, targetColumn;
+
+  //north edge, east edge, south edge and west edge
+  if (rayIndex < mWidth - 1)
+  {
+    targetRow = 0;
+    targetColumn = rayIndex;
+  }
+  else if ((rayIndex -= mWidth - 1) < mHeight - 1)
+  {
+    targetRow = rayIndex;
+    targetColumn = mWidth - 1;
+  }
+  else if ((rayIndex -= mHeight - 1) < mWidth - 1)
+  {
+    targetRow = mHeight - 1;
+    targetColumn = mWidth - 1 - rayIndex;
+  }
+  else
+  {
+    rayIndex -= mWidth - 1;
+    targetRow = mHeight - 1 - rayIndex;
+    targetColumn = 0;
+  }
+
+  int rowDelta = targetRow - mObserverRow;
+  int columnDelta = targetColumn - mObserverColumn;
+  int numberOfSteps = qMax(qAbs(rowDelta), qAbs(columnDelta));
+  double rowStep = (double)rowDelta / (double)numberOfSteps;
+  double columnStep = (double)columnDelta / (double)numberOfSteps;
+  double stepLength = sqrt(rowStep*mCellSizeYKm*rowStep*mCellSizeYKm + columnStep*mCellSizeXKm*columnStep*mCellSizeXKm);
+  int numberOfSamples = qMin(numberOfSteps, (int)(mRadius / stepLength));
+
+  if (latitudes.size() < numberOfSamples)
+  {
+    latitudes.resize(numberOfSamples);
+    longitudes.resize(numberOfSamples);
+    elevations.resize(numberOfSamples);
+  }
+
+  //sample the whole ray in one batch, rows go south
+  for (int step = 1; step <= numberOfSamples; step++)
+  {
+    latitudes[step - 1] = mObserver.latitude - rowStep * step * mCellSizeDegrees;
+    longitudes[step - 1] = mObserver.longitude + columnStep * step * mCellSizeDegrees;
+  }
+  ElevationManager::getInstance()->getElevations(latitudes.data(), longitudes.data(),
+                                                 elevations.data(), numberOfSamples);
+
+  //the terrain drops with the Earth curvature, less so with refraction
+  double curvatureFactor = (1.0 - mRefractionCoefficient) / (2.0 * Constants::EARTH_MEAN_RADIUS);
+  double maximumSlope = -HUGE_VAL;
+
+  for (int step = 1; step <= numberOfSamples; step++)
+  {
+    double distance = step * stepLength;
+    double terrain = elevations[step - 1] - distance*distance*curvatureFactor;
+    double terrainSlope = (terrain - observerElevation) / distance;
+
+    //threads only ever mark cells as visible, overlapping rays never undo each other
+    if (terrainSlope + mTargetHeight / distance >= maximumSlope)
+    {
+      int row = qRound(mObserverRow + rowStep * step);
+      int column = qRound(mObserverColumn + columnStep * step);
+      mCells[(size_t)row * (size_t)mWidth + column] = VISIBLE;
+    }
+
+    if (terrainSlope > maximumSlope)
+    {
+      maximumSlope = terrainSlope;
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true once cancel has been called on a running analysis. This method
+ * is thread-safe.
+ *
+ * @return True if threads should stop
+ */
+bool Viewshed::getIsCancelRequested()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mCancelRequested;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by viewshed threads to report progress. This method is thread-safe.
+ *
+ * @param numberOfRays Number of rays traced since the last report
+ */
+void Viewshed::reportRaysTraced(int numberOfRays)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mMutex.lock();
+  mRaysTraced += numberOfRays;
+  mMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Called by viewshed threads right before they exit. The last thread to
+ * finish classifies the cells that were not found visible, unpins the
+ * elevation databases and emits analysisFinished. This method is thread-safe.
+ */
+void Viewshed::reportThreadFinished()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mMutex.lock();
+  mNumberOfFinishedThreads++;
+  bool isLastThread = (mNumberOfFinishedThreads == mThreads.size());
+  bool wasCancelled = mCancelRequested;
+  mMutex.unlock();
+
+  if (!isLastThread)
+  {
+    return;
+  }
+
+  //a partial result would be misleading
+  if (wasCancelled)
+  {
+    memset(mCells, OUTSIDE, (size_t)mWidth * (size_t)mHeight);
+  }
+  else
+  {
+    classifyCells();
+  }
+
+  ElevationManager::getInstance()->unpinDatasets(mPinnedDatasets);
+  mPinnedDatasets.clear();
+
+  mMutex.lock();
+  mIsRunning = false;
+  mWasCancelled = wasCancelled;
+  mLastRunTime = mRunTimer.elapsed();
+  mMutex.unlock();
+
+  if (!wasCancelled)
+  {
+    qDebug("Viewshed of %dx%d cells computed in %lld ms using %d threads",
+           mWidth, mHeight, mLastRunTime, mThreads.size());
+  }
+
+  emit analysisFinished();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Marks the cells within the radius that no ray found visible as hidden, and
+ * the ones beyond the radius as outside.
+ */
+void Viewshed::classifyCells()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double radiusSquared = mRadius * mRadius;
+
+  for (int row = 0; row < mHeight; row++)
+  {
+    double northKm = (row - mObserverRow) * mCellSizeYKm;
+    unsigned char* cells = &mCells[(size_t)row * (size_t)mWidth];
+    for (int column = 0; column < mWidth; column++)
+    {
+      double eastKm = (column - mObserverColumn) * mCellSizeXKm;
+      if (northKm*northKm + eastKm*eastKm > radiusSquared)
+      {
+        cells[column] = OUTSIDE;
+      }
+      else if (cells[column] != VISIBLE)
+      {
+        cells[column] = HIDDEN;
+      }
+    }
+  }
+
+  //the observer can always see where it stands
+  mCells[(size_t)mObserverRow * (size_t)mWidth + mObserverColumn] = VISIBLE;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Waits for the threads of the last analysis and releases them.
+ */
+void Viewshed::releaseThreads()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  for (int i = 0; i < mThreads.size(); i++)
+  {
+    mThreads[i]->wait();
+    delete mThreads[i];
+  }
+  mThreads.clear();
+}
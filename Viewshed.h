@@ -0,0 +1,155 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef VIEWSHED_H
+#define VIEWSHED_H
+
+#include <QObject>
+#include <QThread>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QColor>
+#include "globals.h"
+
+class ViewshedThread;
+class ElevationDataset;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Terrain visibility analysis on top of ElevationManager. getLineOfSight
+ * tells whether a target can be seen from an observer. A viewshed marks every
+ * cell of a grid around an observer as visible or hidden, up to a given radius.
+ *
+ * The viewshed uses the R2 algorithm: a ray is cast from the observer to every
+ * cell on the border of the grid, sampling the terrain once per cell crossed.
+ * Walking outwards, a cell is visible if the slope from the observer to the
+ * target height above it is at least the steepest terrain slope found closer
+ * to the observer along that ray. Earth curvature and atmospheric refraction
+ * are accounted for. Rays are spread over a pool of ViewshedThread objects and
+ * the terrain of every ray is sampled in a single batch, so the analysis
+ * scales with the number of cores.
+ *
+ * start loads (and pins) the elevation databases under the viewshed, then
+ * returns right away. Poll getProgress or connect to analysisFinished
+ * (emitted from a worker thread) to find out when it is done, and cancel to
+ * stop early. addToEarth shows the result as an overlay on the Earth.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class Viewshed : public QObject
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  Q_OBJECT
+
+  public:
+    enum CellState
+    {
+      OUTSIDE,
+      HIDDEN,
+      VISIBLE
+    };
+
+    Viewshed();
+    ~Viewshed();
+
+    bool start(const GeodeticPosition& observer, double observerHeight, double targetHeight,
+               double radius, int numberOfThreads = QThread::idealThreadCount());
+    void cancel();
+    void waitForFinished();
+
+    bool getIsRunning();
+    bool getWasCancelled();
+    int getProgress();
+    qint64 getLastRunTime();
+    const GeodeticPosition& getObserver() const;
+    double getRadius();
+    int getWidth();
+    int getHeight();
+    double getNorth();
+    double getSouth();
+    double getEast();
+    double getWest();
+    int getCellState(int row, int column);
+    QImage createImage(const QColor& visibleColor, const QColor& hiddenColor, int maximumSize = 2048);
+    void addToEarth(float visibleAltitude = 1000.0f);
+    void removeFromEarth();
+
+    void setCellSizeDegrees(double cellSize);
+    double getCellSizeDegrees();
+    void setRefractionCoefficient(double coefficient);
+    double getRefractionCoefficient();
+
+    static bool getLineOfSight(const GeodeticPosition& observer, double observerHeight,
+                               const GeodeticPosition& target, double targetHeight,
+                               double refractionCoefficient = 0.13);
+
+    //called by viewshed threads
+    double getObserverElevation();
+    int getNumberOfRays();
+    void traceRay(int rayIndex, double observerElevation, QVector<double>& latitudes,
+                  QVector<double>& longitudes, QVector<float>& elevations);
+    bool getIsCancelRequested();
+    void reportRaysTraced(int numberOfRays);
+    void reportThreadFinished();
+
+  signals:
+    void analysisFinished();
+
+  private:
+    void releaseThreads();
+    void classifyCells();
+
+    GeodeticPosition mObserver;
+    double mObserverHeight;
+    double mObserverElevation;//ground plus observer height, in Km
+    double mTargetHeight;
+    double mRadius;
+    double mCellSizeDegrees;
+    double mCellSizeXKm;
+    double mCellSizeYKm;
+    double mRefractionCoefficient;
+    int mWidth;
+    int mHeight;
+    int mObserverRow;
+    int mObserverColumn;
+    unsigned char* mCells;
+    unsigned int mOverlayTexture;
+
+    QList<ViewshedThread*> mThreads;
+    QList<ElevationDataset*> mPinnedDatasets;//datasets under the running analysis
+    QMutex mMutex;
+    int mNumberOfFinishedThreads;
+    int mRaysTraced;
+    bool mIsRunning;
+    bool mCancelRequested;
+    bool mWasCancelled;
+    QElapsedTimer mRunTimer;
+    qint64 mLastRunTime;
+};
+
+#endif//VIEWSHED_H
@@ -0,0 +1,86 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "ViewshedThread.h"
+#include "Viewshed.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Constructor. Initializes attributes.
+ *
+ * @param viewshed Viewshed the rays are traced for
+ * @param firstRay Index of the first ray traced by this thread
+ * @param rayStride Number of rays to skip after every ray
+ */
+ViewshedThread::ViewshedThread(Viewshed* viewshed, int firstRay, int rayStride)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mViewshed = viewshed;
+  mFirstRay = firstRay;
+  mRayStride = rayStride;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Destructor.
+ */
+ViewshedThread::~ViewshedThread()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * OVERRIDE FOR QThread. This method runs on a separate thread. Traces every
+ * ray assigned to this thread, Viewshed::start loaded the elevation databases
+ * already.
+ */
+void ViewshedThread::run()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double observerElevation = mViewshed->getObserverElevation();
+  int numberOfRays = mViewshed->getNumberOfRays();
+  int raysSinceLastReport = 0;
+
+  for (int ray = mFirstRay; ray < numberOfRays; ray += mRayStride)
+  {
+    if (mViewshed->getIsCancelRequested())
+    {
+      break;
+    }
+
+    mViewshed->traceRay(ray, observerElevation, mLatitudes, mLongitudes, mElevations);
+
+    //do not hammer the viewshed mutex on every ray
+    raysSinceLastReport++;
+    if (raysSinceLastReport == 32)
+    {
+      mViewshed->reportRaysTraced(raysSinceLastReport);
+      raysSinceLastReport = 0;
+    }
+  }
+
+  mViewshed->reportRaysTraced(raysSinceLastReport);
+  mViewshed->reportThreadFinished();
+}
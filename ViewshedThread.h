@@ -0,0 +1,65 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef VIEWSHED_THREAD_H
+#define VIEWSHED_THREAD_H
+
+#include <QThread>
+#include <QVector>
+
+class Viewshed;
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Worker thread used by Viewshed to trace its rays in parallel. Each thread
+ * traces every ray starting at the given index and skipping ahead by the given
+ * stride, so neighboring rays (which cost about the same) are spread over all
+ * threads. Threads only ever mark cells as visible, so overlapping rays need
+ * no locking on the cells. Progress is reported back to the Viewshed every
+ * few rays, and cancellation is checked before every ray.
+ *
+ * @version 1.1
+ * @author Hector Mendoza
+ */
+class ViewshedThread : public QThread
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  public:
+    ViewshedThread(Viewshed* viewshed, int firstRay, int rayStride);
+    ~ViewshedThread();
+
+    void run();//OVERRIDE
+
+  private:
+    Viewshed* mViewshed;
+    int mFirstRay;
+    int mRayStride;
+
+    //scratch buffers for the samples of a ray
+    QVector<double> mLatitudes;
+    QVector<double> mLongitudes;
+    QVector<float> mElevations;
+};
+
+#endif//VIEWSHED_THREAD_H
@@ -58,13 +58,14 @@ void VolumeRenderer::render()
   glPushMatrix();
 
   //set color
-  SimpleColor color = mWorldObject->getColor();
+  const WorldObject::FrameState& state = mWorldObject->getFrameState();
+  SimpleColor color = state.color;
   glColor4f(color.red, color.green, color.blue, 0.5f);
 
   //first rotate and translate coordinate system to object
   //coordinate system
-  SimpleVector position = mWorldObject->getPosition();
-  GeodeticPosition geoPosition = mWorldObject->getGeodeticPosition();
+  SimpleVector position = state.position;
+  GeodeticPosition geoPosition = mWorldObject->getFrameGeodeticPosition();
   glRotatef(geoPosition.longitude - 180.0f, 0.0f, 0.0f, 1.0f);
   glRotatef(-1.0f * (90.0f - geoPosition.latitude), 0.0f, 1.0f, 0.0f);
   float radius = sqrt(position.x*position.x + position.y*position.y + position.z*position.z);
@@ -73,13 +74,13 @@ void VolumeRenderer::render()
   //rotate around X, Y and Z axis, note rotations
   //are counterclockwise in OpenGL, that is why we
   //give the negative rotation values
-  SimpleVector rotation = mWorldObject->getRotation();
+  SimpleVector rotation = state.rotation;
   glRotatef(-rotation.x, 1.0f, 0.0f, 0.0f);
   glRotatef(-rotation.y, 0.0f, 1.0f, 0.0f);
   glRotatef(-rotation.z, 0.0f, 0.0f, 1.0f);
 
   //set scale
-  SimpleVector scale = mWorldObject->getScale();
+  SimpleVector scale = state.scale;
   glScalef(scale.x, scale.y, scale.z);
 
   //draw outlined geometry
@@ -123,6 +124,38 @@ void VolumeRenderer::render()
   glPopMatrix();
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * OVERRIDE FOR MeshRenderer. Returns a box around the volume in the frame
+ * state of the object. Volumes are unit shapes scaled and rotated around the
+ * object position, so the box is made big enough for any rotation.
+ *
+ * @param minimum Returns the minimum corner of the box
+ * @param maximum Returns the maximum corner of the box
+ * @return True if the renderer is attached to a world object
+ */
+bool VolumeRenderer::getBounds(SimpleVector& minimum, SimpleVector& maximum)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mWorldObject == NULL)
+  {
+    return false;
+  }
+
+  SimpleVector position = mWorldObject->getFrameState().position;
+  SimpleVector scale = mWorldObject->getFrameState().scale;
+  double radius = sqrt(scale.x*scale.x + scale.y*scale.y + scale.z*scale.z);
+
+  minimum.x = position.x - radius;
+  minimum.y = position.y - radius;
+  minimum.z = position.z - radius;
+  maximum.x = position.x + radius;
+  maximum.y = position.y + radius;
+  maximum.z = position.z + radius;
+
+  return true;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Returns the current volume type. Please refer to volyme types enum in header
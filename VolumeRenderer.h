@@ -47,6 +47,7 @@ class VolumeRenderer : public MeshRenderer
     ~VolumeRenderer();
 
     void render();//OVERRIDE
+    bool getBounds(SimpleVector& minimum, SimpleVector& maximum);//OVERRIDE
 
     int getType();
     void setType(int type);
@@ -24,6 +24,7 @@
 #include "Utilities.h"
 #include "IconModelManager.h"
 #include "ModelRenderer.h"
+#include "WorldObjectManager.h"
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
@@ -35,6 +36,7 @@ WorldObject::WorldObject()
   mPosition.x = 0.0;
   mPosition.y = 0.0;
   mPosition.z = 0.0;
+  mIsGeodeticDirty = true;
   mScale.x = 1.0;
   mScale.y = 1.0;
   mScale.z = 1.0;
@@ -51,12 +53,31 @@ WorldObject::WorldObject()
   mIsClickable = false;
   mIsExpirable = false;
   mHasExpired = false;
-  mExpirationTime = 5;
   mGroup = NO_GROUP;
   mSpeed = 0.0f;
   mScreenLocation.x = 0.0;
   mScreenLocation.y = 0.0;
   mScreenLocation.z = 0.0;
+  mQueueState.fetchAndStoreOrdered(NOT_QUEUED);
+  mNextQueued = NULL;
+  mHandle.fetchAndStoreOrdered(WorldObjectManager::INVALID_HANDLE);
+  mTrackTimestamp = Q_INT64_C(-0x7fffffffffffffff) - 1;//older than any update
+  mIsExpirationScheduled.fetchAndStoreOrdered(0);
+  setExpirationTime(5);
+
+  //all three buffers start with the initial state
+  mFrontState = 0;
+  mBackState = 1;
+  mMiddleState.fetchAndStoreOrdered(2);
+  for (int i = 0; i < 3; i++)
+  {
+    mStates[i].position = mPosition;
+    mStates[i].isGeodeticDirty = mIsGeodeticDirty;
+    mStates[i].scale = mScale;
+    mStates[i].rotation = mRotation;
+    mStates[i].color = mColor;
+    mStates[i].isVisible = mIsVisible;
+  }
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -79,13 +100,21 @@ WorldObject::~WorldObject()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Calls the icon renderer's (if one exists) render method.
+ *
+ * @param batch Sprite batch the icon gets added to, or NULL to draw it right away
  */
-void WorldObject::renderIcon()
+void WorldObject::renderIcon(SpriteBatch* batch)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  //objects outside WorldObjectManager do not get their state acquired for them
+  if (getHandle() == WorldObjectManager::INVALID_HANDLE)
+  {
+    acquireFrameState();
+  }
+
   if (mIconRenderer != NULL)
   {
-    mIconRenderer->render();
+    mIconRenderer->render(batch);
   }
 }
 
@@ -96,6 +125,12 @@ void WorldObject::renderIcon()
 void WorldObject::renderMesh()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  //objects outside WorldObjectManager do not get their state acquired for them
+  if (getHandle() == WorldObjectManager::INVALID_HANDLE)
+  {
+    acquireFrameState();
+  }
+
   if (mMeshRenderer != NULL)
   {
     mMeshRenderer->render();
@@ -113,8 +148,11 @@ void WorldObject::renderMesh()
 bool WorldObject::loadIcon(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  //call IconModelManager to make sure only one instance of the icon is loaded
-  bool returnValue = IconModelManager::getInstance()->loadIcon(filePath);
+  //call IconModelManager to make sure only one instance of the icon is loaded,
+  //the renderer takes its own reference so ours is given back below
+  IconModelManager* iconModelManager = IconModelManager::getInstance();
+  int handle = iconModelManager->loadIcon(filePath);
+  bool returnValue = (handle != IconModelManager::INVALID_HANDLE);
 
   if (returnValue)
   {
@@ -128,6 +166,7 @@ bool WorldObject::loadIcon(const QString& filePath)
     {
       mIconRenderer->setFilePath(filePath);
     }
+    iconModelManager->releaseIcon(handle);
   }
 
   return returnValue;
@@ -144,18 +183,23 @@ bool WorldObject::loadIcon(const QString& filePath)
 bool WorldObject::loadModel(const QString& filePath)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  //call IconModelManager to make sure only one instance of the model is loaded
-  bool returnValue = IconModelManager::getInstance()->loadModel(filePath);
+  //call IconModelManager to make sure only one instance of the model is loaded,
+  //the renderer takes its own reference so ours is given back below
+  IconModelManager* iconModelManager = IconModelManager::getInstance();
+  int handle = iconModelManager->loadModel(filePath);
+  bool returnValue = (handle != IconModelManager::INVALID_HANDLE);
 
   if (returnValue)
   {
     ModelRenderer* modelRenderer = NULL;
+    QMutexLocker locker(&mWriterMutex);
     if (mMeshRenderer == NULL)
     {
       modelRenderer = new ModelRenderer(filePath);
       mMeshRenderer = modelRenderer;
       //associate mesh renderer with this world object
       modelRenderer->setWorldObject(this);
+      publishState();
     }
     else
     {
@@ -163,6 +207,7 @@ bool WorldObject::loadModel(const QString& filePath)
       modelRenderer = (ModelRenderer*)mMeshRenderer;
       modelRenderer->setFilePath(filePath);
     }
+    iconModelManager->releaseModel(handle);
   }
 
   return returnValue;;
@@ -177,13 +222,73 @@ bool WorldObject::loadModel(const QString& filePath)
 void WorldObject::copy(WorldObject* source)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mIsVisible = source->getIsVisible();
   mPosition = source->getPosition();
+  mGeodeticPosition = source->mGeodeticPosition;
+  mIsGeodeticDirty = source->mIsGeodeticDirty;
   mScale = source->getScale();
   mRotation = source->getRotation();
   mColor = source->getColor();
   mLabel = source->getLabel();
   mGroup = source->getGroup();
+  publishState();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Swaps in the state published last, if there is a new one. Only the render
+ * thread may call this method, WorldObjectManager does it at the start of a
+ * frame for the objects that got updated.
+ *
+ * @return True if a new state was acquired
+ */
+bool WorldObject::acquireFrameState()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  //atomic read, QAtomicInt has no portable load method across Qt versions
+  if ((mMiddleState.fetchAndAddOrdered(0) & FRESH_STATE) == 0)
+  {
+    return false;
+  }
+
+  mFrontState = mMiddleState.fetchAndStoreOrdered(mFrontState) & ~FRESH_STATE;
+
+  return true;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the state renderers draw this object with in the current frame.
+ * Only the render thread may call this method.
+ *
+ * @return Frame state
+ */
+const WorldObject::FrameState& WorldObject::getFrameState() const
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mStates[mFrontState];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the geodetic position of the frame state. It is computed and cached
+ * here if WorldObjectManager did not already do it when acquiring the state.
+ * Only the render thread may call this method.
+ *
+ * @return Geodetic position
+ */
+GeodeticPosition WorldObject::getFrameGeodeticPosition()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  FrameState& state = mStates[mFrontState];
+  if (state.isGeodeticDirty)
+  {
+    state.geodeticPosition = Utilities::xyzToGeodetic(state.position);
+    state.isGeodeticDirty = false;
+  }
+
+  return state.geodeticPosition;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -200,14 +305,20 @@ const SimpleVector& WorldObject::getPosition() const
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Returns the world object's current geodetic position.
+ * Returns the world object's current geodetic position. It is only computed
+ * if the object was last placed with setPosition.
  *
  * @return This object's current geodetic position
  */
 GeodeticPosition WorldObject::getGeodeticPosition()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  return Utilities::xyzToGeodetic(mPosition);
+  if (mIsGeodeticDirty)
+  {
+    return Utilities::xyzToGeodetic(mPosition);
+  }
+
+  return mGeodeticPosition;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -361,14 +472,30 @@ bool WorldObject::getHasExpired()
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Returns this world object's expiration time.
+ * Returns the time left before this world object expires, rounded up to whole
+ * seconds. It goes negative once the object has expired.
  *
  * @return This object's expiration time in seconds
  */
 int WorldObject::getExpirationTime()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  return mExpirationTime;
+  int msecs = getExpirationMsecs();
+  return msecs > 0 ? (msecs + 999) / 1000 : msecs / 1000;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the time left before this world object expires. It goes negative
+ * once the object has expired.
+ *
+ * @return This object's expiration time in milliseconds
+ */
+int WorldObject::getExpirationMsecs()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  qint64 now = WorldObjectManager::getTime();
+  return (int)(getExpirationDeadline(now) - now);
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -425,6 +552,20 @@ const QStringList& WorldObject::getCustomInfo() const
   return mCustomInfo;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Get method for the handle WorldObjectManager gave this object when it got
+ * added.
+ *
+ * @return Handle of this object, WorldObjectManager::INVALID_HANDLE if it was
+ * never added
+ */
+int WorldObject::getHandle()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mHandle.fetchAndAddOrdered(0);//atomic read
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Sets the current position for this world object.
@@ -434,7 +575,10 @@ const QStringList& WorldObject::getCustomInfo() const
 void WorldObject::setPosition(const SimpleVector& position)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mPosition = position;
+  mIsGeodeticDirty = true;
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -447,7 +591,11 @@ void WorldObject::setPosition(const SimpleVector& position)
 void WorldObject::setGeodeticPosition(const GeodeticPosition& position)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mPosition = Utilities::geodeticToXYZ(position);
+  mGeodeticPosition = position;
+  mIsGeodeticDirty = false;
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -459,7 +607,9 @@ void WorldObject::setGeodeticPosition(const GeodeticPosition& position)
 void WorldObject::setScale(const SimpleVector& scale)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mScale = scale;
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -471,7 +621,9 @@ void WorldObject::setScale(const SimpleVector& scale)
 void WorldObject::setRotation(const SimpleVector& rotation)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mRotation = rotation;
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -483,7 +635,9 @@ void WorldObject::setRotation(const SimpleVector& rotation)
 void WorldObject::setIsVisible(bool isVisible)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mIsVisible = isVisible;
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -522,7 +676,9 @@ void WorldObject::setName(const QString& name)
 void WorldObject::setLabel(const QString& label)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mLabel = label;
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -534,7 +690,9 @@ void WorldObject::setLabel(const QString& label)
 void WorldObject::setColor(const SimpleColor& color)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mColor = color;
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -561,8 +719,10 @@ void WorldObject::setIconRenderer(IconRenderer* renderer)
 void WorldObject::setMeshRenderer(MeshRenderer* renderer)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mMeshRenderer = renderer;
   mMeshRenderer->setWorldObject(this);
+  publishState();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -589,6 +749,7 @@ void WorldObject::setIsExpirable(bool isExpirable)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
   mIsExpirable = isExpirable;
+  scheduleExpiration();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -607,17 +768,33 @@ void WorldObject::setHasExpired(bool hasExpired)
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Sets the expiration time for this world object. This method can be called
- * to reset the expiration time for an object (e.g. when a position update has
- * been received) to prevent it from expiring and getting removed from the
- * display list.
+ * Sets the expiration time for this world object, counted from now. This
+ * method can be called to reset the expiration time for an object (e.g. when a
+ * position update has been received) to prevent it from expiring and getting
+ * removed from the display list.
  *
  * @param time Expiration time in seconds
  */
 void WorldObject::setExpirationTime(int time)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  mExpirationTime = time;
+  setExpirationMsecs(time * 1000);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the expiration time for this world object, counted from now, with
+ * millisecond resolution. Resetting the time of an object WorldObjectManager
+ * already has scheduled only stores the new deadline, the manager picks it up
+ * when the old one comes due.
+ *
+ * @param msecs Expiration time in milliseconds
+ */
+void WorldObject::setExpirationMsecs(int msecs)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mExpirationDeadline.fetchAndStoreOrdered((int)(WorldObjectManager::getTime() + msecs));
+  scheduleExpiration();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -642,6 +819,7 @@ void WorldObject::setGroup(int group)
 void WorldObject::setSpeed(float speed)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  QMutexLocker locker(&mWriterMutex);
   mSpeed = speed;
 }
 
@@ -673,3 +851,64 @@ void WorldObject::setCustomInfo(const QStringList& stringList)
 {
   mCustomInfo = stringList;
 }
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Publishes the pending attributes renderers need. They are copied into the
+ * back buffer, which then gets swapped with the middle one and flagged as
+ * fresh, and the object is queued for the next frame if it is managed by
+ * WorldObjectManager. Nothing here waits on the render thread. The caller must
+ * hold mWriterMutex, since the back buffer belongs to whoever writes.
+ */
+void WorldObject::publishState()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  FrameState& state = mStates[mBackState];
+  state.position = mPosition;
+  state.geodeticPosition = mGeodeticPosition;
+  state.isGeodeticDirty = mIsGeodeticDirty;
+  state.scale = mScale;
+  state.rotation = mRotation;
+  state.color = mColor;
+  state.label = mLabel;
+  state.isVisible = mIsVisible;
+
+  mBackState = mMiddleState.fetchAndStoreOrdered(mBackState | FRESH_STATE) & ~FRESH_STATE;
+
+  if (getHandle() != WorldObjectManager::INVALID_HANDLE)
+  {
+    WorldObjectManager::getInstance()->queueObject(this);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Hands this object over to WorldObjectManager's expiration schedule if it is
+ * managed, expirable and not scheduled yet. Objects added later get scheduled
+ * by addWorldObject.
+ */
+void WorldObject::scheduleExpiration()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mIsExpirable && getHandle() != WorldObjectManager::INVALID_HANDLE &&
+      mIsExpirationScheduled.testAndSetOrdered(0, 1))
+  {
+    WorldObjectManager::getInstance()->scheduleExpiration(this);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the expiration deadline on WorldObjectManager's clock. The deadline
+ * is stored in an int that wraps around every 24 days, so it is unwrapped
+ * against the current time, which works for expiration times under 24 days.
+ *
+ * @param now Current time in milliseconds, as returned by getTime
+ * @return Expiration deadline in milliseconds
+ */
+qint64 WorldObject::getExpirationDeadline(qint64 now)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  unsigned int deadline = (unsigned int)mExpirationDeadline.fetchAndAddOrdered(0);
+  return now + (int)(deadline - (unsigned int)now);
+}
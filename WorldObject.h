@@ -24,6 +24,8 @@
 #define WORLD_OBJECT_H
 
 #include <QStringList>
+#include <QAtomicInt>
+#include <QMutex>
 #include "globals.h"
 #include "IconRenderer.h"
 #include "MeshRenderer.h"
@@ -34,6 +36,21 @@
  * object in the system. A world object has attributes like position,
  * orientation and scale but it also has renderers associated to it.
  *
+ * Set methods can be called from feed threads while the object is being
+ * rendered. They write the object's pending state and publish a copy of the
+ * attributes renderers need (see FrameState) through a lock-free triple
+ * buffer. The render thread picks the latest copy up at the start of a frame
+ * and renderers only read that frame state, so feeds never wait for a frame
+ * and frames never see half-written updates. Writers (set methods and the
+ * track updates WorldObjectManager applies) are serialized by a per-object
+ * lock that the render thread never takes. Get methods return the pending
+ * state and are only meaningful to the thread updating the object.
+ *
+ * The geodetic position is cached next to the XYZ one. Setting either keeps
+ * the other one valid or flags it dirty, so the geodetic position only gets
+ * recomputed once per XYZ update, in a batch by WorldObjectManager for the
+ * frame states it acquires.
+ *
  * @version 1.1
  * @author Hector Mendoza
  */
@@ -50,16 +67,33 @@ class WorldObject
       TRACK
     };
 
+    struct FrameState
+    {
+      SimpleVector position;
+      GeodeticPosition geodeticPosition;//only valid if not isGeodeticDirty
+      bool isGeodeticDirty;
+      SimpleVector scale;
+      SimpleVector rotation;
+      SimpleColor color;
+      QString label;
+      bool isVisible;
+    };
+
     WorldObject();
     ~WorldObject();
 
     //main methods
-    void renderIcon();
+    void renderIcon(SpriteBatch* batch = NULL);
     void renderMesh();
     bool loadIcon(const QString& filePath);
     bool loadModel(const QString& filePath);
     void copy(WorldObject* source);
 
+    //frame state methods, for the render thread only
+    bool acquireFrameState();
+    const FrameState& getFrameState() const;
+    GeodeticPosition getFrameGeodeticPosition();
+
     //get methods
     const SimpleVector& getPosition() const;
     GeodeticPosition getGeodeticPosition();
@@ -76,10 +110,12 @@ class WorldObject
     bool getIsExpirable();
     bool getHasExpired();
     int getExpirationTime();
+    int getExpirationMsecs();
     int getGroup();
     float getSpeed();
     const SimpleVector& getScreenLocation() const;
     const QStringList& getCustomInfo() const;
+    int getHandle();
 
     //set methods
     void setPosition(const SimpleVector& position);
@@ -97,6 +133,7 @@ class WorldObject
     void setIsExpirable(bool isExpirable);
     void setHasExpired(bool hasExpired);
     void setExpirationTime(int time);
+    void setExpirationMsecs(int msecs);
     void setGroup(int group);
     void setSpeed(float speed);
     void setScreenLocation(const SimpleVector& screenLocation);
@@ -104,6 +141,8 @@ class WorldObject
 
   protected:
     SimpleVector mPosition;
+    GeodeticPosition mGeodeticPosition;//only valid if not mIsGeodeticDirty
+    bool mIsGeodeticDirty;
     SimpleVector mScale;
     SimpleVector mRotation;
     bool mIsVisible;
@@ -116,13 +155,41 @@ class WorldObject
     bool mIsClickable;
     bool mIsExpirable;
     bool mHasExpired;
-    int mExpirationTime;
     int mGroup;
     float mSpeed;
     SimpleVector mScreenLocation;
     QStringList mCustomInfo;
 
   private:
+    friend class WorldObjectManager;//queues objects and hands out handles
+
+    static const int FRESH_STATE = 4;//flags a state nobody acquired yet
+
+    //values of mQueueState, retired objects never get queued again
+    enum QueueStates
+    {
+      NOT_QUEUED,
+      QUEUED,
+      RETIRED_QUEUED,//removed while still on the queue
+      RETIRED//removed and off the queue, safe to delete
+    };
+
+    void publishState();
+    void scheduleExpiration();
+    qint64 getExpirationDeadline(qint64 now);
+
+    FrameState mStates[3];//triple buffer
+    int mFrontState;//render thread only
+    int mBackState;//writer only, under mWriterMutex
+    QAtomicInt mMiddleState;//swapped by both, plus the FRESH_STATE flag
+    QMutex mWriterMutex;//held while pending state is written and published
+    QAtomicInt mQueueState;//one of QueueStates
+    WorldObject* mNextQueued;
+    QAtomicInt mHandle;//set by addWorldObject, read by feed threads
+    qint64 mTrackTimestamp;//of the last track update applied, under mWriterMutex
+    QAtomicInt mExpirationDeadline;//in ms on WorldObjectManager::getTime(), wraps around
+    QAtomicInt mIsExpirationScheduled;
+
     WorldObject(const WorldObject&);//disallow default copying
     WorldObject& operator=(const WorldObject&);//disallow default copying
 
@@ -20,11 +20,18 @@
  *  <http://www.gnu.org/licenses/>.
  */
 
+#include <QtOpenGL>
+#include <QElapsedTimer>
+#include <math.h>
 #include "WorldObject.h"
 #include "WorldObjectManager.h"
 #include "PathTool.h"
 #include "MeasuringTool.h"
 #include "Utilities.h"
+#include "CameraProjection.h"
+#include "IconModelManager.h"
+#include "IconRenderer.h"
+#include "Camera.h"
 
 //Singleton implementation
 WorldObjectManager* WorldObjectManager::mInstance = NULL;
@@ -36,10 +43,26 @@ WorldObjectManager* WorldObjectManager::mInstance = NULL;
 WorldObjectManager::WorldObjectManager()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  //set timer to check for expired tracks
+  mNextHandle = INVALID_HANDLE + 1;
+  mQueuedObjects.fetchAndStoreOrdered(NULL);
+  mFrameEpoch = 0;
+  mPendingTrackBatch = 0;
+  mClusterObjects = true;
+  mClusterIcon = IconModelManager::INVALID_HANDLE;
+
+  //cluster counts are signed distance field glyphs, see GlyphAtlas
+  mClusterCountBatch.setAlphaThreshold(0.5f);
+
+  //set timer to check for expired tracks, it gets set for the next deadline
+  mNextExpiration = NO_EXPIRATION;
   mExpireTimer = new QTimer(0);
+  mExpireTimer->setSingleShot(true);
   connect(mExpireTimer, SIGNAL(timeout()), this, SLOT(onExpireTimer()));
-  mExpireTimer->start(1000);
+
+  //set timer to free retired objects while no frames get rendered
+  mRetireTimer = new QTimer(0);
+  connect(mRetireTimer, SIGNAL(timeout()), this, SLOT(onRetireTimer()));
+  mRetireTimer->start(RETIRED_OBJECT_DELAY);
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -55,7 +78,27 @@ WorldObjectManager::~WorldObjectManager()
     delete mWorldObjectList[i];
   }
   mWorldObjectList.clear();
+  for (int i = 0; i < mRetiredObjects.size(); i++)
+  {
+    delete mRetiredObjects[i].object;
+  }
+  mRetiredObjects.clear();
+  mVisibleObjects.clear();
+  mQueuedObjects.fetchAndStoreOrdered(NULL);
+  mHandles.clear();
+  mNameIndex.clear();
+  mHandleIndex.clear();
+  mExpirations.clear();
+  mSpatialIndex.clear();
+  mVisibleHandles.clear();
+  mVisibleClusters.clear();
   delete mExpireTimer;
+  delete mRetireTimer;
+
+  if (mClusterIcon != IconModelManager::INVALID_HANDLE)
+  {
+    IconModelManager::getInstance()->releaseIcon(mClusterIcon);
+  }
 
   mInstance = NULL;
 }
@@ -81,31 +124,49 @@ WorldObjectManager* WorldObjectManager::getInstance()
 /**
  * Adds a world object to the list. WorldObjectManager keeps track of objects by
  * unique name, therefore this method checks if the given world object's name is
- * already on the list before adding it.
+ * already on the list before adding it. The object shows up from the next
+ * frame on. This method is thread-safe.
  *
  * @param object Handle to world object
- * @return True if world object got added to the list, false if object was
- * already in the list
+ * @return Handle of the added world object, INVALID_HANDLE (which tests false)
+ * if an object with that name was already in the list
  */
-bool WorldObjectManager::addWorldObject(WorldObject* object)
+int WorldObjectManager::addWorldObject(WorldObject* object)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  bool returnValue = false;
+  int handle = INVALID_HANDLE;
+
+  mMutex.lock();
 
   //only add world object if it is not already in the list
-  if (findWorldObject(object->getName()) == -1)
+  if (!mNameIndex.contains(object->getName()))
   {
+    handle = mNextHandle++;
+    mNameIndex.insert(object->getName(), mWorldObjectList.size());
+    mHandleIndex.insert(handle, mWorldObjectList.size());
     mWorldObjectList.append(object);
-    returnValue = true;
+    mHandles.append(handle);
+
+    //the object gets into the spatial index with its first frame state
+    object->mHandle.fetchAndStoreOrdered(handle);
+    queueObject(object);
+
+    if (object->getIsExpirable() && object->mIsExpirationScheduled.testAndSetOrdered(0, 1) &&
+        insertExpiration(object, object->getExpirationDeadline(getTime())))
+    {
+      QMetaObject::invokeMethod(this, "onExpireTimer", Qt::QueuedConnection);
+    }
   }
 
-  return returnValue;
+  mMutex.unlock();
+
+  return handle;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Returns the world object at the given index. Returns NULL if given index is
- * outside the list boundaries.
+ * outside the list boundaries. This method is thread-safe.
  *
  * @param index Index of world object we want to get
  * @return Handle to world object
@@ -113,13 +174,24 @@ bool WorldObjectManager::addWorldObject(WorldObject* object)
 WorldObject* WorldObjectManager::getWorldObject(int index)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  return mWorldObjectList[index];
+  WorldObject* returnWorldObject = NULL;
+
+  mMutex.lock();
+
+  if (index >= 0 && index < mWorldObjectList.size())
+  {
+    returnWorldObject = mWorldObjectList[index];
+  }
+
+  mMutex.unlock();
+
+  return returnWorldObject;
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Returns the world object on the list that matches the given name if there is
- * one, NULL otherwise.
+ * one, NULL otherwise. This method is thread-safe.
  *
  * @param name Name of world object
  * @return Handle to world object
@@ -129,15 +201,63 @@ WorldObject* WorldObjectManager::getWorldObject(const QString& name)
 {
   WorldObject* returnWorldObject = NULL;
 
-  int index = findWorldObject(name);
+  mMutex.lock();
+
+  int index = mNameIndex.value(name, -1);
+  if (index != -1)
+  {
+    returnWorldObject = mWorldObjectList[index];
+  }
+
+  mMutex.unlock();
+
+  return returnWorldObject;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the world object with the given handle if it is still on the list,
+ * NULL otherwise. This method is thread-safe.
+ *
+ * @param handle Handle returned by addWorldObject
+ * @return Handle to world object
+ */
+WorldObject* WorldObjectManager::getWorldObjectFromHandle(int handle)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  WorldObject* returnWorldObject = NULL;
+
+  mMutex.lock();
+
+  int index = mHandleIndex.value(handle, -1);
   if (index != -1)
   {
     returnWorldObject = mWorldObjectList[index];
   }
 
+  mMutex.unlock();
+
   return returnWorldObject;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the handle of the world object at the given index.
+ *
+ * @param index Index of world object
+ * @return Handle of world object, INVALID_HANDLE if index is outside the list
+ */
+int WorldObjectManager::getHandle(int index)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (index < 0 || index >= mHandles.size())
+  {
+    return INVALID_HANDLE;
+  }
+
+  return mHandles[index];
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Removes the world object at the given index. This method is thread-safe.
@@ -149,10 +269,9 @@ void WorldObjectManager::removeWorldObject(int index)
 {
   mMutex.lock();
 
-  if (index < mWorldObjectList.size())
+  if (index >= 0 && index < mWorldObjectList.size())
   {
-    WorldObject* object = mWorldObjectList.takeAt(index);//remove from list
-    delete object;
+    removeAt(index);
   }
 
   mMutex.unlock();
@@ -170,11 +289,31 @@ void WorldObjectManager::removeWorldObject(const QString& name)
 {
   mMutex.lock();
 
-  int index = findWorldObject(name);
+  int index = mNameIndex.value(name, -1);
+  if (index != -1)
+  {
+    removeAt(index);
+  }
+
+  mMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Removes the world object with the given handle from the list, if it is
+ * still there. This method is thread-safe.
+ *
+ * @param handle Handle returned by addWorldObject
+ */
+void WorldObjectManager::removeWorldObjectFromHandle(int handle)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mMutex.lock();
+
+  int index = mHandleIndex.value(handle, -1);
   if (index != -1)
   {
-    WorldObject* object = mWorldObjectList.takeAt(index);//remove from list
-    delete object;
+    removeAt(index);
   }
 
   mMutex.unlock();
@@ -182,40 +321,96 @@ void WorldObjectManager::removeWorldObject(const QString& name)
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Calls the render method on all entities on the list if they have the
- * isVisible flag set to true. This method is thread-safe.
+ * WARNING: This method is supposed to get called from within OpenGL rendering
+ * context. Starts a new frame: pending track updates are applied, the objects
+ * updated since the last frame get their new state acquired, and the objects
+ * inside the view frustum of CameraProjection become the frame snapshot (the
+ * visible objects). The manager is only locked for that
+ * much, the render methods of the snapshot objects are called afterwards, so
+ * feeds can keep adding, updating and removing objects while a frame renders.
+ * This method is thread-safe.
  */
 void WorldObjectManager::renderObjects()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
+  //find the objects in view, push the frustum sides out a bit
+  //so icons and labels do not pop at the edges of the screen
+  CameraProjection* cameraProjection = CameraProjection::getInstance();
+  const int* viewport = cameraProjection->getViewport();
+
+  double marginX = 2.0 * VISIBILITY_MARGIN / qMax(viewport[2], 1);
+  double marginY = 2.0 * VISIBILITY_MARGIN / qMax(viewport[3], 1);
+  double planes[SpatialIndex::NUMBER_OF_PLANES * 4];
+  SpatialIndex::getFrustumPlanes(cameraProjection->getModelView(), cameraProjection->getProjection(),
+                                 marginX, marginY, planes);
+
+  applyTrackUpdates();
+
   mMutex.lock();
 
-  int i = 0;
-  SimpleVector screenLocation;
+  mFrameEpoch++;
+  acquireQueuedObjects();
 
-  //compute screen location and render all meshes first
-  for (i = 0; i < mWorldObjectList.size(); i++)
+  if (mClusterObjects)
   {
-    if (mWorldObjectList[i]->getIsVisible())
-    {
-      //compute and set screen location
-      screenLocation = Utilities::worldToScreen(mWorldObjectList[i]->getPosition());
-      mWorldObjectList[i]->setScreenLocation(screenLocation);
+    //clusters may span CLUSTER_SIZE pixels, turned into an angle at the center of the view
+    double pixelsPerRadian = cameraProjection->getProjection()[5] * viewport[3] * 0.5;
+    double clusterAngle = CLUSTER_SIZE / qMax(pixelsPerRadian, 1.0);
+    mSpatialIndex.findVisible(planes, Camera::getInstance()->getPosition(), clusterAngle,
+                              mVisibleHandles, mVisibleClusters, mExpansions);
+  }
+  else
+  {
+    mSpatialIndex.findVisible(planes, mVisibleHandles);
+    mVisibleClusters.clear();
+    mExpansions.clear();
+  }
 
-      mWorldObjectList[i]->renderMesh();
+  //keep the handles in step with the objects
+  int numberOfVisibleObjects = 0;
+  mVisibleObjects.clear();
+  for (int i = 0; i < mVisibleHandles.size(); i++)
+  {
+    int index = mHandleIndex.value(mVisibleHandles[i], -1);
+    if (index != -1)
+    {
+      mVisibleObjects.append(mWorldObjectList[index]);
+      mVisibleHandles[numberOfVisibleObjects++] = mVisibleHandles[i];
     }
   }
+  mVisibleHandles.resize(numberOfVisibleObjects);
+
+  //no snapshot refers to objects removed before the last one anymore
+  deleteRetiredObjects(false);
+
+  mMutex.unlock();
+
+  int i = 0;
 
-  //render icons last
-  for (i = 0; i < mWorldObjectList.size(); i++)
+  //compute screen locations, then render all meshes first
+  startExpansions();
+  updateScreenLocations();
+  applyExpansions();
+  for (i = 0; i < mVisibleObjects.size(); i++)
   {
-    if (mWorldObjectList[i]->getIsVisible())
+    if (mVisibleObjects[i]->getFrameState().isVisible)
     {
-      mWorldObjectList[i]->renderIcon();
+      mVisibleObjects[i]->renderMesh();
     }
   }
 
-  mMutex.unlock();
+  //render icons last, all of them in one batch, clusters included
+  mIconBatch.clear();
+  for (i = 0; i < mVisibleObjects.size(); i++)
+  {
+    if (mVisibleObjects[i]->getFrameState().isVisible)
+    {
+      mVisibleObjects[i]->renderIcon(&mIconBatch);
+    }
+  }
+  addClusters();
+  mIconBatch.render(IconModelManager::getInstance()->getAtlasTexture());
+  mClusterCountBatch.render(GlyphAtlas::getInstance()->getTexture());
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -230,10 +425,161 @@ int WorldObjectManager::getNumberOfObjects()
   return mWorldObjectList.size();
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of objects in the snapshot of the last frame, i.e. the
+ * ones that were inside the view frustum. Only the render thread may call
+ * this method.
+ *
+ * @return Number of visible objects
+ */
+int WorldObjectManager::getNumberOfVisibleObjects()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mVisibleObjects.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the given object of the snapshot of the last frame, see
+ * getNumberOfVisibleObjects. Objects removed since then are still valid, they
+ * only get deleted once no snapshot refers to them. Only the render thread may
+ * call this method.
+ *
+ * @param index Index of visible object
+ * @return Handle to world object
+ */
+WorldObject* WorldObjectManager::getVisibleObject(int index)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mVisibleObjects[index];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of clusters drawn in the last frame. Only the render
+ * thread may call this method.
+ *
+ * @return Number of visible clusters
+ */
+int WorldObjectManager::getNumberOfVisibleClusters()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mVisibleClusters.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the given cluster of the last frame, see getNumberOfVisibleClusters.
+ * Only the render thread may call this method.
+ *
+ * @param index Index of visible cluster
+ * @return Cluster with its number of objects and average position
+ */
+const SpatialIndex::Cluster& WorldObjectManager::getVisibleCluster(int index)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mVisibleClusters[index];
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Intersects the given ray with the meshes of the visible objects of the last
+ * frame, so picks land on volumes and shapes drawn over the terrain. Meshes
+ * are tested by their bounding boxes (see MeshRenderer::getBounds), paths are
+ * skipped since their boxes are mostly empty. Only the render thread may call
+ * this method.
+ *
+ * @param origin Ray origin (XYZ)
+ * @param direction Unit direction of the ray
+ * @param distance Distance along the ray of the closest hit so far, lowered if
+ *  an object is hit before it
+ * @return True if an object is hit closer than distance
+ */
+bool WorldObjectManager::intersectRay(const SimpleVector& origin, const SimpleVector& direction,
+                                      double& distance)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  bool isHit = false;
+  SimpleVector minimum, maximum;
+
+  for (int i = 0; i < mVisibleObjects.size(); i++)
+  {
+    WorldObject* object = mVisibleObjects[i];
+    MeshRenderer* meshRenderer = object->getMeshRenderer();
+    if (meshRenderer == NULL || object->getGroup() == WorldObject::PATH ||
+        !object->getFrameState().isVisible || !meshRenderer->getBounds(minimum, maximum))
+    {
+      continue;
+    }
+
+    //slab test, one axis at a time
+    const double rayOrigin[3] = {origin.x, origin.y, origin.z};
+    const double rayDirection[3] = {direction.x, direction.y, direction.z};
+    const double boxMinimum[3] = {minimum.x, minimum.y, minimum.z};
+    const double boxMaximum[3] = {maximum.x, maximum.y, maximum.z};
+    double start = 0.0;
+    double end = distance;
+    for (int axis = 0; axis < 3 && start <= end; axis++)
+    {
+      if (rayDirection[axis] == 0.0)
+      {
+        if (rayOrigin[axis] < boxMinimum[axis] || rayOrigin[axis] > boxMaximum[axis])
+        {
+          end = -1.0;
+        }
+        continue;
+      }
+
+      double nearSide = (boxMinimum[axis] - rayOrigin[axis]) / rayDirection[axis];
+      double farSide = (boxMaximum[axis] - rayOrigin[axis]) / rayDirection[axis];
+      if (nearSide > farSide)
+      {
+        qSwap(nearSide, farSide);
+      }
+      start = qMax(start, nearSide);
+      end = qMin(end, farSide);
+    }
+
+    if (start <= end && start < distance)
+    {
+      distance = start;
+      isHit = true;
+    }
+  }
+
+  return isHit;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns true if objects crowding together on screen get clustered.
+ *
+ * @return True if objects are clustered, false otherwise
+ */
+bool WorldObjectManager::getClusterObjects()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  return mClusterObjects;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Sets the value of flag to cluster objects crowding together on screen. If
+ * turned off, every object in view is drawn on its own.
+ *
+ * @param cluster Set to true if you want objects to be clustered
+ */
+void WorldObjectManager::setClusterObjects(bool cluster)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mClusterObjects = cluster;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
  * Returns the index of the world object with the given name if it is found.
- * Returns -1 otherwise.
+ * Returns -1 otherwise. This method is thread-safe.
  *
  * @param name Name of world object
  * @return Index of found world object, -1 otherwise
@@ -241,52 +587,755 @@ int WorldObjectManager::getNumberOfObjects()
 int WorldObjectManager::findWorldObject(const QString& name)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  int index = -1;
+  QMutexLocker locker(&mMutex);
+  return mNameIndex.value(name, -1);
+}
 
-  for (int i = 0; i < mWorldObjectList.size(); i++)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the index of the world object with the given handle if it is found.
+ * Returns -1 otherwise. This method is thread-safe.
+ *
+ * @param handle Handle returned by addWorldObject
+ * @return Index of found world object, -1 otherwise
+ */
+int WorldObjectManager::findWorldObjectFromHandle(int handle)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+  return mHandleIndex.value(handle, -1);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Queues the given track updates for the next frame. Updates are coalesced, an
+ * object updated several times before the frame only keeps the update with the
+ * newest timestamp. Nothing is converted here, this only copies the values, so
+ * feed threads can push large batches at a high rate. This method is
+ * thread-safe.
+ *
+ * @param updates Array of track updates
+ * @param count Number of track updates
+ */
+void WorldObjectManager::updateTracks(const TrackUpdate* updates, int count)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mTrackMutex.lock();
+
+  TrackBatch& batch = mTrackBatches[mPendingTrackBatch];
+
+  for (int i = 0; i < count; i++)
   {
-    if (name == mWorldObjectList[i]->getName())
+    const TrackUpdate& update = updates[i];
+
+    int slot = batch.handleSlots.value(update.handle, -1);
+    if (slot == -1)
     {
-      index = i;
-      break;
+      slot = batch.handles.size();
+      batch.handleSlots.insert(update.handle, slot);
+      batch.handles.append(update.handle);
+      batch.latitudes.append(update.latitude);
+      batch.longitudes.append(update.longitude);
+      batch.altitudes.append(update.altitude);
+      batch.headings.append(update.heading);
+      batch.speeds.append(update.speed);
+      batch.timestamps.append(update.timestamp);
+    }
+    else if (update.timestamp >= batch.timestamps[slot])
+    {
+      batch.latitudes[slot] = update.latitude;
+      batch.longitudes[slot] = update.longitude;
+      batch.altitudes[slot] = update.altitude;
+      batch.headings[slot] = update.heading;
+      batch.speeds[slot] = update.speed;
+      batch.timestamps[slot] = update.timestamp;
     }
   }
 
-  return index;
+  mTrackMutex.unlock();
 }
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
- * Qt SLOT. Gets called every second to loop through the expirable tracks and
- * decrements their expiration timer. If a timer reaches 0, it sets the
- * hasExpired flag for the object (serves as a warning that this object should
- * no longer be used). It deletes any entities that have reached a timer of -2.
+ * Applies the track updates queued since the last call. The pending batch is
+ * swapped for an empty one so feeds can carry on right away, its positions are
+ * converted to XYZ in one batch and the objects get their position, heading
+ * (rotation around the local vertical, i.e. the z rotation) and speed set and
+ * published, each under the object's writer lock so set methods called from
+ * feed threads meanwhile do not interleave with it. Updates for objects that
+ * got removed, or older than the last update applied to their object, are
+ * dropped. renderObjects
+ * calls this method at the start of every frame, so it only needs to be called
+ * directly when nothing is rendering (e.g. benchmarks).
+ */
+void WorldObjectManager::applyTrackUpdates()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mTrackMutex.lock();
+  TrackBatch& batch = mTrackBatches[mPendingTrackBatch];
+  mPendingTrackBatch = 1 - mPendingTrackBatch;
+  mTrackMutex.unlock();
+
+  int count = batch.handles.size();
+  if (count == 0)
+  {
+    return;
+  }
+
+  batch.x.resize(count);
+  batch.y.resize(count);
+  batch.z.resize(count);
+  Utilities::geodeticToXYZ(batch.latitudes.constData(), batch.longitudes.constData(),
+                           batch.altitudes.constData(), batch.x.data(), batch.y.data(),
+                           batch.z.data(), count);
+
+  mMutex.lock();
+
+  for (int i = 0; i < count; i++)
+  {
+    int index = mHandleIndex.value(batch.handles[i], -1);
+    if (index == -1)
+    {
+      continue;
+    }
+
+    WorldObject* object = mWorldObjectList[index];
+    QMutexLocker writerLocker(&object->mWriterMutex);
+
+    //batches only order the updates they hold, drop late ones
+    if (batch.timestamps[i] < object->mTrackTimestamp)
+    {
+      continue;
+    }
+    object->mTrackTimestamp = batch.timestamps[i];
+
+    object->mPosition.x = batch.x[i];
+    object->mPosition.y = batch.y[i];
+    object->mPosition.z = batch.z[i];
+    object->mGeodeticPosition.latitude = batch.latitudes[i];
+    object->mGeodeticPosition.longitude = batch.longitudes[i];
+    object->mGeodeticPosition.altitude = batch.altitudes[i];
+    object->mIsGeodeticDirty = false;
+    object->mRotation.z = batch.headings[i];
+    object->mSpeed = batch.speeds[i];
+    object->publishState();
+  }
+
+  mMutex.unlock();
+
+  //empty the batch for its next turn, keeping the memory around
+  batch.handleSlots.clear();
+  batch.handles.resize(0);
+  batch.latitudes.resize(0);
+  batch.longitudes.resize(0);
+  batch.altitudes.resize(0);
+  batch.headings.resize(0);
+  batch.speeds.resize(0);
+  batch.timestamps.resize(0);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the number of objects with a track update waiting for the next
+ * frame. This method is thread-safe.
+ *
+ * @return Number of pending track updates
+ */
+int WorldObjectManager::getNumberOfPendingTrackUpdates()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mTrackMutex);
+  return mTrackBatches[mPendingTrackBatch].handles.size();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Slot that gets called when the earliest expiration deadline comes due. It
+ * goes through the objects that are due: objects whose expiration time got
+ * reset are put back with their new deadline, objects past their deadline are
+ * flagged as expired and removed EXPIRATION_GRACE_TIME later. Then the timer is
+ * set for the next deadline.
  */
 void WorldObjectManager::onExpireTimer()
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 {
-  int expirationTime = 0;
+  QVector<int> expiredHandles;
 
-  for (int i = 0; i < mWorldObjectList.size(); i++)
+  mMutex.lock();
+
+  qint64 now = getTime();
+  while (!mExpirations.isEmpty() && mExpirations.begin().key() <= now)
   {
-    if (mWorldObjectList[i] != NULL && mWorldObjectList[i]->getIsExpirable())
+    int handle = mExpirations.begin().value();
+    mExpirations.erase(mExpirations.begin());
+
+    //skip objects removed since they got scheduled
+    int index = mHandleIndex.value(handle, -1);
+    if (index == -1)
+    {
+      continue;
+    }
+
+    //drop objects that are no longer expirable, they get scheduled again
+    //if they become expirable
+    WorldObject* object = mWorldObjectList[index];
+    object->mIsExpirationScheduled.fetchAndStoreOrdered(0);
+    if (!object->getIsExpirable() || !object->mIsExpirationScheduled.testAndSetOrdered(0, 1))
     {
-      expirationTime = mWorldObjectList[i]->getExpirationTime();
-      expirationTime--;
-      mWorldObjectList[i]->setExpirationTime(expirationTime);
+      continue;
+    }
 
+    qint64 deadline = object->getExpirationDeadline(now);
+    if (now < deadline)
+    {
+      insertExpiration(object, deadline);
+    }
+    else if (now < deadline + EXPIRATION_GRACE_TIME)
+    {
       //when time expires set has expired flag to true to let object users
       //have a warning they should no longer use this object
-      if (expirationTime == 0)
-      {
-          mWorldObjectList[i]->setHasExpired(true);
-      }
-      else if (expirationTime <= -2)
-      {
-        removeWorldObject(i);
-        //rewind counter since we just deleted one object from the list
-        i--;
-      }
+      object->setHasExpired(true);
+      insertExpiration(object, deadline + EXPIRATION_GRACE_TIME);
+    }
+    else
+    {
+      expiredHandles.append(handle);
+    }
+  }
+
+  for (int i = 0; i < expiredHandles.size(); i++)
+  {
+    removeAt(mHandleIndex.value(expiredHandles[i]));
+  }
+
+  //set timer for the next deadline
+  if (mExpirations.isEmpty())
+  {
+    mNextExpiration = NO_EXPIRATION;
+    mExpireTimer->stop();
+  }
+  else
+  {
+    mNextExpiration = mExpirations.begin().key();
+    mExpireTimer->start((int)qMax(mNextExpiration - now, (qint64)0));
+  }
+
+  mMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Slot that gets called every RETIRED_OBJECT_DELAY to free retired objects
+ * while no frames get rendered. It runs on the GUI thread, the same one that
+ * renders, so it can drain the queue to take retired objects off it and drop
+ * them from the snapshot of the last frame before deleting them.
+ */
+void WorldObjectManager::onRetireTimer()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QMutexLocker locker(&mMutex);
+
+  if (mRetiredObjects.isEmpty())
+  {
+    return;
+  }
+
+  acquireQueuedObjects();
+
+  //keep the handles in step with the objects
+  int numberOfVisibleObjects = 0;
+  for (int i = 0; i < mVisibleHandles.size(); i++)
+  {
+    if (mHandleIndex.contains(mVisibleHandles[i]))
+    {
+      mVisibleObjects[numberOfVisibleObjects] = mVisibleObjects[i];
+      mVisibleHandles[numberOfVisibleObjects++] = mVisibleHandles[i];
+    }
+  }
+  mVisibleObjects.resize(numberOfVisibleObjects);
+  mVisibleHandles.resize(numberOfVisibleObjects);
+
+  deleteRetiredObjects(true);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Puts a managed expirable object in the expiration schedule. WorldObject
+ * calls this method when it becomes expirable, objects that are already
+ * scheduled are not. This method is thread-safe.
+ *
+ * @param object World object to schedule
+ */
+void WorldObjectManager::scheduleExpiration(WorldObject* object)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mMutex.lock();
+
+  //the object might have been removed while it was being scheduled
+  if (mHandleIndex.contains(object->getHandle()) &&
+      insertExpiration(object, object->getExpirationDeadline(getTime())))
+  {
+    //the expire timer belongs to the GUI thread, have it set there
+    QMetaObject::invokeMethod(this, "onExpireTimer", Qt::QueuedConnection);
+  }
+
+  mMutex.unlock();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Inserts an object into the expiration schedule. The manager must be locked.
+ *
+ * @param object World object to schedule
+ * @param deadline Time at which onExpireTimer should look at the object again
+ * @return True if the deadline is earlier than the one the timer is set for,
+ *         in which case the timer needs to be set again
+ */
+bool WorldObjectManager::insertExpiration(WorldObject* object, qint64 deadline)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mExpirations.insert(deadline, object->getHandle());
+
+  if (deadline < mNextExpiration)
+  {
+    mNextExpiration = deadline;
+    return true;
+  }
+
+  return false;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns the time of the clock expiration deadlines are kept on. The clock is
+ * monotonic and starts the first time this method gets called.
+ *
+ * @return Current time in milliseconds
+ */
+qint64 WorldObjectManager::getTime()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  static QElapsedTimer clock;
+  static bool isClockStarted = (clock.start(), true);
+  Q_UNUSED(isClockStarted);
+
+  return clock.elapsed();
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Takes the world object at the given index off the list. Instead of shifting
+ * the rest of the list, the last object is moved into the freed slot and both
+ * indices are updated. The object is retired rather than deleted, since the
+ * snapshot being rendered may still refer to it and it may still be on the
+ * queue. Retiring it under the same compare-and-swap queueObject uses keeps
+ * feeds from queueing it again. The manager must be locked.
+ *
+ * @param index Index of the world object we want to delete
+ */
+void WorldObjectManager::removeAt(int index)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  WorldObject* object = mWorldObjectList[index];
+  int lastIndex = mWorldObjectList.size() - 1;
+
+  mNameIndex.remove(object->getName());
+  mHandleIndex.remove(mHandles[index]);
+  mSpatialIndex.remove(object);
+
+  if (index != lastIndex)
+  {
+    mWorldObjectList[index] = mWorldObjectList[lastIndex];
+    mHandles[index] = mHandles[lastIndex];
+    mNameIndex.insert(mWorldObjectList[index]->getName(), index);
+    mHandleIndex.insert(mHandles[index], index);
+  }
+
+  mWorldObjectList.removeLast();
+  mHandles.removeLast();
+
+  //only queueObject races with this, it moves NOT_QUEUED objects to QUEUED
+  while (!object->mQueueState.testAndSetOrdered(WorldObject::NOT_QUEUED, WorldObject::RETIRED) &&
+         !object->mQueueState.testAndSetOrdered(WorldObject::QUEUED, WorldObject::RETIRED_QUEUED))
+  {
+  }
+
+  RetiredObject retiredObject;
+  retiredObject.object = object;
+  retiredObject.epoch = mFrameEpoch;
+  retiredObject.time = getTime();
+  mRetiredObjects.append(retiredObject);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Queues the given object, whose state just got published, for the next
+ * frame. Objects are pushed onto a lock-free stack and only once per frame,
+ * retired objects are not. WorldObject::publishState calls this method from
+ * any thread.
+ *
+ * @param object Pointer to world object
+ */
+void WorldObjectManager::queueObject(WorldObject* object)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (!object->mQueueState.testAndSetOrdered(WorldObject::NOT_QUEUED, WorldObject::QUEUED))
+  {
+    return;//already queued or retired
+  }
+
+  WorldObject* head = NULL;
+  do
+  {
+    head = mQueuedObjects.fetchAndAddOrdered(0);//atomic read
+    object->mNextQueued = head;
+  }
+  while (!mQueuedObjects.testAndSetOrdered(head, object));
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Takes the whole stack of queued objects, acquires their newest frame state
+ * and brings the spatial index up to date with it. Objects that got removed
+ * meanwhile are skipped and marked as off the queue, so deleteRetiredObjects
+ * can delete them. The geodetic positions of the acquired states are
+ * brought up to date in one batch before the index needs them. The manager
+ * must be locked.
+ */
+void WorldObjectManager::acquireQueuedObjects()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  WorldObject* object = mQueuedObjects.fetchAndStoreOrdered(NULL);
+
+  mAcquiredObjects.clear();
+  while (object != NULL)
+  {
+    WorldObject* next = object->mNextQueued;
+
+    //clear the state before acquiring, so that states published from now on
+    //queue the object again for the next frame; it only fails for retired objects
+    if (object->mQueueState.testAndSetOrdered(WorldObject::QUEUED, WorldObject::NOT_QUEUED))
+    {
+      object->acquireFrameState();
+      mAcquiredObjects.append(object);
+    }
+    else
+    {
+      object->mQueueState.fetchAndStoreOrdered(WorldObject::RETIRED);
+    }
+
+    object = next;
+  }
+
+  updateGeodeticPositions();
+
+  for (int i = 0; i < mAcquiredObjects.size(); i++)
+  {
+    if (!mSpatialIndex.update(mAcquiredObjects[i]))
+    {
+      mSpatialIndex.insert(mAcquiredObjects[i], mAcquiredObjects[i]->getHandle());
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the geodetic positions the acquired frame states are missing, i.e.
+ * the ones of objects placed with setPosition. Their positions are gathered
+ * into the transform store, converted in one batch and cached in the frame
+ * states. Objects placed with geodetic positions already have theirs.
+ */
+void WorldObjectManager::updateGeodeticPositions()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  TransformStore& store = mTransforms;
+  store.objects.clear();
+  store.x.clear();
+  store.y.clear();
+  store.z.clear();
+
+  for (int i = 0; i < mAcquiredObjects.size(); i++)
+  {
+    const WorldObject::FrameState& state = mAcquiredObjects[i]->getFrameState();
+    if (state.isGeodeticDirty)
+    {
+      store.objects.append(mAcquiredObjects[i]);
+      store.x.append(state.position.x);
+      store.y.append(state.position.y);
+      store.z.append(state.position.z);
+    }
+  }
+
+  int count = store.objects.size();
+  store.latitudes.resize(count);
+  store.longitudes.resize(count);
+  store.altitudes.resize(count);
+  Utilities::xyzToGeodetic(store.x.constData(), store.y.constData(), store.z.constData(),
+                           store.latitudes.data(), store.longitudes.data(),
+                           store.altitudes.data(), count);
+
+  for (int i = 0; i < count; i++)
+  {
+    WorldObject::FrameState& state = store.objects[i]->mStates[store.objects[i]->mFrontState];
+    state.geodeticPosition.latitude = store.latitudes[i];
+    state.geodeticPosition.longitude = store.longitudes[i];
+    state.geodeticPosition.altitude = store.altitudes[i];
+    state.isGeodeticDirty = false;
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Computes the screen locations of the visible objects of the frame. Their
+ * positions are gathered into the transform store and projected in one batch.
+ * Only the render thread may call this method.
+ */
+void WorldObjectManager::updateScreenLocations()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  TransformStore& store = mTransforms;
+  int count = mVisibleObjects.size();
+  store.x.resize(count);
+  store.y.resize(count);
+  store.z.resize(count);
+  store.screenX.resize(count);
+  store.screenY.resize(count);
+  store.screenZ.resize(count);
+
+  for (int i = 0; i < count; i++)
+  {
+    const SimpleVector& position = mVisibleObjects[i]->getFrameState().position;
+    store.x[i] = position.x;
+    store.y[i] = position.y;
+    store.z[i] = position.z;
+  }
+
+  CameraProjection::getInstance()->worldToScreen(store.x.constData(), store.y.constData(),
+                                                 store.z.constData(), store.screenX.data(),
+                                                 store.screenY.data(), store.screenZ.data(), count);
+
+  SimpleVector screenLocation;
+  for (int i = 0; i < count; i++)
+  {
+    screenLocation.x = store.screenX[i];
+    screenLocation.y = store.screenY[i];
+    screenLocation.z = store.screenZ[i];
+    mVisibleObjects[i]->setScreenLocation(screenLocation);
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Starts the break up of the clusters the spatial index reported as broken up
+ * in this frame, for the objects and clusters that came out of them.
+ */
+void WorldObjectManager::startExpansions()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  qint64 now = getTime();
+
+  for (int i = 0; i < mExpansions.size(); i++)
+  {
+    ClusterExpansion expansion;
+    expansion.startTime = now;
+    expansion.origin = mExpansions[i].origin;
+
+    if (mExpansions[i].handle != -1)
+    {
+      mObjectExpansions.insert(mExpansions[i].handle, expansion);
+    }
+    else
+    {
+      mClusterExpansions.insert(mExpansions[i].node, expansion);
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Moves the screen locations of the visible objects coming out of a cluster
+ * on their way from the cluster position, so that icons and labels follow.
+ * Finished expansions are dropped.
+ */
+void WorldObjectManager::applyExpansions()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  if (mObjectExpansions.isEmpty())
+  {
+    return;
+  }
+
+  qint64 now = getTime();
+  for (int i = 0; i < mVisibleObjects.size(); i++)
+  {
+    QHash<int, ClusterExpansion>::const_iterator expansion = mObjectExpansions.constFind(mVisibleHandles[i]);
+    if (expansion != mObjectExpansions.constEnd())
+    {
+      WorldObject* object = mVisibleObjects[i];
+      object->setScreenLocation(getExpansionLocation(expansion.value(), object->getScreenLocation(), now));
+    }
+  }
+
+  removeFinishedExpansions(mObjectExpansions, now);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Adds the icons of the visible clusters to the icon batch, sized by the
+ * number of objects in them, and their counts to the cluster count batch.
+ * Clusters obscured by the earth or behind the camera are left out.
+ */
+void WorldObjectManager::addClusters()
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  mClusterCountBatch.clear();
+  if (mVisibleClusters.isEmpty())
+  {
+    return;
+  }
+
+  IconModelManager* iconModelManager = IconModelManager::getInstance();
+  if (mClusterIcon == IconModelManager::INVALID_HANDLE)
+  {
+    mClusterIcon = iconModelManager->loadIcon("images/cluster.png");
+  }
+
+  float region[4];
+  float depth;
+  if (!iconModelManager->getIconRegion(mClusterIcon, region, depth))
+  {
+    return;
+  }
+
+  CameraProjection* cameraProjection = CameraProjection::getInstance();
+  GlyphAtlas* glyphAtlas = GlyphAtlas::getInstance();
+  GeodeticPosition cameraPosition = Camera::getInstance()->getGeodeticPosition();
+  SimpleColor white;
+  white.red = 1.0f;
+  white.green = 1.0f;
+  white.blue = 1.0f;
+  white.alpha = 1.0f;
+  qint64 now = getTime();
+
+  for (int i = 0; i < mVisibleClusters.size(); i++)
+  {
+    const SpatialIndex::Cluster& cluster = mVisibleClusters[i];
+
+    SimpleVector screenLocation = cameraProjection->worldToScreen(cluster.position);
+    if (screenLocation.z >= 1.0 ||
+        Utilities::checkObscure(cameraPosition, Utilities::xyzToGeodetic(cluster.position)))
+    {
+      continue;
+    }
+
+    QHash<int, ClusterExpansion>::const_iterator expansion = mClusterExpansions.constFind(cluster.node);
+    if (expansion != mClusterExpansions.constEnd())
+    {
+      screenLocation = getExpansionLocation(expansion.value(), screenLocation, now);
+    }
+
+    //icons grow with the number of objects in the cluster
+    float size = IconRenderer::ICON_SIZE * (1.0f + 0.25f * log10((float)cluster.count));
+    mIconBatch.addSprite(screenLocation.x, screenLocation.y, size, region, depth, white);
+
+    //center count on the icon, just in front of it
+    glyphAtlas->layoutText(QString::number(cluster.count), CLUSTER_COUNT_PIXEL_SIZE, mClusterCountRun);
+    float x = floor(screenLocation.x - mClusterCountRun.width * 0.5f);
+    float y = floor(screenLocation.y - (mClusterCountRun.ascent - mClusterCountRun.descent) * 0.5f);
+    const QVector<float>& quads = mClusterCountRun.quads;
+    for (int j = 0; j < quads.size(); j += 8)
+    {
+      mClusterCountBatch.addQuad(x + quads[j], y + quads[j+1], x + quads[j+2], y + quads[j+3],
+                                 &quads[j+4], depth + 0.0005f, white);
+    }
+  }
+
+  removeFinishedExpansions(mClusterExpansions, now);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Returns where something coming out of a cluster is drawn at the given time,
+ * on the way from the cluster position to its own screen location. The
+ * motion slows down towards the end.
+ *
+ * @param expansion Cluster break up
+ * @param screenLocation Own screen location
+ * @param now Current time, as of getTime
+ * @return Screen location to draw at
+ */
+SimpleVector WorldObjectManager::getExpansionLocation(const ClusterExpansion& expansion,
+                                                      const SimpleVector& screenLocation, qint64 now)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  double progress = (double)(now - expansion.startTime) / CLUSTER_EXPANSION_TIME;
+  if (progress >= 1.0)
+  {
+    return screenLocation;
+  }
+  progress = progress * (2.0 - progress);
+
+  SimpleVector origin = CameraProjection::getInstance()->worldToScreen(expansion.origin);
+  SimpleVector location = screenLocation;
+  location.x = origin.x + (screenLocation.x - origin.x) * progress;
+  location.y = origin.y + (screenLocation.y - origin.y) * progress;
+
+  return location;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Drops the expansions that are over.
+ *
+ * @param expansions Expansions to look at
+ * @param now Current time, as of getTime
+ */
+void WorldObjectManager::removeFinishedExpansions(QHash<int, ClusterExpansion>& expansions, qint64 now)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QHash<int, ClusterExpansion>::iterator iterator = expansions.begin();
+  while (iterator != expansions.end())
+  {
+    if (now - iterator.value().startTime >= CLUSTER_EXPANSION_TIME)
+    {
+      iterator = expansions.erase(iterator);
+    }
+    else
+    {
+      ++iterator;
+    }
+  }
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Deletes the retired objects that are off the queue, that no snapshot can
+ * refer to anymore (removed before the previous frame started, or dropped from
+ * the snapshot by onRetireTimer) and that got removed at least
+ * RETIRED_OBJECT_DELAY ago. The delay leaves feeds that fetched an object
+ * right before it got removed some time to let go of it, whether frames are
+ * being rendered or not. The manager must be locked.
+ *
+ * @param isSnapshotPruned True if the snapshot holds no removed objects
+ */
+void WorldObjectManager::deleteRetiredObjects(bool isSnapshotPruned)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  qint64 now = getTime();
+  int i = 0;
+  while (i < mRetiredObjects.size())
+  {
+    const RetiredObject& retiredObject = mRetiredObjects[i];
+    if (retiredObject.object->mQueueState.fetchAndAddOrdered(0) == WorldObject::RETIRED &&
+        (isSnapshotPruned || mFrameEpoch - retiredObject.epoch >= 2) &&
+        now - retiredObject.time >= RETIRED_OBJECT_DELAY)
+    {
+      delete retiredObject.object;
+      mRetiredObjects.removeAt(i);
+    }
+    else
+    {
+      i++;
     }
   }
 }
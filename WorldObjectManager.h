@@ -25,9 +25,16 @@
 
 #include <QWidget>
 #include <QList>
+#include <QVector>
+#include <QHash>
+#include <QMap>
 #include <QTimer>
 #include <QMutex>
+#include <QAtomicPointer>
 #include "WorldObject.h"
+#include "SpatialIndex.h"
+#include "SpriteBatch.h"
+#include "GlyphAtlas.h"
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 /**
@@ -41,6 +48,52 @@
  * Deallocation of world objects should only be done through the
  * removeWorldObject method.
  *
+ * Expirable objects are kept in a schedule sorted by deadline, and the expire
+ * timer is set for the earliest one, so only objects that are due get looked
+ * at. Resetting an object's expiration time does not touch the schedule: when
+ * the old deadline comes due the object is put back with its new one. Objects
+ * get flagged as expired at their deadline and removed EXPIRATION_GRACE_TIME
+ * later, all the objects due at once in a single pass.
+ *
+ * Objects are indexed by name and by the handle addWorldObject returns, so
+ * lookups and removals take constant time no matter how many objects there
+ * are. Handles stay valid until the object is removed and are never reused,
+ * whereas indices are only good for looping over the objects: removing an
+ * object moves the last one into its place. Names must not change while
+ * objects are in the manager.
+ *
+ * Objects are also kept in a SpatialIndex, so renderObjects only visits the
+ * objects inside the view frustum. Those are the visible objects of the
+ * frame, the HUD labels and picking (see intersectRay) loop over them instead
+ * of the whole list.
+ * The per-frame conversions (geodetic positions of the updated objects,
+ * screen locations of the visible ones) are done in batches over a
+ * structure-of-arrays TransformStore instead of object by object.
+ *
+ * Feed threads never wait for a frame. Objects publish their updates through
+ * their own triple buffer (see WorldObject) and queue themselves on a
+ * lock-free stack, renderObjects acquires the queued states, takes the frame
+ * snapshot and unlocks the manager before rendering it. Removed objects are
+ * retired with the current frame epoch: they can not be queued anymore and
+ * are only deleted once they are off the queue, no snapshot refers to them
+ * (two frames later, or once onRetireTimer drops them from the snapshot if no
+ * frames get rendered) and RETIRED_OBJECT_DELAY has gone by, so feeds that
+ * fetched one right before its removal have time to let go of it.
+ *
+ * Objects that crowd together on screen are clustered: renderObjects asks the
+ * SpatialIndex for the nodes that look smaller than CLUSTER_SIZE pixels and
+ * draws each as one cluster icon with the number of objects on it, instead of
+ * the icons, meshes and labels of its objects. Clustered objects are not part
+ * of the visible objects. As the camera gets closer clusters break up, and
+ * what comes out of them moves from the cluster position to its own over
+ * CLUSTER_EXPANSION_TIME.
+ *
+ * High-rate feeds should go through updateTracks instead of fetching objects
+ * and calling their set methods. It takes arrays of updates keyed by handle,
+ * keeps only the latest update per object until the next frame, and converts
+ * the positions of a whole frame worth of updates in one batch on the render
+ * thread (see applyTrackUpdates).
+ *
  * @version 1.1
  * @author Hector Mendoza
  */
@@ -50,27 +103,151 @@ class WorldObjectManager : public QWidget
   Q_OBJECT
 
   public:
+    static const int INVALID_HANDLE = 0;
+    static const int VISIBILITY_MARGIN = 64;//in pixels, for icons and labels
+    static const int EXPIRATION_GRACE_TIME = 2000;//in ms, from expired to removed
+    static const int CLUSTER_SIZE = 48;//in pixels, largest extent of a cluster on screen
+    static const int CLUSTER_EXPANSION_TIME = 400;//in ms, for clusters breaking up
+    static const int CLUSTER_COUNT_PIXEL_SIZE = 15;//font size of cluster counts
+    static const int RETIRED_OBJECT_DELAY = 1000;//in ms, from removed to deleted at the earliest
+
+    struct TrackUpdate
+    {
+      int handle;//as returned by addWorldObject
+      double latitude;//in decimal degrees
+      double longitude;//in decimal degrees
+      double altitude;//in Km
+      float heading;//in degrees, clockwise from north
+      float speed;
+      qint64 timestamp;//newer updates win, any monotonic unit
+    };
+
     static WorldObjectManager* getInstance();
+    static qint64 getTime();
     ~WorldObjectManager();
 
-    bool addWorldObject(WorldObject* object);
+    int addWorldObject(WorldObject* object);
     WorldObject* getWorldObject(int index);
     WorldObject* getWorldObject(const QString& name);
+    WorldObject* getWorldObjectFromHandle(int handle);
+    int getHandle(int index);
     void removeWorldObject(int index);
     void removeWorldObject(const QString& name);
+    void removeWorldObjectFromHandle(int handle);
     void renderObjects();
     int getNumberOfObjects();
     int findWorldObject(const QString& name);
+    int findWorldObjectFromHandle(int handle);
+    int getNumberOfVisibleObjects();
+    WorldObject* getVisibleObject(int index);
+    int getNumberOfVisibleClusters();
+    const SpatialIndex::Cluster& getVisibleCluster(int index);
+    bool intersectRay(const SimpleVector& origin, const SimpleVector& direction, double& distance);
+    bool getClusterObjects();
+    void setClusterObjects(bool cluster);
+    void queueObject(WorldObject* object);
+    void scheduleExpiration(WorldObject* object);
+    void updateTracks(const TrackUpdate* updates, int count);
+    void applyTrackUpdates();
+    int getNumberOfPendingTrackUpdates();
 
   public slots:
     void onExpireTimer();
+    void onRetireTimer();
 
   private:
+    //coalesced track updates, stored as separate arrays for batch conversion
+    struct TrackBatch
+    {
+      QHash<int, int> handleSlots;//slot of every handle
+      QVector<int> handles;
+      QVector<double> latitudes;
+      QVector<double> longitudes;
+      QVector<double> altitudes;
+      QVector<float> headings;
+      QVector<float> speeds;
+      QVector<qint64> timestamps;
+      QVector<double> x;
+      QVector<double> y;
+      QVector<double> z;
+    };
+
+    static const qint64 NO_EXPIRATION = Q_INT64_C(0x7fffffffffffffff);
+
+    //positions of a set of objects stored as separate arrays, so per-frame
+    //passes over them stream through memory and can be vectorized
+    struct TransformStore
+    {
+      QVector<WorldObject*> objects;
+      QVector<double> x;
+      QVector<double> y;
+      QVector<double> z;
+      QVector<double> latitudes;
+      QVector<double> longitudes;
+      QVector<double> altitudes;
+      QVector<double> screenX;
+      QVector<double> screenY;
+      QVector<double> screenZ;
+    };
+
+    //cluster break up in progress, see CLUSTER_EXPANSION_TIME
+    struct ClusterExpansion
+    {
+      qint64 startTime;//as of getTime
+      SimpleVector origin;//position of the cluster that broke up
+    };
+
+    struct RetiredObject
+    {
+      WorldObject* object;
+      unsigned int epoch;//frame epoch the object got removed in
+      qint64 time;//as of getTime, when the object got removed
+    };
+
     WorldObjectManager();//private due to Singleton implementation
+    void removeAt(int index);
+    void acquireQueuedObjects();
+    void deleteRetiredObjects(bool isSnapshotPruned);
+    void updateGeodeticPositions();
+    void updateScreenLocations();
+    void startExpansions();
+    void applyExpansions();
+    void addClusters();
+    SimpleVector getExpansionLocation(const ClusterExpansion& expansion,
+                                      const SimpleVector& screenLocation, qint64 now);
+    static void removeFinishedExpansions(QHash<int, ClusterExpansion>& expansions, qint64 now);
+    bool insertExpiration(WorldObject* object, qint64 deadline);
 
     static WorldObjectManager* mInstance;
     QList<WorldObject*> mWorldObjectList;
+    QList<int> mHandles;//handle of every object in the list
+    QHash<QString, int> mNameIndex;//list index of every name
+    QHash<int, int> mHandleIndex;//list index of every handle
+    int mNextHandle;
+    SpatialIndex mSpatialIndex;
+    QVector<int> mVisibleHandles;//handle of every visible object
+    QVector<WorldObject*> mVisibleObjects;//snapshot of the last frame
+    QVector<SpatialIndex::Cluster> mVisibleClusters;//clusters of the last frame
+    QVector<SpatialIndex::Expansion> mExpansions;//clusters broken up in the last frame
+    QHash<int, ClusterExpansion> mObjectExpansions;//by object handle
+    QHash<int, ClusterExpansion> mClusterExpansions;//by cluster node
+    bool mClusterObjects;
+    int mClusterIcon;//IconModelManager handle of the cluster icon
+    GlyphAtlas::GlyphRun mClusterCountRun;
+    SpriteBatch mClusterCountBatch;//cluster counts of the frame, drawn in one call
+    QVector<WorldObject*> mAcquiredObjects;//objects acquired for this frame
+    TransformStore mTransforms;//scratch store for the per-frame passes
+    SpriteBatch mIconBatch;//icons of the frame, drawn in one call
+    QAtomicPointer<WorldObject> mQueuedObjects;//objects updated since then
+    QList<RetiredObject> mRetiredObjects;
+    unsigned int mFrameEpoch;
+    TrackBatch mTrackBatches[2];
+    int mPendingTrackBatch;//batch updateTracks writes into
+    QMutex mTrackMutex;
+    QMultiMap<qint64, int> mExpirations;//handles by deadline
+    qint64 mNextExpiration;//deadline the expire timer is set for
     QTimer* mExpireTimer;
+    QTimer* mRetireTimer;//frees retired objects when no frames get rendered
     QMutex mMutex;
 };
 
@@ -24,7 +24,7 @@
 #define GLOBALS_H
 
 //define modules to be used
-//uncomment next line if you want to use elevation databases
+//uncomment next line if you want to use elevation databases other than GeoTIFF
 //#define USING_GDAL
 //uncomment next line if you want to use satellite imagery
 //#define USING_PROJ4
@@ -25,10 +25,14 @@
 #include "MainWindow.h"
 #include "CrossPlatformSleep.h"
 #include "ElevationManager.h"
+#include "QuantizedMeshManager.h"
 #include "SatelliteImageDownloader.h"
 #include "ExampleHelloWorld.h"
 #include "ExampleFlyObject.h"
 #include "ExampleExpirableObject.h"
+#include "ExampleElevationBenchmark.h"
+#include "ExampleViewshed.h"
+#include "ExampleTrackBenchmark.h"
 
 //DOXYGEN MAIN PAGE
 /**
@@ -85,7 +89,6 @@ int main(int argc, char* argv[])
   app.processEvents();
 
 //give time for splash screen to show up
-#ifndef USING_GDAL
 #ifdef WIN32
   CrossPlatformSleep::msleep(1500);
 #else
@@ -97,30 +100,26 @@ int main(int argc, char* argv[])
     CrossPlatformSleep::msleep(1);
   }
 #endif//WIN32
-#endif//USING_GDAL
 
   //instantiate main GUI window, this will instantiate GLWidget and other sub objects
   MainWindow* mainWindow = MainWindow::getInstance();
 
   //instantiate "plugin" objects
   //NOTE: DEFINITIONS FOR USING_GDAL AND USING_PROJ4 ARE LOCATED IN globals.h
-  //ElevationManager loads elevation databases
-#ifdef USING_GDAL
-  //load elevation database at startup
-  splash.showMessage("Loading elevation database...", Qt::AlignLeft | Qt::AlignBottom, Qt::white);
+  //ElevationManager loads elevation databases, GeoTIFF files are read without GDAL
+  //register elevation databases at startup, they are loaded as the camera gets to them
+  splash.showMessage("Loading elevation databases...", Qt::AlignLeft | Qt::AlignBottom, Qt::white);
   app.processEvents();
-  ElevationManager* elevationManager = ElevationManager::getInstance();
-  elevationManager->loadElevationDatabase("elevation/imgn32w107_1.img");//load example elevation database
-#endif
+  ElevationManager::getInstance()->addElevationDirectory("elevation");
+  //uncomment next line to drape maps over quantized-mesh terrain tiles (a directory or zip archive)
+  //QuantizedMeshManager::getInstance()->openTerrain("terrain");
 
   //SatelliteImageDownloader downloads sattelite imagery
 #ifdef USING_PROJ4
   //instantiate object and start image download thread
   SatelliteImageDownloader* satelliteImageDownloader = new SatelliteImageDownloader();
   satelliteImageDownloader->start();
-#ifdef USING_GDAL
   satelliteImageDownloader->setElevationMode(true);
-#endif//USING_GDAL
 #endif//USING_PROJ4
 
   //++++++++++++++++++++++++++++
@@ -138,6 +137,20 @@ int main(int argc, char* argv[])
   //ExampleExpirableObject* exampleExpirableObject = new ExampleExpirableObject();
   //exampleExpirableObject->start();
 
+  //uncomment next couple of lines if you want to benchmark elevation database loading
+  //ExampleElevationBenchmark* exampleElevationBenchmark = new ExampleElevationBenchmark();
+  //exampleElevationBenchmark->run("elevation");
+  //exampleElevationBenchmark->runSampling(1000000);
+  //exampleElevationBenchmark->runCompressedStorage(1000000);
+
+  //uncomment next couple of lines if you want to run example on line of sight and viewshed analysis
+  //ExampleViewshed* exampleViewshed = new ExampleViewshed();
+  //exampleViewshed->run();
+
+  //uncomment next couple of lines if you want to benchmark feeding track updates
+  //ExampleTrackBenchmark* exampleTrackBenchmark = new ExampleTrackBenchmark();
+  //exampleTrackBenchmark->run(10000);
+
   //END OF EXAMPLES
   //++++++++++++++++++++++++++++
 
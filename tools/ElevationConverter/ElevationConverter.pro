@@ -0,0 +1,45 @@
+TEMPLATE = app
+TARGET = ElevationConverter
+
+#GeoTiffReader decodes JPEG tiles through QImage
+QT = core gui
+CONFIG += console
+CONFIG -= app_bundle
+
+#converter always needs GDAL to read the source databases
+DEFINES += USING_GDAL
+
+#terrain meshes need OpenGL, converted databases never fall back to them
+DEFINES += NO_QUANTIZED_MESH
+
+INCLUDEPATH += ../..
+
+win32 {
+  INCLUDEPATH += ../../FWTools/include
+  LIBS += -L../../FWTools/lib \
+    -lgdal_i
+} else {
+  INCLUDEPATH += /usr/include/gdal
+  LIBS += -lgdal
+}
+
+HEADERS += ../../CrossPlatformSleep.h \
+    ../../ElevationBounds.h \
+    ../../ElevationCache.h \
+    ../../ElevationDataset.h \
+    ../../ElevationLoaderThread.h \
+    ../../ElevationManager.h \
+    ../../ElevationSampler.h \
+    ../../ElevationTileStore.h \
+    ../../GeoTiffReader.h
+
+SOURCES += ../../CrossPlatformSleep.cpp \
+    ../../ElevationBounds.cpp \
+    ../../ElevationCache.cpp \
+    ../../ElevationDataset.cpp \
+    ../../ElevationLoaderThread.cpp \
+    ../../ElevationManager.cpp \
+    ../../ElevationSampler.cpp \
+    ../../ElevationTileStore.cpp \
+    ../../GeoTiffReader.cpp \
+    main.cpp
@@ -0,0 +1,82 @@
+/*
+ *  The Simple Earth Project
+ *  Copyright (C) 2022 HueSoft LLC
+ *  Author: Hector Mendoza, hector.mendoza@huesoftllc.com
+ *
+ *  This file is part of the Simple Earth Project.
+ *
+ *  The Simple Earth Project is free software: you can redistribute it
+ *  and/or modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation, either version
+ *  3 of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QThread>
+#include "CrossPlatformSleep.h"
+#include "ElevationDataset.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+/**
+ * Command line tool that converts any elevation database GDAL can read into a
+ * SimpleEarth elevation cache file (see ElevationCache). SimpleEarth maps the
+ * cache file at startup instead of reading the source database.
+ *
+ * Usage: ElevationConverter <source database> [cache file]
+ *
+ * If no cache file is given, it is written next to the source database with a
+ * .sec extension, which is where SimpleEarth looks for it.
+ */
+int main(int argc, char* argv[])
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+{
+  QCoreApplication app(argc, argv);
+  QStringList arguments = app.arguments();
+
+  if (arguments.size() < 2)
+  {
+    printf("Usage: ElevationConverter <source database> [cache file]\n");
+    return 1;
+  }
+
+  QString sourcePath = arguments[1];
+  QString cachePath = (arguments.size() > 2) ? arguments[2] : ElevationCache::getCachePath(sourcePath);
+
+  ElevationDataset dataset(sourcePath);
+  if (!dataset.open() || dataset.getIsCache() || !dataset.startLoading(QThread::idealThreadCount()))
+  {
+    printf("ElevationConverter: Error opening %s.\n", sourcePath.toStdString().c_str());
+    return 1;
+  }
+
+  while (dataset.getIsLoading())
+  {
+    printf("\rReading %s... %d%%", sourcePath.toStdString().c_str(), (dataset.getLoadProgress() * 100) / dataset.getHeight());
+    fflush(stdout);
+    CrossPlatformSleep::msleep(100);
+  }
+  dataset.waitForLoading();
+  printf("\n");
+
+  printf("Writing %s...\n", cachePath.toStdString().c_str());
+  if (!dataset.saveCache(cachePath))
+  {
+    printf("ElevationConverter: Error converting %s.\n", sourcePath.toStdString().c_str());
+    return 1;
+  }
+
+  printf("Done.\n");
+  return 0;
+}